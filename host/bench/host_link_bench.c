@@ -0,0 +1,458 @@
+/*
+ * Host library RX path : frames/s and CPU per frame for a synthetic LCP stream.
+ *
+ * A writer thread pushes back to back LCP frames into a pipe, a feeder thread
+ * decodes them and a consumer waits in epoll for them, as an application would.
+ *   naive   : per frame header + payload read(), malloc per frame, one wakeup per frame
+ *   batched : host_link (64KB reads, pool frames, one eventfd wakeup per batch)
+ *
+ * spidev mode drives a real SPI link through hw_transport_spidev and the link
+ * thread instead. Without a handshake line the bus must be looped back (MOSI to
+ * MISO): every frame sent comes back through the two-phase exchange and must
+ * match byte for byte, the run fails otherwise. With a handshake line the
+ * module is on the bus and the frames it sends are counted for frames/s.
+ *
+ * usage : host_link_bench [frames]
+ *         host_link_bench spidev <spidev> [frames] [speed_hz] [gpiochip line]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include "host_link.h"
+#include "hw_transport_spidev.h"
+
+#define STREAM_FRAMES       (256)
+#define TICK_NS             (1000000ULL)
+#define SPIDEV_WINDOW       (32)        /* Loopback frames in flight */
+#define SPIDEV_IDLE_NS      (2000000000ULL)
+
+typedef struct bench_ctx
+{
+    int rd_fd;
+    int wr_fd;
+    int event_fd;               /* naive mode */
+    host_link *link;            /* batched mode */
+    lcp_frame_queue queue;      /* naive mode, frames are malloc'ed */
+
+    u8 *stream;
+    int stream_len;
+    long frames;
+    long rate;                  /* frames/s, 0 = unlimited */
+
+    int done;
+    uint64_t writer_cpu_ns;
+    long received;
+    long wakeups;
+} bench_ctx;
+
+static uint64_t ts_ns(clockid_t clock)
+{
+    struct timespec ts;
+
+    clock_gettime(clock, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void build_stream(bench_ctx *ctx, int payload_len)
+{
+    u8 payload[HW_LCP_MAX_PAYLOAD_LEN];
+    u8 *frame;
+    int i, len;
+
+    ctx->stream = malloc(STREAM_FRAMES * (payload_len + HW_LCP_OVERHEAD));
+    ctx->stream_len = 0;
+    for (i = 0; i < payload_len; i++)
+    {
+        payload[i] = (u8)i;
+    }
+
+    for (i = 0; i < STREAM_FRAMES; i++)
+    {
+        len = payload_len;
+        frame = hw_frame_assemble_type(payload, &len, (i % 8) ? HW_LCP_TYPE_80211 : HW_LCP_TYPE_8023);
+        memcpy(&ctx->stream[ctx->stream_len], frame, len);
+        ctx->stream_len += len;
+    }
+}
+
+static void write_all(int fd, const u8 *buf, int len)
+{
+    int ret;
+
+    while (len > 0)
+    {
+        ret = write(fd, buf, len);
+        if (ret < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return;
+        }
+        buf += ret;
+        len -= ret;
+    }
+}
+
+static void *writer_thread(void *arg)
+{
+    bench_ctx *ctx = (bench_ctx *)arg;
+    int frame_len = ctx->stream_len / STREAM_FRAMES;
+    long per_tick = ctx->rate ? (ctx->rate * (long)TICK_NS / 1000000000L) : STREAM_FRAMES;
+    uint64_t next = ts_ns(CLOCK_MONOTONIC);
+    struct timespec ts;
+    long sent = 0, n, off = 0;
+
+    if (per_tick < 1)
+    {
+        per_tick = 1;
+    }
+
+    while (sent < ctx->frames)
+    {
+        n = per_tick;
+        if (n > ctx->frames - sent)
+        {
+            n = ctx->frames - sent;
+        }
+        if (n > STREAM_FRAMES - off)
+        {
+            n = STREAM_FRAMES - off;
+        }
+        write_all(ctx->wr_fd, &ctx->stream[off * frame_len], n * frame_len);
+        sent += n;
+        off = (off + n) % STREAM_FRAMES;
+
+        if (ctx->rate && off % per_tick == 0)
+        {
+            next += TICK_NS;
+            ts.tv_sec  = next / 1000000000ULL;
+            ts.tv_nsec = next % 1000000000ULL;
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+        }
+    }
+
+    ctx->writer_cpu_ns = ts_ns(CLOCK_THREAD_CPUTIME_ID);
+    close(ctx->wr_fd);
+    return NULL;
+}
+
+static int read_exact(int fd, u8 *buf, int len)
+{
+    int done = 0, ret;
+
+    while (done < len)
+    {
+        ret = read(fd, buf + done, len - done);
+        if (ret <= 0)
+        {
+            if (ret < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+        done += ret;
+    }
+    return 0;
+}
+
+/* naive feeder : two read() per frame, one malloc per frame, one eventfd write per frame */
+static void *naive_feeder(void *arg)
+{
+    bench_ctx *ctx = (bench_ctx *)arg;
+    u8 hdr[PAYLOAD_FIELD];
+    uint64_t one = 1;
+    lcp_frame *frame;
+    int len;
+
+    while (read_exact(ctx->rd_fd, hdr, sizeof(hdr)) == 0)
+    {
+        len = hdr[PAYLOAD_LEN_FIELD1] | (hdr[PAYLOAD_LEN_FIELD2] << 8);
+        frame = malloc(sizeof(lcp_frame) + 1);     /* Payload read together with the end flag */
+        if (read_exact(ctx->rd_fd, frame->data, len + 1) < 0)
+        {
+            free(frame);
+            break;
+        }
+        frame->type = hdr[HW_LCP_TYPE_FIELD];
+        frame->len = len;
+        while (lcp_frame_queue_push(&ctx->queue, frame) < 0)
+        {
+            sched_yield();
+        }
+        if (write(ctx->event_fd, &one, sizeof(one)) < 0)
+        {
+            break;
+        }
+    }
+
+    __atomic_store_n(&ctx->done, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+static void *batched_feeder(void *arg)
+{
+    bench_ctx *ctx = (bench_ctx *)arg;
+    struct pollfd pfd = { .fd = ctx->rd_fd, .events = POLLIN };
+    int ret;
+
+    fcntl(ctx->rd_fd, F_SETFL, fcntl(ctx->rd_fd, F_GETFL) | O_NONBLOCK);
+    while ((ret = host_link_feed_fd(ctx->link, ctx->rd_fd)) != HOST_LINK_EOF)
+    {
+        if (ret == HOST_LINK_BUSY)
+        {
+            sched_yield();      /* Consumer is behind, the pipe holds the rest */
+        }
+        else if (ret == 0)
+        {
+            poll(&pfd, 1, 100);
+        }
+    }
+
+    __atomic_store_n(&ctx->done, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+static void consume(bench_ctx *ctx, int batched)
+{
+    lcp_frame *frames[HOST_LINK_BATCH];
+    struct epoll_event ev = { .events = EPOLLIN };
+    int epfd = epoll_create1(0);
+    int fd = batched ? host_link_fd(ctx->link) : ctx->event_fd;
+    volatile u8 sum = 0;
+    uint64_t value;
+    int n, i, done;
+
+    epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+
+    while (1)
+    {
+        done = __atomic_load_n(&ctx->done, __ATOMIC_ACQUIRE);
+        if (epoll_wait(epfd, &ev, 1, 10) > 0)
+        {
+            ctx->wakeups++;
+        }
+
+        if (batched)
+        {
+            while ((n = host_link_recv_batch(ctx->link, frames, HOST_LINK_BATCH)) > 0)
+            {
+                for (i = 0; i < n; i++)
+                {
+                    sum += frames[i]->data[frames[i]->len - 1];
+                }
+                host_link_release(ctx->link, frames, n);
+                ctx->received += n;
+            }
+        }
+        else
+        {
+            if (read(ctx->event_fd, &value, sizeof(value)) < 0 && errno != EAGAIN)
+            {
+                break;
+            }
+            while ((n = lcp_frame_queue_pop(&ctx->queue, frames, 1)) > 0)
+            {
+                sum += frames[0]->data[frames[0]->len - 1];
+                free(frames[0]);
+                ctx->received++;
+            }
+        }
+
+        /* Everything was queued before done was set, so this drain was the last one */
+        if (done)
+        {
+            break;
+        }
+    }
+
+    close(epfd);
+}
+
+static void run(const char *mode, int payload_len, long frames, long rate)
+{
+    int batched = !strcmp(mode, "batched");
+    static bench_ctx ctx;
+    pthread_t writer, feeder;
+    host_link_stats stats = {0};
+    uint64_t t0, c0, wall, cpu;
+    int fds[2];
+
+    memset(&ctx, 0x0, sizeof(ctx));
+    if (pipe(fds) < 0)
+    {
+        return;
+    }
+    fcntl(fds[1], F_SETPIPE_SZ, 1024 * 1024);
+    ctx.rd_fd  = fds[0];
+    ctx.wr_fd  = fds[1];
+    ctx.frames = frames;
+    ctx.rate   = rate;
+    build_stream(&ctx, payload_len);
+
+    if (batched)
+    {
+        ctx.link = host_link_create(NULL);
+    }
+    else
+    {
+        ctx.event_fd = eventfd(0, EFD_NONBLOCK);
+        lcp_frame_queue_init(&ctx.queue);
+    }
+
+    t0 = ts_ns(CLOCK_MONOTONIC);
+    c0 = ts_ns(CLOCK_PROCESS_CPUTIME_ID);
+    pthread_create(&writer, NULL, writer_thread, &ctx);
+    pthread_create(&feeder, NULL, batched ? batched_feeder : naive_feeder, &ctx);
+    consume(&ctx, batched);
+    pthread_join(writer, NULL);
+    pthread_join(feeder, NULL);
+    wall = ts_ns(CLOCK_MONOTONIC) - t0;
+    cpu  = ts_ns(CLOCK_PROCESS_CPUTIME_ID) - c0 - ctx.writer_cpu_ns;
+
+    if (batched)
+    {
+        host_link_get_stats(ctx.link, &stats);
+        host_link_destroy(ctx.link);
+    }
+    else
+    {
+        close(ctx.event_fd);
+    }
+    close(ctx.rd_fd);
+    free(ctx.stream);
+
+    printf("%-8s %5d %9ld %10ld %12.0f %10.1f %9.2f %8lu\n", mode, payload_len, rate, ctx.received,
+           ctx.received * 1e9 / wall, (double)cpu / ctx.received,
+           (double)ctx.received / (ctx.wakeups ? ctx.wakeups : 1), stats.rx_stalls);
+}
+
+/* Loopback frame i : index, then a pattern, over 64 / 256 / 512 byte payloads */
+static int spidev_frame(long i, u8 *payload)
+{
+    static const int sizes[] = { 64, 256, 512 };
+    int len = sizes[i % 3], k;
+
+    memcpy(payload, &i, sizeof(uint32_t));
+    for (k = sizeof(uint32_t); k < len; k++)
+    {
+        payload[k] = (u8)(i + k);
+    }
+    return len;
+}
+
+static int run_spidev(const hw_transport_spidev_config *config, long frames)
+{
+    lcp_frame *batch[HOST_LINK_BATCH];
+    u8 expect[HW_LCP_MAX_PAYLOAD_LEN];
+    int loopback = (config->handshake_line < 0);
+    hw_transport *transport = hw_transport_spidev_create(config);
+    struct pollfd pfd = { .events = POLLIN };
+    long sent = 0, received = 0, mismatched = 0;
+    unsigned long bytes = 0;
+    host_link_stats stats;
+    uint64_t t0, last;
+    host_link *link;
+    int n, i, len;
+
+    link = transport ? host_link_create(transport) : NULL;
+    if (!link || host_link_start(link) < 0)
+    {
+        ERROR_PRINT("can not start the link on [%s]\n", config->spidev);
+        host_link_destroy(link);
+        hw_transport_spidev_destroy(transport);
+        return 1;
+    }
+    pfd.fd = host_link_fd(link);
+
+    t0 = last = ts_ns(CLOCK_MONOTONIC);
+    while (received < frames && ts_ns(CLOCK_MONOTONIC) - last < SPIDEV_IDLE_NS)
+    {
+        while (loopback && sent < frames && sent - received < SPIDEV_WINDOW)
+        {
+            len = spidev_frame(sent, expect);
+            if (host_link_send(link, HW_LCP_TYPE_80211, expect, len) < 0)
+            {
+                break;
+            }
+            sent++;
+        }
+
+        poll(&pfd, 1, 10);
+        while ((n = host_link_recv_batch(link, batch, HOST_LINK_BATCH)) > 0)
+        {
+            for (i = 0; i < n; i++)
+            {
+                if (loopback)
+                {
+                    len = spidev_frame(received, expect);
+                    mismatched += (batch[i]->len != len || memcmp(batch[i]->data, expect, len) != 0);
+                }
+                bytes += batch[i]->len;
+                received++;
+            }
+            host_link_release(link, batch, n);
+            last = ts_ns(CLOCK_MONOTONIC);
+        }
+    }
+    t0 = last - t0;
+
+    host_link_get_stats(link, &stats);
+    host_link_destroy(link);
+    hw_transport_spidev_destroy(transport);
+
+    printf("%-8s %s %u Hz, %s\n", "spidev", config->spidev, (unsigned int)config->speed_hz,
+           loopback ? "loopback" : "module");
+    printf("received %ld / %ld, %.0f frames/s, %.2f MB/s payload, mismatched %ld, rx_dropped %lu\n",
+           received, loopback ? sent : frames, t0 ? received * 1e9 / t0 : 0.0, t0 ? bytes * 1e3 / t0 : 0.0,
+           mismatched, stats.rx_dropped);
+    return (received < frames || mismatched) ? 1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+    long frames;
+    static const int sizes[] = { 64, 256, 512 };
+    static const long rates[] = { 0, 100000 };
+    size_t s, r;
+
+    if (argc > 2 && !strcmp(argv[1], "spidev"))
+    {
+        hw_transport_spidev_config config =
+        {
+            .spidev         = argv[2],
+            .gpiochip       = (argc > 5) ? argv[5] : NULL,
+            .handshake_line = (argc > 6) ? atoi(argv[6]) : -1,
+            .speed_hz       = (argc > 4) ? (uint32_t)atol(argv[4]) : HW_TRANSPORT_SPIDEV_SPEED_HZ,
+        };
+
+        return run_spidev(&config, (argc > 3) ? atol(argv[3]) : 100000);
+    }
+
+    frames = (argc > 1) ? atol(argv[1]) : 500000;
+    printf("frames=%ld (rate 0 = unlimited)\n", frames);
+    printf("%-8s %5s %9s %10s %12s %10s %9s %8s\n",
+           "mode", "len", "rate", "received", "frames/s", "cpu_ns/fr", "fr/wake", "stalls");
+
+    for (r = 0; r < sizeof(rates) / sizeof(rates[0]); r++)
+    {
+        for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+        {
+            run("naive", sizes[s], frames, rates[r]);
+            run("batched", sizes[s], frames, rates[r]);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,192 @@
+/*
+ * 802.11 -> 802.3 conversion : SPI bytes saved per frame and conversion cost.
+ *
+ * usage : ieee80211_conv_bench [iterations]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "ieee80211_conv.h"
+#include "ring_buff.h"
+
+typedef struct sample_frame
+{
+    const char *name;
+    u8 buf[MAX_BUFFER_SIZE];
+    int len;
+} sample_frame;
+
+typedef struct conv_sink
+{
+    int frames;
+    int bytes;
+} conv_sink;
+
+static const u8 bssid[] = { 0x00, 0x11, 0x22, 0x33, 0x44, 0x55 };
+static const u8 sta[]   = { 0x24, 0x0a, 0xc4, 0x01, 0x02, 0x03 };
+static const u8 peer[]  = { 0x3c, 0x22, 0xfb, 0x10, 0x20, 0x30 };
+static const u8 snap_ipv4[] = { 0xaa, 0xaa, 0x03, 0x00, 0x00, 0x00, 0x08, 0x00 };
+static const u8 snap_arp[]  = { 0xaa, 0xaa, 0x03, 0x00, 0x00, 0x00, 0x08, 0x06 };
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int put(u8 *p, const void *src, int len)
+{
+    memcpy(p, src, len);
+    return len;
+}
+
+static int fill(u8 *p, int len)
+{
+    int i;
+
+    for (i = 0; i < len; i++)
+    {
+        p[i] = (u8)(i * 7);
+    }
+    return len;
+}
+
+/* FromDS data header : Addr1 = DA, Addr2 = BSSID, Addr3 = SA */
+static int from_ds_hdr(u8 *p, int qos, int amsdu)
+{
+    int n = 0;
+
+    p[n++] = qos ? 0x88 : 0x08;
+    p[n++] = 0x02;
+    p[n++] = 0x00;
+    p[n++] = 0x00;
+    n += put(&p[n], sta, 6);
+    n += put(&p[n], bssid, 6);
+    n += put(&p[n], peer, 6);
+    p[n++] = 0x10;
+    p[n++] = 0x00;
+    if (qos)
+    {
+        p[n++] = amsdu ? 0x80 : 0x00;
+        p[n++] = 0x00;
+    }
+    return n;
+}
+
+static void build_samples(sample_frame *s)
+{
+    u8 *p;
+    int n, i;
+
+    s[0].name = "qos-ipv4-100";
+    p = s[0].buf;
+    n = from_ds_hdr(p, 1, 0);
+    n += put(&p[n], snap_ipv4, sizeof(snap_ipv4));
+    n += fill(&p[n], 100);
+    s[0].len = n;
+
+    s[1].name = "data-arp";
+    p = s[1].buf;
+    n = from_ds_hdr(p, 0, 0);
+    n += put(&p[n], snap_arp, sizeof(snap_arp));
+    n += fill(&p[n], 28);
+    s[1].len = n;
+
+    s[2].name = "qos-ipv4-400";
+    p = s[2].buf;
+    n = from_ds_hdr(p, 1, 0);
+    n += put(&p[n], snap_ipv4, sizeof(snap_ipv4));
+    n += fill(&p[n], 400);
+    s[2].len = n;
+
+    s[3].name = "amsdu-3x64";
+    p = s[3].buf;
+    n = from_ds_hdr(p, 1, 1);
+    for (i = 0; i < 3; i++)
+    {
+        n += put(&p[n], sta, 6);
+        n += put(&p[n], peer, 6);
+        p[n++] = 0x00;
+        p[n++] = (u8)(sizeof(snap_ipv4) + 64);
+        n += put(&p[n], snap_ipv4, sizeof(snap_ipv4));
+        n += fill(&p[n], 64);
+        if (i < 2)
+        {
+            n = (n - 26 + 3) / 4 * 4 + 26;
+        }
+    }
+    s[3].len = n;
+
+    s[4].name = "llc-stp-38";
+    p = s[4].buf;
+    n = from_ds_hdr(p, 0, 0);
+    p[n++] = 0x42;
+    p[n++] = 0x42;
+    p[n++] = 0x03;
+    n += fill(&p[n], 35);
+    s[4].len = n;
+}
+
+static void sink_cb(void *ctx, u8 *frame, int len)
+{
+    conv_sink *sink = (conv_sink *)ctx;
+
+    sink->frames++;
+    sink->bytes += len;
+}
+
+int main(int argc, char **argv)
+{
+    long iterations = (argc > 1) ? atol(argv[1]) : 1000000;
+    static sample_frame samples[5];
+    static u8 out[MAX_BUFFER_SIZE], back[MAX_BUFFER_SIZE + 64];
+    volatile int guard = 0;
+    size_t i;
+    long j;
+
+    build_samples(samples);
+
+    printf("iterations=%ld\n", iterations);
+    printf("%-14s %7s %7s %7s %8s %11s %11s\n",
+           "frame", "in_len", "out_len", "frames", "saved", "to8023_ns", "to80211_ns");
+
+    for (i = 0; i < sizeof(samples) / sizeof(samples[0]); i++)
+    {
+        conv_sink sink = {0};
+        uint64_t t0, t_conv, t_back;
+        int eth_len;
+
+        if (ieee80211_data_to_8023(samples[i].buf, samples[i].len, out, sizeof(out), sink_cb, &sink) < 0)
+        {
+            printf("%-14s conversion failed\n", samples[i].name);
+            continue;
+        }
+        eth_len = sink.bytes / sink.frames;
+
+        t0 = now_ns();
+        for (j = 0; j < iterations; j++)
+        {
+            guard += ieee80211_data_to_8023(samples[i].buf, samples[i].len, out, sizeof(out), NULL, NULL);
+        }
+        t_conv = now_ns() - t0;
+
+        ieee80211_data_to_8023(samples[i].buf, samples[i].len, out, sizeof(out), NULL, NULL);
+        t0 = now_ns();
+        for (j = 0; j < iterations; j++)
+        {
+            guard += ieee8023_to_80211_data(out, eth_len, bssid, back, sizeof(back));
+        }
+        t_back = now_ns() - t0;
+
+        printf("%-14s %7d %7d %7d %7.1f%% %11.1f %11.1f\n", samples[i].name, samples[i].len,
+               sink.bytes, sink.frames, 100.0 * (samples[i].len - sink.bytes) / samples[i].len,
+               (double)t_conv / iterations, (double)t_back / iterations);
+    }
+
+    return guard == 0;
+}
@@ -0,0 +1,262 @@
+/*
+ * Timed transmit scheduler : cost per send with thousands of entries, and
+ * lateness of timer driven sends against a polling loop.
+ *
+ * virtual   entries with periods spread over the octaves of 1 ms..1 s run for
+ *           horizon_s on a virtual clock that jumps to the next target, as
+ *           the one-shot timer does on the module. ns/send is the heap cost
+ *           on this machine; every entry must have sent exactly the number of
+ *           periods in the horizon, on time, or the bench exits non-zero. A
+ *           last pass makes the air busy busy_pct of the time and shows
+ *           overruns (skipped periods) and expired sends (max_late of half a
+ *           period).
+ *
+ * realtime  the same entries (10 ms..1 s) against CLOCK_MONOTONIC for run_s
+ *           each : "timer" sleeps until the earliest target
+ *           (clock_nanosleep), "tick" wakes every millisecond like a task
+ *           polling with vTaskDelay(1). Lateness is target to send, as the
+ *           device reports it with HW_CMD_GET_SCHED_STATS. Linux scheduling
+ *           noise is included; the module's esp_timer has its own.
+ *
+ * usage : lcp_sched_bench [horizon_s] [run_s] [rt_entries] [busy_pct]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "lcp_sched.h"
+
+#define BENCH_FRAME_LEN     (64)
+#define RT_MAX_SAMPLES      (4 * 1024 * 1024)
+
+typedef struct bench_clock
+{
+    uint64_t now;                   /* Virtual clock, us */
+    int busy_pct;
+    uint32_t *late;                 /* Realtime : lateness of every send */
+    unsigned long samples;
+} bench_clock;
+
+static unsigned int rng_state = 0x12345678;
+static u8 frame[BENCH_FRAME_LEN];
+
+static unsigned int rng(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint64_t virtual_now(void *ctx)
+{
+    return ((bench_clock *)ctx)->now;
+}
+
+static int virtual_tx(void *ctx, const lcp_sched_entry *entry)
+{
+    bench_clock *clk = (bench_clock *)ctx;
+
+    if (clk->busy_pct && (int)(rng() % 100) < clk->busy_pct)
+    {
+        clk->now += 100;            /* The retry comes a little later */
+        return LCP_SCHED_TX_BUSY;
+    }
+    return LCP_SCHED_TX_SENT;
+}
+
+static uint64_t realtime_now(void *ctx)
+{
+    return now_ns() / 1000;
+}
+
+static int realtime_tx(void *ctx, const lcp_sched_entry *entry)
+{
+    bench_clock *clk = (bench_clock *)ctx;
+    uint64_t now = now_ns() / 1000;
+
+    if (clk->samples < RT_MAX_SAMPLES)
+    {
+        clk->late[clk->samples++] = (uint32_t)(now - entry->target_us);
+    }
+    return LCP_SCHED_TX_SENT;
+}
+
+static const lcp_sched_ops virtual_ops = { virtual_now, virtual_tx };
+static const lcp_sched_ops realtime_ops = { realtime_now, realtime_tx };
+
+/* Period spread evenly over the octaves of [min_us, max_us] */
+static uint32_t rand_period(uint32_t min_us, uint32_t max_us)
+{
+    uint32_t lo;
+    int octaves = 0;
+
+    while ((min_us << (octaves + 1)) <= max_us)
+    {
+        octaves++;
+    }
+    lo = min_us << (rng() % (octaves + 1));
+    lo += rng() % lo;
+    return (lo > max_us) ? max_us : lo;
+}
+
+static void fill(lcp_sched *sched, int entries, uint64_t start, uint32_t min_us, uint32_t max_us, int expire)
+{
+    lcp_sched_req req;
+    int i;
+
+    memset(&req, 0x0, sizeof(req));
+    req.frame = frame;
+    req.len = BENCH_FRAME_LEN;
+    for (i = 0; i < entries; i++)
+    {
+        req.id = (uint16_t)i;
+        req.period_us = rand_period(min_us, max_us);
+        req.first_us = start + rng() % req.period_us;
+        req.max_late_us = expire ? req.period_us / 2 : 0;
+        lcp_sched_add(sched, &req);
+    }
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+/* Returns the number of entries off schedule (plus one if the total sent is wrong), 0 with the air busy */
+static unsigned long run_virtual(int entries, uint64_t horizon_us, int busy_pct)
+{
+    lcp_sched_entry *table = calloc(entries, sizeof(lcp_sched_entry));
+    int *heap = calloc(entries, sizeof(int));
+    unsigned long expected = 0, wrong = 0, wakeups = 0;
+    bench_clock clk;
+    lcp_sched sched;
+    uint64_t next, t0, add_ns, run_ns, first;
+    int i;
+
+    memset(&clk, 0x0, sizeof(clk));
+    clk.busy_pct = busy_pct;
+    rng_state = 0x12345678 + entries;
+    lcp_sched_init(&sched, table, heap, entries, &virtual_ops, &clk);
+
+    t0 = now_ns();
+    fill(&sched, entries, 0, 1000, 1000000, busy_pct != 0);
+    add_ns = now_ns() - t0;
+
+    /* Sends each entry owes over the horizon, before the run moves the targets */
+    for (i = 0; i < entries; i++)
+    {
+        first = table[i].target_us;
+        expected += (first < horizon_us) ? (horizon_us - 1 - first) / table[i].period_us + 1 : 0;
+    }
+
+    t0 = now_ns();
+    while (lcp_sched_next(&sched, &next) && next < horizon_us)
+    {
+        if (next > clk.now)
+        {
+            clk.now = next;
+        }
+        lcp_sched_run(&sched, entries);
+        wakeups++;
+    }
+    run_ns = now_ns() - t0;
+
+    if (!busy_pct)
+    {
+        for (i = 0; i < entries; i++)
+        {
+            wrong += (table[i].stats.late_max_us != 0 || table[i].stats.overruns != 0);
+        }
+        wrong += (sched.stats.sent != expected);
+    }
+
+    printf("%-9d %4d%% %10u %10lu %9.1f %9.1f %9u %9u %9u %9u %6lu\n", entries, busy_pct, sched.stats.sent, wakeups,
+           (double)add_ns / entries / 1000.0, sched.stats.sent ? (double)run_ns / sched.stats.sent : 0.0,
+           sched.stats.busy, sched.stats.overruns, sched.stats.expired, sched.stats.late_max_us, wrong);
+
+    free(table);
+    free(heap);
+    return wrong;
+}
+
+static void run_realtime(const char *mode, int entries, int run_s, int tick)
+{
+    lcp_sched_entry *table = calloc(entries, sizeof(lcp_sched_entry));
+    int *heap = calloc(entries, sizeof(int));
+    bench_clock clk;
+    lcp_sched sched;
+    struct timespec ts;
+    uint64_t start, end, next, wake;
+    unsigned long n;
+
+    memset(&clk, 0x0, sizeof(clk));
+    clk.late = malloc(sizeof(uint32_t) * RT_MAX_SAMPLES);
+    rng_state = 0x9e3779b9 + entries;
+    lcp_sched_init(&sched, table, heap, entries, &realtime_ops, &clk);
+
+    start = now_ns() / 1000;
+    end = start + (uint64_t)run_s * 1000000;
+    fill(&sched, entries, start + 10000, 10000, 1000000, 0);
+
+    wake = start;
+    while (lcp_sched_next(&sched, &next) && next < end)
+    {
+        wake = tick ? wake + 1000 : next;
+        ts.tv_sec = wake / 1000000;
+        ts.tv_nsec = (wake % 1000000) * 1000;
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+        lcp_sched_run(&sched, entries);
+    }
+
+    n = clk.samples;
+    qsort(clk.late, n, sizeof(uint32_t), cmp_u32);
+    printf("%-9s %9d %10lu %9u %9u %9u %9u %9u\n", mode, entries, n,
+           n ? clk.late[n / 2] : 0, n ? clk.late[n * 9 / 10] : 0, n ? clk.late[n * 99 / 100] : 0,
+           n ? clk.late[n - 1] : 0, sched.stats.overruns);
+
+    free(clk.late);
+    free(table);
+    free(heap);
+}
+
+int main(int argc, char **argv)
+{
+    int horizon_s = (argc > 1) ? atoi(argv[1]) : 10;
+    int run_s = (argc > 2) ? atoi(argv[2]) : 2;
+    int rt_entries = (argc > 3) ? atoi(argv[3]) : 1000;
+    int busy_pct = (argc > 4) ? atoi(argv[4]) : 20;
+    static const int sizes[] = { 16, 256, 1024, 4096, 16384 };
+    unsigned long wrong = 0;
+    size_t i;
+
+    memset(frame, 0xa5, sizeof(frame));
+
+    printf("virtual clock, horizon %d s, periods 1 ms..1 s\n\n", horizon_s);
+    printf("%-9s %5s %10s %10s %9s %9s %9s %9s %9s %9s %6s\n",
+           "entries", "busy", "sent", "wakeups", "add us", "ns/send", "busy", "overruns", "expired", "late max", "wrong");
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        wrong += run_virtual(sizes[i], (uint64_t)horizon_s * 1000000, 0);
+    }
+    run_virtual(1024, (uint64_t)horizon_s * 1000000, busy_pct);
+
+    printf("\nrealtime, %d s per run, periods 10 ms..1 s, lateness us\n\n", run_s);
+    printf("%-9s %9s %10s %9s %9s %9s %9s %9s\n", "mode", "entries", "sent", "p50", "p90", "p99", "max", "overruns");
+    run_realtime("timer", rt_entries, run_s, 0);
+    run_realtime("tick 1ms", rt_entries, run_s, 1);
+
+    return wrong ? 1 : 0;
+}
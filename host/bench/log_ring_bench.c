@@ -0,0 +1,132 @@
+/*
+ * Cost per log call on the hot path : deferred log ring vs. direct formatted output.
+ *
+ * The printf variants write to /dev/null, so they exclude the UART time the
+ * device would also pay; the numbers are a lower bound for direct logging.
+ *
+ * usage : log_ring_bench [iterations]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define CYCLES()    __rdtsc()
+#else
+#define CYCLES()    0ULL
+#endif
+
+#include "utils.h"
+#include "log_ring.h"
+
+#define BATCH       (32)
+
+typedef struct bench_result
+{
+    double ns;
+    double cycles;
+} bench_result;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void report(const char *name, bench_result *res, long iterations)
+{
+    printf("%-28s %10.1f ns/call %10.1f cycles/call\n", name,
+           res->ns / iterations, res->cycles / iterations);
+}
+
+int main(int argc, char **argv)
+{
+    long iterations = (argc > 1) ? atol(argv[1]) : 1000000;
+    bench_result ring = {0}, ring_limited = {0}, direct = {0}, fmt_only = {0};
+    int saved_stdout, devnull;
+    FILE *null_fp;
+    char line[256];
+    long i, j, accepted = 0;
+
+    log_ring_init();
+
+    /* Flushed records go nowhere while measuring */
+    fflush(stdout);
+    saved_stdout = dup(STDOUT_FILENO);
+    devnull = open("/dev/null", O_WRONLY);
+    dup2(devnull, STDOUT_FILENO);
+    null_fp = fopen("/dev/null", "w");
+
+    for (i = 0; i < iterations; i += BATCH)
+    {
+        static log_site site;
+        uint64_t t0, c0;
+
+        /* Accepted records : the rate limit state is reset for every batch */
+        const uintptr_t args[] = { (uintptr_t)i, (uintptr_t)-1 };
+        memset(&site, 0x0, sizeof(site));
+        t0 = now_ns();
+        c0 = CYCLES();
+        for (j = 0; j < LOG_RING_RATE_BURST; j++)
+        {
+            log_ring_write(&site, LOG_LEVEL_ERROR, __func__, "SPI transmit failed with error: %d (%d)", 2, args);
+        }
+        ring.cycles += CYCLES() - c0;
+        ring.ns += now_ns() - t0;
+        accepted += LOG_RING_RATE_BURST;
+        log_ring_flush();
+
+        /* Rate limited call site : what a storm of identical errors costs */
+        t0 = now_ns();
+        c0 = CYCLES();
+        for (j = 0; j < BATCH; j++)
+        {
+            LOG_RING_WRITE(LOG_LEVEL_ERROR, "SPI transmit timed out %ld", j);
+        }
+        ring_limited.cycles += CYCLES() - c0;
+        ring_limited.ns += now_ns() - t0;
+        log_ring_flush();
+
+        t0 = now_ns();
+        c0 = CYCLES();
+        for (j = 0; j < BATCH; j++)
+        {
+            fprintf(null_fp, "E (%u) %s: [%s] (ERROR) : SPI transmit failed with error: %d (%d)\n",
+                    (unsigned int)i, PRINT_LOGO_NAME, __func__, (int)i, -1);
+        }
+        direct.cycles += CYCLES() - c0;
+        direct.ns += now_ns() - t0;
+
+        t0 = now_ns();
+        c0 = CYCLES();
+        for (j = 0; j < BATCH; j++)
+        {
+            snprintf(line, sizeof(line), "E (%u) %s: [%s] (ERROR) : SPI transmit failed with error: %d (%d)\n",
+                     (unsigned int)i, PRINT_LOGO_NAME, __func__, (int)i, -1);
+        }
+        fmt_only.cycles += CYCLES() - c0;
+        fmt_only.ns += now_ns() - t0;
+    }
+
+    fflush(stdout);
+    dup2(saved_stdout, STDOUT_FILENO);
+    close(saved_stdout);
+    close(devnull);
+    fclose(null_fp);
+
+    printf("iterations=%ld\n", iterations);
+    report("log_ring (accepted)", &ring, accepted);
+    report("log_ring (rate limited)", &ring_limited, iterations);
+    report("fprintf (/dev/null)", &direct, iterations);
+    report("snprintf (format only)", &fmt_only, iterations);
+    printf("dropped=%u\n", (unsigned int)log_ring_dropped());
+
+    return 0;
+}
@@ -0,0 +1,447 @@
+/*
+ * Microbenchmarks of the frame path building blocks, as a baseline for later changes.
+ *
+ *   ring/      tx_buffer_enqueue + tx_buffer_dequeue under the ring lock, one
+ *              thread, then 1 and 2 producers against one consumer
+ *   lcp/       hw_frame_assemble and is_valid_hw_frame across payload sizes
+ *   mac/       is_broadcast_address, is_multicast_address, is_current_wifi_srv_mac
+ *              over a mix of unicast / multicast / broadcast / own addresses
+ *
+ * Every case runs BENCH_REPEATS times and reports the median ns/op, the bytes/s
+ * it implies and the heap allocations per op (glibc malloc is wrapped). The JSON
+ * has a fixed key and case order and no timestamps, so two runs diff cleanly.
+ * The portable modules are built with the event trace hooks (ESP_TRACE) when the
+ * option is on; the JSON records it.
+ *
+ * usage : microbench [iterations] [json]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "hw_link_ctrl_protocol.h"
+#include "ring_buff.h"
+#include "trace_buf.h"
+#include "wifi_mac.h"
+
+#define BENCH_REPEATS       (5)
+#define BENCH_MAX_RESULTS   (32)
+#define BENCH_MAX_THREADS   (2)
+#define MAC_TABLE           (64)        /* Power of 2 */
+#define WIFI_MAC_LEN        (6)
+
+#if defined(__GLIBC__)
+#define BENCH_ALLOC_TRACKING    (1)
+#else
+#define BENCH_ALLOC_TRACKING    (0)
+#endif
+
+#if defined(CONFIG_ESP_TRACE) && CONFIG_ESP_TRACE
+#define BENCH_TRACE_HOOKS       (1)
+#else
+#define BENCH_TRACE_HOOKS       (0)
+#endif
+
+typedef struct bench_result
+{
+    const char *name;
+    int param;                  /* Payload bytes, 0 : none */
+    int threads;
+    long iterations;
+    double ns_per_op;
+    double bytes_per_s;
+    double allocs_per_op;
+} bench_result;
+
+typedef struct ring_thread
+{
+    long frames;
+    int len;
+} ring_thread;
+
+static bench_result results[BENCH_MAX_RESULTS];
+static int result_count;
+static unsigned long alloc_count;
+static volatile unsigned long sink;
+static volatile int ring_go;
+
+static u8 payload[MAX_BUFFER_SIZE];
+static u8 frames[4][HW_LCP_MAX_PAYLOAD_LEN + HW_LCP_OVERHEAD];
+static u8 macs[MAC_TABLE][WIFI_MAC_LEN];
+static const u8 own_mac[WIFI_MAC_LEN] = { 0x24, 0x0a, 0xc4, 0x01, 0x02, 0x03 };
+
+#if BENCH_ALLOC_TRACKING
+extern void *__libc_malloc(size_t);
+extern void *__libc_calloc(size_t, size_t);
+extern void *__libc_realloc(void *, size_t);
+
+void *malloc(size_t size)
+{
+    __atomic_add_fetch(&alloc_count, 1, __ATOMIC_RELAXED);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size)
+{
+    __atomic_add_fetch(&alloc_count, 1, __ATOMIC_RELAXED);
+    return __libc_calloc(n, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    __atomic_add_fetch(&alloc_count, 1, __ATOMIC_RELAXED);
+    return __libc_realloc(ptr, size);
+}
+#endif
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static unsigned long allocs(void)
+{
+    return __atomic_load_n(&alloc_count, __ATOMIC_RELAXED);
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+/* One case : fn(iterations, param) BENCH_REPEATS times, median ns/op */
+static void bench(const char *name, int param, int threads, long iterations, int bytes_per_op,
+                  void (*fn)(long, int))
+{
+    bench_result *r = &results[result_count++];
+    double ns[BENCH_REPEATS];
+    unsigned long a0, a_total = 0;
+    uint64_t t0;
+    int i;
+
+    for (i = 0; i < BENCH_REPEATS; i++)
+    {
+        a0 = allocs();
+        t0 = now_ns();
+        fn(iterations, param);
+        ns[i] = (double)(now_ns() - t0) / iterations;
+        a_total += allocs() - a0;
+    }
+    qsort(ns, BENCH_REPEATS, sizeof(double), cmp_double);
+
+    r->name          = name;
+    r->param         = param;
+    r->threads       = threads;
+    r->iterations    = iterations;
+    r->ns_per_op     = ns[BENCH_REPEATS / 2];
+    r->bytes_per_s   = bytes_per_op * 1e9 / r->ns_per_op;
+    r->allocs_per_op = (double)a_total / ((double)iterations * BENCH_REPEATS);
+
+    printf("%-30s %5d %3d %10.2f %12.1f %10.4f\n", r->name, r->param, r->threads,
+           r->ns_per_op, r->bytes_per_s / 1e6, r->allocs_per_op);
+}
+
+/* Same critical sections as wifi_frame_enqueue / hw_link_get_tx_frame */
+static void ring_put(int len)
+{
+    tx_buffer_critical_section_lock();
+    tx_buffer_enqueue(payload, len, HW_LCP_TYPE_80211);
+    tx_buffer_critical_section_unlock();
+}
+
+static int ring_get(u8 *out)
+{
+    buffer *buf;
+    int len = 0;
+
+    tx_buffer_critical_section_lock();
+    buf = tx_buffer_dequeue();
+    if (buf != BUFFER_EMPTY)
+    {
+        len = buf->len;
+        memcpy(out, buf->buf, len);
+    }
+    tx_buffer_critical_section_unlock();
+    return len;
+}
+
+static void bench_ring_single(long iterations, int len)
+{
+    static u8 out[MAX_BUFFER_SIZE];
+    long i;
+
+    buffer_init();
+    for (i = 0; i < iterations; i++)
+    {
+        ring_put(len);
+        sink += ring_get(out);
+    }
+}
+
+/* Producers retry while the ring is full, so every frame is delivered exactly once */
+static void *ring_producer(void *arg)
+{
+    ring_thread *t = (ring_thread *)arg;
+    long sent = 0;
+    int ret;
+
+    while (!ring_go)
+    {
+    }
+    while (sent < t->frames)
+    {
+        tx_buffer_critical_section_lock();
+        ret = tx_buffer_enqueue(payload, t->len, HW_LCP_TYPE_80211);
+        tx_buffer_critical_section_unlock();
+        if (ret == BUFFER_ENQUEUE_SUCESS)
+        {
+            sent++;
+        }
+        else
+        {
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+static void bench_ring_contended(long iterations, int len, int producers)
+{
+    static u8 out[MAX_BUFFER_SIZE];
+    pthread_t tid[BENCH_MAX_THREADS];
+    ring_thread t;
+    long received = 0;
+    int i, n;
+
+    buffer_init();
+    ring_go = 0;
+    t.frames = iterations / producers;
+    t.len = len;
+    for (i = 0; i < producers; i++)
+    {
+        pthread_create(&tid[i], NULL, ring_producer, &t);
+    }
+    ring_go = 1;
+    while (received < t.frames * producers)
+    {
+        n = ring_get(out);
+        if (n > 0)
+        {
+            received++;
+            sink += n;
+        }
+        else
+        {
+            sched_yield();
+        }
+    }
+    for (i = 0; i < producers; i++)
+    {
+        pthread_join(tid[i], NULL);
+    }
+}
+
+static void bench_ring_1p1c(long iterations, int len)
+{
+    bench_ring_contended(iterations, len, 1);
+}
+
+static void bench_ring_2p1c(long iterations, int len)
+{
+    bench_ring_contended(iterations, len, 2);
+}
+
+static void bench_lcp_assemble(long iterations, int len)
+{
+    int frame_len;
+    long i;
+
+    for (i = 0; i < iterations; i++)
+    {
+        frame_len = len;
+        payload[0] = (u8)i;
+        sink += hw_frame_assemble(payload, &frame_len)[PAYLOAD_FIELD] + frame_len;
+    }
+}
+
+/* A few frames in rotation so the check does not run on one cached line */
+static void bench_lcp_validate(long iterations, int len)
+{
+    int i, frame_len;
+    u8 *frame;
+    long n;
+
+    for (i = 0; i < 4; i++)
+    {
+        frame_len = len;
+        payload[0] = (u8)i;
+        frame = hw_frame_assemble(payload, &frame_len);
+        memcpy(frames[i], frame, frame_len);
+    }
+    for (n = 0; n < iterations; n++)
+    {
+        sink += is_valid_hw_frame(frames[n & 3]);
+    }
+}
+
+static void bench_mac_broadcast(long iterations, int unused)
+{
+    long i;
+
+    for (i = 0; i < iterations; i++)
+    {
+        sink += is_broadcast_address(macs[i & (MAC_TABLE - 1)]);
+    }
+}
+
+static void bench_mac_multicast(long iterations, int unused)
+{
+    long i;
+
+    for (i = 0; i < iterations; i++)
+    {
+        sink += is_multicast_address(macs[i & (MAC_TABLE - 1)]);
+    }
+}
+
+static void bench_mac_current(long iterations, int unused)
+{
+    long i;
+
+    for (i = 0; i < iterations; i++)
+    {
+        sink += is_current_wifi_srv_mac(macs[i & (MAC_TABLE - 1)]);
+    }
+}
+
+/* Roughly what a sniffer sees : mostly unicast to others, some group addressed, a few to us */
+static void build_macs(void)
+{
+    int i, j;
+
+    for (i = 0; i < MAC_TABLE; i++)
+    {
+        for (j = 0; j < WIFI_MAC_LEN; j++)
+        {
+            macs[i][j] = (u8)(i * 37 + j * 11);
+        }
+        macs[i][0] &= 0xFE;
+        switch (i % 8)
+        {
+            case 1:
+                memset(macs[i], 0xFF, WIFI_MAC_LEN);
+                break;
+            case 2:
+                macs[i][0] = 0x01;
+                macs[i][1] = 0x00;
+                macs[i][2] = 0x5E;
+                break;
+            case 3:
+                memcpy(macs[i], own_mac, WIFI_MAC_LEN);
+                break;
+            case 4:
+                memcpy(macs[i], own_mac, WIFI_MAC_LEN - 1);
+                break;
+            default:
+                break;
+        }
+    }
+    wifi_mac_set_current(own_mac);
+}
+
+static int write_json(const char *path, long iterations)
+{
+    FILE *fp = fopen(path, "w");
+    bench_result *r;
+    int i;
+
+    if (!fp)
+    {
+        return -1;
+    }
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"suite\": \"microbench\",\n");
+    fprintf(fp, "  \"schema\": 1,\n");
+    fprintf(fp, "  \"config\": {\n");
+    fprintf(fp, "    \"iterations\": %ld,\n", iterations);
+    fprintf(fp, "    \"repeats\": %d,\n", BENCH_REPEATS);
+    fprintf(fp, "    \"statistic\": \"median\",\n");
+    fprintf(fp, "    \"buffer_count\": %d,\n", BUFFER_COUNT);
+    fprintf(fp, "    \"max_buffer_size\": %d,\n", MAX_BUFFER_SIZE);
+    fprintf(fp, "    \"trace_hooks\": %s,\n", BENCH_TRACE_HOOKS ? "true" : "false");
+    fprintf(fp, "    \"alloc_tracking\": %s\n", BENCH_ALLOC_TRACKING ? "true" : "false");
+    fprintf(fp, "  },\n");
+    fprintf(fp, "  \"results\": [\n");
+    for (i = 0; i < result_count; i++)
+    {
+        r = &results[i];
+        fprintf(fp, "    { \"name\": \"%s\", \"bytes\": %d, \"threads\": %d, \"iterations\": %ld, "
+                    "\"ns_per_op\": %.2f, \"bytes_per_s\": %.0f, \"allocs_per_op\": %.4f }%s\n",
+                r->name, r->param, r->threads, r->iterations, r->ns_per_op, r->bytes_per_s,
+                r->allocs_per_op, (i + 1 < result_count) ? "," : "");
+    }
+    fprintf(fp, "  ]\n");
+    fprintf(fp, "}\n");
+    return fclose(fp);
+}
+
+int main(int argc, char **argv)
+{
+    long iterations = (argc > 1) ? atol(argv[1]) : 1000000;
+    const char *json = (argc > 2) ? argv[2] : "/tmp/microbench.json";
+    static const int ring_sizes[] = { 64, 256, 512 };
+    static const int lcp_sizes[] = { 16, 64, 256, 512 };
+    size_t i;
+
+    if (iterations < BENCH_MAX_THREADS)
+    {
+        fprintf(stderr, "bad iterations\n");
+        return 1;
+    }
+    memset(payload, 0xA5, sizeof(payload));
+    build_macs();
+#if BENCH_TRACE_HOOKS
+    trace_buf_init();
+#endif
+
+    printf("iterations=%ld repeats=%d trace_hooks=%d alloc_tracking=%d\n",
+           iterations, BENCH_REPEATS, BENCH_TRACE_HOOKS, BENCH_ALLOC_TRACKING);
+    printf("%-30s %5s %3s %10s %12s %10s\n", "case", "bytes", "thr", "ns/op", "MB/s", "allocs/op");
+
+    for (i = 0; i < sizeof(ring_sizes) / sizeof(ring_sizes[0]); i++)
+    {
+        bench("ring/enqueue_dequeue", ring_sizes[i], 1, iterations, ring_sizes[i], bench_ring_single);
+    }
+    bench("ring/contended_1p1c", 256, 2, iterations / 4, 256, bench_ring_1p1c);
+    bench("ring/contended_2p1c", 256, 3, iterations / 4, 256, bench_ring_2p1c);
+
+    for (i = 0; i < sizeof(lcp_sizes) / sizeof(lcp_sizes[0]); i++)
+    {
+        bench("lcp/hw_frame_assemble", lcp_sizes[i], 1, iterations, lcp_sizes[i], bench_lcp_assemble);
+    }
+    for (i = 0; i < sizeof(lcp_sizes) / sizeof(lcp_sizes[0]); i++)
+    {
+        bench("lcp/is_valid_hw_frame", lcp_sizes[i], 1, iterations, lcp_sizes[i], bench_lcp_validate);
+    }
+
+    bench("mac/is_broadcast_address", 0, 1, iterations * 10, WIFI_MAC_LEN, bench_mac_broadcast);
+    bench("mac/is_multicast_address", 0, 1, iterations * 10, WIFI_MAC_LEN, bench_mac_multicast);
+    bench("mac/is_current_wifi_srv_mac", 0, 1, iterations * 10, WIFI_MAC_LEN, bench_mac_current);
+
+    if (write_json(json, iterations) < 0)
+    {
+        fprintf(stderr, "write %s failed\n", json);
+        return 1;
+    }
+    printf("json : %s\n", json);
+    return 0;
+}
@@ -0,0 +1,194 @@
+/*
+ * pcapng capture sink : sustained frames/s to disk, block writer vs per-frame fwrite().
+ *
+ *   fwrite       : one fwrite() per EPB part through stdio's default buffer
+ *   fwrite+flush : same, fflush() after every frame (live capture style)
+ *   block        : pcapng_writer (1MB blocks, writer thread, preallocated files)
+ *
+ * Every run ends with fdatasync() so the numbers are disk throughput, not page cache.
+ * max_us is the longest single capture call, i.e. how long the capture path stalled.
+ *
+ * usage : pcapng_bench [dir] [frames]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "pcapng_writer.h"
+
+#define SAMPLE_FRAMES       (64)
+
+typedef struct sample
+{
+    hw_lcp_rx_meta meta;
+    u8 frame[HW_LCP_MAX_PAYLOAD_LEN];
+    int len;
+} sample;
+
+static sample samples[SAMPLE_FRAMES];
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void build_samples(int len)
+{
+    int i, j;
+
+    for (i = 0; i < SAMPLE_FRAMES; i++)
+    {
+        samples[i].len = len;
+        samples[i].meta.timestamp = i * 100;
+        samples[i].meta.rssi = (int8_t)(-40 - i % 50);
+        samples[i].meta.channel = 1 + i % 13;
+        samples[i].meta.orig_len = (uint16_t)len;
+        samples[i].frame[0] = 0x08;
+        for (j = 1; j < len; j++)
+        {
+            samples[i].frame[j] = (u8)(i + j);
+        }
+    }
+}
+
+/* Hand rolled SHB/IDB/EPB in the same layout as pcapng_writer, written piecewise */
+static void naive_header(FILE *fp)
+{
+    uint32_t shb[7] = { 0x0A0D0D0A, 28, 0x1A2B3C4D, 1, 0xffffffff, 0xffffffff, 28 };
+    uint32_t idb[5] = { 1, 20, PCAPNG_LINKTYPE_RADIOTAP, 0, 20 };
+
+    fwrite(shb, sizeof(shb), 1, fp);
+    fwrite(idb, sizeof(idb), 1, fp);
+}
+
+static void naive_packet(FILE *fp, uint64_t ts_us, const sample *s)
+{
+    u8 radiotap[24] = { 0, 0, 24, 0, 0x2b, 0, 0, 0 };
+    uint32_t cap_len = sizeof(radiotap) + s->len;
+    uint32_t pad = ((cap_len + 3) & ~3) - cap_len;
+    uint32_t block_len = 28 + cap_len + pad + 4;
+    uint32_t hdr[7] = { 6, block_len, 0, (uint32_t)(ts_us >> 32), (uint32_t)ts_us, cap_len, cap_len };
+    uint32_t zero = 0;
+
+    memcpy(&radiotap[8], &s->meta.timestamp, 4);
+    radiotap[22] = (u8)s->meta.rssi;
+    fwrite(hdr, sizeof(hdr), 1, fp);
+    fwrite(radiotap, sizeof(radiotap), 1, fp);
+    fwrite(s->frame, s->len, 1, fp);
+    fwrite(&zero, pad, 1, fp);
+    fwrite(&block_len, sizeof(block_len), 1, fp);
+}
+
+static void report(const char *mode, int len, long frames, uint64_t elapsed, uint64_t max_call, size_t bytes,
+                   unsigned long stalls)
+{
+    printf("%-13s %5d %12.0f %9.1f %10.1f %8lu\n", mode, len, frames * 1e9 / elapsed,
+           bytes / 1048576.0 / (elapsed / 1e9), max_call / 1000.0, stalls);
+}
+
+static void run_naive(const char *dir, int len, long frames, int flush)
+{
+    char path[512];
+    uint64_t t0, t1, max_call = 0, start;
+    FILE *fp;
+    long i;
+
+    snprintf(path, sizeof(path), "%s/naive.pcapng", dir);
+    fp = fopen(path, "wb");
+    if (!fp)
+    {
+        perror(path);
+        return;
+    }
+
+    start = now_ns();
+    naive_header(fp);
+    for (i = 0; i < frames; i++)
+    {
+        t0 = now_ns();
+        naive_packet(fp, t0 / 1000, &samples[i % SAMPLE_FRAMES]);
+        if (flush)
+        {
+            fflush(fp);
+        }
+        t1 = now_ns() - t0;
+        if (t1 > max_call)
+        {
+            max_call = t1;
+        }
+    }
+    fflush(fp);
+    fdatasync(fileno(fp));
+    report(flush ? "fwrite+flush" : "fwrite", len, frames, now_ns() - start, max_call, (size_t)ftell(fp), 0);
+    fclose(fp);
+    unlink(path);
+}
+
+static void run_block(const char *dir, int len, long frames)
+{
+    char prefix[512], path[600];
+    pcapng_config config = { prefix, 0, 64 * 1024 * 1024 };
+    pcapng_writer writer;
+    pcapng_stats stats;
+    uint64_t t0, t1, max_call = 0, start;
+    unsigned long f;
+    long i;
+
+    snprintf(prefix, sizeof(prefix), "%s/block", dir);
+    start = now_ns();
+    if (pcapng_writer_open(&writer, &config) != PCAPNG_OK)
+    {
+        printf("pcapng_writer_open [%s] failed\n", prefix);
+        return;
+    }
+
+    for (i = 0; i < frames; i++)
+    {
+        const sample *s = &samples[i % SAMPLE_FRAMES];
+
+        t0 = now_ns();
+        pcapng_write_packet(&writer, t0 / 1000, &s->meta, s->frame, s->len);
+        t1 = now_ns() - t0;
+        if (t1 > max_call)
+        {
+            max_call = t1;
+        }
+    }
+    pcapng_writer_flush(&writer);
+    fdatasync(writer.fd);
+    pcapng_writer_get_stats(&writer, &stats);
+    pcapng_writer_close(&writer);
+    report("block", len, frames, now_ns() - start, max_call, stats.bytes, stats.stalls);
+
+    for (f = 0; f < stats.files; f++)
+    {
+        snprintf(path, sizeof(path), "%s_%05lu.pcapng", prefix, f);
+        unlink(path);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const char *dir = (argc > 1) ? argv[1] : "/tmp";
+    long frames = (argc > 2) ? atol(argv[2]) : 500000;
+    static const int sizes[] = { 64, 256, 512 };
+    size_t i;
+
+    printf("dir=%s frames=%ld\n", dir, frames);
+    printf("%-13s %5s %12s %9s %10s %8s\n", "mode", "len", "frames/s", "MB/s", "max_us", "stalls");
+
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        build_samples(sizes[i]);
+        run_naive(dir, sizes[i], frames, 0);
+        run_naive(dir, sizes[i], frames, 1);
+        run_block(dir, sizes[i], frames);
+    }
+    return 0;
+}
@@ -0,0 +1,343 @@
+/*
+ * Snap length replay : captured frames/s over the link vs. snap length, one frame
+ * per link frame vs. packed (HW_LCP_TYPE_BATCH).
+ *
+ * A capture (classic pcap, raw 802.11 or radiotap, or a synthetic monitor mode
+ * mix) is replayed through the device path : snap length and capture metadata as
+ * the sniffer callback applies them, the interface ring, the link dequeue, LCP
+ * framing and the two-phase link transfer. The host side decodes and unpacks
+ * every frame and checks it against the original. The ring is refilled before
+ * every exchange, so the link runs saturated and frames/s is what the bus carries
+ * at spi_hz with txn_gap_us per transaction. host_ns is the host decode / unpack
+ * cost per frame on this machine.
+ *
+ * usage : snaplen_bench [frames] [spi_hz] [txn_gap_us] [capture.pcap]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "hw_link_ctrl_protocol.h"
+#include "hw_link_xfer.h"
+#include "hw_iface.h"
+
+#define MAX_SAMPLES         (8192)
+#define PCAP_MAGIC          (0xa1b2c3d4)
+#define PCAP_MAGIC_NS       (0xa1b23c4d)
+#define PCAP_LINKTYPE_80211 (105)
+#define PCAP_LINKTYPE_RTAP  (127)
+#define SEQ_CTRL            (22)
+
+typedef struct sample
+{
+    int len;                    /* On air, may exceed what is kept */
+    u8 data[MAX_BUFFER_SIZE];
+} sample;
+
+typedef struct bench_result
+{
+    unsigned long frames;
+    unsigned long exchanges;
+    unsigned long link_frames;
+    unsigned long bus_bytes;
+    unsigned long txns;
+    unsigned long errors;
+    uint64_t host_ns;
+} bench_result;
+
+static sample *samples;
+static int sample_count;
+static unsigned int rng_state = 0x12345678;
+
+static unsigned int rng(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void sample_add(const u8 *frame, int kept, int len)
+{
+    sample *s = &samples[sample_count++];
+
+    s->len = len;
+    memcpy(s->data, frame, kept < MAX_BUFFER_SIZE ? kept : MAX_BUFFER_SIZE);
+}
+
+/* Beacons, probes, short and full size QoS data, roughly a busy 2.4 GHz channel */
+static void build_synthetic(void)
+{
+    static const struct
+    {
+        int weight;
+        u8 fc0;
+        u8 fc1;
+        int min_len;
+        int max_len;
+    } mix[] =
+    {
+        { 25, 0x80, 0x00, 180, 320 },       /* Beacon */
+        { 10, 0x50, 0x00, 200, 350 },       /* Probe response */
+        {  5, 0x40, 0x00,  60, 120 },       /* Probe request */
+        { 35, 0x88, 0x02,  60, 140 },       /* QoS data, TCP ACK size */
+        { 25, 0x88, 0x02, 1000, 1560 },     /* QoS data, full size */
+    };
+    u8 frame[MAX_BUFFER_SIZE];
+    int i, j, k, r, len;
+
+    for (i = 0; i < MAX_SAMPLES; i++)
+    {
+        r = rng() % 100;
+        for (k = 0; r >= mix[k].weight; k++)
+        {
+            r -= mix[k].weight;
+        }
+        len = mix[k].min_len + rng() % (mix[k].max_len - mix[k].min_len + 1);
+        for (j = 0; j < MAX_BUFFER_SIZE; j++)
+        {
+            frame[j] = (u8)rng();
+        }
+        frame[0] = mix[k].fc0;
+        frame[1] = mix[k].fc1;
+        sample_add(frame, len, len);
+    }
+}
+
+static uint32_t pcap_u32(const u8 *p, int swap)
+{
+    return swap ? ((uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3]) :
+                  ((uint32_t)p[3] << 24 | (uint32_t)p[2] << 16 | (uint32_t)p[1] << 8 | p[0]);
+}
+
+/* Classic pcap of raw 802.11 or radiotap frames. Returns the frames loaded, -1 on error */
+static int load_pcap(const char *path)
+{
+    static u8 rec[65536];
+    u8 hdr[24];
+    uint32_t magic, linktype, incl, orig;
+    int swap, skip;
+    FILE *f = fopen(path, "rb");
+
+    if (!f || fread(hdr, 1, sizeof(hdr), f) != sizeof(hdr))
+    {
+        ERROR_PRINT("can not read %s\n", path);
+        return -1;
+    }
+    magic = pcap_u32(hdr, 0);
+    swap = (magic != PCAP_MAGIC && magic != PCAP_MAGIC_NS);
+    linktype = pcap_u32(&hdr[20], swap);
+    if ((swap && pcap_u32(hdr, 1) != PCAP_MAGIC && pcap_u32(hdr, 1) != PCAP_MAGIC_NS) ||
+        (linktype != PCAP_LINKTYPE_80211 && linktype != PCAP_LINKTYPE_RTAP))
+    {
+        ERROR_PRINT("%s : not a pcap of 802.11 frames\n", path);
+        fclose(f);
+        return -1;
+    }
+
+    while (sample_count < MAX_SAMPLES && fread(hdr, 1, 16, f) == 16)
+    {
+        incl = pcap_u32(&hdr[8], swap);
+        orig = pcap_u32(&hdr[12], swap);
+        if (incl > sizeof(rec) || fread(rec, 1, incl, f) != incl)
+        {
+            break;
+        }
+        skip = (linktype == PCAP_LINKTYPE_RTAP && incl >= 4) ? (rec[2] | (rec[3] << 8)) : 0;
+        if ((int)incl - skip < HW_LCP_SNAPLEN_MIN)
+        {
+            continue;
+        }
+        sample_add(&rec[skip], (int)incl - skip, (int)orig - skip);
+    }
+    fclose(f);
+    return sample_count;
+}
+
+/* As the sniffer callback with capture metadata on : snapped, then cut to fit the ring */
+static int replay_enqueue(hw_iface_set *set, const hw_lcp_snap *snap, int idx)
+{
+    const sample *s = &samples[idx];
+    u8 meta_buf[HW_LCP_META_LEN];
+    hw_lcp_rx_meta meta;
+    int len = hw_lcp_snap_len(snap, s->data, s->len);
+
+    memset(&meta, 0x0, sizeof(meta));
+    meta.timestamp = (uint32_t)idx;
+    meta.flags     = (len < s->len) ? HW_LCP_META_FLAG_SNAPPED : 0;
+    meta.orig_len  = (uint16_t)s->len;
+    hw_lcp_meta_encode(meta_buf, &meta);
+    if (len > MAX_BUFFER_SIZE - HW_LCP_META_LEN)
+    {
+        len = MAX_BUFFER_SIZE - HW_LCP_META_LEN;
+    }
+    return hw_iface_enqueue_tx(set, HW_LCP_IFACE_STA, meta_buf, sizeof(meta_buf), (u8 *)s->data, len,
+                               HW_LCP_TYPE_80211_META, 0);
+}
+
+static void check_record(bench_result *r, const hw_lcp_snap *snap, u8 type, const u8 *data, int len)
+{
+    hw_lcp_rx_meta meta;
+    const sample *s;
+    int expect;
+
+    if (type != HW_LCP_TYPE_80211_META || len < HW_LCP_META_LEN)
+    {
+        r->errors++;
+        return;
+    }
+    hw_lcp_meta_decode(data, &meta);
+    s = &samples[meta.timestamp % sample_count];
+    expect = hw_lcp_snap_len(snap, s->data, s->len);
+    expect = (expect > MAX_BUFFER_SIZE - HW_LCP_META_LEN) ? MAX_BUFFER_SIZE - HW_LCP_META_LEN : expect;
+
+    if (meta.orig_len != s->len || len - HW_LCP_META_LEN != expect ||
+        memcmp(&data[HW_LCP_META_LEN], s->data, expect) != 0)
+    {
+        r->errors++;
+        return;
+    }
+    r->frames++;
+}
+
+/* Host end : one LCP frame from the link, unpacked */
+static void host_receive(bench_result *r, const hw_lcp_snap *snap, u8 *frame)
+{
+    int len = is_valid_hw_frame(frame);
+    hw_lcp_batch_rec rec;
+    int off = 0;
+
+    if (len <= 0)
+    {
+        r->errors++;
+        return;
+    }
+    r->link_frames++;
+    if (hw_frame_type(frame) != HW_LCP_TYPE_BATCH)
+    {
+        check_record(r, snap, hw_frame_type(frame), &frame[PAYLOAD_FIELD], len);
+        return;
+    }
+    while (hw_lcp_batch_next(&frame[PAYLOAD_FIELD], len, &off, &rec) > 0)
+    {
+        check_record(r, snap, rec.type, rec.data, rec.len);
+    }
+    if (off != len)
+    {
+        r->errors++;
+    }
+}
+
+static void run(uint16_t snaplen, int batch, unsigned long frames, bench_result *r)
+{
+    static hw_iface_set set;
+    static u8 dev_frame[HW_LINK_MAX_DATA_LEN], host_rx[HW_LINK_MAX_DATA_LEN];
+    u8 dev_hdr[HW_LINK_HDR_LEN], host_hdr[HW_LINK_HDR_LEN];
+    buffer_aqm_config tail_drop = { BUFFER_AQM_NONE, BUFFER_AQM_TARGET_US, BUFFER_AQM_INTERVAL_US };
+    hw_link_xfer dev, host;
+    hw_iface_frame info;
+    hw_lcp_snap snap;
+    const u8 *inl;
+    int next = 0, len, data_len, inl_len;
+    uint64_t t0;
+
+    memset(r, 0x0, sizeof(bench_result));
+    memset(&snap, 0x0, sizeof(snap));
+    hw_lcp_snap_set(&snap, HW_LCP_SNAP_ALL, snaplen);
+    hw_iface_init(&set, 1, &tail_drop);
+    hw_link_xfer_init(&dev);
+    hw_link_xfer_init(&host);
+
+    while (r->frames + r->errors < frames)
+    {
+        while (replay_enqueue(&set, &snap, next) == HW_IFACE_OK)
+        {
+            next = (next + 1) % sample_count;
+        }
+
+        len = batch ? hw_iface_dequeue_batch(&set, &dev_frame[PAYLOAD_FIELD], HW_LCP_MAX_PAYLOAD_LEN, &info) :
+                      hw_iface_dequeue_tx(&set, &dev_frame[PAYLOAD_FIELD], HW_LCP_MAX_PAYLOAD_LEN, &info);
+        len = hw_frame_encap(dev_frame, len, info.type);
+
+        /* Header exchange, then the data phase when the frame did not ride inline */
+        hw_link_xfer_header_build(&dev, dev_hdr, dev_frame, len);
+        hw_link_xfer_header_build(&host, host_hdr, NULL, 0);
+        hw_link_xfer_header_done(&dev, host_hdr, NULL, NULL);
+        data_len = hw_link_xfer_header_done(&host, dev_hdr, &inl, &inl_len);
+        r->exchanges++;
+
+        t0 = now_ns();
+        if (inl_len > 0)
+        {
+            memcpy(host_rx, inl, inl_len);
+            host_receive(r, &snap, host_rx);
+        }
+        else if (data_len > 0)
+        {
+            memcpy(host_rx, dev_frame, dev.tx_len);
+            hw_link_xfer_data_done(&dev);
+            hw_link_xfer_data_done(&host);
+            host_receive(r, &snap, host_rx);
+        }
+        r->host_ns += now_ns() - t0;
+    }
+    r->bus_bytes = dev.bus_bytes;
+    r->txns = dev.hdr_xfers + dev.data_xfers;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long frames = (argc > 1) ? strtoul(argv[1], NULL, 0) : 200000;
+    double spi_hz = (argc > 2) ? atof(argv[2]) : 10e6;
+    double gap_us = (argc > 3) ? atof(argv[3]) : 20.0;
+    static const uint16_t snaplens[] = { 0, 256, 128, 64, 32 };
+    double bus_us, base_fps = 0, fps;
+    bench_result r;
+    size_t i;
+    int batch;
+
+    samples = calloc(MAX_SAMPLES, sizeof(sample));
+    if (!samples)
+    {
+        return 1;
+    }
+    if (argc > 4 ? load_pcap(argv[4]) <= 0 : (build_synthetic(), 0))
+    {
+        return 1;
+    }
+
+    printf("frames=%lu spi_hz=%.0f txn_gap_us=%.1f source=%s (%d frames)\n\n", frames, spi_hz, gap_us,
+           argc > 4 ? argv[4] : "synthetic", sample_count);
+    printf("%-8s %-6s %10s %10s %10s %11s %8s %8s %6s\n", "snaplen", "batch", "bus_B/fr", "fr/xchg",
+           "bus_ms", "frames/s", "speedup", "host_ns", "errors");
+
+    for (i = 0; i < sizeof(snaplens) / sizeof(snaplens[0]); i++)
+    {
+        for (batch = 0; batch <= 1; batch++)
+        {
+            run(snaplens[i], batch, frames, &r);
+            bus_us = (double)r.bus_bytes * 8.0 * 1e6 / spi_hz + (double)r.txns * gap_us;
+            fps = r.frames * 1e6 / bus_us;
+            if (base_fps == 0)
+            {
+                base_fps = fps;
+            }
+            printf("%-8u %-6s %10.1f %10.2f %10.1f %11.0f %7.2fx %8.1f %6lu\n", snaplens[i],
+                   batch ? "on" : "off", (double)r.bus_bytes / r.frames, (double)r.frames / r.exchanges,
+                   bus_us / 1000.0, fps, fps / base_fps, (double)r.host_ns / r.frames, r.errors);
+        }
+    }
+
+    free(samples);
+    return 0;
+}
@@ -0,0 +1,195 @@
+/*
+ * Event trace : cost per event and an end to end drain through the wire format.
+ *
+ *   instant   : TRACE_INSTANT in a tight loop, 1 / 2 / 4 threads on the shared buffer
+ *   pipeline  : producer / consumer on the real tx ring (ring_buff.c hooks), a
+ *               drain thread pulls HW_CMD_TRACE_DRAIN replies into lcp_trace and
+ *               the result is written as Chrome trace JSON
+ *
+ * The host build stands in ns for cycles, so the per-event cost includes a
+ * clock_gettime() that the ESP32's cycle counter read does not pay.
+ *
+ * usage : trace_bench [events] [json]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "ring_buff.h"
+#include "lcp_trace.h"
+
+#define PIPELINE_FRAMES     (200000)
+
+static long thread_events;
+static volatile int pipeline_done;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void *instant_thread(void *arg)
+{
+    long i;
+
+    for (i = 0; i < thread_events; i++)
+    {
+        TRACE_INSTANT(TRACE_ID_LINK_CMD, i);
+    }
+    return NULL;
+}
+
+static void run_instant(long events, int threads)
+{
+    pthread_t tid[4];
+    uint64_t t0, elapsed;
+    int i;
+
+    trace_buf_init();
+    thread_events = events / threads;
+    t0 = now_ns();
+    for (i = 0; i < threads; i++)
+    {
+        pthread_create(&tid[i], NULL, instant_thread, NULL);
+    }
+    for (i = 0; i < threads; i++)
+    {
+        pthread_join(tid[i], NULL);
+    }
+    elapsed = now_ns() - t0;
+    printf("instant    threads=%d %10.1f ns/event %12.0f events/s\n", threads,
+           (double)elapsed * threads / events, events * 1e9 / elapsed);
+}
+
+/* The timestamp read alone, to separate the platform clock from the buffer write */
+static void run_clock(long events)
+{
+    volatile uint32_t sink;
+    uint64_t t0, elapsed;
+    long i;
+
+    t0 = now_ns();
+    for (i = 0; i < events; i++)
+    {
+        sink = TRACE_BUF_CYCLES();
+    }
+    elapsed = now_ns() - t0;
+    (void)sink;
+    printf("clock only           %10.1f ns/read\n", (double)elapsed / events);
+}
+
+static void *producer_thread(void *arg)
+{
+    static u8 frame[256];
+    long i;
+
+    for (i = 0; i < PIPELINE_FRAMES; i++)
+    {
+        while (1)
+        {
+            tx_buffer_critical_section_lock();
+            if (tx_buffer_enqueue(frame, sizeof(frame), HW_LCP_TYPE_80211) == 0)
+            {
+                tx_buffer_critical_section_unlock();
+                break;
+            }
+            tx_buffer_critical_section_unlock();
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+static void *consumer_thread(void *arg)
+{
+    long got = 0;
+    buffer *buf;
+
+    while (got < PIPELINE_FRAMES)
+    {
+        tx_buffer_critical_section_lock();
+        buf = tx_buffer_dequeue();
+        tx_buffer_critical_section_unlock();
+        if (buf)
+        {
+            got++;
+        }
+        else
+        {
+            sched_yield();
+        }
+    }
+    pipeline_done = 1;
+    return NULL;
+}
+
+static void run_pipeline(const char *json)
+{
+    static u8 reply[HW_LCP_MAX_PAYLOAD_LEN];
+    pthread_t producer, consumer;
+    lcp_trace trace;
+    FILE *fp;
+    int len;
+
+    buffer_init();
+    trace_buf_init();
+    lcp_trace_init(&trace);
+    pipeline_done = 0;
+
+    pthread_create(&producer, NULL, producer_thread, NULL);
+    pthread_create(&consumer, NULL, consumer_thread, NULL);
+    for (;;)
+    {
+        int done = pipeline_done;
+
+        len = trace_buf_drain(reply, HW_CMD_TRACE_DRAIN);
+        if (lcp_trace_add_reply(&trace, reply, len) == LCP_TRACE_OK && done)
+        {
+            break;
+        }
+        if (reply[TRACE_REPLY_COUNT] == 0)
+        {
+            sched_yield();
+        }
+    }
+    pthread_join(producer, NULL);
+    pthread_join(consumer, NULL);
+    buffer_deinit();
+
+    printf("pipeline   frames=%d events=%zu replies=%lu dropped=%u\n", PIPELINE_FRAMES, trace.count,
+           trace.replies, (unsigned int)trace.dropped);
+
+    fp = fopen(json, "w");
+    if (!fp)
+    {
+        perror(json);
+    }
+    else
+    {
+        lcp_trace_write_json(&trace, fp);
+        fclose(fp);
+        printf("wrote %s\n", json);
+    }
+    lcp_trace_free(&trace);
+}
+
+int main(int argc, char **argv)
+{
+    long events = (argc > 1) ? atol(argv[1]) : 20000000;
+    const char *json = (argc > 2) ? argv[2] : "/tmp/trace_bench.json";
+
+    printf("events=%ld buffer=%d event=%zu bytes\n", events, TRACE_BUF_EVENTS, sizeof(trace_event));
+    run_clock(events);
+    run_instant(events, 1);
+    run_instant(events, 2);
+    run_instant(events, 4);
+    run_pipeline(json);
+    return 0;
+}
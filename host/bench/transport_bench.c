@@ -0,0 +1,177 @@
+/*
+ * Common link benchmark driver : runs a device side and a host side LCP engine
+ * against each other over a transport pair and reports throughput and
+ * per-frame latency (device dequeue -> host delivery).
+ *
+ * Only transports that exist on Linux are driven here (socketpair, pipes);
+ * SPI and UART need the board.
+ *
+ * usage : transport_bench [frames]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+
+#include "hw_link_ctrl_protocol.h"
+#include "hw_link_engine.h"
+#include "hw_transport.h"
+
+#define POLL_TIMEOUT_MS     (10)
+
+typedef struct bench_side
+{
+    hw_link_engine engine;
+    hw_transport *transport;
+    int payload_len;
+    long frames;
+    long produced;
+    long received;
+    double *latency_us;
+    volatile int *stop;
+} bench_side;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Device : every frame carries its dequeue time */
+static int dev_get_tx(void *ctx, u8 *buf, hw_link_tx_desc *desc)
+{
+    bench_side *side = (bench_side *)ctx;
+    uint64_t t;
+
+    if (side->produced >= side->frames)
+    {
+        return 0;
+    }
+    side->produced++;
+    t = now_ns();
+    memset(buf, 0xa5, side->payload_len);
+    memcpy(buf, &t, sizeof(t));
+    desc->type = HW_LCP_TYPE_80211;
+    return side->payload_len;
+}
+
+static void host_on_rx(void *ctx, u8 *frame)
+{
+    bench_side *side = (bench_side *)ctx;
+    uint64_t t;
+
+    if (is_valid_hw_frame(frame) <= 0)
+    {
+        return;
+    }
+    memcpy(&t, &frame[PAYLOAD_FIELD], sizeof(t));
+    if (side->received < side->frames)
+    {
+        side->latency_us[side->received] = (now_ns() - t) / 1000.0;
+    }
+    side->received++;
+}
+
+static void *dev_thread(void *arg)
+{
+    bench_side *side = (bench_side *)arg;
+
+    while (!*side->stop)
+    {
+        hw_link_engine_poll(&side->engine, POLL_TIMEOUT_MS);
+    }
+    return NULL;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+static void bench_transport_pair(const char *name, hw_transport *dev_tr, hw_transport *host_tr,
+                                 int payload_len, long frames)
+{
+    static bench_side dev, host;
+    volatile int stop = 0;
+    pthread_t tid;
+    uint64_t t0, elapsed;
+    double secs;
+
+    memset(&dev, 0x0, sizeof(dev));
+    memset(&host, 0x0, sizeof(host));
+    dev.payload_len = payload_len;
+    dev.frames = frames;
+    dev.stop = &stop;
+    host.frames = frames;
+    host.latency_us = calloc(frames, sizeof(double));
+
+    hw_transport_open(dev_tr);
+    hw_transport_open(host_tr);
+    hw_link_engine_init(&dev.engine, dev_tr, dev_get_tx, NULL, &dev);
+    hw_link_engine_init(&host.engine, host_tr, NULL, host_on_rx, &host);
+
+    t0 = now_ns();
+    pthread_create(&tid, NULL, dev_thread, &dev);
+    while (host.received < frames)
+    {
+        if (hw_link_engine_poll(&host.engine, POLL_TIMEOUT_MS) == HW_LINK_ENGINE_ERR)
+        {
+            break;
+        }
+    }
+    elapsed = now_ns() - t0;
+    stop = 1;
+    pthread_join(tid, NULL);
+
+    secs = elapsed / 1e9;
+    qsort(host.latency_us, host.received < frames ? host.received : frames, sizeof(double), cmp_double);
+    printf("%-12s %6d %10ld %12.0f %9.2f %9.1f %9.1f %9.1f %6lu\n", name, payload_len, host.received,
+           host.received / secs, host.received * (double)payload_len / secs / 1e6,
+           host.latency_us[host.received / 2], host.latency_us[host.received * 99 / 100],
+           host.latency_us[host.received - 1], dev.engine.errors + host.engine.errors);
+
+    free(host.latency_us);
+}
+
+int main(int argc, char **argv)
+{
+    long frames = (argc > 1) ? atol(argv[1]) : 100000;
+    static const int sizes[] = { 16, 64, 256, 512 };
+    size_t i;
+
+    printf("%-12s %6s %10s %12s %9s %9s %9s %9s %6s\n", "transport", "bytes", "frames",
+           "frames/s", "MB/s", "p50_us", "p99_us", "max_us", "errors");
+
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        hw_transport *dev_tr, *host_tr;
+        int sv[2], a[2], b[2];
+
+        socketpair(AF_UNIX, SOCK_STREAM, 0, sv);
+        dev_tr = hw_transport_sock_create(sv[0], sv[0]);
+        host_tr = hw_transport_sock_create(sv[1], sv[1]);
+        bench_transport_pair("socketpair", dev_tr, host_tr, sizes[i], frames);
+        hw_transport_sock_destroy(dev_tr);
+        hw_transport_sock_destroy(host_tr);
+
+        if (pipe(a) < 0 || pipe(b) < 0)
+        {
+            return 1;
+        }
+        dev_tr = hw_transport_sock_create(a[0], b[1]);
+        host_tr = hw_transport_sock_create(b[0], a[1]);
+        bench_transport_pair("pipe", dev_tr, host_tr, sizes[i], frames);
+        hw_transport_sock_destroy(dev_tr);
+        hw_transport_sock_destroy(host_tr);
+    }
+
+    return 0;
+}
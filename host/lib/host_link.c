@@ -0,0 +1,613 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <net/if.h>
+#include <linux/if_tun.h>
+
+#include "host_link.h"
+#include "hw_link_engine.h"
+
+#define HOST_LINK_POLL_MS       (100)
+
+struct host_link
+{
+    hw_transport *transport;
+    hw_link_engine engine;
+    pthread_t thread;
+    volatile int running;
+
+    lcp_frame_pool pool;
+    lcp_frame_queue rx_queue;
+    lcp_frame_queue tx_queue;
+    lock_t tx_lock;             /* host_link_send() may be called from several threads */
+    lcp_stream stream;
+
+    /* Producer side frame cache, refilled from the pool a batch at a time */
+    lcp_frame *rx_cache[HOST_LINK_BATCH];
+    int rx_cache_count;
+    int rx_batch_off;           /* Next record of a stalled batch, 0 : none */
+
+    int event_fd;
+    int rx_signalled;
+    int tap_fd;
+    u8 *tap_buf;                /* HOST_LINK_TAP_BUF_LEN */
+
+    /* Updated by the link thread and the feed / send / pump callers, read by host_link_get_stats() */
+    lock_t stats_lock;
+    lcp_seq_rx dev_seq;
+    lcp_latency capture_latency;
+    lcp_latency link_latency;
+
+    host_link_stats stats;
+};
+
+static lcp_frame *host_link_rx_frame_get(host_link *link)
+{
+    if (link->rx_cache_count == 0)
+    {
+        link->rx_cache_count = lcp_frame_pool_alloc(&link->pool, link->rx_cache, HOST_LINK_BATCH);
+        if (link->rx_cache_count == 0)
+        {
+            return NULL;
+        }
+    }
+    return link->rx_cache[--link->rx_cache_count];
+}
+
+static uint64_t host_link_now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+/* Sequence and latency accounting for frames carrying the trailer, under stats_lock */
+static void host_link_rx_account(host_link *link, const hw_lcp_ext *ext)
+{
+    uint64_t now = host_link_now_us();
+
+    lcp_seq_rx_update(&link->dev_seq, ext->seq);
+    if (ext->flags & HW_LCP_EXT_CAPTURE_VALID)
+    {
+        lcp_latency_add(&link->capture_latency, ext->capture_us, now);
+    }
+    if (ext->flags & HW_LCP_EXT_SEND_VALID)
+    {
+        lcp_latency_add(&link->link_latency, ext->send_us, now);
+    }
+}
+
+/*
+ * One pool frame per record of a HW_LCP_TYPE_BATCH frame. When the pool or the
+ * queue runs out, the offset of the first record not queued is kept and the call
+ * fails, so a stalled stream hands the same batch again and delivery continues
+ * from there. The trailer is accounted once, when the last record is queued.
+ */
+static int host_link_rx_deliver_batch(host_link *link, const u8 *lcp, int payload_len)
+{
+    hw_lcp_batch_rec rec;
+    lcp_frame *frame;
+    hw_lcp_ext ext;
+    unsigned long frames = 0, bytes = 0;
+    int off = link->rx_batch_off, at = off, ret = 0;
+
+    while (hw_lcp_batch_next(&lcp[PAYLOAD_FIELD], payload_len, &off, &rec) > 0)
+    {
+        if (lcp_frame_queue_full(&link->rx_queue))
+        {
+            ret = -1;
+            break;
+        }
+        frame = host_link_rx_frame_get(link);
+        if (!frame)
+        {
+            ret = -1;
+            break;
+        }
+        frame->type    = rec.type;
+        frame->iface   = rec.iface;
+        frame->len     = rec.len;
+        frame->has_ext = 0;
+        memcpy(frame->data, rec.data, rec.len);
+
+        if (lcp_frame_queue_push(&link->rx_queue, frame) < 0)
+        {
+            link->rx_cache[link->rx_cache_count++] = frame;
+            ret = -1;
+            break;
+        }
+        frames++;
+        bytes += rec.len;
+        at = off;
+    }
+    link->rx_batch_off = ret ? at : 0;
+
+    LOCK(&link->stats_lock);
+    link->stats.frames_rx += frames;
+    link->stats.bytes_rx += bytes;
+    if (ret == 0)
+    {
+        if (hw_frame_get_ext((u8 *)lcp, &ext))
+        {
+            host_link_rx_account(link, &ext);
+        }
+        link->stats.batches_rx++;
+    }
+    UNLOCK(&link->stats_lock);
+    return ret;
+}
+
+/* The engine does not hand a frame twice : whatever was not queued of it is lost */
+static void host_link_rx_drop(host_link *link, const u8 *lcp, int payload_len)
+{
+    hw_lcp_batch_rec rec;
+    unsigned long dropped = 1;
+    int off = link->rx_batch_off;
+
+    link->rx_batch_off = 0;
+    if (lcp[HW_LCP_TYPE_FIELD] == HW_LCP_TYPE_BATCH)
+    {
+        for (dropped = 0; hw_lcp_batch_next(&lcp[PAYLOAD_FIELD], payload_len, &off, &rec) > 0; dropped++)
+        {
+        }
+    }
+
+    LOCK(&link->stats_lock);
+    link->stats.rx_dropped += dropped;
+    UNLOCK(&link->stats_lock);
+}
+
+/*
+ * Copy one decoded LCP frame into a pool frame and queue it for the application.
+ * The trailer is accounted from a local copy: once queued, the frame belongs to
+ * the consumer. Nothing is accounted for a refused frame, so a stalled stream
+ * retrying it does not count it twice.
+ */
+static int host_link_rx_deliver(host_link *link, const u8 *lcp, int payload_len)
+{
+    lcp_frame *frame;
+    hw_lcp_ext ext;
+    int has_ext;
+
+    if (lcp[HW_LCP_TYPE_FIELD] == HW_LCP_TYPE_BATCH)
+    {
+        return host_link_rx_deliver_batch(link, lcp, payload_len);
+    }
+
+    if (lcp_frame_queue_full(&link->rx_queue))
+    {
+        return -1;
+    }
+    frame = host_link_rx_frame_get(link);
+    if (!frame)
+    {
+        return -1;
+    }
+
+    has_ext = hw_frame_get_ext((u8 *)lcp, &ext);
+    frame->type = lcp[HW_LCP_TYPE_FIELD];
+    frame->iface = hw_frame_iface(lcp);
+    frame->len  = payload_len;
+    frame->has_ext = (u8)has_ext;
+    if (has_ext)
+    {
+        frame->ext = ext;
+    }
+    memcpy(frame->data, &lcp[PAYLOAD_FIELD], payload_len);
+
+    if (lcp_frame_queue_push(&link->rx_queue, frame) < 0)
+    {
+        link->rx_cache[link->rx_cache_count++] = frame;
+        return -1;
+    }
+
+    LOCK(&link->stats_lock);
+    if (has_ext)
+    {
+        host_link_rx_account(link, &ext);
+    }
+    link->stats.frames_rx++;
+    link->stats.bytes_rx += payload_len;
+    UNLOCK(&link->stats_lock);
+    return 0;
+}
+
+/* One eventfd write per batch, and only when the consumer is not already awake */
+static void host_link_notify(host_link *link)
+{
+    uint64_t one = 1;
+
+    if (!__atomic_exchange_n(&link->rx_signalled, 1, __ATOMIC_ACQ_REL))
+    {
+        if (write(link->event_fd, &one, sizeof(one)) < 0)
+        {
+            ERROR_PRINT("eventfd write failed [%d]\n", errno);
+        }
+    }
+}
+
+/* Stream input can wait : a full queue stalls the decoder instead of dropping */
+static int host_link_stream_cb(void *ctx, u8 *frame, int payload_len)
+{
+    return host_link_rx_deliver((host_link *)ctx, frame, payload_len);
+}
+
+static void host_link_engine_rx(void *ctx, u8 *frame)
+{
+    host_link *link = (host_link *)ctx;
+    int payload_len = is_valid_hw_frame(frame), partial;
+
+    if (payload_len <= 0)
+    {
+        return;
+    }
+    if (host_link_rx_deliver(link, frame, payload_len) < 0)
+    {
+        partial = (link->rx_batch_off != 0);
+        host_link_rx_drop(link, frame, payload_len);
+        if (partial)
+        {
+            host_link_notify(link);
+        }
+        return;
+    }
+    host_link_notify(link);
+}
+
+static int host_link_engine_tx(void *ctx, u8 *buf, hw_link_tx_desc *desc)
+{
+    host_link *link = (host_link *)ctx;
+    lcp_frame *frame;
+    int len;
+
+    if (lcp_frame_queue_pop(&link->tx_queue, &frame, 1) == 0)
+    {
+        return 0;
+    }
+
+    len = frame->len;
+    desc->type = frame->type;
+    desc->iface = frame->iface;
+    memcpy(buf, frame->data, len);
+    lcp_frame_pool_free(&link->pool, &frame, 1);
+
+    LOCK(&link->stats_lock);
+    link->stats.frames_tx++;
+    link->stats.bytes_tx += len;
+    UNLOCK(&link->stats_lock);
+    return len;
+}
+
+static void *host_link_thread(void *arg)
+{
+    host_link *link = (host_link *)arg;
+
+    while (link->running)
+    {
+        if (hw_link_engine_poll(&link->engine, HOST_LINK_POLL_MS) == HW_LINK_ENGINE_ERR)
+        {
+            DEBUG_PRINT("link exchange failed\n");
+        }
+    }
+    return NULL;
+}
+
+host_link *host_link_create(hw_transport *transport)
+{
+    host_link *link = calloc(1, sizeof(host_link));
+
+    if (!link)
+    {
+        return NULL;
+    }
+
+    if (lcp_frame_pool_init(&link->pool) < 0)
+    {
+        free(link);
+        return NULL;
+    }
+
+    link->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (link->event_fd < 0)
+    {
+        lcp_frame_pool_deinit(&link->pool);
+        free(link);
+        return NULL;
+    }
+
+    link->transport = transport;
+    link->tap_fd = -1;
+    lcp_frame_queue_init(&link->rx_queue);
+    lcp_frame_queue_init(&link->tx_queue);
+    lcp_stream_init(&link->stream);
+    lcp_seq_rx_init(&link->dev_seq);
+    lcp_latency_init(&link->capture_latency);
+    lcp_latency_init(&link->link_latency);
+    LOCK_INIT(&link->tx_lock);
+    LOCK_INIT(&link->stats_lock);
+
+    return link;
+}
+
+void host_link_destroy(host_link *link)
+{
+    if (!link)
+    {
+        return;
+    }
+
+    if (link->running)
+    {
+        link->running = 0;
+        pthread_join(link->thread, NULL);
+        hw_transport_close(link->transport);
+    }
+    free(link->tap_buf);
+    if (link->tap_fd >= 0)
+    {
+        close(link->tap_fd);
+    }
+    close(link->event_fd);
+    lcp_frame_pool_deinit(&link->pool);
+    free(link);
+}
+
+/* Open the device transport and run the LCP engine in a link thread */
+int host_link_start(host_link *link)
+{
+    if (!link->transport || hw_transport_open(link->transport) != HW_TRANSPORT_OK)
+    {
+        return -1;
+    }
+
+    hw_link_engine_init(&link->engine, link->transport, host_link_engine_tx, host_link_engine_rx, link);
+    link->running = 1;
+    if (pthread_create(&link->thread, NULL, host_link_thread, link) != 0)
+    {
+        link->running = 0;
+        hw_transport_close(link->transport);
+        return -1;
+    }
+    return 0;
+}
+
+int host_link_fd(host_link *link)
+{
+    return link->event_fd;
+}
+
+/* Drain up to max frames. Frames stay owned by the caller until host_link_release() */
+int host_link_recv_batch(host_link *link, lcp_frame **frames, int max)
+{
+    uint64_t value;
+    int count = lcp_frame_queue_pop(&link->rx_queue, frames, max);
+
+    if (count == 0)
+    {
+        /* Re-arm : clear the eventfd before the flag so a concurrent push always signals again */
+        if (read(link->event_fd, &value, sizeof(value)) < 0 && errno != EAGAIN)
+        {
+            ERROR_PRINT("eventfd read failed [%d]\n", errno);
+        }
+        __atomic_store_n(&link->rx_signalled, 0, __ATOMIC_RELEASE);
+        count = lcp_frame_queue_pop(&link->rx_queue, frames, max);
+    }
+    return count;
+}
+
+void host_link_release(host_link *link, lcp_frame **frames, int count)
+{
+    lcp_frame_pool_free(&link->pool, frames, count);
+}
+
+int host_link_send(host_link *link, u8 type, const u8 *payload, int len)
+{
+    return host_link_send_iface(link, HW_LCP_IFACE_STA, type, payload, len);
+}
+
+/* Frame for one interface's queue on the device (hw_lcp_iface) */
+int host_link_send_iface(host_link *link, u8 iface, u8 type, const u8 *payload, int len)
+{
+    lcp_frame *frame;
+    int ret = -1;
+
+    if (len <= 0 || len > HW_LCP_MAX_PAYLOAD_LEN)
+    {
+        return -1;
+    }
+
+    LOCK(&link->tx_lock);
+    if (lcp_frame_pool_alloc(&link->pool, &frame, 1) == 1)
+    {
+        frame->type = type;
+        frame->iface = iface;
+        frame->len  = len;
+        memcpy(frame->data, payload, len);
+        ret = lcp_frame_queue_push(&link->tx_queue, frame);
+        if (ret < 0)
+        {
+            lcp_frame_pool_free(&link->pool, &frame, 1);
+        }
+    }
+    if (ret < 0)
+    {
+        LOCK(&link->stats_lock);
+        link->stats.tx_dropped++;
+        UNLOCK(&link->stats_lock);
+    }
+    UNLOCK(&link->tx_lock);
+    return ret;
+}
+
+/* Decode a raw LCP byte stream from fd : one large read, many frames, one wakeup */
+int host_link_feed_fd(host_link *link, int fd)
+{
+    int count = lcp_stream_read_fd(&link->stream, fd, host_link_stream_cb, link);
+
+    /* A batch stalled half way has queued records too */
+    if (count > 0 || link->rx_batch_off)
+    {
+        host_link_notify(link);
+    }
+    if (count < 0)
+    {
+        return HOST_LINK_EOF;
+    }
+    if (lcp_stream_stalled(&link->stream))
+    {
+        LOCK(&link->stats_lock);
+        link->stats.rx_stalls++;
+        UNLOCK(&link->stats_lock);
+        return count ? count : HOST_LINK_BUSY;
+    }
+    return count;
+}
+
+/* Sequence trailers both ways : host -> device from the next frame, device -> host once it sees the command */
+int host_link_set_seq(host_link *link, int enable)
+{
+    u8 cmd[2] = { HW_CMD_SET_LINK_SEQ, (u8)(enable != 0) };
+
+    hw_link_engine_set_seq(&link->engine, enable);
+    return host_link_send(link, HW_LCP_TYPE_CMD, cmd, sizeof(cmd));
+}
+
+int host_link_tap_open(host_link *link, const char *name)
+{
+    struct ifreq ifr;
+    int fd = open("/dev/net/tun", O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    int sock;
+
+    if (fd < 0)
+    {
+        ERROR_PRINT("open /dev/net/tun failed [%d]\n", errno);
+        return -1;
+    }
+
+    memset(&ifr, 0x0, sizeof(ifr));
+    ifr.ifr_flags = IFF_TAP | IFF_NO_PI;
+    if (name)
+    {
+        strncpy(ifr.ifr_name, name, IFNAMSIZ - 1);
+    }
+    if (ioctl(fd, TUNSETIFF, &ifr) < 0)
+    {
+        ERROR_PRINT("TUNSETIFF [%s] failed [%d]\n", name ? name : "", errno);
+        close(fd);
+        return -1;
+    }
+
+    /* Longer packets would not fit one LCP frame; the pump still drops any that come */
+    sock = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    ifr.ifr_mtu = HOST_LINK_TAP_MTU;
+    if (sock < 0 || ioctl(sock, SIOCSIFMTU, &ifr) < 0)
+    {
+        ERROR_PRINT("SIOCSIFMTU [%s] %d failed [%d]\n", ifr.ifr_name, HOST_LINK_TAP_MTU, errno);
+    }
+    if (sock >= 0)
+    {
+        close(sock);
+    }
+
+    link->tap_buf = malloc(HOST_LINK_TAP_BUF_LEN);
+    if (!link->tap_buf)
+    {
+        close(fd);
+        return -1;
+    }
+    link->tap_fd = fd;
+    return 0;
+}
+
+int host_link_tap_fd(host_link *link)
+{
+    return link->tap_fd;
+}
+
+/*
+ * Bridge one batch in each direction. With a TAP attached this is the RX consumer:
+ * 802.3 frames go to the TAP, anything else is released. A TAP takes one packet per
+ * write(), so batching here is on the queue side (one pop / one release per batch).
+ */
+int host_link_tap_pump(host_link *link)
+{
+    lcp_frame *frames[HOST_LINK_BATCH];
+    unsigned long tap_tx = 0, tap_rx = 0, oversize = 0;
+    int count, i, len;
+
+    if (link->tap_fd < 0)
+    {
+        return -1;
+    }
+
+    count = host_link_recv_batch(link, frames, HOST_LINK_BATCH);
+    for (i = 0; i < count; i++)
+    {
+        if (frames[i]->type == HW_LCP_TYPE_8023 &&
+            write(link->tap_fd, frames[i]->data, frames[i]->len) == frames[i]->len)
+        {
+            tap_tx++;
+        }
+    }
+    host_link_release(link, frames, count);
+
+    for (i = 0; i < HOST_LINK_BATCH; i++)
+    {
+        len = read(link->tap_fd, link->tap_buf, HOST_LINK_TAP_BUF_LEN);
+        if (len <= 0)
+        {
+            break;
+        }
+        if (len > HW_LCP_MAX_PAYLOAD_LEN)
+        {
+            oversize++;
+            continue;
+        }
+        if (host_link_send(link, HW_LCP_TYPE_8023, link->tap_buf, len) == 0)
+        {
+            tap_rx++;
+        }
+    }
+
+    LOCK(&link->stats_lock);
+    link->stats.tap_tx += tap_tx;
+    link->stats.tap_rx += tap_rx;
+    link->stats.tap_oversize += oversize;
+    UNLOCK(&link->stats_lock);
+    return (int)(tap_tx + tap_rx);
+}
+
+/* Consistent snapshot : the latency windows are copied under the lock and summarised outside it */
+void host_link_get_stats(host_link *link, host_link_stats *stats)
+{
+    lcp_latency *lat = malloc(2 * sizeof(lcp_latency));
+
+    LOCK(&link->stats_lock);
+    *stats = link->stats;
+    stats->seq = link->dev_seq.stats;
+    if (lat)
+    {
+        lat[0] = link->capture_latency;
+        lat[1] = link->link_latency;
+    }
+    UNLOCK(&link->stats_lock);
+
+    stats->resyncs = link->stream.resyncs;
+    stats->reads   = link->stream.reads;
+    if (lat)
+    {
+        lcp_latency_get(&lat[0], &stats->capture_latency);
+        lcp_latency_get(&lat[1], &stats->link_latency);
+        free(lat);
+    }
+    else
+    {
+        memset(&stats->capture_latency, 0x0, sizeof(lcp_latency_summary));
+        memset(&stats->link_latency, 0x0, sizeof(lcp_latency_summary));
+    }
+}
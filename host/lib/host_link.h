@@ -0,0 +1,78 @@
+#ifndef _HOST_LINK_H
+#define _HOST_LINK_H
+
+#include "utils.h"
+#include "hw_transport.h"
+#include "lcp_frame_pool.h"
+#include "lcp_stream.h"
+#include "lcp_seq.h"
+#include "lcp_latency.h"
+
+/*
+ * Userspace host side of the module link.
+ *
+ * Frames coming from the module are decoded into preallocated pool frames and
+ * queued for the application. host_link_fd() is an eventfd that becomes
+ * readable when frames are pending, so it can sit in the application's epoll
+ * set; host_link_recv_batch() then drains them in one go.
+ *
+ * Frames reach the library either from a device transport driven by a link
+ * thread (host_link_start : hw_transport_spidev for the module's SPI link,
+ * hw_transport_sock for a socket or pipe) or from a raw LCP byte stream
+ * (host_link_feed_fd).
+ * Use one or the other: the RX queue has a single producer.
+ */
+
+#define HOST_LINK_BATCH         (64)
+
+/* Largest 802.3 frame one LCP frame carries, the TAP MTU is set from it */
+#define HOST_LINK_TAP_MTU       (HW_LCP_MAX_PAYLOAD_LEN - 14)
+#define HOST_LINK_TAP_BUF_LEN   (65536)     /* Any packet the TAP can hand over, so none is cut */
+
+/* host_link_feed_fd() */
+#define HOST_LINK_EOF           (-1)
+#define HOST_LINK_BUSY          (-2)    /* RX queue full, frames held until the consumer drains */
+
+typedef struct host_link_stats
+{
+    unsigned long frames_rx;
+    unsigned long frames_tx;
+    unsigned long bytes_rx;
+    unsigned long bytes_tx;
+    unsigned long rx_dropped;       /* Pool or queue exhausted (link thread) */
+    unsigned long batches_rx;       /* HW_LCP_TYPE_BATCH frames, their records count as frames */
+    unsigned long rx_stalls;        /* Stream input held back (host_link_feed_fd) */
+    unsigned long tx_dropped;
+    unsigned long resyncs;
+    unsigned long reads;
+    unsigned long tap_rx;
+    unsigned long tap_tx;
+    unsigned long tap_oversize;     /* TAP packets longer than one LCP frame, dropped */
+
+    /* Frames with the sequence trailer (HW_CMD_SET_LINK_SEQ) */
+    lcp_seq_stats seq;
+    lcp_latency_summary capture_latency;    /* On air (rx_ctrl.timestamp) -> host */
+    lcp_latency_summary link_latency;       /* Handed to the device link -> host */
+} host_link_stats;
+
+typedef struct host_link host_link;
+
+host_link *host_link_create(hw_transport *);
+void host_link_destroy(host_link *);
+int host_link_start(host_link *);
+int host_link_fd(host_link *);
+
+int host_link_recv_batch(host_link *, lcp_frame **, int);
+void host_link_release(host_link *, lcp_frame **, int);
+int host_link_send(host_link *, u8, const u8 *, int);
+int host_link_send_iface(host_link *, u8, u8, const u8 *, int);
+int host_link_feed_fd(host_link *, int);
+int host_link_set_seq(host_link *, int);
+
+int host_link_tap_open(host_link *, const char *);
+int host_link_tap_fd(host_link *);
+int host_link_tap_pump(host_link *);
+
+void host_link_get_stats(host_link *, host_link_stats *);
+
+#endif
@@ -0,0 +1,257 @@
+/*
+ * Linux SPI master transport : spidev for the bus, GPIO character device for
+ * the module's handshake line.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/gpio.h>
+#include <linux/spi/spidev.h>
+
+#include "hw_transport_spidev.h"
+#include "hw_link_xfer.h"
+
+typedef struct spidev_priv
+{
+    hw_transport_spidev_config config;
+    int spi_fd;
+    int event_fd;                   /* Handshake line events, -1 : no handshake */
+    int ready;                      /* A rising edge was seen since the last exchange */
+
+    const u8 *tx;
+    u8 *rx;
+    int len;
+} spidev_priv;
+
+static const u8 zero_buf[HW_LINK_MAX_DATA_LEN];
+
+static long spidev_now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+
+static int spidev_open_handshake(spidev_priv *priv)
+{
+    struct gpioevent_request req;
+    struct gpiohandle_data data;
+    int chip_fd = open(priv->config.gpiochip, O_RDONLY | O_CLOEXEC);
+
+    if (chip_fd < 0)
+    {
+        ERROR_PRINT("open [%s] failed [%d]\n", priv->config.gpiochip, errno);
+        return HW_TRANSPORT_ERR;
+    }
+
+    memset(&req, 0x0, sizeof(req));
+    req.lineoffset  = (uint32_t)priv->config.handshake_line;
+    req.handleflags = GPIOHANDLE_REQUEST_INPUT;
+    req.eventflags  = GPIOEVENT_REQUEST_RISING_EDGE;
+    strncpy(req.consumer_label, "esp-link-handshake", sizeof(req.consumer_label) - 1);
+    if (ioctl(chip_fd, GPIO_GET_LINEEVENT_IOCTL, &req) < 0)
+    {
+        ERROR_PRINT("handshake line [%d] request failed [%d]\n", priv->config.handshake_line, errno);
+        close(chip_fd);
+        return HW_TRANSPORT_ERR;
+    }
+    close(chip_fd);
+
+    priv->event_fd = req.fd;
+    fcntl(priv->event_fd, F_SETFL, fcntl(priv->event_fd, F_GETFL) | O_NONBLOCK);
+
+    /* A transaction queued before we started only shows as the current level */
+    if (ioctl(priv->event_fd, GPIOHANDLE_GET_LINE_VALUES_IOCTL, &data) == 0 && data.values[0])
+    {
+        priv->ready = 1;
+    }
+    return HW_TRANSPORT_OK;
+}
+
+static int spidev_open(hw_transport *transport)
+{
+    spidev_priv *priv = (spidev_priv *)transport->priv;
+    uint8_t mode = SPI_MODE_0, bits = 8;
+    uint32_t speed = priv->config.speed_hz ? priv->config.speed_hz : HW_TRANSPORT_SPIDEV_SPEED_HZ;
+
+    priv->spi_fd = open(priv->config.spidev, O_RDWR | O_CLOEXEC);
+    if (priv->spi_fd < 0)
+    {
+        ERROR_PRINT("open [%s] failed [%d]\n", priv->config.spidev, errno);
+        return HW_TRANSPORT_ERR;
+    }
+
+    /* Mode 0, 8 bit words : the slave configuration in hw_transport_spi.c */
+    if (ioctl(priv->spi_fd, SPI_IOC_WR_MODE, &mode) < 0 ||
+        ioctl(priv->spi_fd, SPI_IOC_WR_BITS_PER_WORD, &bits) < 0 ||
+        ioctl(priv->spi_fd, SPI_IOC_WR_MAX_SPEED_HZ, &speed) < 0)
+    {
+        ERROR_PRINT("[%s] setup failed [%d]\n", priv->config.spidev, errno);
+        close(priv->spi_fd);
+        priv->spi_fd = -1;
+        return HW_TRANSPORT_ERR;
+    }
+    priv->config.speed_hz = speed;
+
+    priv->ready = 0;
+    if (priv->config.handshake_line >= 0 && spidev_open_handshake(priv) != HW_TRANSPORT_OK)
+    {
+        close(priv->spi_fd);
+        priv->spi_fd = -1;
+        return HW_TRANSPORT_ERR;
+    }
+    return HW_TRANSPORT_OK;
+}
+
+static void spidev_close(hw_transport *transport)
+{
+    spidev_priv *priv = (spidev_priv *)transport->priv;
+
+    if (priv->spi_fd >= 0)
+    {
+        close(priv->spi_fd);
+    }
+    if (priv->event_fd >= 0)
+    {
+        close(priv->event_fd);
+    }
+    priv->spi_fd = priv->event_fd = -1;
+}
+
+/* The bus is only clocked in get_result(), once the slave is ready */
+static int spidev_queue(hw_transport *transport, const u8 *tx, u8 *rx, int len)
+{
+    spidev_priv *priv = (spidev_priv *)transport->priv;
+
+    if (len > HW_LINK_MAX_DATA_LEN || priv->spi_fd < 0)
+    {
+        return HW_TRANSPORT_ERR;
+    }
+    priv->tx  = tx ? tx : zero_buf;
+    priv->rx  = rx;
+    priv->len = len;
+    return HW_TRANSPORT_OK;
+}
+
+/* Consume the handshake events pending; a rising edge means the slave queued its next transaction */
+static void spidev_read_events(spidev_priv *priv)
+{
+    struct gpioevent_data ev;
+
+    while (read(priv->event_fd, &ev, sizeof(ev)) == sizeof(ev))
+    {
+        if (ev.id == GPIOEVENT_EVENT_RISING_EDGE)
+        {
+            priv->ready = 1;
+        }
+    }
+}
+
+static int spidev_wait_ready(spidev_priv *priv, int timeout_ms)
+{
+    long deadline = spidev_now_ms() + timeout_ms;
+    struct pollfd pfd;
+
+    pfd.fd = priv->event_fd;
+    pfd.events = POLLIN;
+
+    spidev_read_events(priv);
+    while (!priv->ready)
+    {
+        timeout_ms = (int)(deadline - spidev_now_ms());
+        if (timeout_ms <= 0 || poll(&pfd, 1, timeout_ms) < 0)
+        {
+            return HW_TRANSPORT_TIMEOUT;
+        }
+        spidev_read_events(priv);
+    }
+    return HW_TRANSPORT_OK;
+}
+
+static int spidev_get_result(hw_transport *transport, int timeout_ms)
+{
+    spidev_priv *priv = (spidev_priv *)transport->priv;
+    struct spi_ioc_transfer xfer;
+    int ret;
+
+    if (priv->len <= 0)
+    {
+        return HW_TRANSPORT_ERR;
+    }
+    if (priv->event_fd >= 0)
+    {
+        ret = spidev_wait_ready(priv, timeout_ms);
+        if (ret != HW_TRANSPORT_OK)
+        {
+            return ret;     /* Still queued, the next call keeps waiting */
+        }
+    }
+
+    /* Edges from here on belong to the slave's next transaction */
+    priv->ready = 0;
+
+    memset(&xfer, 0x0, sizeof(xfer));
+    xfer.tx_buf        = (uintptr_t)priv->tx;
+    xfer.rx_buf        = (uintptr_t)priv->rx;
+    xfer.len           = (uint32_t)priv->len;
+    xfer.speed_hz      = priv->config.speed_hz;
+    xfer.bits_per_word = 8;
+    if (ioctl(priv->spi_fd, SPI_IOC_MESSAGE(1), &xfer) < 0)
+    {
+        ERROR_PRINT("SPI_IOC_MESSAGE failed [%d]\n", errno);
+        priv->len = 0;
+        return HW_TRANSPORT_ERR;
+    }
+
+    ret = priv->len;
+    priv->len = 0;
+    return ret;
+}
+
+static const hw_transport_ops spidev_ops =
+{
+    .name       = "spidev-master",
+    .open       = spidev_open,
+    .close      = spidev_close,
+    .queue      = spidev_queue,
+    .get_result = spidev_get_result,
+    .reset      = NULL,
+};
+
+hw_transport *hw_transport_spidev_create(const hw_transport_spidev_config *config)
+{
+    hw_transport *transport;
+    spidev_priv *priv;
+
+    if (!config || !config->spidev || (config->handshake_line >= 0 && !config->gpiochip))
+    {
+        return NULL;
+    }
+
+    transport = calloc(1, sizeof(hw_transport) + sizeof(spidev_priv));
+    if (!transport)
+    {
+        return NULL;
+    }
+    priv = (spidev_priv *)(transport + 1);
+    priv->config   = *config;
+    priv->spi_fd   = -1;
+    priv->event_fd = -1;
+
+    transport->ops = &spidev_ops;
+    transport->priv = priv;
+    return transport;
+}
+
+void hw_transport_spidev_destroy(hw_transport *transport)
+{
+    if (transport)
+    {
+        spidev_close(transport);
+        free(transport);
+    }
+}
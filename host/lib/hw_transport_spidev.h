@@ -0,0 +1,34 @@
+#ifndef _HW_TRANSPORT_SPIDEV_H
+#define _HW_TRANSPORT_SPIDEV_H
+
+#include "hw_transport.h"
+
+/*
+ * Linux SPI master transport (spidev) for the module's default link
+ * (ESP_LINK_TRANSPORT_SPI).
+ *
+ * The module is the SPI slave: it raises the handshake line once it has
+ * queued a transaction and drops it when the transaction is done. queue()
+ * only records the buffers; get_result() waits for a rising edge of the
+ * handshake line (GPIO character device) and clocks the whole exchange in
+ * one full duplex SPI_IOC_MESSAGE, so each header and data phase of the
+ * two-phase exchange is one chip select assertion, as the slave expects.
+ *
+ * With handshake_line < 0 there is no handshake and exchanges are clocked
+ * at once : a MOSI-MISO loopback jumper, where every frame comes back.
+ */
+
+#define HW_TRANSPORT_SPIDEV_SPEED_HZ    (10000000)
+
+typedef struct hw_transport_spidev_config
+{
+    const char *spidev;             /* /dev/spidevB.C */
+    const char *gpiochip;           /* /dev/gpiochipN carrying the handshake line */
+    int handshake_line;             /* Line offset on gpiochip, < 0 : none (loopback) */
+    uint32_t speed_hz;              /* 0 : HW_TRANSPORT_SPIDEV_SPEED_HZ */
+} hw_transport_spidev_config;
+
+hw_transport *hw_transport_spidev_create(const hw_transport_spidev_config *);
+void hw_transport_spidev_destroy(hw_transport *);
+
+#endif
@@ -0,0 +1,110 @@
+#include "lcp_frame_pool.h"
+
+int lcp_frame_pool_init(lcp_frame_pool *pool)
+{
+    int i;
+
+    memset(pool, 0x0, sizeof(lcp_frame_pool));
+    pool->frames = calloc(LCP_POOL_FRAMES, sizeof(lcp_frame));
+    pool->free_list = calloc(LCP_POOL_FRAMES, sizeof(lcp_frame *));
+    if (!pool->frames || !pool->free_list)
+    {
+        lcp_frame_pool_deinit(pool);
+        return -1;
+    }
+
+    for (i = 0; i < LCP_POOL_FRAMES; i++)
+    {
+        pool->free_list[i] = &pool->frames[i];
+    }
+    pool->free_count = LCP_POOL_FRAMES;
+    LOCK_INIT(&pool->lock);
+    return 0;
+}
+
+void lcp_frame_pool_deinit(lcp_frame_pool *pool)
+{
+    SAFE_FREE(pool->frames);
+    SAFE_FREE(pool->free_list);
+    pool->free_count = 0;
+}
+
+/* Take up to count frames, returns how many were available */
+int lcp_frame_pool_alloc(lcp_frame_pool *pool, lcp_frame **frames, int count)
+{
+    int i;
+
+    LOCK(&pool->lock);
+    if (count > pool->free_count)
+    {
+        count = pool->free_count;
+    }
+    for (i = 0; i < count; i++)
+    {
+        frames[i] = pool->free_list[--pool->free_count];
+    }
+    UNLOCK(&pool->lock);
+
+    return count;
+}
+
+void lcp_frame_pool_free(lcp_frame_pool *pool, lcp_frame **frames, int count)
+{
+    int i;
+
+    LOCK(&pool->lock);
+    for (i = 0; i < count; i++)
+    {
+        pool->free_list[pool->free_count++] = frames[i];
+    }
+    UNLOCK(&pool->lock);
+}
+
+void lcp_frame_queue_init(lcp_frame_queue *queue)
+{
+    memset(queue, 0x0, sizeof(lcp_frame_queue));
+}
+
+/* Producer side. Returns 0, or -1 when the queue is full */
+int lcp_frame_queue_push(lcp_frame_queue *queue, lcp_frame *frame)
+{
+    unsigned int tail = queue->tail;
+
+    if (tail - __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE) >= LCP_QUEUE_SIZE)
+    {
+        return -1;
+    }
+    queue->slots[tail & (LCP_QUEUE_SIZE - 1)] = frame;
+    __atomic_store_n(&queue->tail, tail + 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/* Consumer side. Pops up to max frames */
+int lcp_frame_queue_pop(lcp_frame_queue *queue, lcp_frame **frames, int max)
+{
+    unsigned int head = queue->head;
+    unsigned int avail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE) - head;
+    int i;
+
+    if ((unsigned int)max > avail)
+    {
+        max = (int)avail;
+    }
+    for (i = 0; i < max; i++)
+    {
+        frames[i] = queue->slots[(head + i) & (LCP_QUEUE_SIZE - 1)];
+    }
+    __atomic_store_n(&queue->head, head + max, __ATOMIC_RELEASE);
+    return max;
+}
+
+int lcp_frame_queue_empty(lcp_frame_queue *queue)
+{
+    return __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE) == __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+}
+
+/* Producer side. A queue that is not full stays so until this producer pushes */
+int lcp_frame_queue_full(lcp_frame_queue *queue)
+{
+    return queue->tail - __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE) >= LCP_QUEUE_SIZE;
+}
@@ -0,0 +1,52 @@
+#ifndef _LCP_FRAME_POOL_H
+#define _LCP_FRAME_POOL_H
+
+#include "utils.h"
+#include "hw_link_ctrl_protocol.h"
+
+/*
+ * Preallocated LCP frame pool and single producer / single consumer frame queues.
+ * Nothing on the frame path allocates: frames are taken from the pool, handed
+ * through a queue by pointer and released back in batches.
+ */
+
+#define LCP_POOL_FRAMES         (1024)
+#define LCP_QUEUE_SIZE          (1024)      /* Power of 2 */
+
+typedef struct lcp_frame
+{
+    int len;
+    u8 type;
+    u8 iface;                   /* hw_lcp_iface */
+    u8 has_ext;                 /* ext holds the frame's sequence trailer */
+    hw_lcp_ext ext;
+    u8 data[HW_LCP_MAX_PAYLOAD_LEN];
+} lcp_frame;
+
+typedef struct lcp_frame_pool
+{
+    lcp_frame *frames;
+    lcp_frame **free_list;
+    int free_count;
+    lock_t lock;
+} lcp_frame_pool;
+
+typedef struct lcp_frame_queue
+{
+    lcp_frame *slots[LCP_QUEUE_SIZE];
+    unsigned int head;          /* Consumer */
+    unsigned int tail;          /* Producer */
+} lcp_frame_queue;
+
+int lcp_frame_pool_init(lcp_frame_pool *);
+void lcp_frame_pool_deinit(lcp_frame_pool *);
+int lcp_frame_pool_alloc(lcp_frame_pool *, lcp_frame **, int);
+void lcp_frame_pool_free(lcp_frame_pool *, lcp_frame **, int);
+
+void lcp_frame_queue_init(lcp_frame_queue *);
+int lcp_frame_queue_push(lcp_frame_queue *, lcp_frame *);
+int lcp_frame_queue_pop(lcp_frame_queue *, lcp_frame **, int);
+int lcp_frame_queue_empty(lcp_frame_queue *);
+int lcp_frame_queue_full(lcp_frame_queue *);
+
+#endif
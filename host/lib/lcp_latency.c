@@ -0,0 +1,69 @@
+#include "lcp_latency.h"
+
+#define LCP_LATENCY_WRAP        (1LL << 32)
+
+void lcp_latency_init(lcp_latency *lat)
+{
+    memset(lat, 0x0, sizeof(lcp_latency));
+}
+
+void lcp_latency_add(lcp_latency *lat, uint32_t dev_us, uint64_t host_us)
+{
+    int64_t epoch;
+
+    /* A backwards step of more than half the range is the device clock wrapping */
+    if (lat->started && dev_us < lat->last_dev_us && lat->last_dev_us - dev_us > 0x80000000UL)
+    {
+        lat->dev_epoch += LCP_LATENCY_WRAP;
+    }
+    if (!lat->started || (int32_t)(dev_us - lat->last_dev_us) > 0)
+    {
+        lat->last_dev_us = dev_us;
+    }
+    lat->started = 1;
+
+    /* A late frame from just before the wrap belongs to the previous epoch */
+    epoch = lat->dev_epoch;
+    if (dev_us > lat->last_dev_us && dev_us - lat->last_dev_us > 0x80000000UL)
+    {
+        epoch -= LCP_LATENCY_WRAP;
+    }
+
+    lat->diffs[lat->count % LCP_LATENCY_SAMPLES] = (int64_t)host_us - (epoch + dev_us);
+    lat->count++;
+}
+
+static int cmp_i64(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+void lcp_latency_get(const lcp_latency *lat, lcp_latency_summary *summary)
+{
+    unsigned long n = lat->count < LCP_LATENCY_SAMPLES ? lat->count : LCP_LATENCY_SAMPLES;
+    int64_t *sorted;
+
+    memset(summary, 0x0, sizeof(lcp_latency_summary));
+    summary->samples = lat->count;
+    if (n == 0)
+    {
+        return;
+    }
+
+    sorted = malloc(n * sizeof(int64_t));
+    if (!sorted)
+    {
+        return;
+    }
+    memcpy(sorted, lat->diffs, n * sizeof(int64_t));
+    qsort(sorted, n, sizeof(int64_t), cmp_i64);
+
+    summary->offset_us = sorted[0];
+    summary->p50_us = (uint32_t)(sorted[n * 50 / 100] - sorted[0]);
+    summary->p90_us = (uint32_t)(sorted[n * 90 / 100] - sorted[0]);
+    summary->p99_us = (uint32_t)(sorted[n * 99 / 100] - sorted[0]);
+    summary->max_us = (uint32_t)(sorted[n - 1] - sorted[0]);
+    free(sorted);
+}
@@ -0,0 +1,42 @@
+#ifndef _LCP_LATENCY_H
+#define _LCP_LATENCY_H
+
+#include <stdint.h>
+
+#include "utils.h"
+
+/*
+ * One-way latency from device timestamps (hw_lcp_ext) to host receive time.
+ *
+ * The two clocks are unrelated, so the offset is estimated as the minimum of
+ * (host - device) over the last LCP_LATENCY_SAMPLES frames: latencies are
+ * relative to the fastest frame in the window. The window keeps the estimate
+ * following slow drift between the clocks.
+ */
+
+#define LCP_LATENCY_SAMPLES     (4096)
+
+typedef struct lcp_latency_summary
+{
+    unsigned long samples;
+    int64_t offset_us;          /* host - device clock */
+    uint32_t p50_us;
+    uint32_t p90_us;
+    uint32_t p99_us;
+    uint32_t max_us;
+} lcp_latency_summary;
+
+typedef struct lcp_latency
+{
+    int64_t diffs[LCP_LATENCY_SAMPLES];
+    unsigned long count;
+    int64_t dev_epoch;          /* Unwraps the 32 bit device clock */
+    uint32_t last_dev_us;
+    u8 started;
+} lcp_latency;
+
+void lcp_latency_init(lcp_latency *);
+void lcp_latency_add(lcp_latency *, uint32_t, uint64_t);
+void lcp_latency_get(const lcp_latency *, lcp_latency_summary *);
+
+#endif
@@ -0,0 +1,229 @@
+#include "lcp_ota_tx.h"
+
+/* chunk : data bytes per HW_CMD_OTA_DATA (at most LCP_OTA_DATA_MAX), reboot : ask the device to reboot when done */
+void lcp_ota_tx_init(lcp_ota_tx *tx, const u8 *image, uint32_t size, int chunk, int reboot)
+{
+    memset(tx, 0x0, sizeof(lcp_ota_tx));
+    tx->image      = image;
+    tx->size       = size;
+    tx->chunk      = (chunk > 0 && chunk <= LCP_OTA_DATA_MAX) ? chunk : LCP_OTA_DATA_MAX;
+    tx->reboot     = reboot;
+    tx->rewound_to = LCP_OTA_PROBE;
+    tx->state      = LCP_OTA_TX_BEGIN;
+    sha256(image, size, tx->hash);
+}
+
+/* Next payload to send into out (HW_LCP_MAX_PAYLOAD_LEN). Returns its length, 0 while waiting for replies */
+int lcp_ota_tx_next(lcp_ota_tx *tx, u8 *out)
+{
+    uint32_t n;
+
+    switch (tx->state)
+    {
+        case LCP_OTA_TX_BEGIN:
+            if (tx->cmd_pending)
+            {
+                return 0;
+            }
+            tx->cmd_pending = 1;
+            out[0] = HW_CMD_OTA_BEGIN;
+            hw_lcp_put_le32(&out[1], tx->size);
+            memcpy(&out[5], tx->hash, SHA256_LEN);
+            return 1 + 4 + SHA256_LEN;
+
+        case LCP_OTA_TX_SENDING:
+            break;
+
+        case LCP_OTA_TX_ENDING:
+            if (tx->cmd_pending)
+            {
+                return 0;
+            }
+            tx->cmd_pending = 1;
+            tx->stats.end_polls++;
+            out[0] = HW_CMD_OTA_END;
+            out[1] = (u8)tx->reboot;
+            return 2;
+
+        default:
+            return 0;
+    }
+
+    /* Short frames top up the window, so a single sector buffer fills completely */
+    n = ((tx->limit < tx->size) ? tx->limit : tx->size);
+    n = (n > tx->sent) ? n - tx->sent : 0;
+    if (n > (uint32_t)tx->chunk)
+    {
+        n = tx->chunk;
+    }
+    if (n > 0)
+    {
+        out[0] = HW_CMD_OTA_DATA;
+        hw_lcp_put_le32(&out[1], tx->sent);
+        memcpy(&out[HW_CMD_OTA_DATA_HDR_LEN], &tx->image[tx->sent], n);
+        tx->sent += n;
+        tx->stats.frames++;
+        tx->stats.bytes += n;
+        return HW_CMD_OTA_DATA_HDR_LEN + n;
+    }
+
+    /* Window used up, or everything sent but not acknowledged : one probe at a time */
+    if (tx->probe_pending)
+    {
+        return 0;
+    }
+    tx->probe_pending = 1;
+    tx->probe_sent = tx->sent;
+    tx->stats.probes++;
+    out[0] = HW_CMD_OTA_DATA;
+    hw_lcp_put_le32(&out[1], LCP_OTA_PROBE);
+    return HW_CMD_OTA_DATA_HDR_LEN;
+}
+
+static void lcp_ota_tx_rewind(lcp_ota_tx *tx, uint32_t next)
+{
+    if (tx->sent != next)
+    {
+        tx->stats.resends++;
+    }
+    tx->sent = next;
+    tx->rewound_to = next;
+}
+
+static int lcp_ota_tx_data_reply(lcp_ota_tx *tx, int status, uint32_t next, uint32_t req)
+{
+    if (req == LCP_OTA_PROBE)
+    {
+        tx->probe_pending = 0;
+        /* Everything sent before the probe has been seen : a gap below that was lost on the way */
+        if (next < tx->probe_sent)
+        {
+            lcp_ota_tx_rewind(tx, next);
+        }
+    }
+
+    switch (status)
+    {
+        case LCP_OTA_OK:
+            break;
+
+        case LCP_OTA_BUSY:
+        case LCP_OTA_ERR_OFFSET:
+            if (status == LCP_OTA_BUSY)
+            {
+                tx->stats.busy++;
+            }
+            /* Only the first refusal rewinds; the frames that were in flight behind it are refused too */
+            if (next != tx->rewound_to)
+            {
+                lcp_ota_tx_rewind(tx, next);
+            }
+            break;
+
+        case LCP_OTA_ERR_STATE:
+            /* A late duplicate after the last byte was taken */
+            if (next == tx->size)
+            {
+                break;
+            }
+            /* fall through */
+        default:
+            tx->status = status;
+            return LCP_OTA_TX_FAILED;
+    }
+
+    if (tx->sent < tx->acked)
+    {
+        tx->sent = tx->acked;
+    }
+    return (tx->acked == tx->size) ? LCP_OTA_TX_ENDING : LCP_OTA_TX_SENDING;
+}
+
+/* One HW_CMD_OTA_* reply. Returns the new state */
+int lcp_ota_tx_reply(lcp_ota_tx *tx, const u8 *reply, int len)
+{
+    uint32_t next, window, req;
+    int status;
+
+    if (len < HW_CMD_OTA_REPLY_LEN || tx->state == LCP_OTA_TX_DONE || tx->state == LCP_OTA_TX_FAILED)
+    {
+        return tx->state;
+    }
+    status = reply[HW_CMD_OTA_REPLY_STATUS];
+    next   = hw_lcp_get_le32(&reply[HW_CMD_OTA_REPLY_NEXT]);
+    window = hw_lcp_get_le32(&reply[HW_CMD_OTA_REPLY_WINDOW]);
+    req    = hw_lcp_get_le32(&reply[HW_CMD_OTA_REPLY_REQ]);
+
+    switch (reply[HW_CMD_OTA_REPLY_CMD])
+    {
+        case HW_CMD_OTA_BEGIN:
+            if (tx->state != LCP_OTA_TX_BEGIN)
+            {
+                break;
+            }
+            tx->cmd_pending = 0;
+            if (status == LCP_OTA_OK)
+            {
+                tx->acked = next;
+                tx->limit = next + window;
+                tx->state = LCP_OTA_TX_SENDING;
+            }
+            else if (status != LCP_OTA_BUSY)
+            {
+                tx->status = status;
+                tx->state = LCP_OTA_TX_FAILED;
+            }
+            break;
+
+        case HW_CMD_OTA_DATA:
+            if (tx->state != LCP_OTA_TX_SENDING)
+            {
+                break;
+            }
+            tx->acked = next;
+            tx->limit = next + window;
+            tx->state = lcp_ota_tx_data_reply(tx, status, next, req);
+            break;
+
+        case HW_CMD_OTA_END:
+            if (tx->state != LCP_OTA_TX_ENDING)
+            {
+                break;
+            }
+            tx->cmd_pending = 0;
+            if (status == LCP_OTA_OK)
+            {
+                tx->state = LCP_OTA_TX_DONE;
+            }
+            else if (status != LCP_OTA_BUSY)
+            {
+                tx->status = status;
+                tx->state = LCP_OTA_TX_FAILED;
+            }
+            break;
+
+        default:
+            break;
+    }
+    return tx->state;
+}
+
+/* No reply for too long : send the pending BEGIN / END or probe again. Returns 1 if something was re-armed */
+int lcp_ota_tx_timeout(lcp_ota_tx *tx)
+{
+    if (tx->state == LCP_OTA_TX_DONE || tx->state == LCP_OTA_TX_FAILED || (!tx->cmd_pending && !tx->probe_pending))
+    {
+        return 0;
+    }
+    tx->cmd_pending = 0;
+    tx->probe_pending = 0;
+    tx->stats.timeouts++;
+    return 1;
+}
+
+/* HW_CMD_OTA_ABORT payload into out. Returns its length */
+int lcp_ota_tx_abort(u8 *out)
+{
+    out[0] = HW_CMD_OTA_ABORT;
+    return 1;
+}
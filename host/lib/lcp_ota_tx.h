@@ -0,0 +1,74 @@
+#ifndef _LCP_OTA_TX_H
+#define _LCP_OTA_TX_H
+
+#include <stdint.h>
+
+#include "utils.h"
+#include "lcp_ota.h"
+
+/*
+ * Host side of the firmware update (HW_CMD_OTA_*).
+ *
+ * lcp_ota_tx_next() builds the next command payload (BEGIN, DATA, a probe or
+ * END), or returns 0 while it waits for replies; the caller carries the
+ * payloads over the link and feeds every HW_CMD_OTA_* reply back through
+ * lcp_ota_tx_reply(), in the order they arrive. Data is
+ * sent up to the device's last reported window past its next offset. After
+ * a refused frame (window full, offset mismatch) the sender goes back to the
+ * device's next offset once; the replies to frames already in flight behind
+ * it are ignored. When the window is used up a zero length probe asks for a
+ * fresh one; its reply also recovers frames lost on the link.
+ *
+ * A lost BEGIN, END or probe (or its reply) leaves the sender waiting. When
+ * no reply has come for longer than the link's round trip, the caller calls
+ * lcp_ota_tx_timeout() : the pending command or probe goes out again on the
+ * next lcp_ota_tx_next(). The device takes a repeated BEGIN of the same image
+ * as a no-op and a repeated END once done, and a late reply to the first one
+ * is ignored.
+ */
+
+#define LCP_OTA_TX_BEGIN        (0)
+#define LCP_OTA_TX_SENDING      (1)
+#define LCP_OTA_TX_ENDING       (2)     /* All data acknowledged, polling HW_CMD_OTA_END */
+#define LCP_OTA_TX_DONE         (3)
+#define LCP_OTA_TX_FAILED       (4)
+
+typedef struct lcp_ota_tx_stats
+{
+    unsigned long frames;
+    unsigned long bytes;
+    unsigned long resends;          /* Go-back to the device's next offset */
+    unsigned long probes;
+    unsigned long busy;
+    unsigned long end_polls;
+    unsigned long timeouts;
+} lcp_ota_tx_stats;
+
+typedef struct lcp_ota_tx
+{
+    const u8 *image;
+    uint32_t size;
+    u8 hash[SHA256_LEN];
+    int chunk;
+
+    int state;
+    int status;                     /* Last error from the device */
+    uint32_t sent;                  /* Next offset to send */
+    uint32_t acked;                 /* Device's next offset */
+    uint32_t limit;                 /* acked + window at the last reply */
+    uint32_t rewound_to;
+    int cmd_pending;                /* BEGIN / END waiting for its reply */
+    int probe_pending;
+    uint32_t probe_sent;            /* sent when the probe went out */
+    int reboot;
+
+    lcp_ota_tx_stats stats;
+} lcp_ota_tx;
+
+void lcp_ota_tx_init(lcp_ota_tx *, const u8 *, uint32_t, int, int);
+int lcp_ota_tx_next(lcp_ota_tx *, u8 *);
+int lcp_ota_tx_reply(lcp_ota_tx *, const u8 *, int);
+int lcp_ota_tx_timeout(lcp_ota_tx *);
+int lcp_ota_tx_abort(u8 *);
+
+#endif
@@ -0,0 +1,133 @@
+#include <errno.h>
+#include <unistd.h>
+
+#include "lcp_stream.h"
+
+void lcp_stream_init(lcp_stream *stream)
+{
+    memset(stream, 0x0, sizeof(lcp_stream));
+}
+
+/* Decode every complete frame held in buf and keep the partial tail. Returns frames decoded */
+static int lcp_stream_decode(lcp_stream *stream, lcp_stream_frame_cb cb, void *ctx)
+{
+    int pos = 0, count = 0;
+
+    stream->stalled = 0;
+    while (stream->len - pos >= HW_LCP_OVERHEAD - 1)
+    {
+        u8 *frame = &stream->buf[pos];
+        int payload_len, frame_len;
+
+        if (frame[HW_LCP_START_FLAG_FIELD] != HW_LCP_START_FLAG)
+        {
+            u8 *next = memchr(frame + 1, HW_LCP_START_FLAG, stream->len - pos - 1);
+
+            stream->resyncs++;
+            pos = next ? (int)(next - stream->buf) : stream->len;
+            continue;
+        }
+
+        payload_len = hw_frame_raw_len(frame);
+        frame_len = payload_len + HW_LCP_OVERHEAD - 1;
+        if (payload_len > HW_LCP_MAX_PAYLOAD_LEN + HW_LCP_EXT_LEN)
+        {
+            stream->resyncs++;
+            pos++;
+            continue;
+        }
+        if (stream->len - pos < frame_len)
+        {
+            break;      /* Rest of the frame is in the next read */
+        }
+
+        if (frame[PAYLOAD_FIELD + payload_len] != HW_LCP_END_FLAG)
+        {
+            stream->resyncs++;
+            pos++;
+            continue;
+        }
+
+        /* The callback sees the payload length without the sequence trailer */
+        if (frame[PAYLOAD_LEN_FIELD2] & HW_LCP_FLAG_EXT)
+        {
+            if (payload_len < HW_LCP_EXT_LEN)
+            {
+                stream->resyncs++;
+                pos++;
+                continue;
+            }
+            payload_len -= HW_LCP_EXT_LEN;
+        }
+
+        if (cb(ctx, frame, payload_len) != 0)
+        {
+            stream->stalled = 1;
+            break;
+        }
+        stream->frames++;
+        count++;
+        pos += frame_len;
+    }
+
+    if (pos > 0)
+    {
+        memmove(stream->buf, &stream->buf[pos], stream->len - pos);
+        stream->len -= pos;
+    }
+    return count;
+}
+
+/* Push a buffer through the decoder. Input that no longer fits behind a stalled frame is dropped */
+int lcp_stream_feed(lcp_stream *stream, const u8 *data, int len, lcp_stream_frame_cb cb, void *ctx)
+{
+    int count = 0, chunk;
+
+    while (len > 0)
+    {
+        chunk = (int)sizeof(stream->buf) - stream->len;
+        if (chunk == 0)
+        {
+            break;
+        }
+        if (chunk > len)
+        {
+            chunk = len;
+        }
+        memcpy(&stream->buf[stream->len], data, chunk);
+        stream->len += chunk;
+        data += chunk;
+        len -= chunk;
+        count += lcp_stream_decode(stream, cb, ctx);
+    }
+    return count;
+}
+
+/*
+ * One read of up to LCP_STREAM_CHUNK bytes straight into the decode buffer, so a
+ * single syscall brings in many frames. A stalled stream only retries the frames
+ * it holds. Returns frames decoded, 0 on EAGAIN, -1 on EOF/error.
+ */
+int lcp_stream_read_fd(lcp_stream *stream, int fd, lcp_stream_frame_cb cb, void *ctx)
+{
+    int ret;
+
+    if (stream->stalled)
+    {
+        return lcp_stream_decode(stream, cb, ctx);
+    }
+
+    ret = read(fd, &stream->buf[stream->len], sizeof(stream->buf) - stream->len);
+    if (ret <= 0)
+    {
+        return (ret < 0 && (errno == EAGAIN || errno == EINTR)) ? 0 : -1;
+    }
+    stream->reads++;
+    stream->len += ret;
+    return lcp_stream_decode(stream, cb, ctx);
+}
+
+int lcp_stream_stalled(lcp_stream *stream)
+{
+    return stream->stalled;
+}
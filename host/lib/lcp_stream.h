@@ -0,0 +1,34 @@
+#ifndef _LCP_STREAM_H
+#define _LCP_STREAM_H
+
+#include "utils.h"
+#include "hw_link_ctrl_protocol.h"
+
+/*
+ * Incremental decoder for a byte stream of back to back LCP frames.
+ * Frames may be split across reads; garbage is skipped up to the next start flag.
+ * The frame callback returns non zero to refuse a frame: decoding stops and the
+ * frame stays buffered (stalled) until the next call, so the consumer can push back.
+ */
+
+#define LCP_STREAM_CHUNK        (64 * 1024)
+#define LCP_STREAM_FRAME_MAX    (HW_LCP_MAX_PAYLOAD_LEN + HW_LCP_EXT_LEN + HW_LCP_OVERHEAD)
+
+typedef int (*lcp_stream_frame_cb)(void *ctx, u8 *frame, int payload_len);
+
+typedef struct lcp_stream
+{
+    u8 buf[LCP_STREAM_FRAME_MAX + LCP_STREAM_CHUNK];
+    int len;                    /* Bytes held in buf */
+    int stalled;                /* Last decode was refused by the callback */
+    unsigned long frames;
+    unsigned long resyncs;
+    unsigned long reads;
+} lcp_stream;
+
+void lcp_stream_init(lcp_stream *);
+int lcp_stream_feed(lcp_stream *, const u8 *, int, lcp_stream_frame_cb, void *);
+int lcp_stream_read_fd(lcp_stream *, int, lcp_stream_frame_cb, void *);
+int lcp_stream_stalled(lcp_stream *);
+
+#endif
@@ -0,0 +1,116 @@
+#include <stdlib.h>
+
+#include "lcp_tmpl_tx.h"
+
+/* arena_size : the device's CONFIG_ESP_LCP_TMPL_ARENA */
+int lcp_tmpl_tx_init(lcp_tmpl_tx *tx, int arena_size)
+{
+    memset(tx, 0x0, sizeof(lcp_tmpl_tx));
+    tx->shadow_arena = malloc(arena_size);
+    if (!tx->shadow_arena)
+    {
+        return -1;
+    }
+    lcp_tmpl_init(&tx->shadow, tx->shadow_arena, arena_size);
+    return 0;
+}
+
+void lcp_tmpl_tx_deinit(lcp_tmpl_tx *tx)
+{
+    int i;
+
+    for (i = 0; i < LCP_TMPL_TX_IDS; i++)
+    {
+        free(tx->defs[i].frame);
+    }
+    free(tx->shadow_arena);
+    memset(tx, 0x0, sizeof(lcp_tmpl_tx));
+}
+
+/* Frame as template id; a redefined template is uploaded again before its next use */
+int lcp_tmpl_tx_define(lcp_tmpl_tx *tx, u8 id, const u8 *frame, int len)
+{
+    lcp_tmpl_def *def = &tx->defs[id];
+    u8 *copy;
+
+    if (len <= 0 || len > HW_LCP_MAX_PAYLOAD_LEN - 2 || len > tx->shadow.arena_size)
+    {
+        return -1;
+    }
+    copy = malloc(len);
+    if (!copy)
+    {
+        return -1;
+    }
+    memcpy(copy, frame, len);
+
+    free(def->frame);
+    def->frame = copy;
+    def->len = len;
+    lcp_tmpl_drop(&tx->shadow, id);
+    return 0;
+}
+
+static void lcp_tmpl_tx_raw(lcp_tmpl_tx *tx, const u8 *frame, int len, lcp_tmpl_msg *msg)
+{
+    msg->type = HW_LCP_TYPE_80211;
+    msg->len = len;
+    memcpy(msg->payload, frame, len);
+    tx->stats.raw++;
+}
+
+/*
+ * Messages carrying frame (made from template id, -1 for none) into msgs, in
+ * the order to send them. Returns their count (at most LCP_TMPL_TX_MSGS), -1
+ * if the frame is too long to send at all.
+ */
+int lcp_tmpl_tx_encode(lcp_tmpl_tx *tx, int id, const u8 *frame, int len, lcp_tmpl_msg *msgs)
+{
+    lcp_tmpl_def *def = (id >= 0 && id < LCP_TMPL_TX_IDS) ? &tx->defs[id] : NULL;
+    lcp_tmpl_msg *msg = msgs;
+    u8 patch[HW_LCP_MAX_PAYLOAD_LEN];
+    int patch_len, tmpl_len;
+
+    if (len <= 0 || len > HW_LCP_MAX_PAYLOAD_LEN)
+    {
+        return -1;
+    }
+    tx->stats.frames++;
+
+    patch_len = (def && def->frame && def->len == len) ?
+                lcp_tmpl_encode((u8)id, def->frame, frame, len, patch, sizeof(patch)) : -1;
+    if (patch_len < 0 || patch_len >= len)
+    {
+        lcp_tmpl_tx_raw(tx, frame, len, msg);
+        tx->stats.bytes += msg->len;
+        return 1;
+    }
+
+    if (!lcp_tmpl_cached(&tx->shadow, (u8)id))
+    {
+        lcp_tmpl_put(&tx->shadow, (u8)id, def->frame, def->len);
+        msg->type = HW_LCP_TYPE_CMD;
+        msg->payload[0] = HW_CMD_TMPL_PUT;
+        msg->payload[1] = (u8)id;
+        memcpy(&msg->payload[2], def->frame, def->len);
+        msg->len = 2 + def->len;
+        tx->stats.uploads++;
+        tx->stats.bytes += msg->len;
+        msg++;
+    }
+    lcp_tmpl_get(&tx->shadow, (u8)id, &tmpl_len);
+
+    msg->type = HW_LCP_TYPE_TMPL_TX;
+    msg->len = patch_len;
+    memcpy(msg->payload, patch, patch_len);
+    tx->stats.patched++;
+    tx->stats.bytes += msg->len;
+    return (int)(msg - msgs) + 1;
+}
+
+/* HW_CMD_TMPL_MISS from the device : it no longer has the template */
+void lcp_tmpl_tx_miss(lcp_tmpl_tx *tx, u8 id)
+{
+    lcp_tmpl_drop(&tx->shadow, id);
+    tx->stats.misses++;
+}
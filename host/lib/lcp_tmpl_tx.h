@@ -0,0 +1,64 @@
+#ifndef _LCP_TMPL_TX_H
+#define _LCP_TMPL_TX_H
+
+#include <stdint.h>
+
+#include "utils.h"
+#include "lcp_tmpl.h"
+
+/*
+ * Host side of the injection templates (lcp_tmpl.h).
+ *
+ * The caller defines the frames it injects repeatedly as templates and then
+ * hands every frame to lcp_tmpl_tx_encode() with the template it was made
+ * from. The encoder keeps a shadow of the device's cache, the same store with
+ * an arena of the device's size, so it knows which templates the device still
+ * has: it uploads a template (HW_CMD_TMPL_PUT) right before the first frame
+ * after an eviction, and sends the frame as its patches against it. Frames
+ * that do not match their template's length go raw. A HW_CMD_TMPL_MISS from
+ * the device (shadow out of step, device reset) goes to lcp_tmpl_tx_miss(),
+ * the next frame then uploads again.
+ */
+
+#define LCP_TMPL_TX_IDS             (256)
+#define LCP_TMPL_TX_MSGS            (2)     /* Most messages per encoded frame */
+
+typedef struct lcp_tmpl_msg
+{
+    u8 type;                        /* HW_LCP_TYPE_CMD, _TMPL_TX or _80211 */
+    int len;
+    u8 payload[HW_LCP_MAX_PAYLOAD_LEN];
+} lcp_tmpl_msg;
+
+typedef struct lcp_tmpl_tx_stats
+{
+    unsigned long frames;
+    unsigned long raw;              /* Sent whole */
+    unsigned long patched;          /* Sent as HW_LCP_TYPE_TMPL_TX */
+    unsigned long uploads;
+    unsigned long misses;
+    unsigned long bytes;            /* Payload bytes of every message */
+} lcp_tmpl_tx_stats;
+
+typedef struct lcp_tmpl_def
+{
+    u8 *frame;
+    int len;
+} lcp_tmpl_def;
+
+typedef struct lcp_tmpl_tx
+{
+    lcp_tmpl_def defs[LCP_TMPL_TX_IDS];
+    lcp_tmpl_store shadow;
+    u8 *shadow_arena;
+
+    lcp_tmpl_tx_stats stats;
+} lcp_tmpl_tx;
+
+int lcp_tmpl_tx_init(lcp_tmpl_tx *, int);
+void lcp_tmpl_tx_deinit(lcp_tmpl_tx *);
+int lcp_tmpl_tx_define(lcp_tmpl_tx *, u8, const u8 *, int);
+int lcp_tmpl_tx_encode(lcp_tmpl_tx *, int, const u8 *, int, lcp_tmpl_msg *);
+void lcp_tmpl_tx_miss(lcp_tmpl_tx *, u8);
+
+#endif
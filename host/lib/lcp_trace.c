@@ -0,0 +1,131 @@
+#include "lcp_trace.h"
+
+#define LCP_TRACE_INITIAL_SIZE  (4096)
+
+void lcp_trace_init(lcp_trace *trace)
+{
+    memset(trace, 0x0, sizeof(lcp_trace));
+    trace->mhz = 1;
+}
+
+void lcp_trace_free(lcp_trace *trace)
+{
+    free(trace->events);
+    memset(trace, 0x0, sizeof(lcp_trace));
+}
+
+static int lcp_trace_reserve(lcp_trace *trace, size_t n)
+{
+    size_t size = trace->size ? trace->size : LCP_TRACE_INITIAL_SIZE;
+    lcp_trace_event *events;
+
+    if (trace->count + n <= trace->size)
+    {
+        return LCP_TRACE_OK;
+    }
+    while (size < trace->count + n)
+    {
+        size *= 2;
+    }
+    events = realloc(trace->events, size * sizeof(lcp_trace_event));
+    if (!events)
+    {
+        return LCP_TRACE_ERR;
+    }
+    trace->events = events;
+    trace->size = size;
+    return LCP_TRACE_OK;
+}
+
+/* Payload of one HW_CMD_TRACE_DRAIN reply. Returns LCP_TRACE_MORE, LCP_TRACE_OK or LCP_TRACE_ERR */
+int lcp_trace_add_reply(lcp_trace *trace, const u8 *payload, int len)
+{
+    lcp_trace_event *out;
+    trace_event ev;
+    int i, count;
+
+    if (len < TRACE_REPLY_EVENTS || payload[TRACE_REPLY_CMD] != HW_CMD_TRACE_DRAIN)
+    {
+        return LCP_TRACE_ERR;
+    }
+    count = payload[TRACE_REPLY_COUNT];
+    if (TRACE_REPLY_EVENTS + count * TRACE_WIRE_LEN > len || lcp_trace_reserve(trace, count) != LCP_TRACE_OK)
+    {
+        return LCP_TRACE_ERR;
+    }
+
+    trace->mhz = payload[TRACE_REPLY_MHZ] | (payload[TRACE_REPLY_MHZ + 1] << 8);
+    if (trace->mhz == 0)
+    {
+        trace->mhz = 1;
+    }
+    trace->dropped = hw_lcp_get_le32(&payload[TRACE_REPLY_DROPPED]);
+    trace->replies++;
+
+    for (i = 0; i < count; i++)
+    {
+        trace_event_decode(&payload[TRACE_REPLY_EVENTS + i * TRACE_WIRE_LEN], &ev);
+        out = &trace->events[trace->count++];
+
+        /* Signed step from the core's previous event : handles the wrap and small preemption reorders */
+        if (!trace->started[ev.core])
+        {
+            trace->last[ev.core] = ev.cycles;
+            trace->started[ev.core] = 1;
+        }
+        else
+        {
+            trace->last[ev.core] += (int64_t)(int32_t)(ev.cycles - (uint32_t)trace->last[ev.core]);
+        }
+
+        out->cycles = trace->last[ev.core];
+        out->arg    = ev.arg;
+        out->id     = ev.id;
+        out->core   = ev.core;
+        out->phase  = ev.phase;
+    }
+
+    return payload[TRACE_REPLY_MORE] ? LCP_TRACE_MORE : LCP_TRACE_OK;
+}
+
+/* Chrome trace event format, JSON object form : begin/end pairs and thread scoped instants */
+int lcp_trace_write_json(const lcp_trace *trace, FILE *fp)
+{
+    static const char phases[] = { 'i', 'B', 'E' };
+    uint64_t base = UINT64_MAX;
+    const lcp_trace_event *ev;
+    size_t i;
+    int core;
+
+    for (i = 0; i < trace->count; i++)
+    {
+        if (trace->events[i].cycles < base)
+        {
+            base = trace->events[i].cycles;
+        }
+    }
+
+    fprintf(fp, "{\"displayTimeUnit\":\"ns\",\"otherData\":{\"mhz\":%u,\"dropped\":%u},\"traceEvents\":[\n",
+            trace->mhz, (unsigned int)trace->dropped);
+    fprintf(fp, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"esp32\"}}");
+    for (core = 0; core < LCP_TRACE_CORES; core++)
+    {
+        if (trace->started[core])
+        {
+            fprintf(fp, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"core %d\"}}",
+                    core, core);
+        }
+    }
+
+    for (i = 0; i < trace->count; i++)
+    {
+        ev = &trace->events[i];
+        fprintf(fp, ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%u,%s\"args\":{\"arg\":%u}}",
+                trace_id_name(ev->id), (ev->phase <= TRACE_PH_END) ? phases[ev->phase] : 'i',
+                (double)(ev->cycles - base) / trace->mhz, ev->core,
+                (ev->phase == TRACE_PH_INSTANT) ? "\"s\":\"t\"," : "", (unsigned int)ev->arg);
+    }
+    fprintf(fp, "\n]}\n");
+
+    return ferror(fp) ? LCP_TRACE_ERR : LCP_TRACE_OK;
+}
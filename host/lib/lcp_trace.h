@@ -0,0 +1,55 @@
+#ifndef _LCP_TRACE_H
+#define _LCP_TRACE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "utils.h"
+#include "trace_buf.h"
+
+/*
+ * Host side of the device event trace (trace_buf.h).
+ *
+ * HW_CMD_TRACE_DRAIN replies are appended with lcp_trace_add_reply(); the 32 bit
+ * cycle counts are unwrapped per core, so the host has to drain more often than
+ * the counter wraps (2^32 / CPU MHz, ~26 s at 160 MHz). lcp_trace_write_json()
+ * writes Chrome trace event JSON, which chrome://tracing and ui.perfetto.dev open
+ * directly; one track per core. The cores' cycle counters are not synchronised,
+ * so cross-core alignment is only approximate.
+ */
+
+#define LCP_TRACE_CORES         (256)
+
+#define LCP_TRACE_MORE          (1)     /* Device still has events, drain again */
+#define LCP_TRACE_OK            (0)
+#define LCP_TRACE_ERR           (-1)
+
+typedef struct lcp_trace_event
+{
+    uint64_t cycles;            /* Unwrapped */
+    uint32_t arg;
+    uint16_t id;
+    u8 core;
+    u8 phase;
+} lcp_trace_event;
+
+typedef struct lcp_trace
+{
+    lcp_trace_event *events;
+    size_t count;
+    size_t size;
+
+    uint64_t last[LCP_TRACE_CORES];
+    u8 started[LCP_TRACE_CORES];
+
+    unsigned int mhz;
+    uint32_t dropped;           /* Reported by the device */
+    unsigned long replies;
+} lcp_trace;
+
+void lcp_trace_init(lcp_trace *);
+void lcp_trace_free(lcp_trace *);
+int lcp_trace_add_reply(lcp_trace *, const u8 *, int);
+int lcp_trace_write_json(const lcp_trace *, FILE *);
+
+#endif
@@ -0,0 +1,430 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "pcapng_writer.h"
+
+#define PCAPNG_SHB_TYPE         (0x0A0D0D0A)
+#define PCAPNG_IDB_TYPE         (0x00000001)
+#define PCAPNG_EPB_TYPE         (0x00000006)
+#define PCAPNG_BYTE_ORDER_MAGIC (0x1A2B3C4D)
+#define PCAPNG_EPB_HDR_LEN      (28)
+#define PCAPNG_EPB_TRAILER_LEN  (4)
+
+/* Radiotap : TSFT, Flags, Channel, dBm antenna signal, each only when known */
+#define RADIOTAP_HDR_LEN        (8)
+#define RADIOTAP_MAX_LEN        (24)
+#define RADIOTAP_TSFT           (1 << 0)
+#define RADIOTAP_FLAGS          (1 << 1)
+#define RADIOTAP_CHANNEL        (1 << 3)
+#define RADIOTAP_DBM_SIGNAL     (1 << 5)
+#define RADIOTAP_F_FCS          (0x10)
+#define RADIOTAP_CHAN_2GHZ      (0x0080)
+
+#define PCAPNG_PAD4(len)        (((len) + 3) & ~3)
+#define PCAPNG_MAX_RECORD       (PCAPNG_EPB_HDR_LEN + PCAPNG_PAD4(RADIOTAP_MAX_LEN + HW_LCP_MAX_PAYLOAD_LEN) + PCAPNG_EPB_TRAILER_LEN)
+
+static void put_u16(u8 *p, uint16_t v)
+{
+    memcpy(p, &v, sizeof(v));
+}
+
+static void put_u32(u8 *p, uint32_t v)
+{
+    memcpy(p, &v, sizeof(v));
+}
+
+static void put_u64(u8 *p, uint64_t v)
+{
+    memcpy(p, &v, sizeof(v));
+}
+
+/* Section header + one 802.11 radiotap interface, microsecond timestamps (default if_tsresol) */
+static int pcapng_file_header(u8 *p)
+{
+    int n = 0;
+
+    put_u32(&p[n], PCAPNG_SHB_TYPE);
+    put_u32(&p[n + 4], 28);
+    put_u32(&p[n + 8], PCAPNG_BYTE_ORDER_MAGIC);
+    put_u16(&p[n + 12], 1);                 /* Major */
+    put_u16(&p[n + 14], 0);                 /* Minor */
+    put_u64(&p[n + 16], (uint64_t)-1);      /* Section length unknown */
+    put_u32(&p[n + 24], 28);
+    n += 28;
+
+    put_u32(&p[n], PCAPNG_IDB_TYPE);
+    put_u32(&p[n + 4], 20);
+    put_u16(&p[n + 8], PCAPNG_LINKTYPE_RADIOTAP);
+    put_u16(&p[n + 10], 0);
+    put_u32(&p[n + 12], 0);                 /* No snap length limit */
+    put_u32(&p[n + 16], 20);
+    n += 20;
+
+    return n;
+}
+
+static uint16_t channel_to_freq(u8 channel)
+{
+    if (channel == 14)
+    {
+        return 2484;
+    }
+    return (channel >= 1 && channel <= 13) ? (uint16_t)(2407 + 5 * channel) : 0;
+}
+
+/*
+ * Present fields are the ones the metadata carries, at their radiotap alignment.
+ * A frame without metadata only has Flags: zeros would read as TSFT 0, no
+ * channel and 0 dBm. Returns the header length.
+ */
+static int radiotap_header(u8 *p, const hw_lcp_rx_meta *meta, int fcs)
+{
+    uint32_t present = RADIOTAP_FLAGS;
+    uint16_t freq = meta ? channel_to_freq(meta->channel) : 0;
+    int n = RADIOTAP_HDR_LEN;
+
+    memset(p, 0x0, RADIOTAP_MAX_LEN);
+    if (meta)
+    {
+        put_u64(&p[n], meta->timestamp);    /* TSFT : device clock, us */
+        present |= RADIOTAP_TSFT;
+        n += 8;
+    }
+    p[n++] = fcs ? RADIOTAP_F_FCS : 0;
+    if (freq)
+    {
+        n = (n + 1) & ~1;
+        put_u16(&p[n], freq);
+        put_u16(&p[n + 2], RADIOTAP_CHAN_2GHZ);
+        present |= RADIOTAP_CHANNEL;
+        n += 4;
+    }
+    if (meta)
+    {
+        p[n++] = (u8)meta->rssi;
+        present |= RADIOTAP_DBM_SIGNAL;
+    }
+
+    put_u16(&p[2], (uint16_t)n);
+    put_u32(&p[4], present);
+    return n;
+}
+
+/* Writer thread counters : pcapng_writer_get_stats() reads them from the capture side */
+static void pcapng_stat_add(pcapng_writer *writer, unsigned long *counter, unsigned long n)
+{
+    pthread_mutex_lock(&writer->lock);
+    *counter += n;
+    pthread_mutex_unlock(&writer->lock);
+}
+
+static void pcapng_file_finish(pcapng_writer *writer)
+{
+    if (writer->fd < 0)
+    {
+        return;
+    }
+    /* Drop the preallocated tail */
+    if (ftruncate(writer->fd, (off_t)writer->file_len) < 0)
+    {
+        pcapng_stat_add(writer, &writer->stats.write_errors, 1);
+    }
+    close(writer->fd);
+    writer->fd = -1;
+}
+
+static int pcapng_write_all(pcapng_writer *writer, const u8 *buf, size_t len)
+{
+    ssize_t ret;
+
+    while (len > 0)
+    {
+        ret = write(writer->fd, buf, len);
+        if (ret < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            pcapng_stat_add(writer, &writer->stats.write_errors, 1);
+            return PCAPNG_ERR;
+        }
+        buf += ret;
+        len -= ret;
+        writer->file_len += ret;
+        pcapng_stat_add(writer, &writer->stats.bytes, (unsigned long)ret);
+    }
+    return PCAPNG_OK;
+}
+
+static int pcapng_file_next(pcapng_writer *writer)
+{
+    char path[512];
+    u8 hdr[64];
+    int len;
+
+    pcapng_file_finish(writer);
+
+    snprintf(path, sizeof(path), "%s_%05d.pcapng", writer->config.prefix, writer->file_index++);
+    writer->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (writer->fd < 0)
+    {
+        ERROR_PRINT("open [%s] failed [%d]\n", path, errno);
+        pcapng_stat_add(writer, &writer->stats.write_errors, 1);
+        return PCAPNG_ERR;
+    }
+
+    /* Reserve the whole file up front so extending it never stalls a block write */
+    if (fallocate(writer->fd, 0, 0, (off_t)writer->config.file_size) < 0)
+    {
+        DEBUG_PRINT("fallocate [%s] not supported\n", path);
+    }
+
+    writer->file_len = 0;
+    pcapng_stat_add(writer, &writer->stats.files, 1);
+    len = pcapng_file_header(hdr);
+    return pcapng_write_all(writer, hdr, len);
+}
+
+/* Writer thread side : one block, rotating first when it would overflow the file */
+static void pcapng_write_block(pcapng_writer *writer, const u8 *buf, size_t len)
+{
+    if (writer->fd < 0 || writer->file_len + len > writer->config.file_size)
+    {
+        if (pcapng_file_next(writer) != PCAPNG_OK)
+        {
+            return;
+        }
+    }
+    if (pcapng_write_all(writer, buf, len) == PCAPNG_OK)
+    {
+        pcapng_stat_add(writer, &writer->stats.blocks, 1);
+    }
+}
+
+static void *pcapng_writer_thread(void *arg)
+{
+    pcapng_writer *writer = (pcapng_writer *)arg;
+
+    pthread_mutex_lock(&writer->lock);
+    while (1)
+    {
+        while (writer->write_len == 0 && writer->running)
+        {
+            pthread_cond_wait(&writer->cond, &writer->lock);
+        }
+        if (writer->write_len == 0)
+        {
+            break;
+        }
+
+        pthread_mutex_unlock(&writer->lock);
+        pcapng_write_block(writer, writer->write_buf, writer->write_len);
+        pthread_mutex_lock(&writer->lock);
+
+        writer->write_len = 0;
+        pthread_cond_broadcast(&writer->cond);
+    }
+    pthread_mutex_unlock(&writer->lock);
+    return NULL;
+}
+
+/* Hand the fill block to the writer thread, waiting only if it is still busy with the last one */
+static void pcapng_hand_off(pcapng_writer *writer)
+{
+    u8 *tmp;
+
+    if (writer->fill_len == 0)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&writer->lock);
+    if (writer->write_len != 0)
+    {
+        writer->stats.stalls++;
+        while (writer->write_len != 0)
+        {
+            pthread_cond_wait(&writer->cond, &writer->lock);
+        }
+    }
+    tmp = writer->write_buf;
+    writer->write_buf = writer->fill_buf;
+    writer->write_len = writer->fill_len;
+    writer->fill_buf = tmp;
+    writer->fill_len = 0;
+    pthread_cond_broadcast(&writer->cond);
+    pthread_mutex_unlock(&writer->lock);
+}
+
+int pcapng_writer_open(pcapng_writer *writer, const pcapng_config *config)
+{
+    memset(writer, 0x0, sizeof(pcapng_writer));
+    writer->config = *config;
+    writer->fd = -1;
+
+    if (!writer->config.block_size)
+    {
+        writer->config.block_size = PCAPNG_BLOCK_SIZE;
+    }
+    if (!writer->config.file_size)
+    {
+        writer->config.file_size = PCAPNG_FILE_SIZE;
+    }
+    if (!writer->config.prefix || writer->config.block_size < PCAPNG_MAX_RECORD ||
+        writer->config.file_size < writer->config.block_size + 64)
+    {
+        return PCAPNG_ERR;
+    }
+
+    if (posix_memalign((void **)&writer->fill_buf, 4096, writer->config.block_size) != 0)
+    {
+        return PCAPNG_ERR;
+    }
+    if (posix_memalign((void **)&writer->write_buf, 4096, writer->config.block_size) != 0)
+    {
+        SAFE_FREE(writer->fill_buf);
+        return PCAPNG_ERR;
+    }
+
+    pthread_mutex_init(&writer->lock, NULL);
+    pthread_cond_init(&writer->cond, NULL);
+
+    /* First file is created now so a bad path fails here rather than in the thread */
+    if (pcapng_file_next(writer) == PCAPNG_OK)
+    {
+        writer->running = 1;
+        if (pthread_create(&writer->thread, NULL, pcapng_writer_thread, writer) == 0)
+        {
+            writer->opened = 1;
+            return PCAPNG_OK;
+        }
+    }
+
+    pcapng_file_finish(writer);
+    pthread_cond_destroy(&writer->cond);
+    pthread_mutex_destroy(&writer->lock);
+    SAFE_FREE(writer->fill_buf);
+    SAFE_FREE(writer->write_buf);
+    return PCAPNG_ERR;
+}
+
+/* Safe on a writer whose open failed : there is no thread to join then */
+void pcapng_writer_close(pcapng_writer *writer)
+{
+    if (!writer->opened)
+    {
+        return;
+    }
+    writer->opened = 0;
+    pcapng_hand_off(writer);
+
+    pthread_mutex_lock(&writer->lock);
+    writer->running = 0;
+    pthread_cond_broadcast(&writer->cond);
+    pthread_mutex_unlock(&writer->lock);
+    pthread_join(writer->thread, NULL);
+
+    pcapng_file_finish(writer);
+    pthread_cond_destroy(&writer->cond);
+    pthread_mutex_destroy(&writer->lock);
+    SAFE_FREE(writer->fill_buf);
+    SAFE_FREE(writer->write_buf);
+}
+
+/* Append one Enhanced Packet Block. ts_us is host time; meta may be NULL */
+int pcapng_write_packet(pcapng_writer *writer, uint64_t ts_us, const hw_lcp_rx_meta *meta,
+                        const u8 *frame, int len)
+{
+    int rt_len, cap_len, block_len;
+    u8 *p;
+
+    if (len <= 0 || len > HW_LCP_MAX_PAYLOAD_LEN)
+    {
+        return PCAPNG_ERR;
+    }
+
+    if (writer->fill_len + PCAPNG_EPB_HDR_LEN + PCAPNG_PAD4(RADIOTAP_MAX_LEN + len) + PCAPNG_EPB_TRAILER_LEN >
+        writer->config.block_size)
+    {
+        pcapng_hand_off(writer);
+    }
+
+    p = &writer->fill_buf[writer->fill_len];
+    /* The device forwards the FCS unless the frame was truncated */
+    rt_len = radiotap_header(&p[PCAPNG_EPB_HDR_LEN], meta, !meta || meta->orig_len == 0 || meta->orig_len == len);
+    cap_len = rt_len + len;
+    block_len = PCAPNG_EPB_HDR_LEN + PCAPNG_PAD4(cap_len) + PCAPNG_EPB_TRAILER_LEN;
+
+    put_u32(&p[0], PCAPNG_EPB_TYPE);
+    put_u32(&p[4], block_len);
+    put_u32(&p[8], 0);                                  /* Interface 0 */
+    put_u32(&p[12], (uint32_t)(ts_us >> 32));
+    put_u32(&p[16], (uint32_t)ts_us);
+    put_u32(&p[20], cap_len);
+    put_u32(&p[24], rt_len + ((meta && meta->orig_len > len) ? meta->orig_len : len));
+    memcpy(&p[PCAPNG_EPB_HDR_LEN + rt_len], frame, len);
+    memset(&p[PCAPNG_EPB_HDR_LEN + cap_len], 0x0, PCAPNG_PAD4(cap_len) - cap_len);
+    put_u32(&p[block_len - 4], block_len);
+
+    writer->fill_len += block_len;
+    writer->stats.packets++;
+    return PCAPNG_OK;
+}
+
+/* Capture sink for LCP payloads : 802.11 frames with or without metadata, others are skipped */
+int pcapng_write_lcp(pcapng_writer *writer, u8 type, const u8 *payload, int len)
+{
+    hw_lcp_rx_meta meta;
+    struct timespec ts;
+    uint64_t ts_us;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts_us = (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+
+    switch (type)
+    {
+        case HW_LCP_TYPE_80211_META:
+            if (len <= HW_LCP_META_LEN)
+            {
+                return PCAPNG_ERR;
+            }
+            hw_lcp_meta_decode(payload, &meta);
+            return pcapng_write_packet(writer, ts_us, &meta, payload + HW_LCP_META_LEN,
+                                       len - HW_LCP_META_LEN);
+
+        case HW_LCP_TYPE_80211:
+            return pcapng_write_packet(writer, ts_us, NULL, payload, len);
+
+        default:
+            return PCAPNG_OK;
+    }
+}
+
+/* Push out everything captured so far and wait for it to reach the file */
+int pcapng_writer_flush(pcapng_writer *writer)
+{
+    unsigned long errors;
+
+    pcapng_hand_off(writer);
+
+    pthread_mutex_lock(&writer->lock);
+    while (writer->write_len != 0)
+    {
+        pthread_cond_wait(&writer->cond, &writer->lock);
+    }
+    errors = writer->stats.write_errors;
+    pthread_mutex_unlock(&writer->lock);
+
+    return errors ? PCAPNG_ERR : PCAPNG_OK;
+}
+
+void pcapng_writer_get_stats(pcapng_writer *writer, pcapng_stats *stats)
+{
+    pthread_mutex_lock(&writer->lock);
+    *stats = writer->stats;
+    pthread_mutex_unlock(&writer->lock);
+}
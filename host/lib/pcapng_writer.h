@@ -0,0 +1,74 @@
+#ifndef _PCAPNG_WRITER_H
+#define _PCAPNG_WRITER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#include "utils.h"
+#include "hw_link_ctrl_protocol.h"
+
+/*
+ * Streaming pcapng capture sink, 802.11 + radiotap link type.
+ *
+ * Packets are appended to a large in-memory block; full blocks are handed to a
+ * writer thread (double buffered) so the capture path only blocks when the disk
+ * falls a whole block behind. Files are preallocated to file_size and rotated
+ * when full (<prefix>_00000.pcapng, <prefix>_00001.pcapng, ...), then trimmed
+ * to their real size on close.
+ */
+
+#define PCAPNG_BLOCK_SIZE       (1024 * 1024)
+#define PCAPNG_FILE_SIZE        (256 * 1024 * 1024)
+#define PCAPNG_LINKTYPE_RADIOTAP (127)
+
+#define PCAPNG_OK               (0)
+#define PCAPNG_ERR              (-1)
+
+typedef struct pcapng_config
+{
+    const char *prefix;
+    size_t block_size;          /* 0 = PCAPNG_BLOCK_SIZE */
+    size_t file_size;           /* Rotate and preallocate, 0 = PCAPNG_FILE_SIZE */
+} pcapng_config;
+
+typedef struct pcapng_stats
+{
+    unsigned long packets;
+    unsigned long bytes;        /* Written to disk */
+    unsigned long blocks;
+    unsigned long files;
+    unsigned long stalls;       /* Capture waited for the writer thread */
+    unsigned long write_errors;
+} pcapng_stats;
+
+typedef struct pcapng_writer
+{
+    pcapng_config config;
+
+    u8 *fill_buf;               /* Capture side */
+    size_t fill_len;
+    u8 *write_buf;              /* Writer thread side */
+    size_t write_len;
+
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int running;
+    int opened;                 /* pcapng_writer_open() succeeded, pcapng_writer_close() not called yet */
+
+    int fd;
+    int file_index;
+    size_t file_len;
+
+    pcapng_stats stats;         /* Under lock, but packets : capture side only */
+} pcapng_writer;
+
+int pcapng_writer_open(pcapng_writer *, const pcapng_config *);
+void pcapng_writer_close(pcapng_writer *);
+int pcapng_write_packet(pcapng_writer *, uint64_t, const hw_lcp_rx_meta *, const u8 *, int);
+int pcapng_write_lcp(pcapng_writer *, u8, const u8 *, int);
+int pcapng_writer_flush(pcapng_writer *);
+void pcapng_writer_get_stats(pcapng_writer *, pcapng_stats *);
+
+#endif
@@ -0,0 +1,462 @@
+/*
+ * 802.11 <-> 802.3 conversion check : exits non-zero when a frame converts wrong.
+ *
+ * Built in frames are byte for byte what a monitor capture shows for the usual
+ * data traffic : 3 address frames in every DS direction, 4 address (WDS), QoS,
+ * QoS + HT control, RFC 1042 and bridge tunnel SNAP, non SNAP LLC (STP), A-MSDU
+ * with padded subframes and a truncated one, and frames that must be skipped or
+ * refused. Every 802.3 frame produced is checked for DA, SA, EtherType / length
+ * and payload, then sent back through ieee8023_to_80211_data and converted
+ * again, which must give the same 802.3 frame.
+ *
+ * A classic pcap (raw 802.11 or radiotap) can be given as well : its data
+ * frames are checked for the addresses their DS bits select and the round trip.
+ *
+ * usage : ieee80211_conv_check [capture.pcap]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "ieee80211_conv.h"
+
+#define CHECK_OUT_MAX       (4)
+#define CHECK_BUF_LEN       (2400)
+#define PCAP_MAGIC          (0xa1b2c3d4)
+#define PCAP_MAGIC_NS       (0xa1b23c4d)
+#define PCAP_LINKTYPE_80211 (105)
+#define PCAP_LINKTYPE_RTAP  (127)
+
+#define AP                  0x00, 0x1a, 0x2b, 0x3c, 0x4d, 0x5e
+#define AP2                 0x00, 0x1a, 0x2b, 0x3c, 0x4d, 0x60
+#define STA                 0xa4, 0x83, 0xe7, 0x12, 0x34, 0x56
+#define GW                  0x00, 0x11, 0x32, 0xaa, 0xbb, 0xcc
+#define PEER                0x3c, 0x22, 0xfb, 0x01, 0x02, 0x03
+#define BCAST               0xff, 0xff, 0xff, 0xff, 0xff, 0xff
+#define STP_GROUP           0x01, 0x80, 0xc2, 0x00, 0x00, 0x00
+#define IBSS_ID             0x02, 0x5a, 0x11, 0x22, 0x33, 0x44
+
+#define SNAP(t0, t1)        0xaa, 0xaa, 0x03, 0x00, 0x00, 0x00, t0, t1
+#define TUNNEL(t0, t1)      0xaa, 0xaa, 0x03, 0x00, 0x00, 0xf8, t0, t1
+
+/* ARP who-has 192.168.1.42 tell 192.168.1.1 (28) */
+#define ARP_BODY            0x00, 0x01, 0x08, 0x00, 0x06, 0x04, 0x00, 0x01, GW, 0xc0, 0xa8, 0x01, 0x01, \
+                            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xc0, 0xa8, 0x01, 0x2a
+/* IPv4 / UDP DNS query header (40) */
+#define IPV4_BODY           0x45, 0x00, 0x00, 0x28, 0x1c, 0x46, 0x40, 0x00, 0x40, 0x11, 0x9a, 0x4b, \
+                            0xc0, 0xa8, 0x01, 0x2a, 0xc0, 0xa8, 0x01, 0x01, \
+                            0xd6, 0x3c, 0x00, 0x35, 0x00, 0x14, 0x7f, 0x0a, \
+                            0x12, 0x34, 0x01, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+/* IPv6 header, fe80::a683:e7ff:fe12:3456 -> ff02::1 (40) */
+#define IPV6_BODY           0x60, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3a, 0xff, \
+                            0xfe, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, \
+                            0xa6, 0x83, 0xe7, 0xff, 0xfe, 0x12, 0x34, 0x56, \
+                            0xff, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, \
+                            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01
+/* EAPOL-Key, message 2 of the 4-way handshake, cut (24) */
+#define EAPOL_BODY          0x02, 0x03, 0x00, 0x75, 0x02, 0x01, 0x0a, 0x00, 0x00, 0x00, 0x00, 0x00, \
+                            0x00, 0x00, 0x00, 0x01, 0x5c, 0x8e, 0x1f, 0x30, 0x72, 0x4a, 0x9d, 0x06
+/* LLC 42 42 03 + STP configuration BPDU (38) */
+#define STP_BODY            0x42, 0x42, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, AP, \
+                            0x00, 0x00, 0x00, 0x00, 0x80, 0x00, AP, 0x80, 0x01, 0x00, 0x00, \
+                            0x14, 0x00, 0x02, 0x00, 0x0f, 0x00
+
+typedef struct conv_expect
+{
+    u8 da[IEEE80211_MAC_LEN];
+    u8 sa[IEEE80211_MAC_LEN];
+    uint16_t type_len;
+    int off;                        /* Payload in the 802.11 frame */
+    int len;
+} conv_expect;
+
+typedef struct conv_vector
+{
+    const char *name;
+    const u8 *frame;
+    int len;
+    int out_size;                   /* 0 : CHECK_BUF_LEN */
+    int result;
+    conv_expect out[CHECK_OUT_MAX];
+} conv_vector;
+
+typedef struct conv_sink
+{
+    int count;
+    int len[CHECK_OUT_MAX];
+    u8 frame[CHECK_OUT_MAX][CHECK_BUF_LEN];
+} conv_sink;
+
+static const u8 f_from_ds_arp[] =
+{
+    0x08, 0x02, 0x00, 0x00, BCAST, AP, GW, 0x10, 0x3a,
+    SNAP(0x08, 0x06), ARP_BODY,
+};
+
+static const u8 f_to_ds_ipv4[] =
+{
+    0x08, 0x01, 0x3a, 0x01, AP, STA, GW, 0x20, 0x5b,
+    SNAP(0x08, 0x00), IPV4_BODY,
+};
+
+static const u8 f_ibss_ipv6[] =
+{
+    0x08, 0x00, 0x00, 0x00, PEER, STA, IBSS_ID, 0x30, 0x01,
+    SNAP(0x86, 0xdd), IPV6_BODY,
+};
+
+static const u8 f_wds_ipv4[] =
+{
+    0x08, 0x03, 0x00, 0x00, AP2, AP, PEER, 0x40, 0x02, GW,
+    SNAP(0x08, 0x00), IPV4_BODY,
+};
+
+static const u8 f_qos_eapol[] =
+{
+    0x88, 0x01, 0x3a, 0x01, AP, STA, AP, 0x00, 0x00, 0x07, 0x00,
+    SNAP(0x88, 0x8e), EAPOL_BODY,
+};
+
+static const u8 f_qos_htc_ipv6[] =
+{
+    0x88, 0x82, 0x2c, 0x00, STA, AP, GW, 0x50, 0x7c, 0x00, 0x00, 0x0c, 0x00, 0x00, 0x00,
+    SNAP(0x86, 0xdd), IPV6_BODY,
+};
+
+static const u8 f_wds_qos_arp[] =
+{
+    0x88, 0x03, 0x00, 0x00, AP2, AP, BCAST, 0x60, 0x03, GW, 0x05, 0x00,
+    SNAP(0x08, 0x06), ARP_BODY,
+};
+
+static const u8 f_tunnel_aarp[] =
+{
+    0x08, 0x02, 0x00, 0x00, BCAST, AP, GW, 0x70, 0x04,
+    TUNNEL(0x80, 0xf3), ARP_BODY,
+};
+
+static const u8 f_stp[] =
+{
+    0x08, 0x02, 0x00, 0x00, STP_GROUP, AP, AP, 0x80, 0x05,
+    STP_BODY,
+};
+
+static const u8 f_amsdu[] =
+{
+    0x88, 0x02, 0x2c, 0x00, STA, AP, AP, 0x90, 0x06, 0x80, 0x00,
+    STA, GW, 0x00, 0x24, SNAP(0x08, 0x06), ARP_BODY, 0x00, 0x00,
+    STA, PEER, 0x00, 0x0a, 0x42, 0x42, 0x03, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00,
+    STA, GW, 0x00, 0x30, SNAP(0x08, 0x00), IPV4_BODY,
+};
+
+static const u8 f_amsdu_cut[] =
+{
+    0x88, 0x02, 0x2c, 0x00, STA, AP, AP, 0xa0, 0x07, 0x80, 0x00,
+    STA, GW, 0x00, 0x24, SNAP(0x08, 0x06), ARP_BODY, 0x00, 0x00,
+    STA, GW, 0x00, 0x64, SNAP(0x08, 0x00), 0x45, 0x00,
+};
+
+static const u8 f_protected[] =
+{
+    0x08, 0x41, 0x3a, 0x01, AP, STA, GW, 0xb0, 0x08,
+    0x01, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x5f, 0x21, 0x9a, 0x04,
+};
+
+static const u8 f_null[] =
+{
+    0x48, 0x11, 0x3a, 0x01, AP, STA, AP, 0xc0, 0x09,
+};
+
+static const u8 f_qos_null[] =
+{
+    0xc8, 0x01, 0x3a, 0x01, AP, STA, AP, 0xd0, 0x0a, 0x00, 0x00,
+};
+
+static const u8 f_beacon[] =
+{
+    0x80, 0x00, 0x00, 0x00, BCAST, AP, AP, 0xe0, 0x0b,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x64, 0x00, 0x11, 0x04,
+};
+
+static const u8 f_qos_cut[] =
+{
+    0x88, 0x01, 0x3a, 0x01, AP, STA, GW, 0xf0, 0x0c, 0x00,
+};
+
+static const u8 f_no_body[] =
+{
+    0x08, 0x02, 0x00, 0x00, STA, AP, GW, 0x00, 0x0d,
+};
+
+static const conv_vector vectors[] =
+{
+    { "3addr FromDS ARP",        f_from_ds_arp,  sizeof(f_from_ds_arp),  0, 1,
+      { { { BCAST }, { GW }, 0x0806, 32, 28 } } },
+    { "3addr ToDS IPv4",         f_to_ds_ipv4,   sizeof(f_to_ds_ipv4),   0, 1,
+      { { { GW }, { STA }, 0x0800, 32, 40 } } },
+    { "3addr IBSS IPv6",         f_ibss_ipv6,    sizeof(f_ibss_ipv6),    0, 1,
+      { { { PEER }, { STA }, 0x86dd, 32, 40 } } },
+    { "4addr WDS IPv4",          f_wds_ipv4,     sizeof(f_wds_ipv4),     0, 1,
+      { { { PEER }, { GW }, 0x0800, 38, 40 } } },
+    { "QoS ToDS EAPOL",          f_qos_eapol,    sizeof(f_qos_eapol),    0, 1,
+      { { { AP }, { STA }, 0x888e, 34, 24 } } },
+    { "QoS+HTC FromDS IPv6",     f_qos_htc_ipv6, sizeof(f_qos_htc_ipv6), 0, 1,
+      { { { STA }, { GW }, 0x86dd, 38, 40 } } },
+    { "QoS 4addr ARP",           f_wds_qos_arp,  sizeof(f_wds_qos_arp),  0, 1,
+      { { { BCAST }, { GW }, 0x0806, 40, 28 } } },
+    { "bridge tunnel AARP",      f_tunnel_aarp,  sizeof(f_tunnel_aarp),  0, 1,
+      { { { BCAST }, { GW }, 0x80f3, 32, 28 } } },
+    { "non SNAP LLC (STP)",      f_stp,          sizeof(f_stp),          0, 1,
+      { { { STP_GROUP }, { AP }, 38, 24, 38 } } },
+    { "A-MSDU 3 subframes",      f_amsdu,        sizeof(f_amsdu),        0, 3,
+      { { { STA }, { GW }, 0x0806, 48, 28 },
+        { { STA }, { PEER }, 10, 92, 10 },
+        { { STA }, { GW }, 0x0800, 124, 40 } } },
+    { "A-MSDU cut subframe",     f_amsdu_cut,    sizeof(f_amsdu_cut),    0, 1,
+      { { { STA }, { GW }, 0x0806, 48, 28 } } },
+    { "out buffer too small",    f_to_ds_ipv4,   sizeof(f_to_ds_ipv4),   40, IEEE80211_CONV_ERR },
+    { "protected",               f_protected,    sizeof(f_protected),    0, IEEE80211_CONV_SKIP },
+    { "null function",           f_null,         sizeof(f_null),         0, IEEE80211_CONV_SKIP },
+    { "QoS null",                f_qos_null,     sizeof(f_qos_null),     0, IEEE80211_CONV_SKIP },
+    { "beacon",                  f_beacon,       sizeof(f_beacon),       0, IEEE80211_CONV_SKIP },
+    { "data without body",       f_no_body,      sizeof(f_no_body),      0, IEEE80211_CONV_SKIP },
+    { "QoS without QoS control", f_qos_cut,      sizeof(f_qos_cut),      0, IEEE80211_CONV_ERR },
+    { "shorter than a header",   f_qos_cut,      20,                     0, IEEE80211_CONV_ERR },
+};
+
+static const u8 bssid[] = { AP };
+
+static void sink_frame(void *ctx, u8 *frame, int len)
+{
+    conv_sink *sink = (conv_sink *)ctx;
+
+    if (sink->count < CHECK_OUT_MAX)
+    {
+        memcpy(sink->frame[sink->count], frame, len);
+        sink->len[sink->count] = len;
+    }
+    sink->count++;
+}
+
+/* 802.3 -> ToDS 802.11 -> 802.3 must give eth back, with the 802.11 header as the AP expects it */
+static const char *round_trip(const u8 *eth, int len)
+{
+    static u8 wifi[CHECK_BUF_LEN];
+    static u8 out[CHECK_BUF_LEN];
+    conv_sink sink;
+    int type_len = (eth[12] << 8) | eth[13];
+    int wifi_len, want = len;
+
+    wifi_len = ieee8023_to_80211_data(eth, len, bssid, wifi, sizeof(wifi));
+    if (wifi_len < IEEE80211_HDR_LEN)
+    {
+        return "802.3 -> 802.11 failed";
+    }
+    if (wifi[0] != 0x08 || wifi[1] != 0x01 ||
+        memcmp(&wifi[4], bssid, IEEE80211_MAC_LEN) ||
+        memcmp(&wifi[10], &eth[6], IEEE80211_MAC_LEN) ||
+        memcmp(&wifi[16], &eth[0], IEEE80211_MAC_LEN))
+    {
+        return "ToDS header (FC / BSSID / SA / DA)";
+    }
+    if (type_len >= ETH_P_802_3_MIN)
+    {
+        if (wifi_len != len + IEEE80211_HDR_LEN + IEEE80211_SNAP_LEN - ETH_HDR_LEN ||
+            wifi[24] != 0xaa || wifi[25] != 0xaa || wifi[26] != 0x03 ||
+            wifi[30] != eth[12] || wifi[31] != eth[13])
+        {
+            return "RFC 1042 SNAP";
+        }
+    }
+    else
+    {
+        want = ETH_HDR_LEN + type_len;     /* 802.3 padding does not go on air */
+        if (wifi_len != IEEE80211_HDR_LEN + type_len)
+        {
+            return "LLC length";
+        }
+    }
+
+    memset(&sink, 0x0, sizeof(sink));
+    if (ieee80211_data_to_8023(wifi, wifi_len, out, sizeof(out), sink_frame, &sink) != 1 || sink.count != 1)
+    {
+        return "802.11 -> 802.3 back failed";
+    }
+    if (sink.len[0] != want || memcmp(sink.frame[0], eth, want))
+    {
+        return "round trip differs";
+    }
+    return NULL;
+}
+
+static const char *check_output(const conv_expect *exp, const u8 *frame, int frame_len, const u8 *eth, int len)
+{
+    if (exp->off + exp->len > frame_len)
+    {
+        return "bad vector";
+    }
+    if (memcmp(&eth[0], exp->da, IEEE80211_MAC_LEN))
+    {
+        return "DA";
+    }
+    if (memcmp(&eth[6], exp->sa, IEEE80211_MAC_LEN))
+    {
+        return "SA";
+    }
+    if (((eth[12] << 8) | eth[13]) != exp->type_len)
+    {
+        return "EtherType / length";
+    }
+    if (len != ETH_HDR_LEN + exp->len || memcmp(&eth[ETH_HDR_LEN], &frame[exp->off], exp->len))
+    {
+        return "payload";
+    }
+    return round_trip(eth, len);
+}
+
+static int check_vector(const conv_vector *v)
+{
+    static u8 out[CHECK_BUF_LEN];
+    const char *err = NULL;
+    conv_sink sink;
+    int ret, i;
+
+    memset(&sink, 0x0, sizeof(sink));
+    ret = ieee80211_data_to_8023(v->frame, v->len, out, v->out_size ? v->out_size : (int)sizeof(out),
+                                 sink_frame, &sink);
+    if (ret != v->result)
+    {
+        err = "result";
+    }
+    else if (ret > 0 && sink.count != ret)
+    {
+        err = "callback count";
+    }
+    for (i = 0; !err && i < ret && i < CHECK_OUT_MAX; i++)
+    {
+        err = check_output(&v->out[i], v->frame, v->len, sink.frame[i], sink.len[i]);
+    }
+
+    printf("%-26s %4d  %s%s\n", v->name, ret, err ? "FAIL " : "ok", err ? err : "");
+    return err ? 1 : 0;
+}
+
+/* 802.3 padded to the 60 byte minimum : the padding is not sent and does not come back */
+static int check_padded_llc(void)
+{
+    u8 eth[60] = { GW, STA, 0x00, 38, STP_BODY };
+    const char *err = round_trip(eth, sizeof(eth));
+
+    printf("%-26s %4s  %s%s\n", "padded 802.3 LLC", "-", err ? "FAIL " : "ok", err ? err : "");
+    return err ? 1 : 0;
+}
+
+static uint32_t pcap_u32(const u8 *p, int swap)
+{
+    return swap ? ((uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3]) :
+                  ((uint32_t)p[3] << 24 | (uint32_t)p[2] << 16 | (uint32_t)p[1] << 8 | p[0]);
+}
+
+/* A captured data frame : addresses its DS bits select (A-MSDU : per subframe) and the round trip */
+static int check_captured(const u8 *frame, int len, unsigned long *frames)
+{
+    static u8 out[CHECK_BUF_LEN];
+    static const int da_at[4] = { 4, 16, 4, 16 };     /* By DS bits : -, ToDS, FromDS, both */
+    static const int sa_at[4] = { 10, 10, 16, 24 };
+    conv_sink sink;
+    int ds, ret, i, amsdu;
+
+    memset(&sink, 0x0, sizeof(sink));
+    ret = ieee80211_data_to_8023(frame, len, out, sizeof(out), sink_frame, &sink);
+    if (ret <= 0)
+    {
+        return 0;
+    }
+    (*frames)++;
+
+    ds = frame[1] & 0x03;
+    amsdu = (frame[0] & 0x80) && (frame[(ds == 3) ? 30 : 24] & 0x80);
+    for (i = 0; i < ret && i < CHECK_OUT_MAX; i++)
+    {
+        if (!amsdu && (memcmp(&sink.frame[i][0], &frame[da_at[ds]], IEEE80211_MAC_LEN) ||
+                       memcmp(&sink.frame[i][6], &frame[sa_at[ds]], IEEE80211_MAC_LEN)))
+        {
+            return 1;
+        }
+        if (round_trip(sink.frame[i], sink.len[i]))
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int check_pcap(const char *path)
+{
+    static u8 rec[65536];
+    unsigned long records = 0, frames = 0, failed = 0;
+    uint32_t magic, linktype, incl;
+    u8 hdr[24];
+    int swap, skip;
+    FILE *f = fopen(path, "rb");
+
+    if (!f || fread(hdr, 1, sizeof(hdr), f) != sizeof(hdr))
+    {
+        ERROR_PRINT("can not read %s\n", path);
+        return 1;
+    }
+    magic = pcap_u32(hdr, 0);
+    swap = (magic != PCAP_MAGIC && magic != PCAP_MAGIC_NS);
+    linktype = pcap_u32(&hdr[20], swap);
+    if ((swap && pcap_u32(hdr, 1) != PCAP_MAGIC && pcap_u32(hdr, 1) != PCAP_MAGIC_NS) ||
+        (linktype != PCAP_LINKTYPE_80211 && linktype != PCAP_LINKTYPE_RTAP))
+    {
+        ERROR_PRINT("%s : not a pcap of 802.11 frames\n", path);
+        fclose(f);
+        return 1;
+    }
+
+    while (fread(hdr, 1, 16, f) == 16)
+    {
+        incl = pcap_u32(&hdr[8], swap);
+        if (incl > sizeof(rec) || fread(rec, 1, incl, f) != incl)
+        {
+            break;
+        }
+        records++;
+        skip = (linktype == PCAP_LINKTYPE_RTAP && incl >= 4) ? (rec[2] | (rec[3] << 8)) : 0;
+        if ((int)incl - skip >= IEEE80211_HDR_LEN && (int)incl - skip <= CHECK_BUF_LEN - ETH_HDR_LEN)
+        {
+            if (check_captured(&rec[skip], (int)incl - skip, &frames))
+            {
+                printf("record %lu : wrong conversion\n", records);
+                failed++;
+            }
+        }
+    }
+    fclose(f);
+
+    printf("%-26s %lu records, %lu converted, %lu failed\n", path, records, frames, failed);
+    return failed ? 1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+    size_t i;
+    int failed = 0;
+
+    printf("%-26s %4s  %s\n", "frame", "ret", "result");
+    for (i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++)
+    {
+        failed += check_vector(&vectors[i]);
+    }
+    failed += check_padded_llc();
+    if (argc > 1)
+    {
+        failed += check_pcap(argv[1]);
+    }
+
+    printf("\n%s\n", failed ? "FAILED" : "all ok");
+    return failed ? 1 : 0;
+}
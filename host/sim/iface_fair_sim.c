@@ -0,0 +1,432 @@
+/*
+ * Station + SoftAP sharing the link : one shared queue vs. per-interface queues.
+ *
+ * Device -> host : both interfaces' sniffed frames compete for a link of fixed
+ * byte rate. "shared" puts everything in a single ring (the layout before
+ * interfaces), "drr" gives each interface its own ring served deficit round
+ * robin, "drr-ap4" gives the AP four times the station's quantum. Each run is
+ * compared with its weighted max-min fair share (Jain index, 1.0 : fair).
+ *
+ * Host -> device : the station's air is busy half of the time in 1-10 ms spells,
+ * the AP's is free. With a shared ring the AP's frames wait behind a station
+ * frame the air refuses; per-interface rings hold that frame aside.
+ *
+ * A classify check on a synthetic frame mix runs first and fails the sim if any
+ * frame lands on the wrong interface.
+ *
+ * Everything runs on a virtual clock through the real hw_iface / ring code.
+ *
+ * usage : iface_fair_sim [seconds] [link_kBps]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hw_link_ctrl_protocol.h"
+#include "hw_iface.h"
+#include "wifi_mac.h"
+
+#define STEP_US             (50)
+#define POLL_US             (1000)      /* Device app loop : one air drain per link exchange */
+#define AIR_BUDGET          (BUFFER_COUNT)
+#define AIR_FRAMES_PER_POLL (4)
+#define HIST_BUCKET_US      (50)
+#define HIST_BUCKETS        (4000)      /* 200 ms */
+#define NIFACE              (HW_LCP_IFACE_MAX)
+
+typedef struct sim_flow
+{
+    unsigned int rate;                  /* Frames/s */
+    int min_len;
+    int max_len;
+} sim_flow;
+
+typedef struct sim_load
+{
+    const char *name;
+    sim_flow flow[NIFACE];
+} sim_load;
+
+typedef struct sim_sched
+{
+    const char *name;
+    int count;                          /* 1 : shared ring */
+    uint32_t quantum[NIFACE];
+} sim_sched;
+
+typedef struct sim_result
+{
+    unsigned long offered[NIFACE];      /* Bytes */
+    unsigned long delivered[NIFACE];
+    unsigned long frames[NIFACE];
+    unsigned long drops[NIFACE];
+    unsigned long hist[NIFACE][HIST_BUCKETS];
+} sim_result;
+
+static uint32_t sim_now_us;
+static unsigned int rng_state;
+static hw_iface_set set;
+
+/* Host -> device air model */
+static uint32_t air_busy_until[NIFACE];
+static int air_tokens[NIFACE];
+
+static uint32_t sim_clock(void)
+{
+    return sim_now_us;
+}
+
+static unsigned int rng(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+/* Bernoulli per step approximates Poisson arrivals at rate_per_s */
+static int arrival(unsigned int rate_per_s)
+{
+    return (rng() % 1000000) < rate_per_s * STEP_US;
+}
+
+static int flow_len(const sim_flow *flow)
+{
+    return flow->min_len + (int)(rng() % (unsigned int)(flow->max_len - flow->min_len + 1));
+}
+
+static void hist_add(sim_result *r, int k, uint32_t delay_us)
+{
+    int bucket = delay_us / HIST_BUCKET_US;
+
+    r->hist[k][bucket < HIST_BUCKETS ? bucket : HIST_BUCKETS - 1]++;
+}
+
+static double percentile(const sim_result *r, int k, double p)
+{
+    unsigned long target = (unsigned long)(r->frames[k] * p), seen = 0;
+    int i;
+
+    for (i = 0; i < HIST_BUCKETS; i++)
+    {
+        seen += r->hist[k][i];
+        if (seen > target)
+        {
+            return i * HIST_BUCKET_US / 1000.0;
+        }
+    }
+    return HIST_BUCKETS * HIST_BUCKET_US / 1000.0;
+}
+
+static void sim_setup(const sim_sched *sched)
+{
+    buffer_aqm_config tail_drop = { BUFFER_AQM_NONE, BUFFER_AQM_TARGET_US, BUFFER_AQM_INTERVAL_US };
+    int k;
+
+    rng_state = 0x2545f491;
+    sim_now_us = 1;
+    buffer_set_clock(sim_clock);
+    hw_iface_init(&set, sched->count, &tail_drop);
+    for (k = 0; k < sched->count; k++)
+    {
+        hw_iface_set_filter(&set, k, HW_IFACE_FILTER_DEFAULT, sched->quantum[k]);
+    }
+}
+
+/* Frame tagged with its real interface, so the shared ring can still be accounted per interface */
+static int sim_frame(u8 *frame, const sim_flow *flow, int k)
+{
+    int len = flow_len(flow);
+
+    memset(frame, 0x0, len);
+    frame[0] = (u8)k;
+    hw_lcp_put_le32(&frame[1], sim_now_us);
+    return len;
+}
+
+static void run_d2h(const sim_load *load, const sim_sched *sched, int seconds, uint32_t link_Bps, sim_result *r)
+{
+    static u8 frame[MAX_BUFFER_SIZE];
+    uint32_t end = (uint32_t)seconds * 1000000;
+    uint32_t link_free = 0;
+    hw_iface_frame info;
+    int k, len;
+
+    memset(r, 0x0, sizeof(sim_result));
+    sim_setup(sched);
+
+    for (; sim_now_us < end; sim_now_us += STEP_US)
+    {
+        for (k = 0; k < NIFACE; k++)
+        {
+            if (!arrival(load->flow[k].rate))
+            {
+                continue;
+            }
+            len = sim_frame(frame, &load->flow[k], k);
+            r->offered[k] += len;
+            if (hw_iface_enqueue_tx(&set, sched->count > 1 ? k : 0, NULL, 0, frame, len, HW_LCP_TYPE_80211,
+                                    sim_now_us) != HW_IFACE_OK)
+            {
+                r->drops[k]++;
+            }
+        }
+
+        if (sim_now_us < link_free)
+        {
+            continue;
+        }
+        len = hw_iface_dequeue_tx(&set, frame, sizeof(frame), &info);
+        if (len > 0)
+        {
+            k = frame[0];
+            r->delivered[k] += len;
+            r->frames[k]++;
+            hist_add(r, k, sim_now_us - info.capture_us);
+            link_free = sim_now_us + (uint32_t)((uint64_t)len * 1000000 / link_Bps);
+        }
+    }
+    buffer_set_clock(NULL);
+}
+
+static int sim_air_tx(void *ctx, u8 iface, u8 type, const u8 *frame, int len)
+{
+    sim_result *r = (sim_result *)ctx;
+    int k = frame[0];
+
+    if (sim_now_us < air_busy_until[k] || air_tokens[k] == 0)
+    {
+        return HW_IFACE_AIR_BUSY;
+    }
+    air_tokens[k]--;
+    r->delivered[k] += len;
+    r->frames[k]++;
+    hist_add(r, k, sim_now_us - hw_lcp_get_le32(&frame[1]));
+    return HW_IFACE_AIR_SENT;
+}
+
+static void run_h2d(const sim_load *load, const sim_sched *sched, int seconds, sim_result *r)
+{
+    static u8 frame[MAX_BUFFER_SIZE];
+    uint32_t end = (uint32_t)seconds * 1000000;
+    uint32_t sta_free_until = 0;
+    int k, len;
+
+    memset(r, 0x0, sizeof(sim_result));
+    memset(air_busy_until, 0x0, sizeof(air_busy_until));
+    sim_setup(sched);
+
+    for (; sim_now_us < end; sim_now_us += STEP_US)
+    {
+        /* Station air : busy and free spells of 1-10 ms each */
+        if (sim_now_us >= air_busy_until[HW_LCP_IFACE_STA] && sim_now_us >= sta_free_until)
+        {
+            air_busy_until[HW_LCP_IFACE_STA] = sim_now_us + 1000 + rng() % 9000;
+            sta_free_until = air_busy_until[HW_LCP_IFACE_STA] + 1000 + rng() % 9000;
+        }
+
+        for (k = 0; k < NIFACE; k++)
+        {
+            if (!arrival(load->flow[k].rate))
+            {
+                continue;
+            }
+            len = sim_frame(frame, &load->flow[k], k);
+            r->offered[k] += len;
+            if (hw_iface_enqueue_rx(&set, sched->count > 1 ? k : 0, frame, len, HW_LCP_TYPE_80211) != HW_IFACE_OK)
+            {
+                r->drops[k]++;
+            }
+        }
+
+        if (sim_now_us % POLL_US < STEP_US)
+        {
+            for (k = 0; k < NIFACE; k++)
+            {
+                air_tokens[k] = AIR_FRAMES_PER_POLL;
+            }
+            hw_iface_air_drain(&set, AIR_BUDGET, sim_air_tx, r);
+        }
+    }
+    buffer_set_clock(NULL);
+}
+
+/* Weighted max-min fair share of capacity between NIFACE demands (water filling) */
+static void fair_share(const double *demand, const uint32_t *weight, double capacity, double *share)
+{
+    double left = capacity, wsum;
+    int done[NIFACE] = { 0 };
+    int k, progress = 1;
+
+    while (progress)
+    {
+        progress = 0;
+        wsum = 0;
+        for (k = 0; k < NIFACE; k++)
+        {
+            wsum += done[k] ? 0 : weight[k];
+        }
+        for (k = 0; k < NIFACE && wsum > 0; k++)
+        {
+            if (!done[k] && demand[k] <= left * weight[k] / wsum)
+            {
+                share[k] = demand[k];
+                left -= demand[k];
+                done[k] = 1;
+                progress = 1;
+                break;
+            }
+        }
+    }
+    for (k = 0; k < NIFACE; k++)
+    {
+        if (!done[k])
+        {
+            share[k] = left * weight[k] / wsum;
+        }
+    }
+}
+
+static void report(const char *sched, const sim_result *r, int seconds, const double *share)
+{
+    double x[NIFACE], sum = 0, sum2 = 0;
+    int k;
+
+    for (k = 0; k < NIFACE; k++)
+    {
+        printf("  %-8s %-4s %8.1f %8.1f %8.1f %7lu %7.2f %7.2f\n", sched, k == HW_LCP_IFACE_STA ? "sta" : "ap",
+               r->offered[k] / 1000.0 / seconds, r->delivered[k] / 1000.0 / seconds,
+               share ? share[k] / 1000.0 : 0.0, r->drops[k], percentile(r, k, 0.50), percentile(r, k, 0.99));
+        if (share)
+        {
+            x[k] = (r->delivered[k] / (double)seconds) / share[k];
+            sum += x[k];
+            sum2 += x[k] * x[k];
+        }
+    }
+    if (share)
+    {
+        printf("  %-8s jain %.3f\n", sched, sum * sum / (NIFACE * sum2));
+    }
+}
+
+/* Synthetic frames with the interface each one must land on */
+static int classify_check(void)
+{
+    static const u8 sta_mac[6] = { 0x24, 0x0a, 0xc4, 0x00, 0x00, 0x01 };
+    static const u8 ap_mac[6]  = { 0x24, 0x0a, 0xc4, 0x00, 0x00, 0x02 };
+    static const u8 other[6]   = { 0x02, 0x11, 0x22, 0x33, 0x44, 0x55 };
+    static const u8 bcast[6]   = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff };
+    static const u8 mcast[6]   = { 0x01, 0x00, 0x5e, 0x00, 0x00, 0xfb };
+    static const struct
+    {
+        const char *name;
+        u8 fc0;
+        u8 fc1;
+        const u8 *addr1;
+        u8 filter;                      /* Applied to both interfaces */
+        int expect;
+    } cases[] =
+    {
+        { "fromds data to sta",     0x08, 0x02, sta_mac, HW_IFACE_FILTER_DEFAULT, HW_LCP_IFACE_STA },
+        { "fromds data broadcast",  0x08, 0x02, bcast,   HW_IFACE_FILTER_DEFAULT, HW_LCP_IFACE_STA },
+        { "fromds data multicast",  0x08, 0x02, mcast,   HW_IFACE_FILTER_DEFAULT, HW_IFACE_FILTERED },
+        { "fromds data mc allowed", 0x08, 0x02, mcast,   HW_IFACE_FILTER_DEFAULT | HW_IFACE_FILTER_MULTICAST,
+          HW_LCP_IFACE_STA },
+        { "fromds data to other",   0x08, 0x02, other,   HW_IFACE_FILTER_DEFAULT, HW_IFACE_FILTERED },
+        { "fromds data any",        0x08, 0x02, other,   HW_IFACE_FILTER_ALL, HW_LCP_IFACE_STA },
+        { "probe resp to sta",      0x50, 0x00, sta_mac, HW_IFACE_FILTER_DEFAULT, HW_LCP_IFACE_STA },
+        { "probe resp to ap",       0x50, 0x00, ap_mac,  HW_IFACE_FILTER_DEFAULT, HW_LCP_IFACE_AP },
+        { "tods data to ap",        0x08, 0x01, ap_mac,  HW_IFACE_FILTER_DEFAULT, HW_LCP_IFACE_AP },
+        { "tods data to other",     0x08, 0x01, other,   HW_IFACE_FILTER_DEFAULT, HW_IFACE_FILTERED },
+        { "probe req broadcast",    0x40, 0x00, bcast,   HW_IFACE_FILTER_DEFAULT, HW_LCP_IFACE_AP },
+        { "auth to ap",             0xb0, 0x00, ap_mac,  HW_IFACE_FILTER_DEFAULT, HW_LCP_IFACE_AP },
+        { "beacon, ap unicast only",0x80, 0x00, bcast,   HW_IFACE_FILTER_UNICAST, HW_IFACE_FILTERED },
+        { "wds data",               0x08, 0x03, sta_mac, HW_IFACE_FILTER_DEFAULT, HW_IFACE_FILTERED },
+    };
+    buffer_aqm_config tail_drop = { BUFFER_AQM_NONE, BUFFER_AQM_TARGET_US, BUFFER_AQM_INTERVAL_US };
+    u8 frame[64];
+    int i, got, failed = 0;
+
+    hw_iface_init(&set, NIFACE, &tail_drop);
+    hw_iface_set_mac(&set, HW_LCP_IFACE_STA, sta_mac);
+    hw_iface_set_mac(&set, HW_LCP_IFACE_AP, ap_mac);
+
+    for (i = 0; i < (int)(sizeof(cases) / sizeof(cases[0])); i++)
+    {
+        memset(frame, 0x0, sizeof(frame));
+        frame[0] = cases[i].fc0;
+        frame[1] = cases[i].fc1;
+        memcpy(&frame[4], cases[i].addr1, 6);
+        hw_iface_set_filter(&set, HW_LCP_IFACE_STA, cases[i].filter, 0);
+        hw_iface_set_filter(&set, HW_LCP_IFACE_AP, cases[i].filter, 0);
+
+        got = hw_iface_classify(&set, frame, sizeof(frame));
+        if (got != cases[i].expect)
+        {
+            printf("classify : %-24s got %d expected %d\n", cases[i].name, got, cases[i].expect);
+            failed++;
+        }
+    }
+    printf("classify : %d/%d as expected, filtered sta %u ap %u\n", i - failed, i,
+           (unsigned int)set.ifaces[HW_LCP_IFACE_STA].stats.filtered,
+           (unsigned int)set.ifaces[HW_LCP_IFACE_AP].stats.filtered);
+    return failed;
+}
+
+int main(int argc, char **argv)
+{
+    int seconds = (argc > 1) ? atoi(argv[1]) : 20;
+    uint32_t link_Bps = ((argc > 2) ? (uint32_t)atoi(argv[2]) : 1000) * 1000;
+    const sim_sched scheds[] =
+    {
+        { "shared",  1,      { HW_IFACE_QUANTUM_MIN, HW_IFACE_QUANTUM_MIN } },
+        { "drr",     NIFACE, { HW_IFACE_QUANTUM_MIN, HW_IFACE_QUANTUM_MIN } },
+        { "drr-ap4", NIFACE, { HW_IFACE_QUANTUM_MIN, 4 * HW_IFACE_QUANTUM_MIN } },
+    };
+    /* Station floods at ~3x the link; the AP light, then saturating as well */
+    const sim_load d2h_loads[] =
+    {
+        { "sta flood, ap light", { { 3 * link_Bps / 456, 400, 512 }, { 3 * link_Bps / 10 / 200, 100, 300 } } },
+        { "sta flood, ap heavy", { { 3 * link_Bps / 456, 400, 512 }, { 6 * link_Bps / 10 / 200, 100, 300 } } },
+    };
+    const sim_load h2d_load = { "sta air busy 50%", { { 2000, 200, 500 }, { 1000, 200, 500 } } };
+    static sim_result r;
+    double demand[NIFACE], share[NIFACE];
+    size_t i, j;
+    int k;
+
+    if (classify_check() != 0)
+    {
+        return 1;
+    }
+
+    printf("\ndevice -> host, seconds=%d link=%u kB/s ring=%d\n", seconds, (unsigned int)(link_Bps / 1000),
+           BUFFER_COUNT);
+    printf("  %-8s %-4s %8s %8s %8s %7s %7s %7s\n", "sched", "if", "off kB/s", "got kB/s", "fair", "drops",
+           "p50ms", "p99ms");
+    for (i = 0; i < sizeof(d2h_loads) / sizeof(d2h_loads[0]); i++)
+    {
+        printf(" %s\n", d2h_loads[i].name);
+        for (j = 0; j < sizeof(scheds) / sizeof(scheds[0]); j++)
+        {
+            run_d2h(&d2h_loads[i], &scheds[j], seconds, link_Bps, &r);
+            for (k = 0; k < NIFACE; k++)
+            {
+                demand[k] = r.offered[k] / (double)seconds;
+            }
+            fair_share(demand, scheds[j].quantum, link_Bps, share);
+            report(scheds[j].name, &r, seconds, share);
+        }
+    }
+
+    printf("\nhost -> device, %s, air %d frames/ms per interface\n", h2d_load.name, AIR_FRAMES_PER_POLL);
+    printf("  %-8s %-4s %8s %8s %8s %7s %7s %7s\n", "sched", "if", "off kB/s", "got kB/s", "", "drops",
+           "p50ms", "p99ms");
+    for (j = 0; j < 2; j++)
+    {
+        run_h2d(&h2d_load, &scheds[j], seconds, &r);
+        report(scheds[j].name, &r, seconds, NULL);
+    }
+    return 0;
+}
@@ -0,0 +1,416 @@
+/*
+ * Firmware update over the link : lcp_ota_tx on the host side, lcp_ota on the
+ * device side, a file standing in for the OTA partition with NOR erase /
+ * program delays.
+ *
+ * The link is pipelined : up to `depth` commands are in flight, each exchange
+ * takes link_us, replies come back in order. Commands and replies can be
+ * dropped on the way (loss_pct) : lost data frames exercise the go-back and
+ * probe recovery, a lost BEGIN, END, probe or reply leaves the host with
+ * nothing in flight and nothing to send, which the sim treats as the host's
+ * reply timeout (lcp_ota_tx_timeout). Three device
+ * layouts are timed in real time :
+ *
+ *   inline  the link task does the flash work itself (one buffer)
+ *   single  writer thread, one buffer : the link waits while a sector is written
+ *   double  writer thread, two buffers : the next sector fills during the write
+ *
+ * and the image on "flash" is checked against the source. The last runs inject
+ * faults : one byte corrupted on the way to flash (expects LCP_OTA_ERR_HASH),
+ * HW_CMD_OTA_ABORT arriving while the writer reads the image back (accepted,
+ * the boot partition must not switch) and while it switches the partition
+ * (refused, the update completes).
+ *
+ * usage : lcp_ota_sim [image_kb] [link_us] [depth] [loss_pct] [erase_us] [page_us]
+ */
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "lcp_ota.h"
+#include "lcp_ota_tx.h"
+
+#define SIM_MAX_DEPTH       (64)
+#define SIM_TIMEOUT_S       (120)
+#define SIM_PART_SIZE       (4 * 1024 * 1024)
+#define SIM_REPLY_TIMEOUT   (4)     /* Idle exchanges with nothing in flight before the host resends */
+
+typedef struct sim_config
+{
+    const char *name;
+    int nbufs;
+    int writer_thread;
+    int fault;                      /* SIM_FAULT_* */
+} sim_config;
+
+#define SIM_FAULT_NONE              (0)
+#define SIM_FAULT_CORRUPT           (1)     /* Flip one byte on its way to flash */
+#define SIM_FAULT_ABORT_VERIFY      (2)     /* HW_CMD_OTA_ABORT during the read back */
+#define SIM_FAULT_ABORT_ACTIVATE    (3)     /* HW_CMD_OTA_ABORT during the partition switch */
+
+typedef struct sim_cmd
+{
+    u8 data[HW_LCP_MAX_PAYLOAD_LEN];
+    int len;
+} sim_cmd;
+
+typedef struct sim_writer
+{
+    lcp_ota *ota;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int kicks;
+    int stop;
+} sim_writer;
+
+/* Flash ops wrapper that flips one byte of the image on its way to the partition */
+typedef struct corrupt_flash
+{
+    lcp_ota_flash flash;
+    lcp_ota_flash *inner;
+    uint32_t at;
+    int fault;
+    lcp_ota *ota;
+    int abort_status;               /* Reply to the injected abort, -1 : not sent */
+    int activations;                /* esp_ota_abort does not undo a boot partition switch */
+} corrupt_flash;
+
+static const char *sim_path = "/tmp/lcp_ota_sim.bin";
+static uint32_t link_us = 200;
+static int depth = 8;
+static int loss_pct;
+static uint32_t erase_us = 30000;
+static uint32_t page_us = 400;
+static unsigned int rng_state = 0x2545F491;
+
+static uint64_t now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static void sleep_until(uint64_t deadline_us)
+{
+    struct timespec ts;
+
+    ts.tv_sec = deadline_us / 1000000;
+    ts.tv_nsec = (long)(deadline_us % 1000000) * 1000;
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+}
+
+static unsigned int rng(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static void writer_notify(void *ctx)
+{
+    sim_writer *w = (sim_writer *)ctx;
+
+    pthread_mutex_lock(&w->lock);
+    w->kicks++;
+    pthread_cond_signal(&w->cond);
+    pthread_mutex_unlock(&w->lock);
+}
+
+/* The link side's abort, as if it came in while the writer is inside the flash op */
+static void inject_abort(corrupt_flash *c, int fault)
+{
+    u8 cmd = HW_CMD_OTA_ABORT;
+    u8 reply[HW_CMD_OTA_REPLY_LEN];
+
+    if (c->fault == fault && c->abort_status < 0)
+    {
+        lcp_ota_handle_cmd(c->ota, &cmd, 1, reply);
+        c->abort_status = reply[HW_CMD_OTA_REPLY_STATUS];
+    }
+}
+
+/* Same loop as ota_writer_task in app_main.c, a condition variable in place of the task notification */
+static void *writer_thread(void *arg)
+{
+    sim_writer *w = (sim_writer *)arg;
+
+    for (;;)
+    {
+        pthread_mutex_lock(&w->lock);
+        while (w->kicks == 0 && !w->stop)
+        {
+            pthread_cond_wait(&w->cond, &w->lock);
+        }
+        if (w->stop)
+        {
+            pthread_mutex_unlock(&w->lock);
+            return NULL;
+        }
+        w->kicks = 0;
+        pthread_mutex_unlock(&w->lock);
+
+        while (lcp_ota_work(w->ota))
+        {
+        }
+    }
+}
+
+static int corrupt_begin(lcp_ota_flash *flash, uint32_t size)
+{
+    corrupt_flash *c = (corrupt_flash *)flash;
+
+    return c->inner->ops->begin(c->inner, size);
+}
+
+static int corrupt_write(lcp_ota_flash *flash, uint32_t offset, const u8 *buf, int len)
+{
+    corrupt_flash *c = (corrupt_flash *)flash;
+    u8 copy[LCP_OTA_BUF_SIZE];
+
+    if (c->fault == SIM_FAULT_CORRUPT && c->at >= offset && c->at < offset + len)
+    {
+        memcpy(copy, buf, len);
+        copy[c->at - offset] ^= 0x01;
+        buf = copy;
+    }
+    return c->inner->ops->write(c->inner, offset, buf, len);
+}
+
+static int corrupt_read(lcp_ota_flash *flash, uint32_t offset, u8 *buf, int len)
+{
+    corrupt_flash *c = (corrupt_flash *)flash;
+
+    inject_abort(c, SIM_FAULT_ABORT_VERIFY);
+    return c->inner->ops->read(c->inner, offset, buf, len);
+}
+
+static int corrupt_activate(lcp_ota_flash *flash)
+{
+    corrupt_flash *c = (corrupt_flash *)flash;
+
+    inject_abort(c, SIM_FAULT_ABORT_ACTIVATE);
+    c->activations++;
+    return c->inner->ops->activate(c->inner);
+}
+
+static void corrupt_abort(lcp_ota_flash *flash)
+{
+    corrupt_flash *c = (corrupt_flash *)flash;
+
+    c->inner->ops->abort(c->inner);
+}
+
+static const lcp_ota_flash_ops corrupt_ops =
+{
+    .name     = "corrupt",
+    .begin    = corrupt_begin,
+    .write    = corrupt_write,
+    .read     = corrupt_read,
+    .activate = corrupt_activate,
+    .abort    = corrupt_abort,
+};
+
+static int check_flash(lcp_ota_flash *flash, const u8 *image, uint32_t size)
+{
+    u8 buf[LCP_OTA_BUF_SIZE];
+    uint32_t offset;
+    int n;
+
+    for (offset = 0; offset < size; offset += n)
+    {
+        n = (size - offset > sizeof(buf)) ? (int)sizeof(buf) : (int)(size - offset);
+        if (flash->ops->read(flash, offset, buf, n) != LCP_OTA_FLASH_OK || memcmp(buf, &image[offset], n))
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int run(const sim_config *cfg, const u8 *image, uint32_t size, int expect)
+{
+    static lcp_ota ota;
+    static sim_cmd queue[SIM_MAX_DEPTH];
+    lcp_ota_flash *file = lcp_ota_flash_file_create(sim_path, SIM_PART_SIZE, erase_us, page_us);
+    corrupt_flash corrupt = { { &corrupt_ops, NULL }, file, size / 2, cfg->fault, &ota, -1, 0 };
+    lcp_ota_flash *flash = cfg->fault ? &corrupt.flash : file;
+    u8 reply[HW_CMD_OTA_REPLY_LEN];
+    sim_writer writer;
+    lcp_ota_tx tx;
+    sim_cmd *cmd;
+    uint64_t start, tick, t0, stall, max_stall = 0, exchanges = 0;
+    unsigned long lost = 0;
+    int head = 0, count = 0, idle = 0, state, len, ok;
+
+    if (!file)
+    {
+        return -1;
+    }
+    memset(&writer, 0x0, sizeof(sim_writer));
+    writer.ota = &ota;
+    pthread_mutex_init(&writer.lock, NULL);
+    pthread_cond_init(&writer.cond, NULL);
+
+    lcp_ota_init(&ota, flash, cfg->nbufs, cfg->writer_thread ? writer_notify : NULL, &writer);
+    if (cfg->writer_thread)
+    {
+        pthread_create(&writer.thread, NULL, writer_thread, &writer);
+    }
+    lcp_ota_tx_init(&tx, image, size, LCP_OTA_DATA_MAX, 1);
+
+    start = tick = now_us();
+    state = tx.state;
+    while (state != LCP_OTA_TX_DONE && state != LCP_OTA_TX_FAILED && now_us() - start < SIM_TIMEOUT_S * 1000000ULL)
+    {
+        /* Host puts the next command on the wire */
+        cmd = &queue[(head + count) % depth];
+        len = (count < depth) ? lcp_ota_tx_next(&tx, cmd->data) : 0;
+        if (len > 0 && (int)(rng() % 100) < loss_pct)
+        {
+            lost++;
+        }
+        else if (len > 0)
+        {
+            cmd->len = len;
+            count++;
+        }
+
+        /* The oldest one reaches the device once the pipe is full or the host has nothing more to say */
+        t0 = now_us();
+        if (count > 0 && (count == depth || len == 0))
+        {
+            cmd = &queue[head];
+            head = (head + 1) % depth;
+            count--;
+            lcp_ota_handle_cmd(&ota, cmd->data, cmd->len, reply);
+            if ((int)(rng() % 100) < loss_pct)
+            {
+                lost++;
+            }
+            else
+            {
+                state = lcp_ota_tx_reply(&tx, reply, HW_CMD_OTA_REPLY_LEN);
+            }
+        }
+
+        /* Nothing in flight and nothing to send : a command or its reply was lost */
+        idle = (count == 0 && len == 0) ? idle + 1 : 0;
+        if (idle > SIM_REPLY_TIMEOUT)
+        {
+            lcp_ota_tx_timeout(&tx);
+            idle = 0;
+        }
+        if (!cfg->writer_thread)
+        {
+            lcp_ota_work(&ota);
+        }
+        stall = now_us() - t0;
+        if (stall > max_stall)
+        {
+            max_stall = stall;
+        }
+
+        exchanges++;
+        tick += link_us;
+        sleep_until(tick);
+    }
+
+    if (cfg->writer_thread)
+    {
+        pthread_mutex_lock(&writer.lock);
+        writer.stop = 1;
+        pthread_cond_signal(&writer.cond);
+        pthread_mutex_unlock(&writer.lock);
+        pthread_join(writer.thread, NULL);
+    }
+
+    if (expect == LCP_OTA_OK)
+    {
+        ok = (state == LCP_OTA_TX_DONE && lcp_ota_flash_file_activated(file) && check_flash(file, image, size) == 0);
+    }
+    else
+    {
+        ok = (state == LCP_OTA_TX_FAILED && tx.status == expect && !lcp_ota_flash_file_activated(file));
+    }
+    if (cfg->fault == SIM_FAULT_ABORT_VERIFY)
+    {
+        ok = ok && corrupt.abort_status == LCP_OTA_OK && corrupt.activations == 0;
+    }
+    else if (cfg->fault == SIM_FAULT_ABORT_ACTIVATE)
+    {
+        ok = ok && corrupt.abort_status == LCP_OTA_ERR_STATE;
+    }
+
+    printf("%-8s %5d %9.1f %9.2f %8lu %7lu %7lu %7lu %7lu %7lu %7lu  %s\n",
+           cfg->name, cfg->nbufs, size / 1024.0 / ((now_us() - start) / 1e6), max_stall / 1000.0,
+           (unsigned long)exchanges, tx.stats.frames, lost, tx.stats.resends, tx.stats.probes,
+           tx.stats.timeouts, (unsigned long)ota.stats.busy, ok ? "ok" : "FAIL");
+
+    pthread_mutex_destroy(&writer.lock);
+    pthread_cond_destroy(&writer.cond);
+    lcp_ota_flash_file_destroy(file);
+    unlink(sim_path);
+    return ok ? 0 : -1;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t size = ((argc > 1) ? (uint32_t)atoi(argv[1]) : 192) * 1024;
+    static const sim_config configs[] =
+    {
+        { "inline", 1, 0, 0 },
+        { "single", 1, 1, 0 },
+        { "double", 2, 1, 0 },
+    };
+    static const sim_config corrupt = { "corrupt", 2, 1, SIM_FAULT_CORRUPT };
+    static const sim_config abort_verify = { "abort_v", 2, 1, SIM_FAULT_ABORT_VERIFY };
+    static const sim_config abort_activate = { "abort_a", 2, 1, SIM_FAULT_ABORT_ACTIVATE };
+    u8 *image;
+    uint32_t i;
+    size_t c;
+    int failed = 0;
+
+    link_us  = (argc > 2) ? (uint32_t)atoi(argv[2]) : link_us;
+    depth    = (argc > 3) ? atoi(argv[3]) : depth;
+    loss_pct = (argc > 4) ? atoi(argv[4]) : loss_pct;
+    erase_us = (argc > 5) ? (uint32_t)atoi(argv[5]) : erase_us;
+    page_us  = (argc > 6) ? (uint32_t)atoi(argv[6]) : page_us;
+    if (depth < 1 || depth > SIM_MAX_DEPTH || size == 0 || size > SIM_PART_SIZE)
+    {
+        fprintf(stderr, "bad arguments\n");
+        return 1;
+    }
+
+    image = malloc(size);
+    if (!image)
+    {
+        return 1;
+    }
+    for (i = 0; i < size; i++)
+    {
+        image[i] = (u8)rng();
+    }
+
+    printf("image=%u KB link=%u us/exchange depth=%d loss=%d%% erase=%u us/4KB page=%u us/256B\n",
+           (unsigned int)(size / 1024), (unsigned int)link_us, depth, loss_pct,
+           (unsigned int)erase_us, (unsigned int)page_us);
+    printf("%-8s %5s %9s %9s %8s %7s %7s %7s %7s %7s %7s\n",
+           "mode", "bufs", "KB/s", "stall_ms", "xchg", "frames", "lost", "resend", "probes", "timeout", "busy");
+
+    for (c = 0; c < sizeof(configs) / sizeof(configs[0]); c++)
+    {
+        failed |= run(&configs[c], image, size, LCP_OTA_OK);
+    }
+    failed |= run(&corrupt, image, size < 64 * 1024 ? size : 64 * 1024, LCP_OTA_ERR_HASH);
+    failed |= run(&abort_verify, image, size < 64 * 1024 ? size : 64 * 1024, LCP_OTA_ERR_STATE);
+    failed |= run(&abort_activate, image, size < 64 * 1024 ? size : 64 * 1024, LCP_OTA_OK);
+
+    free(image);
+    return failed ? 1 : 0;
+}
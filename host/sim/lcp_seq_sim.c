@@ -0,0 +1,251 @@
+/*
+ * Link sequence / latency accounting against synthetic streams with known impairments.
+ *
+ * Sequence : frames carrying the hw_lcp_ext trailer are written to a file with
+ * injected loss, adjacent swaps, duplicates and sequence resets, then read back
+ * through host_link_feed_fd(). The counters host_link reports must match what
+ * was injected.
+ *
+ * Latency : device timestamps are generated from a clock with an unknown offset,
+ * drift and a 32 bit wrap; the estimated one-way latency percentiles are compared
+ * with the true ones (relative to the fastest frame, as the estimator defines them).
+ *
+ * usage : lcp_seq_sim [frames]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "host_link.h"
+
+typedef struct seq_case
+{
+    const char *name;
+    int loss_pm;                /* Per mille of positions */
+    int swap_pm;
+    int dup_pm;
+    int resets;
+    uint16_t first_seq;
+} seq_case;
+
+typedef struct seq_expect
+{
+    uint32_t received;
+    uint32_t lost;
+    uint32_t reordered;
+    uint32_t duplicates;
+    uint32_t resets;
+} seq_expect;
+
+static const seq_case seq_cases[] =
+{
+    { "clean",        0,  0, 0, 0, 0 },
+    { "loss-1%",     10,  0, 0, 0, 0 },
+    { "swap-1%",      0, 10, 0, 0, 0 },
+    { "dup-0.5%",     0,  0, 5, 0, 0 },
+    { "mixed",       10, 10, 5, 0, 0 },
+    { "resets",       5,  5, 5, 3, 0 },
+    { "wrap",        10, 10, 5, 0, 65000 },
+};
+
+static unsigned int rng_state;
+
+static unsigned int rng(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static void put_frame(FILE *fp, uint16_t seq)
+{
+    static u8 frame[64 + HW_LCP_EXT_LEN + HW_LCP_OVERHEAD];
+    hw_lcp_ext ext = { seq, 0, 0, 0, 0 };
+    int len;
+
+    memset(&frame[PAYLOAD_FIELD], (u8)seq, 64);
+    len = hw_frame_encap_ext(frame, 64, HW_LCP_TYPE_80211, &ext);
+    fwrite(frame, len, 1, fp);
+}
+
+/* Builds the impaired stream and the counters a correct receiver must report */
+static void build_stream(FILE *fp, const seq_case *c, long frames, seq_expect *expect)
+{
+    uint16_t seq = c->first_seq;
+    long i, reset_every = c->resets ? frames / (c->resets + 1) : 0;
+    unsigned int r;
+
+    memset(expect, 0x0, sizeof(seq_expect));
+    for (i = 0; i < frames; i++)
+    {
+        if (reset_every && i > 0 && i % reset_every == 0 && expect->resets < (uint32_t)c->resets)
+        {
+            seq += 20000;
+            put_frame(fp, seq++);
+            expect->received++;
+            expect->resets++;
+            continue;
+        }
+
+        r = rng() % 1000;
+        if (r < (unsigned int)c->loss_pm)
+        {
+            seq++;
+            expect->lost++;
+        }
+        else if (r < (unsigned int)(c->loss_pm + c->swap_pm) && i + 1 < frames)
+        {
+            put_frame(fp, seq + 1);
+            put_frame(fp, seq);
+            seq += 2;
+            i++;
+            expect->received += 2;
+            expect->reordered++;
+        }
+        else if (r < (unsigned int)(c->loss_pm + c->swap_pm + c->dup_pm))
+        {
+            put_frame(fp, seq);
+            put_frame(fp, seq++);
+            expect->received++;
+            expect->duplicates++;
+        }
+        else
+        {
+            put_frame(fp, seq++);
+            expect->received++;
+        }
+    }
+    /* Trailing losses are only visible once a later frame arrives */
+    put_frame(fp, seq);
+    expect->received++;
+}
+
+static int run_seq_case(const seq_case *c, long frames)
+{
+    lcp_frame *batch[HOST_LINK_BATCH];
+    host_link *link = host_link_create(NULL);
+    host_link_stats stats;
+    seq_expect expect;
+    FILE *fp = tmpfile();
+    int n, ok;
+
+    rng_state = 0x9e3779b9;
+    build_stream(fp, c, frames, &expect);
+    fflush(fp);
+    lseek(fileno(fp), 0, SEEK_SET);
+
+    while (host_link_feed_fd(link, fileno(fp)) != HOST_LINK_EOF)
+    {
+        while ((n = host_link_recv_batch(link, batch, HOST_LINK_BATCH)) > 0)
+        {
+            host_link_release(link, batch, n);
+        }
+    }
+    host_link_get_stats(link, &stats);
+    host_link_destroy(link);
+    fclose(fp);
+
+    ok = stats.seq.received == expect.received && stats.seq.lost == expect.lost &&
+         stats.seq.reordered == expect.reordered && stats.seq.duplicates == expect.duplicates &&
+         stats.seq.resets == expect.resets;
+
+    printf("%-10s %9u/%-9u %6u/%-6u %6u/%-6u %6u/%-6u %3u/%-3u %s\n", c->name,
+           (unsigned int)stats.seq.received, (unsigned int)expect.received,
+           (unsigned int)stats.seq.lost, (unsigned int)expect.lost,
+           (unsigned int)stats.seq.reordered, (unsigned int)expect.reordered,
+           (unsigned int)stats.seq.duplicates, (unsigned int)expect.duplicates,
+           (unsigned int)stats.seq.resets, (unsigned int)expect.resets, ok ? "ok" : "MISMATCH");
+    return ok;
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+/* Base 200 us, exponential-ish queueing with mean ~300 us, 1% link stalls of 2-7 ms */
+static uint32_t true_latency(void)
+{
+    uint32_t lat = 200;
+    unsigned int r = rng() % 1000;
+
+    while (r > 0 && rng() % 4 != 0)
+    {
+        lat += 100;
+        r--;
+    }
+    if (rng() % 100 == 0)
+    {
+        lat += 2000 + rng() % 5000;
+    }
+    return lat;
+}
+
+static int run_latency(long frames, int drift_ppm)
+{
+    lcp_latency *lat = malloc(sizeof(lcp_latency));
+    uint32_t *truth = malloc(LCP_LATENCY_SAMPLES * sizeof(uint32_t));
+    lcp_latency_summary s;
+    uint64_t host_us = 5000000000ULL;
+    uint64_t dev_base = 0xFFFFFFFFULL - 2000000;    /* Device clock wraps 2 s in */
+    uint32_t t, min_true, p50, p90, p99, max;
+    long i, n;
+    int ok;
+
+    rng_state = 0x12345678;
+    lcp_latency_init(lat);
+    for (i = 0; i < frames; i++)
+    {
+        /* Frame leaves the device every ~500 us on the device clock, arrives after its latency */
+        uint64_t send_host = host_us + i * 500;
+        uint32_t dev_us = (uint32_t)(dev_base + (send_host - host_us) + (send_host - host_us) * drift_ppm / 1000000);
+
+        t = true_latency();
+        lcp_latency_add(lat, dev_us, send_host + t);
+        truth[i % LCP_LATENCY_SAMPLES] = t;
+    }
+
+    n = frames < LCP_LATENCY_SAMPLES ? frames : LCP_LATENCY_SAMPLES;
+    qsort(truth, n, sizeof(uint32_t), cmp_u32);
+    min_true = truth[0];
+    p50 = truth[n * 50 / 100] - min_true;
+    p90 = truth[n * 90 / 100] - min_true;
+    p99 = truth[n * 99 / 100] - min_true;
+    max = truth[n - 1] - min_true;
+    lcp_latency_get(lat, &s);
+
+    /* Drift over one window skews the estimate by at most window length * drift */
+    ok = labs((long)s.p50_us - (long)p50) <= 50 && labs((long)s.p99_us - (long)p99) <= 100;
+    printf("drift %3d ppm : est p50/p90/p99/max %u/%u/%u/%u us, true %u/%u/%u/%u us %s\n", drift_ppm,
+           (unsigned int)s.p50_us, (unsigned int)s.p90_us, (unsigned int)s.p99_us, (unsigned int)s.max_us,
+           (unsigned int)p50, (unsigned int)p90, (unsigned int)p99, (unsigned int)max, ok ? "ok" : "MISMATCH");
+
+    free(lat);
+    free(truth);
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    long frames = (argc > 1) ? atol(argv[1]) : 200000;
+    int failures = 0;
+    size_t i;
+
+    printf("frames=%ld\n", frames);
+    printf("%-10s %19s %13s %13s %13s %7s\n", "case", "received got/exp", "lost", "reordered", "dups", "resets");
+    for (i = 0; i < sizeof(seq_cases) / sizeof(seq_cases[0]); i++)
+    {
+        failures += !run_seq_case(&seq_cases[i], frames);
+    }
+
+    failures += !run_latency(frames, 0);
+    failures += !run_latency(frames, 20);
+    failures += !run_latency(frames, -40);
+
+    return failures != 0;
+}
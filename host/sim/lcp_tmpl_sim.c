@@ -0,0 +1,357 @@
+/*
+ * Injection templates : link bytes per injected frame, whole frames vs. template
+ * patches (HW_LCP_TYPE_TMPL_TX) against device caches of several sizes.
+ *
+ * The host injects a mix made from a few dozen templates, picked with Zipf
+ * popularity : probe requests with a random source address (80..140 bytes),
+ * QoS null frames toggling power save (26 bytes) and action frames to changing
+ * peers with a new dialog token (40..60 bytes). Every frame gets a new sequence
+ * number unless vary_seq is 0; the device sends with en_sys_seq, so a real host
+ * would leave it alone. lcp_tmpl_tx encodes each frame, the messages go through
+ * LCP framing and the two-phase link transfer to the device, which runs the
+ * real lcp_tmpl store; every frame it builds is checked against the intended
+ * one. The last row runs a device cache smaller than the host believes, to
+ * exercise HW_CMD_TMPL_MISS recovery (the missed frame is lost).
+ *
+ * usage : lcp_tmpl_sim [frames] [templates] [vary_seq] [seed]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "hw_link_ctrl_protocol.h"
+#include "hw_link_xfer.h"
+#include "lcp_tmpl.h"
+#include "lcp_tmpl_tx.h"
+
+#define MAX_TEMPLATES       (LCP_TMPL_TX_IDS)
+#define SEQ_CTRL            (22)
+
+#define KIND_PROBE          (0)
+#define KIND_NULL           (1)
+#define KIND_ACTION         (2)
+
+typedef struct sim_tmpl
+{
+    int kind;
+    int len;
+    u8 frame[HW_LCP_MAX_PAYLOAD_LEN];
+} sim_tmpl;
+
+typedef struct sim_config
+{
+    const char *name;
+    int use_tmpl;
+    int dev_arena;
+    int host_arena;
+} sim_config;
+
+typedef struct sim_result
+{
+    unsigned long frames;
+    unsigned long lcp_bytes;
+    unsigned long inline_frames;
+    unsigned long link_frames;
+    unsigned long bus_bytes;
+    unsigned long lost;             /* Dropped on a device miss */
+    unsigned long errors;
+    lcp_tmpl_tx_stats tx;
+    lcp_tmpl_stats dev;
+} sim_result;
+
+static sim_tmpl templates[MAX_TEMPLATES];
+static double zipf_cdf[MAX_TEMPLATES];
+static int template_count;
+static unsigned int rng_state = 0x12345678;
+
+static unsigned int rng(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static void rand_bytes(u8 *p, int n)
+{
+    while (n-- > 0)
+    {
+        *p++ = (u8)rng();
+    }
+}
+
+static void make_templates(int count)
+{
+    static const u8 bcast[6] = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff };
+    sim_tmpl *t;
+    double sum = 0;
+    int i, k;
+
+    template_count = count;
+    for (i = 0; i < count; i++)
+    {
+        t = &templates[i];
+        memset(t, 0x0, sizeof(sim_tmpl));
+        t->kind = i % 3;
+        switch (t->kind)
+        {
+            case KIND_PROBE:
+                /* Probe request, wildcard BSSID, SSID + rates + vendor IEs */
+                t->len = 80 + rng() % 61;
+                t->frame[0] = 0x40;
+                memcpy(&t->frame[4], bcast, 6);
+                rand_bytes(&t->frame[10], 6);
+                memcpy(&t->frame[16], bcast, 6);
+                rand_bytes(&t->frame[24], t->len - 24);
+                break;
+
+            case KIND_NULL:
+                /* QoS null to the AP */
+                t->len = 26;
+                t->frame[0] = 0xc8;
+                t->frame[1] = 0x01;
+                rand_bytes(&t->frame[4], 18);
+                memcpy(&t->frame[16], &t->frame[4], 6);
+                break;
+
+            default:
+                /* Action frame : category, action, dialog token, body */
+                t->len = 40 + rng() % 21;
+                t->frame[0] = 0xd0;
+                rand_bytes(&t->frame[4], 18);
+                rand_bytes(&t->frame[24], t->len - 24);
+                break;
+        }
+    }
+
+    for (k = 0; k < count; k++)
+    {
+        sum += 1.0 / (k + 1);
+        zipf_cdf[k] = sum;
+    }
+    for (k = 0; k < count; k++)
+    {
+        zipf_cdf[k] /= sum;
+    }
+}
+
+static int pick_template(void)
+{
+    double u = (rng() & 0xffffff) / (double)0x1000000;
+    int i;
+
+    for (i = 0; i < template_count - 1; i++)
+    {
+        if (u < zipf_cdf[i])
+        {
+            break;
+        }
+    }
+    return i;
+}
+
+/* The frame actually injected : the template with its per-frame fields */
+static int make_frame(int id, uint16_t seq, int vary_seq, u8 *out)
+{
+    const sim_tmpl *t = &templates[id];
+
+    memcpy(out, t->frame, t->len);
+    switch (t->kind)
+    {
+        case KIND_PROBE:
+            rand_bytes(&out[10], 6);
+            out[10] = (out[10] & 0xfc) | 0x02;          /* Locally administered unicast */
+            break;
+
+        case KIND_NULL:
+            if (rng() & 1)
+            {
+                out[1] |= 0x10;
+            }
+            break;
+
+        default:
+            rand_bytes(&out[4], 6);
+            out[4] &= 0xfe;
+            out[26] = (u8)rng();
+            break;
+    }
+    if (vary_seq)
+    {
+        out[SEQ_CTRL]     = (u8)((seq << 4) & 0xf0);
+        out[SEQ_CTRL + 1] = (u8)(seq >> 4);
+    }
+    return t->len;
+}
+
+/* One message over the link, host -> device. Returns the LCP frame the device got */
+static u8 *link_send(sim_result *r, hw_link_xfer *host, hw_link_xfer *dev, const lcp_tmpl_msg *msg)
+{
+    static u8 host_frame[HW_LCP_MAX_PAYLOAD_LEN + HW_LCP_OVERHEAD];
+    static u8 dev_rx[HW_LCP_MAX_PAYLOAD_LEN + HW_LCP_OVERHEAD];
+    u8 host_hdr[HW_LINK_HDR_LEN], dev_hdr[HW_LINK_HDR_LEN];
+    const u8 *inl;
+    int len, inl_len, data_len;
+
+    memcpy(&host_frame[PAYLOAD_FIELD], msg->payload, msg->len);
+    len = hw_frame_encap(host_frame, msg->len, msg->type);
+    r->lcp_bytes += len;
+    r->link_frames++;
+
+    hw_link_xfer_header_build(host, host_hdr, host_frame, len);
+    hw_link_xfer_header_build(dev, dev_hdr, NULL, 0);
+    hw_link_xfer_header_done(host, dev_hdr, NULL, NULL);
+    data_len = hw_link_xfer_header_done(dev, host_hdr, &inl, &inl_len);
+    if (inl_len > 0)
+    {
+        memcpy(dev_rx, inl, inl_len);
+        r->inline_frames++;
+        return dev_rx;
+    }
+    if (data_len > 0)
+    {
+        memcpy(dev_rx, host_frame, host->tx_len);
+        hw_link_xfer_data_done(host);
+        hw_link_xfer_data_done(dev);
+        return dev_rx;
+    }
+    return NULL;
+}
+
+/* Device side of one LCP frame : 0 if it produced want, 1 on a miss, -1 on a mismatch */
+static int device_rx(lcp_tmpl_store *store, u8 *lcp, const u8 *want, int want_len)
+{
+    static u8 built[HW_LCP_MAX_PAYLOAD_LEN];
+    int len = lcp ? is_valid_hw_frame(lcp) : -1;
+
+    if (len <= 0)
+    {
+        return -1;
+    }
+    switch (hw_frame_type(lcp))
+    {
+        case HW_LCP_TYPE_CMD:
+            if (lcp[PAYLOAD_FIELD] != HW_CMD_TMPL_PUT || len < 2)
+            {
+                return -1;
+            }
+            return (lcp_tmpl_put(store, lcp[PAYLOAD_FIELD + 1], &lcp[PAYLOAD_FIELD + 2], len - 2) == LCP_TMPL_OK) ? 0 : -1;
+
+        case HW_LCP_TYPE_TMPL_TX:
+            len = lcp_tmpl_build(store, &lcp[PAYLOAD_FIELD], len, built, sizeof(built));
+            if (len == LCP_TMPL_MISS)
+            {
+                return 1;
+            }
+            return (len == want_len && memcmp(built, want, len) == 0) ? 0 : -1;
+
+        case HW_LCP_TYPE_80211:
+            return (len == want_len && memcmp(&lcp[PAYLOAD_FIELD], want, len) == 0) ? 0 : -1;
+
+        default:
+            return -1;
+    }
+}
+
+static void sim_run(const sim_config *cfg, unsigned long frames, int vary_seq, unsigned int seed, sim_result *r)
+{
+    lcp_tmpl_msg msgs[LCP_TMPL_TX_MSGS];
+    hw_link_xfer host, dev;
+    lcp_tmpl_store store;
+    lcp_tmpl_tx tx;
+    u8 *arena = malloc(cfg->dev_arena > 0 ? cfg->dev_arena : 1);
+    u8 frame[HW_LCP_MAX_PAYLOAD_LEN];
+    unsigned long i;
+    int id, len, n, m, rc;
+
+    memset(r, 0x0, sizeof(sim_result));
+    rng_state = seed;
+    hw_link_xfer_init(&host);
+    hw_link_xfer_init(&dev);
+    lcp_tmpl_init(&store, arena, cfg->dev_arena);
+    lcp_tmpl_tx_init(&tx, cfg->host_arena > 0 ? cfg->host_arena : 1);
+    for (id = 0; id < template_count; id++)
+    {
+        lcp_tmpl_tx_define(&tx, (u8)id, templates[id].frame, templates[id].len);
+    }
+
+    for (i = 0; i < frames; i++)
+    {
+        id = pick_template();
+        len = make_frame(id, (uint16_t)i, vary_seq, frame);
+        n = lcp_tmpl_tx_encode(&tx, cfg->use_tmpl ? id : -1, frame, len, msgs);
+        r->frames++;
+
+        for (m = 0; m < n; m++)
+        {
+            rc = device_rx(&store, link_send(r, &host, &dev, &msgs[m]), frame, len);
+            if (rc == 1)
+            {
+                /* HW_CMD_TMPL_MISS back to the host */
+                lcp_tmpl_tx_miss(&tx, (u8)id);
+                r->lost++;
+            }
+            else if (rc < 0)
+            {
+                r->errors++;
+            }
+        }
+    }
+
+    r->bus_bytes = host.bus_bytes;
+    r->tx = tx.stats;
+    r->dev = store.stats;
+    lcp_tmpl_tx_deinit(&tx);
+    free(arena);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long frames = (argc > 1) ? strtoul(argv[1], NULL, 0) : 200000;
+    int count = (argc > 2) ? atoi(argv[2]) : 24;
+    int vary_seq = (argc > 3) ? atoi(argv[3]) : 1;
+    unsigned int seed = (argc > 4) ? (unsigned int)strtoul(argv[4], NULL, 0) : 0x12345678;
+    static const sim_config configs[] =
+    {
+        { "raw",            0, 4096, 4096 },
+        { "tmpl 512",       1,  512,  512 },
+        { "tmpl 1K",        1, 1024, 1024 },
+        { "tmpl 2K",        1, 2048, 2048 },
+        { "tmpl 4K",        1, 4096, 4096 },
+        { "tmpl 1K/host 4K", 1, 1024, 4096 },
+    };
+    unsigned long total_errors = 0;
+    double base_bus = 0, bus;
+    sim_result r;
+    size_t c;
+
+    if (count < 1 || count > MAX_TEMPLATES)
+    {
+        printf("templates : 1..%d\n", MAX_TEMPLATES);
+        return 1;
+    }
+    rng_state = seed;
+    make_templates(count);
+
+    printf("frames=%lu templates=%d vary_seq=%d\n\n", frames, count, vary_seq);
+    printf("%-16s %9s %9s %7s %7s %7s %8s %9s %6s %6s\n",
+           "config", "lcp B/f", "bus B/f", "bus x", "inline", "hit", "uploads", "evictions", "lost", "errors");
+    for (c = 0; c < sizeof(configs) / sizeof(configs[0]); c++)
+    {
+        sim_run(&configs[c], frames, vary_seq, seed, &r);
+        bus = (double)r.bus_bytes / r.frames;
+        if (c == 0)
+        {
+            base_bus = bus;
+        }
+        printf("%-16s %9.1f %9.1f %6.2fx %6.1f%% %6.1f%% %8lu %9u %6lu %6lu\n", configs[c].name,
+               (double)r.lcp_bytes / r.frames, bus, base_bus / bus,
+               100.0 * r.inline_frames / r.link_frames,
+               100.0 * r.dev.hits / (r.frames ? r.frames : 1),
+               r.tx.uploads, r.dev.evictions, r.lost, r.errors);
+        total_errors += r.errors;
+    }
+
+    return total_errors ? 1 : 0;
+}
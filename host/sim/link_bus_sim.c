@@ -0,0 +1,226 @@
+/*
+ * Bus time simulation : fixed 512 byte SPI transactions vs. the two-phase
+ * header/data scheme (hw_link_xfer) for a few representative traffic mixes.
+ *
+ * Both ends of the link run the shared state machine, frames are carried
+ * through the real LCP codec and checked on arrival.
+ *
+ * usage : link_bus_sim [exchanges] [spi_hz] [txn_gap_us]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hw_link_ctrl_protocol.h"
+#include "hw_link_xfer.h"
+#include "ring_buff.h"
+
+#define FIXED_XFER_LEN      (MAX_BUFFER_SIZE)
+#define MAX_SIM_PAYLOAD     (MAX_BUFFER_SIZE - HW_LCP_OVERHEAD)
+
+typedef struct size_bucket
+{
+    int weight;
+    int min_len;
+    int max_len;
+} size_bucket;
+
+typedef struct traffic_mix
+{
+    const char *name;
+    int dev_pct;                /* % of exchanges where the device has a frame */
+    int host_pct;               /* % of exchanges where the host has a frame */
+    size_bucket dev_sizes[4];
+    size_bucket host_sizes[4];
+} traffic_mix;
+
+static const traffic_mix mixes[] =
+{
+    { "idle-poll",     2,  0, { { 1, 100, 300 } },                                    { { 1, 0, 0 } } },
+    { "mgmt-sniff",   60,  5, { { 3, 60, 120 }, { 5, 120, 300 }, { 2, 300, 400 } },   { { 1, 40, 80 } } },
+    { "data-imix",    90, 30, { { 7, 40, 64 }, { 4, 300, 400 }, { 1, 450, MAX_SIM_PAYLOAD } }, { { 7, 40, 64 }, { 4, 300, 400 } } },
+    { "ctrl-small",   80, 40, { { 1, 10, 19 } },                                       { { 1, 2, 2 } } },
+    { "bulk-full",   100, 10, { { 1, MAX_SIM_PAYLOAD, MAX_SIM_PAYLOAD } },             { { 1, 40, 80 } } },
+};
+
+typedef struct sim_result
+{
+    unsigned long frames;
+    unsigned long payload_bytes;
+    unsigned long fixed_bytes;
+    unsigned long fixed_txns;
+    unsigned long var_bytes;
+    unsigned long var_txns;
+    unsigned long errors;
+} sim_result;
+
+static unsigned int rng_state = 0x12345678;
+
+static unsigned int rng(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static int pick_len(const size_bucket *buckets)
+{
+    int total = 0, i, r;
+
+    for (i = 0; i < 4 && buckets[i].weight; i++)
+    {
+        total += buckets[i].weight;
+    }
+    r = rng() % total;
+    for (i = 0; r >= buckets[i].weight; i++)
+    {
+        r -= buckets[i].weight;
+    }
+    return buckets[i].min_len + rng() % (buckets[i].max_len - buckets[i].min_len + 1);
+}
+
+/* Assemble an LCP frame of payload len into out, returns frame length or 0 */
+static int make_frame(u8 *out, int len)
+{
+    static u8 payload[MAX_BUFFER_SIZE];
+    u8 *frame;
+    int i;
+
+    if (len <= 0)
+    {
+        return 0;
+    }
+    for (i = 0; i < len; i++)
+    {
+        payload[i] = (u8)rng();
+    }
+    frame = hw_frame_assemble(payload, &len);
+    memcpy(out, frame, len);
+    return len;
+}
+
+static void check_frame(sim_result *res, const u8 *expect, int expect_len, u8 *got)
+{
+    int len = is_valid_hw_frame(got);
+
+    if (len + HW_LCP_OVERHEAD - 1 != expect_len || memcmp(expect, got, expect_len) != 0)
+    {
+        res->errors++;
+        return;
+    }
+    res->frames++;
+    res->payload_bytes += len;
+}
+
+static void run_mix(const traffic_mix *mix, int exchanges, sim_result *res)
+{
+    static u8 dev_frame[HW_LINK_MAX_DATA_LEN], host_frame[HW_LINK_MAX_DATA_LEN];
+    static u8 dev_rx[HW_LINK_MAX_DATA_LEN], host_rx[HW_LINK_MAX_DATA_LEN];
+    u8 dev_hdr[HW_LINK_HDR_LEN], host_hdr[HW_LINK_HDR_LEN];
+    hw_link_xfer dev, host;
+    const u8 *inl;
+    int i, dev_len, host_len, dev_data, host_data, inl_len;
+
+    memset(res, 0x0, sizeof(sim_result));
+    hw_link_xfer_init(&dev);
+    hw_link_xfer_init(&host);
+
+    for (i = 0; i < exchanges; i++)
+    {
+        dev_len  = ((int)(rng() % 100) < mix->dev_pct) ? make_frame(dev_frame, pick_len(mix->dev_sizes)) : 0;
+        host_len = ((int)(rng() % 100) < mix->host_pct) ? make_frame(host_frame, pick_len(mix->host_sizes)) : 0;
+
+        /* Fixed scheme : one full size transaction per exchange */
+        res->fixed_txns++;
+        res->fixed_bytes += FIXED_XFER_LEN;
+
+        /* Two-phase scheme : header exchange ... */
+        hw_link_xfer_header_build(&dev, dev_hdr, dev_frame, dev_len);
+        hw_link_xfer_header_build(&host, host_hdr, host_frame, host_len);
+        res->var_txns++;
+
+        dev_data = hw_link_xfer_header_done(&dev, host_hdr, &inl, &inl_len);
+        if (inl_len > 0)
+        {
+            memcpy(dev_rx, inl, inl_len);
+            check_frame(res, host_frame, host_len, dev_rx);
+        }
+        host_data = hw_link_xfer_header_done(&host, dev_hdr, &inl, &inl_len);
+        if (inl_len > 0)
+        {
+            memcpy(host_rx, inl, inl_len);
+            check_frame(res, dev_frame, dev_len, host_rx);
+        }
+
+        if (dev_data != host_data || dev_data == HW_LINK_XFER_ERR)
+        {
+            res->errors++;
+            continue;
+        }
+
+        /* ... then a data transfer of exactly the negotiated length */
+        if (dev_data > 0)
+        {
+            res->var_txns++;
+            memset(dev_rx, 0x0, dev_data);
+            memset(host_rx, 0x0, host_data);
+            if (dev.tx_len > 0 && !dev.tx_inline)
+            {
+                memcpy(host_rx, dev_frame, dev.tx_len);
+            }
+            if (host.tx_len > 0 && !host.tx_inline)
+            {
+                memcpy(dev_rx, host_frame, host.tx_len);
+            }
+            hw_link_xfer_data_done(&dev);
+            hw_link_xfer_data_done(&host);
+
+            if (dev.peer_len > 0)
+            {
+                check_frame(res, host_frame, host_len, dev_rx);
+            }
+            if (host.peer_len > 0)
+            {
+                check_frame(res, dev_frame, dev_len, host_rx);
+            }
+        }
+    }
+    res->var_bytes = dev.bus_bytes;
+}
+
+static double bus_time_us(unsigned long bytes, unsigned long txns, double spi_hz, double gap_us)
+{
+    return (double)bytes * 8.0 * 1e6 / spi_hz + (double)txns * gap_us;
+}
+
+int main(int argc, char **argv)
+{
+    int exchanges = (argc > 1) ? atoi(argv[1]) : 100000;
+    double spi_hz = (argc > 2) ? atof(argv[2]) : 10e6;
+    double gap_us = (argc > 3) ? atof(argv[3]) : 20.0;
+    sim_result res;
+    size_t i;
+
+    printf("exchanges=%d spi_hz=%.0f txn_gap_us=%.1f\n\n", exchanges, spi_hz, gap_us);
+    printf("%-12s %10s %12s %12s %9s %9s %8s %6s\n",
+           "mix", "frames", "fixed_ms", "twophase_ms", "util_fix", "util_2ph", "speedup", "errors");
+
+    for (i = 0; i < sizeof(mixes) / sizeof(mixes[0]); i++)
+    {
+        double fixed_us, var_us, payload_us;
+
+        run_mix(&mixes[i], exchanges, &res);
+
+        fixed_us   = bus_time_us(res.fixed_bytes, res.fixed_txns, spi_hz, gap_us);
+        var_us     = bus_time_us(res.var_bytes, res.var_txns, spi_hz, gap_us);
+        payload_us = bus_time_us(res.payload_bytes, 0, spi_hz, 0);
+
+        printf("%-12s %10lu %12.1f %12.1f %8.1f%% %8.1f%% %7.2fx %6lu\n",
+               mixes[i].name, res.frames, fixed_us / 1000.0, var_us / 1000.0,
+               100.0 * payload_us / fixed_us, 100.0 * payload_us / var_us,
+               fixed_us / var_us, res.errors);
+    }
+
+    return 0;
+}
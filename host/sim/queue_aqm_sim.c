@@ -0,0 +1,168 @@
+/*
+ * Device to host queue delay : tail drop vs. CoDel vs. deadline on the real tx ring.
+ *
+ * Arrivals come in on/off bursts (sniffer traffic), the consumer is the link
+ * draining one frame per service time with occasional stalls (congested SPI
+ * host). The ring runs on a virtual clock; every delivered frame's sojourn
+ * time is recorded. Arrivals and stalls come from their own random streams,
+ * seeded the same for every policy and drawn on the clock only, so all
+ * policies see the same traffic and the same link.
+ *
+ * usage : queue_aqm_sim [seconds] [service_us] [target_ms]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hw_link_ctrl_protocol.h"
+#include "ring_buff.h"
+
+#define STEP_US             (50)
+#define HIST_BUCKET_US      (100)
+#define HIST_BUCKETS        (20000)     /* 2 s */
+#define ARRIVAL_SEED        (0x2545f491)
+#define LINK_SEED           (0x9e3779b9)
+
+typedef struct sim_config
+{
+    const char *name;
+    buffer_aqm_config aqm;
+} sim_config;
+
+typedef struct sim_result
+{
+    unsigned long arrived;
+    unsigned long delivered;
+    unsigned long fresh;                /* Delivered within the target */
+    unsigned long hist[HIST_BUCKETS];
+    buffer_stats stats;
+} sim_result;
+
+static uint32_t sim_now_us;
+
+static uint32_t sim_clock(void)
+{
+    return sim_now_us;
+}
+
+static unsigned int rng(unsigned int *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+/* Bernoulli per step approximates Poisson arrivals at rate_per_s */
+static int arrival(unsigned int *state, unsigned int rate_per_s)
+{
+    return (rng(state) % 1000000) < rate_per_s * STEP_US;
+}
+
+static double percentile(const sim_result *r, double p)
+{
+    unsigned long target = (unsigned long)(r->delivered * p), seen = 0;
+    int i;
+
+    for (i = 0; i < HIST_BUCKETS; i++)
+    {
+        seen += r->hist[i];
+        if (seen > target)
+        {
+            return i * HIST_BUCKET_US / 1000.0;
+        }
+    }
+    return HIST_BUCKETS * HIST_BUCKET_US / 1000.0;
+}
+
+static void run(const sim_config *config, int seconds, uint32_t service_us, uint32_t target_us, sim_result *r)
+{
+    static u8 frame[128];
+    uint32_t end = (uint32_t)seconds * 1000000;
+    uint32_t next_service = 0, next_slot = 0, stall_until = 0, burst_until = 0, idle_until = 0;
+    unsigned int arrival_rng = ARRIVAL_SEED, link_rng = LINK_SEED;
+    buffer *buf;
+    uint32_t sojourn;
+    int bucket;
+
+    memset(r, 0x0, sizeof(sim_result));
+    sim_now_us = 1;
+    buffer_init();
+    buffer_set_clock(sim_clock);
+    tx_buffer_set_aqm(&config->aqm);
+
+    for (; sim_now_us < end; sim_now_us += STEP_US)
+    {
+        /* On/off source : 50-300 ms bursts at 1.5x link capacity, 50-500 ms idle between */
+        if (sim_now_us >= burst_until && sim_now_us >= idle_until)
+        {
+            burst_until = sim_now_us + 50000 + rng(&arrival_rng) % 250000;
+            idle_until = burst_until + 50000 + rng(&arrival_rng) % 450000;
+        }
+        if (sim_now_us < burst_until && arrival(&arrival_rng, 1500000 / service_us))
+        {
+            r->arrived++;
+            tx_buffer_enqueue(frame, sizeof(frame), HW_LCP_TYPE_80211);
+        }
+
+        /* Link : 1% chance per service time of a 100-300 ms stall, whatever the queue holds */
+        if (sim_now_us >= next_slot)
+        {
+            next_slot += service_us;
+            if (sim_now_us >= stall_until && rng(&link_rng) % 100 == 0)
+            {
+                stall_until = sim_now_us + 100000 + rng(&link_rng) % 200000;
+            }
+        }
+
+        /* Consumer : one frame per service time outside stalls */
+        if (sim_now_us < next_service || sim_now_us < stall_until)
+        {
+            continue;
+        }
+        buf = tx_buffer_dequeue();
+        if (!buf)
+        {
+            continue;
+        }
+        sojourn = sim_now_us - buf->enqueue_us;
+        bucket = sojourn / HIST_BUCKET_US;
+        r->hist[bucket < HIST_BUCKETS ? bucket : HIST_BUCKETS - 1]++;
+        r->delivered++;
+        r->fresh += (sojourn <= target_us);
+        next_service = sim_now_us + service_us;
+    }
+
+    tx_buffer_get_stats(&r->stats);
+    buffer_set_clock(NULL);
+}
+
+int main(int argc, char **argv)
+{
+    int seconds = (argc > 1) ? atoi(argv[1]) : 60;
+    uint32_t service_us = (argc > 2) ? (uint32_t)atoi(argv[2]) : 2000;
+    uint32_t target_us = ((argc > 3) ? (uint32_t)atoi(argv[3]) : 20) * 1000;
+    const sim_config configs[] =
+    {
+        { "tail-drop", { BUFFER_AQM_NONE, 0, 0 } },
+        { "codel",     { BUFFER_AQM_CODEL, target_us, BUFFER_AQM_INTERVAL_US } },
+        { "deadline",  { BUFFER_AQM_DEADLINE, target_us, 0 } },
+    };
+    static sim_result r;
+    size_t i;
+
+    printf("seconds=%d service=%u us ring=%d target=%u ms\n", seconds, (unsigned int)service_us,
+           BUFFER_COUNT, (unsigned int)(target_us / 1000));
+    printf("%-10s %8s %9s %8s %8s %7s %7s %7s %7s %7s\n", "aqm", "arrived", "delivered", "taildrop",
+           "aged", "fresh%", "p50ms", "p90ms", "p99ms", "maxms");
+
+    for (i = 0; i < sizeof(configs) / sizeof(configs[0]); i++)
+    {
+        run(&configs[i], seconds, service_us, target_us, &r);
+        printf("%-10s %8lu %9lu %8u %8u %6.1f%% %7.1f %7.1f %7.1f %7.1f\n", configs[i].name, r.arrived,
+               r.delivered, (unsigned int)r.stats.tail_drops, (unsigned int)r.stats.aged_out,
+               100.0 * r.fresh / (r.delivered ? r.delivered : 1), percentile(&r, 0.50), percentile(&r, 0.90),
+               percentile(&r, 0.99), r.stats.max_sojourn_us / 1000.0);
+    }
+    return 0;
+}
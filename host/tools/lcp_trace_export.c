@@ -0,0 +1,80 @@
+/*
+ * Convert the device event trace to Chrome trace JSON (chrome://tracing, ui.perfetto.dev).
+ *
+ * Reads a raw LCP byte stream (UART capture, socket dump, "-" for stdin), keeps
+ * the HW_CMD_TRACE_DRAIN replies in it and writes them out as one trace.
+ *
+ * usage : lcp_trace_export <stream|-> [out.json]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "host_link.h"
+#include "lcp_trace.h"
+
+int main(int argc, char **argv)
+{
+    lcp_frame *batch[HOST_LINK_BATCH];
+    host_link *link;
+    lcp_trace trace;
+    FILE *out = stdout;
+    int fd, n, i, ret = 0;
+
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage : %s <stream|-> [out.json]\n", argv[0]);
+        return 1;
+    }
+
+    fd = strcmp(argv[1], "-") ? open(argv[1], O_RDONLY) : STDIN_FILENO;
+    if (fd < 0)
+    {
+        perror(argv[1]);
+        return 1;
+    }
+    if (argc > 2 && !(out = fopen(argv[2], "w")))
+    {
+        perror(argv[2]);
+        return 1;
+    }
+
+    link = host_link_create(NULL);
+    lcp_trace_init(&trace);
+    while (host_link_feed_fd(link, fd) != HOST_LINK_EOF)
+    {
+        while ((n = host_link_recv_batch(link, batch, HOST_LINK_BATCH)) > 0)
+        {
+            for (i = 0; i < n; i++)
+            {
+                if (batch[i]->type == HW_LCP_TYPE_CMD && batch[i]->len > 0 && batch[i]->data[0] == HW_CMD_TRACE_DRAIN &&
+                    lcp_trace_add_reply(&trace, batch[i]->data, batch[i]->len) == LCP_TRACE_ERR)
+                {
+                    fprintf(stderr, "malformed trace reply (%d bytes)\n", batch[i]->len);
+                }
+            }
+            host_link_release(link, batch, n);
+        }
+    }
+
+    if (lcp_trace_write_json(&trace, out) != LCP_TRACE_OK)
+    {
+        ret = 1;
+    }
+    fprintf(stderr, "%zu events from %lu replies, %u dropped on the device\n", trace.count, trace.replies,
+            (unsigned int)trace.dropped);
+
+    lcp_trace_free(&trace);
+    host_link_destroy(link);
+    if (out != stdout)
+    {
+        fclose(out);
+    }
+    if (fd != STDIN_FILENO)
+    {
+        close(fd);
+    }
+    return ret;
+}
@@ -5,273 +5,859 @@
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 
 #include "esp_netif.h"
 #include "esp_event.h"
 #include "esp_system.h"
+#include "esp_task.h"
 #include "esp_wifi.h"
+#include "esp_timer.h"
 #include "esp_log.h"
 #include "nvs_flash.h"
-#include "driver/spi_slave.h"
-#include "driver/gpio.h"
 
 #include "wifi_service.h"
 #include "hw_link_ctrl_protocol.h"
+#include "hw_link_engine.h"
+#include "hw_iface.h"
+#include "hw_transport.h"
+#include "ieee80211_conv.h"
+#include "lcp_seq.h"
+#include "lcp_ota.h"
+#include "lcp_tmpl.h"
+#include "lcp_sched.h"
 #include "ring_buff.h"
+#include "trace_buf.h"
 #include "utils.h"
 
-#if CONFIG_IDF_TARGET_ESP32 || CONFIG_IDF_TARGET_ESP32S2
-#define GPIO_HANDSHAKE 2
-#define GPIO_MOSI 12
-#define GPIO_MISO 13
-#define GPIO_SCLK 15
-#define GPIO_CS 14
-
-#elif CONFIG_IDF_TARGET_ESP32C3 || CONFIG_IDF_TARGET_ESP32C2
-#define GPIO_HANDSHAKE 3
-#define GPIO_MOSI 7
-#define GPIO_MISO 2
-#define GPIO_SCLK 6
-#define GPIO_CS 10
-
-#elif CONFIG_IDF_TARGET_ESP32C6
-#define GPIO_HANDSHAKE 15
-#define GPIO_MOSI 19
-#define GPIO_MISO 20
-#define GPIO_SCLK 18
-#define GPIO_CS 9
-
-#elif CONFIG_IDF_TARGET_ESP32H2
-#define GPIO_HANDSHAKE 2
-#define GPIO_MOSI 5
-#define GPIO_MISO 0
-#define GPIO_SCLK 4
-#define GPIO_CS 1
-
-#elif CONFIG_IDF_TARGET_ESP32S3
-#define GPIO_HANDSHAKE 2
-#define GPIO_MOSI 11
-#define GPIO_MISO 13
-#define GPIO_SCLK 12
-#define GPIO_CS 10
-
-#endif //CONFIG_IDF_TARGET_ESP32 || CONFIG_IDF_TARGET_ESP32S2
-
-#ifdef CONFIG_IDF_TARGET_ESP32
-#define RCV_HOST    HSPI_HOST
+#define WIFI_SSID                     "your_ssid"
+#define WIFI_PASSWORD                 "your_pw"
 
+#ifdef CONFIG_ESP_LCP_ETH_CONVERT
+static bool eth_convert_enabled = true;
 #else
-#define RCV_HOST    SPI2_HOST
+static bool eth_convert_enabled = false;
+#endif
 
+#ifdef CONFIG_ESP_LCP_CAPTURE_META
+static bool capture_meta_enabled = true;
+#else
+static bool capture_meta_enabled = false;
 #endif
 
-#define WIFI_SSID                     "your_ssid"
-#define WIFI_PASSWORD                 "your_pw"
+#ifdef CONFIG_ESP_LCP_LINK_BATCH
+static bool link_batch_enabled = true;
+#else
+static bool link_batch_enabled = false;
+#endif
+
+static hw_lcp_snap snap;                /* Bytes forwarded per 802.11 frame type */
+
+static hw_transport *link_transport;
+static hw_link_engine link_engine;
+static lcp_seq_rx host_seq;             /* Host -> device sequence accounting */
+static hw_iface_set ifaces;             /* Sniffed and injected frames, per interface */
+
+#define AIR_TX_BUDGET                 (BUFFER_COUNT)    /* Injected frames sent per link exchange */
+
+typedef struct eth_enqueue_ctx
+{
+    uint32_t capture_us;
+    int iface;
+} eth_enqueue_ctx;
+
+#if CONFIG_ESP_LCP_TMPL
+static u8 tmpl_arena[CONFIG_ESP_LCP_TMPL_ARENA];
+static lcp_tmpl_store tmpl_store;       /* Injection templates uploaded by the host */
+#endif
+
+#if CONFIG_ESP_LCP_SCHED
+#define SCHED_TASK_STACK              (3072)
+/*
+ * Above the link task (ESP_TASK_MAIN_PRIO) so a due frame does not wait out a link
+ * exchange, below the WiFi driver task (configMAX_PRIORITIES - 2) and the esp_timer
+ * task that wakes it (ESP_TASK_TIMER_PRIO). On the busy retry the WiFi task has to
+ * run to free its tx buffers; at its level the two would share time slices instead.
+ */
+#define SCHED_TASK_PRIORITY           (ESP_TASK_TIMER_PRIO - 1)
+#define SCHED_TX_BUDGET               (8)       /* Frames per wake up before the task yields */
+#define SCHED_BUSY_RETRY_US           (200)     /* WiFi tx buffers full */
+
+static lcp_sched sched;                 /* Frames the device sends on its own schedule */
+static lcp_sched_entry sched_entries[CONFIG_ESP_LCP_SCHED_ENTRIES];
+static int sched_heap[CONFIG_ESP_LCP_SCHED_ENTRIES];
+static u8 sched_frames[CONFIG_ESP_LCP_SCHED_ENTRIES][CONFIG_ESP_LCP_SCHED_FRAME_MAX];
+static SemaphoreHandle_t sched_lock;
+static TaskHandle_t sched_task;
+static esp_timer_handle_t sched_timer;
+#endif
+
+#if CONFIG_ESP_LCP_OTA
+#define OTA_TASK_STACK                (4096)
+#define OTA_TASK_PRIORITY             (tskIDLE_PRIORITY + 1)
+#define OTA_REBOOT_DELAY_MS           (500)
 
-/* Called after a transaction is queued and ready for pickup by master. We use this to set the handshake line high. */
-void my_post_setup_cb(spi_slave_transaction_t *trans)
+static lcp_ota ota;
+static TaskHandle_t ota_task;
+#endif
+
+/* Converted 802.3 frames (one per A-MSDU subframe) */
+static void eth_frame_enqueue(void *ctx, u8 *frame, int len)
 {
-    gpio_set_level(GPIO_HANDSHAKE, 1);
+    eth_enqueue_ctx *eth = (eth_enqueue_ctx *)ctx;
+
+    hw_iface_enqueue_tx(&ifaces, eth->iface, NULL, 0, frame, len, HW_LCP_TYPE_8023, eth->capture_us);
 }
 
-/* Called after transaction is sent/received. We use this to set the handshake line low. */
-void my_post_trans_cb(spi_slave_transaction_t *trans)
+/*
+ * Raw 802.11 frame to the host, its first snap_len bytes. The rx_ctrl metadata goes
+ * in front when capture metadata is on, and always for a snapped frame so the host
+ * still gets its length.
+ */
+static void wifi_frame_enqueue(wifi_promiscuous_pkt_t *pkt, int iface, int snap_len)
 {
-    gpio_set_level(GPIO_HANDSHAKE, 0);
+    u8 meta_buf[HW_LCP_META_LEN];
+    hw_lcp_rx_meta meta;
+    int orig_len = (int)pkt->rx_ctrl.sig_len;
+    int len = (snap_len < orig_len) ? snap_len : orig_len;
+
+    if (capture_meta_enabled || len < orig_len)
+    {
+        /* Truncated frames keep their on-air length in orig_len */
+        if (len > MAX_BUFFER_SIZE - HW_LCP_META_LEN)
+        {
+            len = MAX_BUFFER_SIZE - HW_LCP_META_LEN;
+        }
+
+        meta.timestamp = pkt->rx_ctrl.timestamp;
+        meta.rssi      = (int8_t)pkt->rx_ctrl.rssi;
+        meta.channel   = pkt->rx_ctrl.channel;
+        meta.rate      = pkt->rx_ctrl.rate;
+        meta.flags     = (len < orig_len) ? HW_LCP_META_FLAG_SNAPPED : 0;
+        meta.orig_len  = (uint16_t)orig_len;
+        hw_lcp_meta_encode(meta_buf, &meta);
+
+        hw_iface_enqueue_tx(&ifaces, iface, meta_buf, sizeof(meta_buf), pkt->payload, len, HW_LCP_TYPE_80211_META,
+                            pkt->rx_ctrl.timestamp);
+    }
+    else
+    {
+        hw_iface_enqueue_tx(&ifaces, iface, NULL, 0, pkt->payload, len, HW_LCP_TYPE_80211, pkt->rx_ctrl.timestamp);
+    }
 }
 
-void spi_init(void)
+/* Each frame goes to the interface whose role and receive filter accept it (hw_iface_classify) */
+void promiscuous_callback(void *buff, wifi_promiscuous_pkt_type_t type)
 {
-    esp_err_t ret;
+    static u8 eth_buf[MAX_BUFFER_SIZE];
+    wifi_promiscuous_pkt_t *pkt = (wifi_promiscuous_pkt_t *)buff;
+    uint8_t *pkt_ctrl = pkt->payload;
+    eth_enqueue_ctx eth;
+    int iface, snap_len;
 
-    TRACE_FUNC_ENTRY();
+    if (type != WIFI_PKT_MGMT && type != WIFI_PKT_DATA)
+    {
+        return;
+    }
 
-    /* Configuration for the SPI bus */
-    spi_bus_config_t buscfg =
+    TRACE_BEGIN(TRACE_ID_WIFI_RX, pkt->rx_ctrl.sig_len);
+    iface = hw_iface_classify(&ifaces, pkt_ctrl, (int)pkt->rx_ctrl.sig_len);
+    snap_len = hw_lcp_snap_len(&snap, pkt_ctrl, (int)pkt->rx_ctrl.sig_len);
+    if (iface == HW_IFACE_FILTERED)
     {
-        .mosi_io_num = GPIO_MOSI,
-        .miso_io_num = GPIO_MISO,
-        .sclk_io_num = GPIO_SCLK,
-        .quadwp_io_num = -1,
-        .quadhd_io_num = -1,
-    };
+        /* Not for any interface, counted in its filtered stat */
+    }
+    else if (type == WIFI_PKT_DATA && iface == HW_LCP_IFACE_STA && eth_convert_enabled &&
+             snap_len == (int)pkt->rx_ctrl.sig_len)
+    {
+        /* Frames that can not be converted (protected, null data, ...) still go out as 802.11 */
+        eth.capture_us = pkt->rx_ctrl.timestamp;
+        eth.iface = iface;
+        TRACE_BEGIN(TRACE_ID_ETH_CONVERT, pkt->rx_ctrl.sig_len);
+        if (ieee80211_data_to_8023(pkt_ctrl, (int)pkt->rx_ctrl.sig_len - IEEE80211_FCS_LEN,
+                                   eth_buf, sizeof(eth_buf), eth_frame_enqueue, &eth) < 0)
+        {
+            wifi_frame_enqueue(pkt, iface, snap_len);
+        }
+        TRACE_END(TRACE_ID_ETH_CONVERT, 0);
+    }
+    else
+    {
+        /* Snapped data frames stay 802.11 : conversion needs the whole frame */
+        wifi_frame_enqueue(pkt, iface, snap_len);
+    }
+    TRACE_END(TRACE_ID_WIFI_RX, 0);
+}
+
+static void hw_link_queue_aqm(u8 *cmd, int len)
+{
+    buffer_aqm_config config;
+    ring_buffer *ring;
 
-    /* Configuration for the SPI slave interface */
-    spi_slave_interface_config_t slvcfg =
+    if (len < 7 || (ring = hw_iface_queue(&ifaces, cmd[1])) == NULL)
     {
-        .mode=0,
-        .spics_io_num=GPIO_CS,
-        .queue_size=3,
-        .flags=0,
-        .post_setup_cb=my_post_setup_cb,
-        .post_trans_cb=my_post_trans_cb
-    };
+        return;
+    }
+    config.mode        = cmd[2];
+    config.target_us   = (uint32_t)(cmd[3] | (cmd[4] << 8)) * 1000;
+    config.interval_us = (uint32_t)(cmd[5] | (cmd[6] << 8)) * 1000;
+
+    buffer_set_aqm(ring, &config);
+    INFO_PRINT("queue [%u] aqm [%u] target [%u us]\n", cmd[1], config.mode, (unsigned int)config.target_us);
+}
+
+/* Reply goes back to the host through the tx ring as a command frame */
+static void hw_link_queue_stats(u8 *cmd, int len)
+{
+    u8 reply[HW_CMD_QUEUE_STATS_LEN];
+    buffer_stats stats;
+    ring_buffer *ring;
 
-    /* Configuration for the handshake line */
-    gpio_config_t io_conf =
+    if (len < 2 || (ring = hw_iface_queue(&ifaces, cmd[1])) == NULL)
     {
-        .intr_type = GPIO_INTR_DISABLE,
-        .mode = GPIO_MODE_OUTPUT,
-        .pin_bit_mask = (1 << GPIO_HANDSHAKE)
-    };
+        return;
+    }
+    buffer_get_stats(ring, &stats);
+
+    reply[0] = HW_CMD_GET_QUEUE_STATS;
+    reply[1] = cmd[1];
+    hw_lcp_put_le32(&reply[2], stats.enqueued);
+    hw_lcp_put_le32(&reply[6], stats.dequeued);
+    hw_lcp_put_le32(&reply[10], stats.tail_drops);
+    hw_lcp_put_le32(&reply[14], stats.aged_out);
+    hw_lcp_put_le32(&reply[18], stats.max_sojourn_us);
+
+    tx_buffer_critical_section_lock();
+    tx_buffer_enqueue(reply, sizeof(reply), HW_LCP_TYPE_CMD);
+    tx_buffer_critical_section_unlock();
+}
 
-    /* Configure handshake line as output */
-    gpio_config(&io_conf);
-    /* Enable pull-ups on SPI lines so we don't detect rogue pulses when no master is connected. */
-    gpio_set_pull_mode(GPIO_MOSI, GPIO_PULLUP_ONLY);
-    gpio_set_pull_mode(GPIO_SCLK, GPIO_PULLUP_ONLY);
-    gpio_set_pull_mode(GPIO_CS, GPIO_PULLUP_ONLY);
+static void hw_link_iface_filter(u8 *cmd, int len)
+{
+    if (len < 5)
+    {
+        return;
+    }
+    if (hw_iface_set_filter(&ifaces, cmd[1], cmd[2], (uint32_t)(cmd[3] | (cmd[4] << 8))) == HW_IFACE_OK)
+    {
+        INFO_PRINT("iface [%u] filter [0x%02x] quantum [%u]\n", cmd[1], cmd[2],
+                   (unsigned int)ifaces.ifaces[cmd[1]].quantum);
+    }
+}
 
-    /* Initialize SPI slave interface */
-    ret = spi_slave_initialize(RCV_HOST, &buscfg, &slvcfg, SPI_DMA_CH_AUTO);
-    assert(ret == ESP_OK);
+static void hw_link_iface_stats(u8 *cmd, int len)
+{
+    u8 reply[HW_CMD_IFACE_STATS_LEN];
+    hw_iface *iface;
 
-    TRACE_FUNC_EXIT();
+    if (len < 2 || (iface = hw_iface_get(&ifaces, cmd[1])) == NULL)
+    {
+        return;
+    }
+
+    reply[0] = HW_CMD_GET_IFACE_STATS;
+    reply[1] = cmd[1];
+    hw_lcp_put_le32(&reply[2], iface->stats.tx_frames);
+    hw_lcp_put_le32(&reply[6], iface->stats.tx_bytes);
+    hw_lcp_put_le32(&reply[10], iface->stats.tx_drops);
+    hw_lcp_put_le32(&reply[14], iface->stats.filtered);
+    hw_lcp_put_le32(&reply[18], iface->stats.rx_frames);
+    hw_lcp_put_le32(&reply[22], iface->stats.rx_bytes);
+    hw_lcp_put_le32(&reply[26], iface->stats.rx_drops);
+    hw_lcp_put_le32(&reply[30], iface->stats.rx_retries);
+
+    tx_buffer_critical_section_lock();
+    tx_buffer_enqueue(reply, sizeof(reply), HW_LCP_TYPE_CMD);
+    tx_buffer_critical_section_unlock();
 }
 
-void promiscuous_callback(void *buff, wifi_promiscuous_pkt_type_t type)
+static void hw_link_seq_stats(void)
 {
-    wifi_promiscuous_pkt_t *pkt = (wifi_promiscuous_pkt_t *)buff;
-    uint8_t *pkt_ctrl = pkt->payload;
+    u8 reply[HW_CMD_LINK_SEQ_LEN];
+
+    reply[0] = HW_CMD_GET_LINK_SEQ;
+    hw_lcp_put_le32(&reply[1], host_seq.stats.received);
+    hw_lcp_put_le32(&reply[5], host_seq.stats.lost);
+    hw_lcp_put_le32(&reply[9], host_seq.stats.reordered);
+    hw_lcp_put_le32(&reply[13], host_seq.stats.duplicates);
+    hw_lcp_put_le32(&reply[17], host_seq.stats.resets);
+
+    tx_buffer_critical_section_lock();
+    tx_buffer_enqueue(reply, sizeof(reply), HW_LCP_TYPE_CMD);
+    tx_buffer_critical_section_unlock();
+}
+
+#if CONFIG_ESP_TRACE
+static void hw_link_trace_drain(u8 *cmd, int len)
+{
+    static u8 reply[HW_LCP_MAX_PAYLOAD_LEN];
+    int reply_len;
 
-    if (type == WIFI_PKT_MGMT) /* MGMT Frame */
+    if (len >= 2 && cmd[1] == 1)
     {
-        if (pkt_ctrl[0] == 0x50 && pkt_ctrl[1] == 0x00)
-        {
-            uint8_t *da = &pkt_ctrl[4];
-            uint8_t *sa = &pkt_ctrl[10];
+        trace_buf_dump();
+        return;
+    }
 
-            if ((is_current_wifi_srv_mac(da)) || 
-                (is_broadcast_address(da)))
-            {
-                tx_buffer_critical_section_lock();
-                tx_buffer_enqueue((u8 *)pkt_ctrl, (int)pkt->rx_ctrl.sig_len);
-                tx_buffer_critical_section_unlock();
+    reply_len = trace_buf_drain(reply, HW_CMD_TRACE_DRAIN);
+    tx_buffer_critical_section_lock();
+    tx_buffer_enqueue(reply, reply_len, HW_LCP_TYPE_CMD);
+    tx_buffer_critical_section_unlock();
+}
+#endif
 
-                //INFO_PRINT("Received a probe response packet");
-            }
-        }
+#if CONFIG_ESP_LCP_OTA
+static void ota_notify(void *ctx)
+{
+    if (ota_task)
+    {
+        xTaskNotifyGive(ota_task);
     }
-    else if (type == WIFI_PKT_DATA) /* Data Frame */
+}
+
+/* Flash side of the update. Not above the link task : the link keeps exchanging while a sector is erased */
+static void ota_writer_task(void *arg)
+{
+    while (1)
     {
-        bool toDS = pkt_ctrl[1] & 0x01;
-        bool fromDS = pkt_ctrl[1] & 0x02;
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        while (lcp_ota_work(&ota))
+        {
+        }
 
-        if (toDS == false && fromDS == true)
+        if (ota.reboot && ota.state == LCP_OTA_DONE)
         {
-            uint8_t *da = &pkt_ctrl[4];
-            if (is_current_wifi_srv_mac(da) || is_broadcast_address(da))
-            {
-                tx_buffer_critical_section_lock();
-                tx_buffer_enqueue((u8 *)pkt_ctrl, (int)pkt->rx_ctrl.sig_len);
-                tx_buffer_critical_section_unlock();
-                
-                //printf("DATA Frame [%d]\n", (int)pkt->rx_ctrl.sig_len);
-            }
-            else if (is_multicast_address(da))
-            {
-                printf("muticast add\n");
-            }
+            INFO_PRINT("ota done, rebooting\n");
+            vTaskDelay(OTA_REBOOT_DELAY_MS / portTICK_PERIOD_MS);
+            esp_restart();
         }
     }
 }
 
-void app_main_loop(void)
+static void hw_link_ota_cmd(u8 *cmd, int len)
 {
-    esp_err_t ret;
-    spi_slave_transaction_t spi_trans;
-    struct buffer *tx_buff = NULL;
-    static WORD_ALIGNED_ATTR char recvbuf[MAX_BUFFER_SIZE]="";
-    static uint8_t sendbuf[MAX_BUFFER_SIZE] = {0};
-    int recvbuf_len = MAX_BUFFER_SIZE * 8, actual_send_buf_len;
-    u8 *actual_send_buf = NULL;
+    u8 reply[HW_CMD_OTA_REPLY_LEN];
+    int reply_len = lcp_ota_handle_cmd(&ota, cmd, len, reply);
 
-    TRACE_FUNC_ENTRY();
+    tx_buffer_critical_section_lock();
+    tx_buffer_enqueue(reply, reply_len, HW_LCP_TYPE_CMD);
+    tx_buffer_critical_section_unlock();
+}
+#endif
+
+#if CONFIG_ESP_LCP_TMPL
+static void hw_link_tmpl_stats(void)
+{
+    u8 reply[HW_CMD_TMPL_STATS_LEN];
+
+    reply[0] = HW_CMD_GET_TMPL_STATS;
+    hw_lcp_put_le32(&reply[1], tmpl_store.stats.puts);
+    hw_lcp_put_le32(&reply[5], tmpl_store.stats.hits);
+    hw_lcp_put_le32(&reply[9], tmpl_store.stats.misses);
+    hw_lcp_put_le32(&reply[13], tmpl_store.stats.evictions);
+    hw_lcp_put_le32(&reply[17], tmpl_store.stats.invalid);
+
+    tx_buffer_critical_section_lock();
+    tx_buffer_enqueue(reply, sizeof(reply), HW_LCP_TYPE_CMD);
+    tx_buffer_critical_section_unlock();
+}
+
+/* Template frame to the interface's queue; a miss is reported so the host uploads it again */
+static void hw_link_tmpl_tx(u8 iface, u8 *payload, int len)
+{
+    static u8 frame[HW_LCP_MAX_PAYLOAD_LEN];
+    u8 reply[2];
+    int frame_len = lcp_tmpl_build(&tmpl_store, payload, len, frame, sizeof(frame));
+
+    if (frame_len > 24)
+    {
+        hw_iface_enqueue_rx(&ifaces, iface, frame, frame_len, HW_LCP_TYPE_80211);
+    }
+    else if (frame_len == LCP_TMPL_MISS)
+    {
+        reply[0] = HW_CMD_TMPL_MISS;
+        reply[1] = payload[0];
+        tx_buffer_critical_section_lock();
+        tx_buffer_enqueue(reply, sizeof(reply), HW_LCP_TYPE_CMD);
+        tx_buffer_critical_section_unlock();
+    }
+}
+#endif
+
+#if CONFIG_ESP_LCP_SCHED
+static uint64_t sched_now(void *ctx)
+{
+    return (uint64_t)esp_timer_get_time();
+}
 
-    memset(&spi_trans, 0x0, sizeof(spi_slave_transaction_t));
+static int sched_air_tx(void *ctx, const lcp_sched_entry *entry)
+{
+    esp_err_t err;
 
-    spi_trans.tx_buffer = NULL;
-    spi_trans.length    = recvbuf_len;
+    TRACE_BEGIN(TRACE_ID_WIFI_TX, entry->len);
+    err = esp_wifi_80211_tx(entry->iface == HW_LCP_IFACE_AP ? WIFI_IF_AP : WIFI_IF_STA, entry->frame, entry->len, true);
+    TRACE_END(TRACE_ID_WIFI_TX, err);
+
+    if (err == ESP_ERR_NO_MEM)
+    {
+        return LCP_SCHED_TX_BUSY;
+    }
+    return (err == ESP_OK) ? LCP_SCHED_TX_SENT : LCP_SCHED_TX_ERR;
+}
+
+static const lcp_sched_ops sched_ops =
+{
+    .now = sched_now,
+    .tx  = sched_air_tx,
+};
+
+static void sched_timer_expired(void *arg)
+{
+    xTaskNotifyGive(sched_task);
+}
+
+/* Woken by the one-shot timer at the earliest target, or by a schedule change */
+static void sched_tx_task(void *arg)
+{
+    uint64_t next, now;
+    int sent, pending;
 
     while (1)
     {
-        memset(recvbuf, 0x0, MAX_BUFFER_SIZE);
-        spi_trans.rx_buffer = recvbuf;
-        ret = spi_slave_transmit(RCV_HOST, &spi_trans, 500);
-        if (ret == ESP_OK)
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        xSemaphoreTake(sched_lock, portMAX_DELAY);
+        sent = lcp_sched_run(&sched, SCHED_TX_BUDGET);
+        pending = lcp_sched_next(&sched, &next);
+        xSemaphoreGive(sched_lock);
+
+        esp_timer_stop(sched_timer);
+        if (sent == SCHED_TX_BUDGET)
+        {
+            xTaskNotifyGive(sched_task);    /* More may be due, after the others had a turn */
+        }
+        else if (pending)
         {
-            u8 *p_recvbuf = (u8 *)recvbuf;
-            int recv_len = is_valid_hw_frame(p_recvbuf);
+            /* Next target; one already due means the air was busy */
+            now = (uint64_t)esp_timer_get_time();
+            esp_timer_start_once(sched_timer, (next > now) ? next - now : SCHED_BUSY_RETRY_US);
+        }
+    }
+}
 
-            if (recv_len > 24)
+static void sched_start(void)
+{
+    esp_timer_create_args_t timer_args =
+    {
+        .callback = sched_timer_expired,
+        .name     = "lcp_sched",
+    };
+
+    lcp_sched_init(&sched, sched_entries, sched_heap, CONFIG_ESP_LCP_SCHED_ENTRIES, &sched_ops, NULL);
+    sched_lock = xSemaphoreCreateMutex();
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &sched_timer));
+    xTaskCreate(sched_tx_task, "lcp_sched", SCHED_TASK_STACK, NULL, SCHED_TASK_PRIORITY, &sched_task);
+}
+
+static void hw_link_sched_add(u8 *cmd, int len)
+{
+    u8 reply[HW_CMD_SCHED_ADD_REPLY_LEN];
+    uint64_t now = (uint64_t)esp_timer_get_time();
+    lcp_sched_entry *entry;
+    lcp_sched_req req;
+    uint32_t first;
+    int status = LCP_SCHED_INVALID;
+
+    memset(&req, 0x0, sizeof(req));
+    if (len >= HW_CMD_SCHED_ADD_HDR_LEN)
+    {
+        req.id = (uint16_t)(cmd[HW_CMD_SCHED_ADD_ID] | (cmd[HW_CMD_SCHED_ADD_ID + 1] << 8));
+        req.len = len - HW_CMD_SCHED_ADD_HDR_LEN;
+    }
+    if (req.len > 24 && req.len <= CONFIG_ESP_LCP_SCHED_FRAME_MAX && cmd[HW_CMD_SCHED_ADD_IFACE] < HW_IFACE_MAX)
+    {
+        req.iface       = cmd[HW_CMD_SCHED_ADD_IFACE];
+        req.period_us   = hw_lcp_get_le32(&cmd[HW_CMD_SCHED_ADD_PERIOD]);
+        req.max_late_us = hw_lcp_get_le32(&cmd[HW_CMD_SCHED_ADD_MAX_LATE]);
+        req.count       = (uint16_t)(cmd[HW_CMD_SCHED_ADD_COUNT] | (cmd[HW_CMD_SCHED_ADD_COUNT + 1] << 8));
+
+        /* Absolute times are the low 32 bits of the device clock, the host knows them from the ext trailer */
+        first = hw_lcp_get_le32(&cmd[HW_CMD_SCHED_ADD_FIRST]);
+        req.first_us = (cmd[HW_CMD_SCHED_ADD_FLAGS] & HW_SCHED_FLAG_ABS) ?
+                       now + (int64_t)(int32_t)(first - (uint32_t)now) : now + first;
+
+        xSemaphoreTake(sched_lock, portMAX_DELAY);
+        entry = lcp_sched_add(&sched, &req);
+        if (entry)
+        {
+            memcpy(sched_frames[entry - sched_entries], &cmd[HW_CMD_SCHED_ADD_FRAME], req.len);
+            entry->frame = sched_frames[entry - sched_entries];
+        }
+        xSemaphoreGive(sched_lock);
+        xTaskNotifyGive(sched_task);
+        status = entry ? LCP_SCHED_OK : LCP_SCHED_FULL;
+    }
+
+    reply[0] = HW_CMD_SCHED_ADD;
+    reply[1] = (u8)(req.id & 0xFF);
+    reply[2] = (u8)(req.id >> 8);
+    reply[3] = (u8)status;
+    hw_lcp_put_le32(&reply[4], (uint32_t)now);
+
+    tx_buffer_critical_section_lock();
+    tx_buffer_enqueue(reply, sizeof(reply), HW_LCP_TYPE_CMD);
+    tx_buffer_critical_section_unlock();
+}
+
+static void hw_link_sched_del(u8 *cmd, int len)
+{
+    if (len < 3)
+    {
+        return;
+    }
+    xSemaphoreTake(sched_lock, portMAX_DELAY);
+    lcp_sched_remove(&sched, (uint16_t)(cmd[1] | (cmd[2] << 8)));
+    xSemaphoreGive(sched_lock);
+    xTaskNotifyGive(sched_task);
+}
+
+static void hw_link_sched_stats(u8 *cmd, int len)
+{
+    u8 reply[HW_CMD_SCHED_STATS_LEN];
+    lcp_sched_entry_stats entry_stats;
+    lcp_sched_entry *entry;
+    lcp_sched_stats stats;
+    int reply_len, i;
+
+    memset(&entry_stats, 0x0, sizeof(entry_stats));
+    memset(&stats, 0x0, sizeof(stats));
+    reply[0] = HW_CMD_GET_SCHED_STATS;
+    xSemaphoreTake(sched_lock, portMAX_DELAY);
+    if (len >= 3)
+    {
+        reply[1] = cmd[1];
+        reply[2] = cmd[2];
+        entry = lcp_sched_find(&sched, (uint16_t)(cmd[1] | (cmd[2] << 8)));
+        reply_len = entry ? HW_CMD_SCHED_ENTRY_STATS_LEN : 3;
+        if (entry)
+        {
+            entry_stats = entry->stats;
+        }
+    }
+    else
+    {
+        stats = sched.stats;
+        reply_len = HW_CMD_SCHED_STATS_LEN;
+    }
+    xSemaphoreGive(sched_lock);
+
+    if (reply_len == HW_CMD_SCHED_ENTRY_STATS_LEN)
+    {
+        hw_lcp_put_le32(&reply[3], entry_stats.sent);
+        hw_lcp_put_le32(&reply[7], entry_stats.overruns);
+        hw_lcp_put_le32(&reply[11], entry_stats.expired);
+        hw_lcp_put_le32(&reply[15], entry_stats.late_max_us);
+        hw_lcp_put_le32(&reply[19], entry_stats.sent ? (uint32_t)(entry_stats.late_sum_us / entry_stats.sent) : 0);
+    }
+    else if (reply_len == HW_CMD_SCHED_STATS_LEN)
+    {
+        hw_lcp_put_le32(&reply[1], stats.sent);
+        hw_lcp_put_le32(&reply[5], stats.overruns);
+        hw_lcp_put_le32(&reply[9], stats.expired);
+        hw_lcp_put_le32(&reply[13], stats.busy);
+        hw_lcp_put_le32(&reply[17], stats.errors);
+        hw_lcp_put_le32(&reply[21], stats.late_max_us);
+        hw_lcp_put_le32(&reply[25], stats.sent ? (uint32_t)(stats.late_sum_us / stats.sent) : 0);
+        for (i = 0; i < LCP_SCHED_HIST_BUCKETS; i++)
+        {
+            hw_lcp_put_le32(&reply[29 + 4 * i], stats.hist[i]);
+        }
+    }
+
+    tx_buffer_critical_section_lock();
+    tx_buffer_enqueue(reply, reply_len, HW_LCP_TYPE_CMD);
+    tx_buffer_critical_section_unlock();
+}
+#endif
+
+static void hw_link_cmd(u8 *cmd, int len)
+{
+    TRACE_INSTANT(TRACE_ID_LINK_CMD, cmd[0]);
+    switch (cmd[0])
+    {
+        case HW_CMD_SET_ETH_CONVERT:
+            if (len >= 2)
             {
-                esp_wifi_80211_tx(WIFI_IF_STA, &p_recvbuf[PAYLOAD_FIELD], recv_len, true);
+                eth_convert_enabled = (cmd[1] != 0);
+                INFO_PRINT("802.3 conversion [%d]\n", (int)eth_convert_enabled);
             }
-            else if (recv_len == 2)
+            break;
+
+        case HW_CMD_SET_CAPTURE_META:
+            if (len >= 2)
             {
-                // H/W command
+                capture_meta_enabled = (cmd[1] != 0);
+                INFO_PRINT("capture metadata [%d]\n", (int)capture_meta_enabled);
             }
-            else
+            break;
+
+        case HW_CMD_SET_QUEUE_AQM:
+            hw_link_queue_aqm(cmd, len);
+            break;
+
+        case HW_CMD_GET_QUEUE_STATS:
+            hw_link_queue_stats(cmd, len);
+            break;
+
+        case HW_CMD_SET_LINK_SEQ:
+            if (len >= 2)
             {
-                //failed
+                hw_link_engine_set_seq(&link_engine, cmd[1]);
+                INFO_PRINT("link sequence [%u]\n", cmd[1]);
             }
-        }
-        else
-        {
-            switch (ret)
+            break;
+
+        case HW_CMD_GET_LINK_SEQ:
+            hw_link_seq_stats();
+            break;
+
+        case HW_CMD_SET_SNAPLEN:
+            if (len >= 4)
             {
-                case ESP_ERR_INVALID_ARG:
-                    ERROR_PRINT("Invalid argument passed to spi_slave_transmit");
-                    break;
+                hw_lcp_snap_set(&snap, cmd[1], (uint16_t)(cmd[2] | (cmd[3] << 8)));
+                INFO_PRINT("snaplen [%u %u %u %u]\n", snap.len[0], snap.len[1], snap.len[2], snap.len[3]);
+            }
+            break;
 
-                case ESP_ERR_TIMEOUT:
-                    ERROR_PRINT("SPI transmit timed out");
-                    break;
+        case HW_CMD_SET_LINK_BATCH:
+            if (len >= 2)
+            {
+                link_batch_enabled = (cmd[1] != 0);
+                INFO_PRINT("link batch [%d]\n", (int)link_batch_enabled);
+            }
+            break;
 
-                case ESP_ERR_NO_MEM:
-                    ERROR_PRINT("Memory allocation failed for spi_slave_transmit");
-                    break;
+        case HW_CMD_SET_IFACE_FILTER:
+            hw_link_iface_filter(cmd, len);
+            break;
 
-                default:
-                    ERROR_PRINT("SPI transmit failed with error: %d", ret);
-                    break;
+        case HW_CMD_GET_IFACE_STATS:
+            hw_link_iface_stats(cmd, len);
+            break;
+
+#if CONFIG_ESP_LCP_TMPL
+        case HW_CMD_TMPL_PUT:
+            if (len >= 2)
+            {
+                lcp_tmpl_put(&tmpl_store, cmd[1], &cmd[2], len - 2);
             }
-        }
+            break;
 
-        tx_buffer_critical_section_lock();
-        tx_buff = tx_buffer_dequeue();
-        if (tx_buff == BUFFER_EMPTY)
-        {
-            actual_send_buf_len = 0;
-            sendbuf[0] = '\0';
-        }
-        else
-        {
-            actual_send_buf_len = tx_buff->len;
-            memcpy(sendbuf, tx_buff->buf, tx_buff->len);
-        }
-        tx_buffer_critical_section_unlock();
+        case HW_CMD_GET_TMPL_STATS:
+            hw_link_tmpl_stats();
+            break;
+#endif
+
+#if CONFIG_ESP_LCP_SCHED
+        case HW_CMD_SCHED_ADD:
+            hw_link_sched_add(cmd, len);
+            break;
+
+        case HW_CMD_SCHED_DEL:
+            hw_link_sched_del(cmd, len);
+            break;
+
+        case HW_CMD_GET_SCHED_STATS:
+            hw_link_sched_stats(cmd, len);
+            break;
+#endif
+
+#if CONFIG_ESP_TRACE
+        case HW_CMD_TRACE_DRAIN:
+            hw_link_trace_drain(cmd, len);
+            break;
+#endif
+
+#if CONFIG_ESP_LCP_OTA
+        case HW_CMD_OTA_BEGIN:
+        case HW_CMD_OTA_DATA:
+        case HW_CMD_OTA_END:
+        case HW_CMD_OTA_ABORT:
+            hw_link_ota_cmd(cmd, len);
+            break;
+#endif
+
+        default:
+            ERROR_PRINT("Unknown H/W command [%u]\n", cmd[0]);
+            break;
+    }
+}
+
+/* Air side of the host -> device queues, called by hw_iface_air_drain */
+static int wifi_air_tx(void *ctx, u8 iface, u8 type, const u8 *frame, int len)
+{
+    static u8 wifi_buf[MAX_BUFFER_SIZE + IEEE80211_HDR_LEN + IEEE80211_SNAP_LEN];
+    esp_err_t err;
 
-        actual_send_buf = hw_frame_assemble(sendbuf, &actual_send_buf_len);
-        if (actual_send_buf == NULL)
+    if (type == HW_LCP_TYPE_8023)
+    {
+        len = ieee8023_to_80211_data(frame, len, get_wifi_srv_bssid(), wifi_buf, sizeof(wifi_buf));
+        if (len <= 0)
         {
-            spi_trans.tx_buffer = NULL;
+            return HW_IFACE_AIR_ERR;
         }
-        else
+        frame = wifi_buf;
+    }
+
+    TRACE_BEGIN(TRACE_ID_WIFI_TX, len);
+    err = esp_wifi_80211_tx(iface == HW_LCP_IFACE_AP ? WIFI_IF_AP : WIFI_IF_STA, frame, len, true);
+    TRACE_END(TRACE_ID_WIFI_TX, err);
+
+    if (err == ESP_ERR_NO_MEM)
+    {
+        return HW_IFACE_AIR_BUSY;   /* WiFi tx buffers full, keep the frame */
+    }
+    return (err == ESP_OK) ? HW_IFACE_AIR_SENT : HW_IFACE_AIR_ERR;
+}
+
+/* Frames to send go to the queue of the interface in their header, hw_iface_air_drain sends them */
+static void hw_link_rx_frame(void *ctx, u8 *frame)
+{
+    int recv_len = is_valid_hw_frame(frame);
+    u8 iface = hw_frame_iface(frame);
+    hw_lcp_ext ext;
+
+    if (recv_len <= 0)
+    {
+        //failed
+        return;
+    }
+
+    if (hw_frame_get_ext(frame, &ext))
+    {
+        lcp_seq_rx_update(&host_seq, ext.seq);
+    }
+
+    TRACE_BEGIN(TRACE_ID_LINK_RX, (hw_frame_type(frame) << 16) | recv_len);
+    switch (hw_frame_type(frame))
+    {
+        case HW_LCP_TYPE_80211:
+            if (recv_len > 24)
+            {
+                hw_iface_enqueue_rx(&ifaces, iface, &frame[PAYLOAD_FIELD], recv_len, HW_LCP_TYPE_80211);
+            }
+            break;
+
+        case HW_LCP_TYPE_8023:
+            /* Converted to ToDS data for the station's BSS, means nothing on the AP */
+            if (iface == HW_LCP_IFACE_STA)
+            {
+                hw_iface_enqueue_rx(&ifaces, iface, &frame[PAYLOAD_FIELD], recv_len, HW_LCP_TYPE_8023);
+            }
+            break;
+
+        case HW_LCP_TYPE_CMD:
+            hw_link_cmd(&frame[PAYLOAD_FIELD], recv_len);
+            break;
+
+#if CONFIG_ESP_LCP_TMPL
+        case HW_LCP_TYPE_TMPL_TX:
+            hw_link_tmpl_tx(iface, &frame[PAYLOAD_FIELD], recv_len);
+            break;
+#endif
+
+        default:
+            break;
+    }
+    TRACE_END(TRACE_ID_LINK_RX, 0);
+}
+
+/*
+ * Engine TX source, copied straight into the LCP frame : command replies in the
+ * tx ring first, then the interfaces' sniffed frames in round robin.
+ */
+static int hw_link_get_tx_frame(void *ctx, u8 *buf, hw_link_tx_desc *desc)
+{
+    struct buffer *tx_buff = NULL;
+    hw_iface_frame frame;
+    int len = 0;
+
+    tx_buffer_critical_section_lock();
+    tx_buff = tx_buffer_dequeue();
+    if (tx_buff != BUFFER_EMPTY)
+    {
+        len = tx_buff->len;
+        frame.iface = HW_LCP_IFACE_STA;
+        frame.type = tx_buff->type;
+        frame.enqueue_us = tx_buff->enqueue_us;
+        frame.capture_us = tx_buff->capture_us;
+        memcpy(buf, tx_buff->buf, tx_buff->len);
+    }
+    tx_buffer_critical_section_unlock();
+
+    if (len == 0)
+    {
+        len = link_batch_enabled ? hw_iface_dequeue_batch(&ifaces, buf, HW_LCP_MAX_PAYLOAD_LEN, &frame) :
+                                   hw_iface_dequeue_tx(&ifaces, buf, HW_LCP_MAX_PAYLOAD_LEN, &frame);
+    }
+    if (len > 0)
+    {
+        desc->type = frame.type;
+        desc->iface = frame.iface;
+        desc->enqueue_us = frame.enqueue_us;
+        desc->capture_us = frame.capture_us;
+        desc->send_us = buffer_now_us();
+        desc->ts_flags = HW_LCP_EXT_ENQUEUE_VALID | HW_LCP_EXT_SEND_VALID |
+                         (frame.capture_us ? HW_LCP_EXT_CAPTURE_VALID : 0);
+    }
+    TRACE_INSTANT(TRACE_ID_LINK_TX_FETCH, len);
+
+    return len;
+}
+
+static hw_transport *link_transport_get(void)
+{
+#if CONFIG_ESP_LINK_TRANSPORT_UART
+    return hw_transport_uart_get();
+#else
+    return hw_transport_spi_get();
+#endif
+}
+
+void app_main_loop(void)
+{
+    TRACE_FUNC_ENTRY();
+
+    hw_link_engine_init(&link_engine, link_transport, hw_link_get_tx_frame, hw_link_rx_frame, NULL);
+    lcp_seq_rx_init(&host_seq);
+#ifdef CONFIG_ESP_LCP_SEQ
+    hw_link_engine_set_seq(&link_engine, 1);
+#endif
+
+    while (1)
+    {
+        if (hw_link_engine_poll(&link_engine, 500) == HW_LINK_ENGINE_OK)
         {
-            spi_trans.tx_buffer = actual_send_buf;
+            vTaskDelay(1 / portTICK_PERIOD_MS);
         }
-        spi_trans.length = recvbuf_len;
-
-        vTaskDelay(1 / portTICK_PERIOD_MS);
+        hw_iface_air_drain(&ifaces, AIR_TX_BUDGET, wifi_air_tx, NULL);
     }
     TRACE_FUNC_EXIT();
 }
 
 void app_main(void)
 {
+    buffer_aqm_config aqm;
     esp_err_t ret;
 
+#if CONFIG_ESP_DEFERRED_LOG
+    log_ring_init();
+    log_ring_task_start();
+#endif
+#if CONFIG_ESP_TRACE
+    trace_buf_init();
+#endif
+
     TRACE_FUNC_ENTRY();
 
     ret = nvs_flash_init();
@@ -284,17 +870,49 @@ void app_main(void)
 
     buffer_init();
 
+    /* The tx ring only carries command replies now, those are never aged out */
+    aqm.mode = BUFFER_AQM_NONE;
+    aqm.target_us = BUFFER_AQM_TARGET_US;
+    aqm.interval_us = BUFFER_AQM_INTERVAL_US;
+    tx_buffer_set_aqm(&aqm);
+    buffer_tx_aqm_config(&aqm);
+    hw_iface_init(&ifaces, HW_IFACE_MAX, &aqm);
+    hw_lcp_snap_set(&snap, HW_LCP_SNAP_ALL, CONFIG_ESP_LCP_SNAPLEN);
+#if CONFIG_ESP_LCP_TMPL
+    lcp_tmpl_init(&tmpl_store, tmpl_arena, sizeof(tmpl_arena));
+#endif
+
+#if CONFIG_ESP_LCP_SCHED
+    sched_start();
+#endif
+
+#if CONFIG_ESP_LCP_OTA
+    lcp_ota_init(&ota, lcp_ota_flash_esp_get(), LCP_OTA_BUFS, ota_notify, NULL);
+    xTaskCreate(ota_writer_task, "lcp_ota", OTA_TASK_STACK, NULL, OTA_TASK_PRIORITY, &ota_task);
+#endif
+
     while (wifi_srv_station_start((uint8_t *)WIFI_SSID, NULL) == false)
     {
         /* Todo */
     }
+    hw_iface_set_mac(&ifaces, HW_LCP_IFACE_STA, get_wifi_srv_mac_address());
+#if CONFIG_ESP_LCP_SOFTAP
+    hw_iface_set_mac(&ifaces, HW_LCP_IFACE_AP, get_wifi_srv_ap_mac_address());
+#endif
 
     wifi_srv_pk_sniffer_start(promiscuous_callback);
-    spi_init();
+
+    link_transport = link_transport_get();
+    if (hw_transport_open(link_transport) != HW_TRANSPORT_OK)
+    {
+        ERROR_PRINT("link transport open failed\n");
+        return;
+    }
 
     /* app main loop */
     app_main_loop();
     
+    hw_transport_close(link_transport);
     wifi_srv_pk_sniffer_stop();
     esp_wifi_disconnect();
     buffer_deinit();
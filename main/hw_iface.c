@@ -0,0 +1,424 @@
+#include "hw_iface.h"
+#include "wifi_mac.h"
+
+#define FC0_TYPE_MASK               (0x0C)
+#define FC0_TYPE_MGMT               (0x00)
+#define FC0_TYPE_DATA               (0x08)
+#define FC0_PROBE_RESP              (0x50)
+#define FC1_DS_MASK                 (0x03)
+#define FC1_TO_DS                   (0x01)
+#define FC1_FROM_DS                 (0x02)
+#define HDR_ADDR1                   (4)
+#define HDR_MIN_LEN                 (24)
+
+void hw_iface_init(hw_iface_set *set, int count, const buffer_aqm_config *tx_aqm)
+{
+    hw_iface *iface;
+    int i;
+
+    memset(set, 0x0, sizeof(hw_iface_set));
+    set->count = (count >= 1 && count <= HW_IFACE_MAX) ? count : HW_IFACE_MAX;
+    set->tx_drr.fresh = 1;
+    set->rx_drr.fresh = 1;
+
+    for (i = 0; i < set->count; i++)
+    {
+        iface = &set->ifaces[i];
+        iface->id      = (u8)i;
+        iface->enabled = 1;
+        iface->filter  = HW_IFACE_FILTER_DEFAULT;
+        iface->quantum = HW_IFACE_QUANTUM_MIN;
+        ring_buffer_init(&iface->tx, tx_aqm);
+        ring_buffer_init(&iface->rx, NULL);
+    }
+}
+
+hw_iface *hw_iface_get(hw_iface_set *set, int id)
+{
+    return (id >= 0 && id < set->count) ? &set->ifaces[id] : NULL;
+}
+
+void hw_iface_set_mac(hw_iface_set *set, int id, const u8 *mac)
+{
+    hw_iface *iface = hw_iface_get(set, id);
+
+    if (iface)
+    {
+        memcpy(iface->mac, mac, sizeof(iface->mac));
+    }
+}
+
+/* quantum 0 keeps the current one */
+int hw_iface_set_filter(hw_iface_set *set, int id, u8 filter, uint32_t quantum)
+{
+    hw_iface *iface = hw_iface_get(set, id);
+
+    if (!iface)
+    {
+        return HW_IFACE_INVALID;
+    }
+    iface->filter = filter;
+    if (quantum != 0)
+    {
+        iface->quantum = (quantum < HW_IFACE_QUANTUM_MIN) ? HW_IFACE_QUANTUM_MIN :
+                         (quantum > HW_IFACE_QUANTUM_MAX) ? HW_IFACE_QUANTUM_MAX : quantum;
+    }
+    return HW_IFACE_OK;
+}
+
+/* Ring behind a hw_link_ctl_protocol_queue id, NULL for anything else. HW_QUEUE_TX / RX are the station's */
+ring_buffer *hw_iface_queue(hw_iface_set *set, u8 queue)
+{
+    hw_iface *iface;
+
+    if (queue == HW_QUEUE_TX || queue == HW_QUEUE_RX)
+    {
+        queue = (queue == HW_QUEUE_TX ? HW_QUEUE_IFACE_TX : HW_QUEUE_IFACE_RX) + HW_LCP_IFACE_STA;
+    }
+    iface = hw_iface_get(set, queue & 0x0F);
+
+    if (!iface)
+    {
+        return NULL;
+    }
+    switch (queue & 0xF0)
+    {
+        case HW_QUEUE_IFACE_TX:
+            return &iface->tx;
+
+        case HW_QUEUE_IFACE_RX:
+            return &iface->rx;
+
+        default:
+            return NULL;
+    }
+}
+
+static int hw_iface_accepts(const hw_iface *iface, const u8 *addr1)
+{
+    if (iface->filter & HW_IFACE_FILTER_ALL)
+    {
+        return 1;
+    }
+    if (is_broadcast_address(addr1))
+    {
+        return (iface->filter & HW_IFACE_FILTER_BROADCAST) != 0;
+    }
+    if (is_multicast_address(addr1))
+    {
+        return (iface->filter & HW_IFACE_FILTER_MULTICAST) != 0;
+    }
+    return (iface->filter & HW_IFACE_FILTER_UNICAST) && memcmp(addr1, iface->mac, sizeof(iface->mac)) == 0;
+}
+
+/*
+ * Frames each role looks at : the station takes FromDS data and probe responses
+ * (as before interfaces existed), the AP takes ToDS data and management frames.
+ */
+static int hw_iface_direction(const hw_iface *iface, const u8 *frame)
+{
+    u8 type = frame[0] & FC0_TYPE_MASK;
+    u8 ds = frame[1] & FC1_DS_MASK;
+
+    if (iface->id == HW_LCP_IFACE_STA)
+    {
+        return (type == FC0_TYPE_DATA && ds == FC1_FROM_DS) ||
+               (frame[0] == FC0_PROBE_RESP && frame[1] == 0x00);
+    }
+    return (type == FC0_TYPE_DATA && ds == FC1_TO_DS) || type == FC0_TYPE_MGMT;
+}
+
+/* Interface a sniffed 802.11 frame belongs to, or HW_IFACE_FILTERED */
+int hw_iface_classify(hw_iface_set *set, const u8 *frame, int len)
+{
+    hw_iface *iface;
+    int i;
+
+    if (len < HDR_MIN_LEN)
+    {
+        return HW_IFACE_FILTERED;
+    }
+    for (i = 0; i < set->count; i++)
+    {
+        iface = &set->ifaces[i];
+        if (!iface->enabled || !hw_iface_direction(iface, frame))
+        {
+            continue;
+        }
+        if (hw_iface_accepts(iface, &frame[HDR_ADDR1]))
+        {
+            return i;
+        }
+        iface->stats.filtered++;
+    }
+    return HW_IFACE_FILTERED;
+}
+
+/*
+ * Next interface to serve : each visit to a backlogged interface adds its
+ * quantum, it sends while its deficit covers the head frame. The caller
+ * charges what it actually took. Interfaces in skip are passed over.
+ */
+static int hw_iface_drr_pick(hw_iface_set *set, hw_iface_drr *drr, int (*head_len)(hw_iface *), unsigned int skip)
+{
+    hw_iface *iface;
+    int tries, len;
+
+    for (tries = 0; tries < 2 * set->count; tries++)
+    {
+        iface = &set->ifaces[drr->next];
+        len = (skip & (1u << drr->next)) ? 0 : head_len(iface);
+        if (len > 0)
+        {
+            if (drr->fresh)
+            {
+                drr->deficit[drr->next] += iface->quantum;
+                drr->fresh = 0;
+            }
+            if (len <= drr->deficit[drr->next])
+            {
+                return drr->next;
+            }
+        }
+        else
+        {
+            drr->deficit[drr->next] = 0;    /* No credit saved up while idle */
+        }
+        drr->next = (drr->next + 1) % set->count;
+        drr->fresh = 1;
+    }
+    return -1;
+}
+
+static int hw_iface_tx_head_len(hw_iface *iface)
+{
+    buffer *head;
+    int len;
+
+    LOCK(&iface->tx.lock);
+    head = buffer_peek(&iface->tx);
+    len = head ? head->len : 0;
+    UNLOCK(&iface->tx.lock);
+    return len;
+}
+
+static int hw_iface_rx_head_len(hw_iface *iface)
+{
+    buffer *head;
+    int len;
+
+    if (iface->has_held)
+    {
+        return iface->held.len;
+    }
+    LOCK(&iface->rx.lock);
+    head = buffer_peek(&iface->rx);
+    len = head ? head->len : 0;
+    UNLOCK(&iface->rx.lock);
+    return len;
+}
+
+/* Producer side (sniffer) : hdr (may be NULL) + buf into the interface's device -> host ring */
+int hw_iface_enqueue_tx(hw_iface_set *set, int id, const u8 *hdr, int hdr_len, u8 *buf, int len, u8 type,
+                        uint32_t capture_us)
+{
+    hw_iface *iface = hw_iface_get(set, id);
+    int ret;
+
+    if (!iface || !iface->enabled)
+    {
+        return HW_IFACE_INVALID;
+    }
+
+    LOCK(&iface->tx.lock);
+    ret = buffer_enqueue_hdr(&iface->tx, hdr, hdr_len, buf, len, type, capture_us);
+    UNLOCK(&iface->tx.lock);
+
+    if (ret == BUFFER_FULL)
+    {
+        iface->stats.tx_drops++;
+        return HW_IFACE_FULL;
+    }
+    return (ret == BUFFER_ENQUEUE_SUCESS) ? HW_IFACE_OK : HW_IFACE_INVALID;
+}
+
+/*
+ * Link side : next device -> host frame copied into out. Returns its length, 0 if
+ * all rings are empty or the frame due next is longer than max (it stays queued).
+ */
+int hw_iface_dequeue_tx(hw_iface_set *set, u8 *out, int max, hw_iface_frame *info)
+{
+    hw_iface *iface;
+    buffer *buf;
+    int attempt, id, len;
+
+    /* A pick can come back empty when the ring's AQM drops everything that is left */
+    for (attempt = 0; attempt <= set->count; attempt++)
+    {
+        id = hw_iface_drr_pick(set, &set->tx_drr, hw_iface_tx_head_len, 0);
+        if (id < 0)
+        {
+            return 0;
+        }
+        iface = &set->ifaces[id];
+        len = 0;
+
+        LOCK(&iface->tx.lock);
+        buf = buffer_dequeue(&iface->tx);
+        if (buf && buf->len > max)
+        {
+            buffer_unget(&iface->tx);
+            UNLOCK(&iface->tx.lock);
+            return 0;
+        }
+        if (buf)
+        {
+            len = buf->len;
+            memcpy(out, buf->buf, len);
+            info->iface      = iface->id;
+            info->type       = buf->type;
+            info->enqueue_us = buf->enqueue_us;
+            info->capture_us = buf->capture_us;
+        }
+        UNLOCK(&iface->tx.lock);
+
+        if (len > 0)
+        {
+            set->tx_drr.deficit[id] -= len;
+            iface->stats.tx_frames++;
+            iface->stats.tx_bytes += len;
+            return len;
+        }
+    }
+    return 0;
+}
+
+/*
+ * As hw_iface_dequeue_tx, then more frames packed behind the first one as
+ * HW_LCP_TYPE_BATCH records while they fit in max. info describes the first
+ * frame, with the type changed to HW_LCP_TYPE_BATCH. A lone frame goes as is.
+ */
+int hw_iface_dequeue_batch(hw_iface_set *set, u8 *out, int max, hw_iface_frame *info)
+{
+    hw_iface_frame next;
+    int first, used, len;
+
+    first = hw_iface_dequeue_tx(set, out, max, info);
+    used = first + 2 * HW_LCP_BATCH_HDR_LEN;
+    if (first <= 0 || used >= max)
+    {
+        return first;
+    }
+
+    /* Second frame right after the room for both record headers */
+    len = hw_iface_dequeue_tx(set, &out[used], max - used, &next);
+    if (len <= 0)
+    {
+        return first;
+    }
+    memmove(&out[HW_LCP_BATCH_HDR_LEN], out, first);
+    hw_lcp_batch_put_hdr(out, info->type, info->iface, first);
+    hw_lcp_batch_put_hdr(&out[used - HW_LCP_BATCH_HDR_LEN], next.type, next.iface, len);
+    used += len;
+
+    while (used + HW_LCP_BATCH_HDR_LEN < max)
+    {
+        len = hw_iface_dequeue_tx(set, &out[used + HW_LCP_BATCH_HDR_LEN], max - used - HW_LCP_BATCH_HDR_LEN, &next);
+        if (len <= 0)
+        {
+            break;
+        }
+        hw_lcp_batch_put_hdr(&out[used], next.type, next.iface, len);
+        used += HW_LCP_BATCH_HDR_LEN + len;
+    }
+
+    info->type = HW_LCP_TYPE_BATCH;
+    return used;
+}
+
+/* Link side : a host -> device frame for the interface's air queue */
+int hw_iface_enqueue_rx(hw_iface_set *set, int id, u8 *frame, int len, u8 type)
+{
+    hw_iface *iface = hw_iface_get(set, id);
+    int ret;
+
+    if (!iface || !iface->enabled)
+    {
+        return HW_IFACE_INVALID;
+    }
+
+    LOCK(&iface->rx.lock);
+    ret = buffer_enqueue_hdr(&iface->rx, NULL, 0, frame, len, type, 0);
+    UNLOCK(&iface->rx.lock);
+
+    if (ret != BUFFER_ENQUEUE_SUCESS)
+    {
+        iface->stats.rx_drops++;
+        return (ret == BUFFER_FULL) ? HW_IFACE_FULL : HW_IFACE_INVALID;
+    }
+    return HW_IFACE_OK;
+}
+
+/*
+ * Send up to budget host -> device frames through air_tx. A frame the air is
+ * too busy for stays held on its interface, which is skipped for the rest of
+ * this call; the other interfaces go on. Returns the frames sent.
+ */
+int hw_iface_air_drain(hw_iface_set *set, int budget, hw_iface_air_tx_fn air_tx, void *ctx)
+{
+    unsigned int busy = 0;
+    hw_iface *iface;
+    buffer *buf;
+    int sent = 0;
+    int id, ret;
+
+    while (sent < budget)
+    {
+        id = hw_iface_drr_pick(set, &set->rx_drr, hw_iface_rx_head_len, busy);
+        if (id < 0)
+        {
+            break;
+        }
+        iface = &set->ifaces[id];
+
+        if (!iface->has_held)
+        {
+            LOCK(&iface->rx.lock);
+            buf = buffer_dequeue(&iface->rx);
+            if (buf)
+            {
+                memcpy(iface->held.buf, buf->buf, buf->len);
+                iface->held.len  = buf->len;
+                iface->held.type = buf->type;
+                iface->has_held  = 1;
+            }
+            UNLOCK(&iface->rx.lock);
+            if (!iface->has_held)
+            {
+                continue;
+            }
+        }
+
+        ret = air_tx(ctx, iface->id, iface->held.type, iface->held.buf, iface->held.len);
+        if (ret == HW_IFACE_AIR_BUSY)
+        {
+            iface->stats.rx_retries++;
+            busy |= 1u << id;
+            continue;
+        }
+
+        set->rx_drr.deficit[id] -= iface->held.len;
+        iface->has_held = 0;
+        if (ret == HW_IFACE_AIR_SENT)
+        {
+            iface->stats.rx_frames++;
+            iface->stats.rx_bytes += iface->held.len;
+            sent++;
+        }
+        else
+        {
+            iface->stats.rx_drops++;
+        }
+    }
+    return sent;
+}
@@ -0,0 +1,116 @@
+#ifndef _HW_IFACE_H
+#define _HW_IFACE_H
+
+#include "utils.h"
+#include "hw_link_ctrl_protocol.h"
+#include "ring_buff.h"
+
+/*
+ * Logical WiFi interfaces sharing the link (station, SoftAP).
+ *
+ * Each interface has its own device -> host ring (sniffed frames it accepts)
+ * and host -> device ring (frames to send on air), its own receive filter and
+ * counters. Both directions are served deficit round robin over the
+ * interfaces, so a busy interface can not hold the other one back: a full
+ * ring only drops its own frames, and a frame the air refuses is kept aside
+ * while the other interface keeps sending. The interface of a frame travels
+ * in the LCP header (hw_frame_iface).
+ */
+
+#if defined(CONFIG_IDF_TARGET_ESP32) && !CONFIG_ESP_LCP_SOFTAP
+#define HW_IFACE_MAX                (1)     /* Station only, no rings for the AP */
+#else
+#define HW_IFACE_MAX                (HW_LCP_IFACE_MAX)
+#endif
+
+/* Receive filter on Addr1 */
+#define HW_IFACE_FILTER_UNICAST     (0x01)  /* The interface's own address */
+#define HW_IFACE_FILTER_BROADCAST   (0x02)
+#define HW_IFACE_FILTER_MULTICAST   (0x04)
+#define HW_IFACE_FILTER_ALL         (0x08)  /* Any address */
+#define HW_IFACE_FILTER_DEFAULT     (HW_IFACE_FILTER_UNICAST | HW_IFACE_FILTER_BROADCAST)
+
+/* DRR bytes per round; at least one full frame so every visit can send */
+#define HW_IFACE_QUANTUM_MIN        (MAX_BUFFER_SIZE)
+#define HW_IFACE_QUANTUM_MAX        (16 * MAX_BUFFER_SIZE)
+
+#define HW_IFACE_OK                 (0)
+#define HW_IFACE_FULL               (-1)
+#define HW_IFACE_FILTERED           (-2)
+#define HW_IFACE_INVALID            (-3)
+
+/* Result of a hw_iface_air_tx_fn */
+#define HW_IFACE_AIR_SENT           (0)
+#define HW_IFACE_AIR_BUSY           (1)     /* Try the same frame again later */
+#define HW_IFACE_AIR_ERR            (-1)    /* Frame dropped */
+
+typedef struct hw_iface_stats
+{
+    uint32_t tx_frames;         /* Device -> host, handed to the link */
+    uint32_t tx_bytes;
+    uint32_t tx_drops;          /* Device -> host ring full */
+    uint32_t filtered;          /* Right direction, address not accepted */
+    uint32_t rx_frames;         /* Host -> device, sent on air */
+    uint32_t rx_bytes;
+    uint32_t rx_drops;          /* Host -> device ring full or air error */
+    uint32_t rx_retries;        /* Air busy, frame kept */
+} hw_iface_stats;
+
+typedef struct hw_iface
+{
+    u8 id;                      /* hw_lcp_iface, also its role */
+    u8 enabled;
+    u8 filter;
+    u8 mac[6];
+    uint32_t quantum;
+
+    ring_buffer tx;             /* Device -> host */
+    ring_buffer rx;             /* Host -> device */
+    buffer held;                /* Host -> device frame the air refused, goes first */
+    u8 has_held;
+
+    hw_iface_stats stats;
+} hw_iface;
+
+/* Round robin position and deficits of one direction, owned by its consumer */
+typedef struct hw_iface_drr
+{
+    int next;
+    u8 fresh;                   /* next has not had its quantum for this visit */
+    int32_t deficit[HW_IFACE_MAX];
+} hw_iface_drr;
+
+typedef struct hw_iface_set
+{
+    hw_iface ifaces[HW_IFACE_MAX];
+    int count;
+    hw_iface_drr tx_drr;
+    hw_iface_drr rx_drr;
+} hw_iface_set;
+
+/* One device -> host frame handed to the link */
+typedef struct hw_iface_frame
+{
+    u8 iface;
+    u8 type;
+    uint32_t enqueue_us;
+    uint32_t capture_us;
+} hw_iface_frame;
+
+typedef int (*hw_iface_air_tx_fn)(void *ctx, u8 iface, u8 type, const u8 *frame, int len);
+
+void hw_iface_init(hw_iface_set *, int, const buffer_aqm_config *);
+hw_iface *hw_iface_get(hw_iface_set *, int);
+void hw_iface_set_mac(hw_iface_set *, int, const u8 *);
+int hw_iface_set_filter(hw_iface_set *, int, u8, uint32_t);
+ring_buffer *hw_iface_queue(hw_iface_set *, u8);
+
+int hw_iface_classify(hw_iface_set *, const u8 *, int);
+int hw_iface_enqueue_tx(hw_iface_set *, int, const u8 *, int, u8 *, int, u8, uint32_t);
+int hw_iface_dequeue_tx(hw_iface_set *, u8 *, int, hw_iface_frame *);
+int hw_iface_dequeue_batch(hw_iface_set *, u8 *, int, hw_iface_frame *);
+
+int hw_iface_enqueue_rx(hw_iface_set *, int, u8 *, int, u8);
+int hw_iface_air_drain(hw_iface_set *, int, hw_iface_air_tx_fn, void *);
+
+#endif
@@ -1,37 +1,85 @@
 #include "hw_link_ctrl_protocol.h"
 
-#define HW_LCP_START_FLAG        (0x7c)
-#define HW_LCP_END_FLAG          (0x7e)
-#define HW_LCP_PADDING           (0xff)
-#define MAX_PAYLOAD_LEN          (512)
+#define MAX_PAYLOAD_LEN          (HW_LCP_MAX_PAYLOAD_LEN)
 
 u8 *hw_frame_assemble(u8 *buff, int *buff_len)
 {
-    static u8 assemble_buff[MAX_PAYLOAD_LEN];
+    return hw_frame_assemble_type(buff, buff_len, HW_LCP_TYPE_80211);
+}
+
+u8 *hw_frame_assemble_type(u8 *buff, int *buff_len, u8 type)
+{
+    static u8 assemble_buff[MAX_PAYLOAD_LEN + HW_LCP_OVERHEAD];
 
-    if (!buff_len || *buff_len < 1 || !buff)
+    if (!buff_len || *buff_len < 1 || *buff_len > MAX_PAYLOAD_LEN || !buff)
     {
         ERROR_PRINT("!buff_len || buff_len < 0 || !buff\n");
         return NULL;
     }
     memset(assemble_buff, 0x0, sizeof(assemble_buff));
+    memcpy(assemble_buff + PAYLOAD_FIELD, buff, *buff_len);
+
+    *buff_len = hw_frame_encap(assemble_buff, *buff_len, type);
+
+    return assemble_buff;
+}
 
+/* Frame a payload already placed at frame[PAYLOAD_FIELD] in place. Returns the frame length */
+int hw_frame_encap(u8 *frame, int payload_len, u8 type)
+{
     /* Check FRAME_START FLAG */
-    assemble_buff[HW_LCP_START_FLAG_FIELD]   = HW_LCP_START_FLAG;
-    assemble_buff[HW_LCP_PADDING_FIELD]      = HW_LCP_PADDING;
-    assemble_buff[PAYLOAD_LEN_FIELD1]        = (u8)(*buff_len & 0xFF);         // Lower byte
-    assemble_buff[PAYLOAD_LEN_FIELD2]        = (u8)((*buff_len >> 8) & 0xFF);  // Upper byte
-    memcpy(assemble_buff+ PAYLOAD_FIELD, buff, *buff_len);
-    assemble_buff[PAYLOAD_FIELD + *buff_len] = HW_LCP_END_FLAG;
+    frame[HW_LCP_START_FLAG_FIELD]        = HW_LCP_START_FLAG;
+    frame[HW_LCP_TYPE_FIELD]              = type;
+    frame[PAYLOAD_LEN_FIELD1]             = (u8)(payload_len & 0xFF);         // Lower byte
+    frame[PAYLOAD_LEN_FIELD2]             = (u8)((payload_len >> 8) & 0xFF);  // Upper byte
+    frame[PAYLOAD_FIELD + payload_len]    = HW_LCP_END_FLAG;
 
-    *buff_len = *buff_len + (HW_LCP_OVERHEAD -1);
+    return payload_len + (HW_LCP_OVERHEAD - 1);
+}
 
-    return assemble_buff;
+/* Same, with the sequence / timestamp trailer appended after the payload */
+int hw_frame_encap_ext(u8 *frame, int payload_len, u8 type, const hw_lcp_ext *ext)
+{
+    u8 *trailer = &frame[PAYLOAD_FIELD + payload_len];
+    int len;
+
+    trailer[HW_LCP_EXT_SEQ]      = (u8)(ext->seq & 0xFF);
+    trailer[HW_LCP_EXT_SEQ + 1]  = (u8)((ext->seq >> 8) & 0xFF);
+    trailer[HW_LCP_EXT_FLAGS]    = ext->flags;
+    trailer[HW_LCP_EXT_RESERVED] = 0;
+    hw_lcp_put_le32(&trailer[HW_LCP_EXT_CAPTURE_TS], ext->capture_us);
+    hw_lcp_put_le32(&trailer[HW_LCP_EXT_ENQUEUE_TS], ext->enqueue_us);
+    hw_lcp_put_le32(&trailer[HW_LCP_EXT_SEND_TS], ext->send_us);
+
+    len = hw_frame_encap(frame, payload_len + HW_LCP_EXT_LEN, type);
+    frame[PAYLOAD_LEN_FIELD2] |= HW_LCP_FLAG_EXT;
+    return len;
+}
+
+/* Read the trailer of a valid frame. Returns 1 if the frame has one */
+int hw_frame_get_ext(u8 *frame, hw_lcp_ext *ext)
+{
+    int raw_len = hw_frame_raw_len(frame);
+    u8 *trailer;
+
+    if (!(frame[PAYLOAD_LEN_FIELD2] & HW_LCP_FLAG_EXT) || raw_len < HW_LCP_EXT_LEN)
+    {
+        return 0;
+    }
+
+    trailer = &frame[PAYLOAD_FIELD + raw_len - HW_LCP_EXT_LEN];
+    ext->seq        = trailer[HW_LCP_EXT_SEQ] | (trailer[HW_LCP_EXT_SEQ + 1] << 8);
+    ext->flags      = trailer[HW_LCP_EXT_FLAGS];
+    ext->capture_us = hw_lcp_get_le32(&trailer[HW_LCP_EXT_CAPTURE_TS]);
+    ext->enqueue_us = hw_lcp_get_le32(&trailer[HW_LCP_EXT_ENQUEUE_TS]);
+    ext->send_us    = hw_lcp_get_le32(&trailer[HW_LCP_EXT_SEND_TS]);
+    return 1;
 }
 
 int is_valid_hw_frame(u8 *buff)
 {
     int payload_len = 0;
+    int trailer_len = 0;
     int end_flag = 0;
 
     if (!buff)
@@ -49,16 +97,25 @@ int is_valid_hw_frame(u8 *buff)
         return 0;
     }
 
-    /* Check padding */
-    if (buff[HW_LCP_PADDING_FIELD] != HW_LCP_PADDING)
+    /* Check frame type */
+    if (buff[HW_LCP_TYPE_FIELD] != HW_LCP_TYPE_80211 &&
+        buff[HW_LCP_TYPE_FIELD] != HW_LCP_TYPE_8023 &&
+        buff[HW_LCP_TYPE_FIELD] != HW_LCP_TYPE_CMD &&
+        buff[HW_LCP_TYPE_FIELD] != HW_LCP_TYPE_80211_META &&
+        buff[HW_LCP_TYPE_FIELD] != HW_LCP_TYPE_BATCH &&
+        buff[HW_LCP_TYPE_FIELD] != HW_LCP_TYPE_TMPL_TX)
     {
-        ERROR_PRINT("buff != HW_LCP_PADDING_FIELD\n");
+        ERROR_PRINT("Unknown frame type [%u]\n", buff[HW_LCP_TYPE_FIELD]);
         return 0;
     }
 
-    /* Parse data length as Little Endian */
-    payload_len = buff[PAYLOAD_LEN_FIELD1] | (buff[PAYLOAD_LEN_FIELD2] << 8);
-    if ((payload_len < 0) || (payload_len > MAX_PAYLOAD_LEN))
+    /* Parse data length as Little Endian, the trailer (if any) is not part of the payload */
+    payload_len = hw_frame_raw_len(buff);
+    if (buff[PAYLOAD_LEN_FIELD2] & HW_LCP_FLAG_EXT)
+    {
+        trailer_len = HW_LCP_EXT_LEN;
+    }
+    if ((payload_len < trailer_len) || (payload_len - trailer_len > MAX_PAYLOAD_LEN))
     {
         ERROR_PRINT("Invalid payload len [%d]\n", payload_len);
         return 0;
@@ -72,5 +129,130 @@ int is_valid_hw_frame(u8 *buff)
         return 0;
     }
     
-    return payload_len;
+    return payload_len - trailer_len;
+}
+
+/* Bytes between header and end flag (payload + trailer), straight from the length field */
+int hw_frame_raw_len(const u8 *buff)
+{
+    return (buff[PAYLOAD_LEN_FIELD1] | (buff[PAYLOAD_LEN_FIELD2] << 8)) & HW_LCP_LEN_MASK;
+}
+
+u8 hw_frame_type(u8 *buff)
+{
+    return buff[HW_LCP_TYPE_FIELD];
+}
+
+u8 hw_frame_iface(const u8 *buff)
+{
+    return (buff[PAYLOAD_LEN_FIELD2] & HW_LCP_IFACE_MASK) >> HW_LCP_IFACE_SHIFT;
+}
+
+/* After hw_frame_encap*(), which leave the interface at 0 */
+void hw_frame_set_iface(u8 *buff, u8 iface)
+{
+    buff[PAYLOAD_LEN_FIELD2] = (buff[PAYLOAD_LEN_FIELD2] & ~HW_LCP_IFACE_MASK) |
+                               ((iface << HW_LCP_IFACE_SHIFT) & HW_LCP_IFACE_MASK);
+}
+
+void hw_lcp_meta_encode(u8 *buff, const hw_lcp_rx_meta *meta)
+{
+    buff[HW_LCP_META_TIMESTAMP]      = (u8)(meta->timestamp & 0xFF);
+    buff[HW_LCP_META_TIMESTAMP + 1]  = (u8)((meta->timestamp >> 8) & 0xFF);
+    buff[HW_LCP_META_TIMESTAMP + 2]  = (u8)((meta->timestamp >> 16) & 0xFF);
+    buff[HW_LCP_META_TIMESTAMP + 3]  = (u8)((meta->timestamp >> 24) & 0xFF);
+    buff[HW_LCP_META_RSSI]           = (u8)meta->rssi;
+    buff[HW_LCP_META_CHANNEL]        = meta->channel;
+    buff[HW_LCP_META_RATE]           = meta->rate;
+    buff[HW_LCP_META_FLAGS]          = meta->flags;
+    buff[HW_LCP_META_ORIG_LEN1]      = (u8)(meta->orig_len & 0xFF);
+    buff[HW_LCP_META_ORIG_LEN2]      = (u8)((meta->orig_len >> 8) & 0xFF);
+    buff[HW_LCP_META_RESERVED1]      = 0;
+    buff[HW_LCP_META_RESERVED2]      = 0;
+}
+
+void hw_lcp_meta_decode(const u8 *buff, hw_lcp_rx_meta *meta)
+{
+    meta->timestamp = (uint32_t)buff[HW_LCP_META_TIMESTAMP] |
+                      ((uint32_t)buff[HW_LCP_META_TIMESTAMP + 1] << 8) |
+                      ((uint32_t)buff[HW_LCP_META_TIMESTAMP + 2] << 16) |
+                      ((uint32_t)buff[HW_LCP_META_TIMESTAMP + 3] << 24);
+    meta->rssi      = (int8_t)buff[HW_LCP_META_RSSI];
+    meta->channel   = buff[HW_LCP_META_CHANNEL];
+    meta->rate      = buff[HW_LCP_META_RATE];
+    meta->flags     = buff[HW_LCP_META_FLAGS];
+    meta->orig_len  = buff[HW_LCP_META_ORIG_LEN1] | (buff[HW_LCP_META_ORIG_LEN2] << 8);
+}
+
+void hw_lcp_batch_put_hdr(u8 *rec, u8 type, u8 iface, int len)
+{
+    rec[HW_LCP_BATCH_TYPE]  = type;
+    rec[HW_LCP_BATCH_IFACE] = iface;
+    rec[HW_LCP_BATCH_LEN1]  = (u8)(len & 0xFF);
+    rec[HW_LCP_BATCH_LEN2]  = (u8)((len >> 8) & 0xFF);
+}
+
+/* Walk the records of a HW_LCP_TYPE_BATCH payload. Returns 1 with rec filled, 0 at the end, -1 if malformed */
+int hw_lcp_batch_next(const u8 *payload, int len, int *off, hw_lcp_batch_rec *rec)
+{
+    const u8 *hdr = &payload[*off];
+
+    if (*off >= len)
+    {
+        return 0;
+    }
+    if (len - *off < HW_LCP_BATCH_HDR_LEN)
+    {
+        return -1;
+    }
+
+    rec->type  = hdr[HW_LCP_BATCH_TYPE];
+    rec->iface = hdr[HW_LCP_BATCH_IFACE];
+    rec->len   = hdr[HW_LCP_BATCH_LEN1] | (hdr[HW_LCP_BATCH_LEN2] << 8);
+    rec->data  = &hdr[HW_LCP_BATCH_DATA];
+    if (rec->len <= 0 || rec->len > len - *off - HW_LCP_BATCH_HDR_LEN)
+    {
+        return -1;
+    }
+    *off += HW_LCP_BATCH_HDR_LEN + rec->len;
+    return 1;
+}
+
+/* type : 802.11 frame type or HW_LCP_SNAP_ALL. Lengths below a MAC header are raised to one */
+void hw_lcp_snap_set(hw_lcp_snap *snap, u8 type, uint16_t len)
+{
+    int i;
+
+    if (len != 0 && len < HW_LCP_SNAPLEN_MIN)
+    {
+        len = HW_LCP_SNAPLEN_MIN;
+    }
+    for (i = 0; i < HW_LCP_SNAP_TYPES; i++)
+    {
+        if (type == HW_LCP_SNAP_ALL || type == i)
+        {
+            snap->len[i] = len;
+        }
+    }
+}
+
+/* Bytes of an 802.11 frame of len bytes to forward */
+int hw_lcp_snap_len(const hw_lcp_snap *snap, const u8 *frame, int len)
+{
+    int snap_len = snap->len[(frame[0] >> 2) & 0x03];
+
+    return (snap_len != 0 && snap_len < len) ? snap_len : len;
+}
+
+void hw_lcp_put_le32(u8 *buff, uint32_t value)
+{
+    buff[0] = (u8)(value & 0xFF);
+    buff[1] = (u8)((value >> 8) & 0xFF);
+    buff[2] = (u8)((value >> 16) & 0xFF);
+    buff[3] = (u8)((value >> 24) & 0xFF);
+}
+
+uint32_t hw_lcp_get_le32(const u8 *buff)
+{
+    return (uint32_t)buff[0] | ((uint32_t)buff[1] << 8) | ((uint32_t)buff[2] << 16) | ((uint32_t)buff[3] << 24);
 }
@@ -3,10 +3,20 @@
 
 #include "utils.h"
 
+#define HW_LCP_START_FLAG           (0x7c)
+#define HW_LCP_END_FLAG             (0x7e)
+#define HW_LCP_MAX_PAYLOAD_LEN      (512)
+
+/* Flag bits in the top of PAYLOAD_LEN_FIELD2, the length itself is 12 bits */
+#define HW_LCP_LEN_MASK             (0x0FFF)
+#define HW_LCP_FLAG_EXT             (0x80)  /* hw_lcp_ext trailer between payload and end flag */
+#define HW_LCP_IFACE_MASK           (0x70)  /* Interface the frame belongs to (hw_lcp_iface) */
+#define HW_LCP_IFACE_SHIFT          (4)
+
 enum hw_link_ctl_protocol_frame
 {
     HW_LCP_START_FLAG_FIELD = 0,
-    HW_LCP_PADDING_FIELD,
+    HW_LCP_TYPE_FIELD,
     PAYLOAD_LEN_FIELD1,
     PAYLOAD_LEN_FIELD2,
     PAYLOAD_FIELD, //4
@@ -14,7 +24,211 @@ enum hw_link_ctl_protocol_frame
     HW_LCP_OVERHEAD,
 };
 
+/* Frame types. 0xff is the original padding value and still means a raw 802.11 frame */
+enum hw_link_ctl_protocol_type
+{
+    HW_LCP_TYPE_8023  = 0x01,
+    HW_LCP_TYPE_CMD   = 0x02,
+    HW_LCP_TYPE_80211_META = 0x03,  /* [rx metadata][802.11 frame] */
+    HW_LCP_TYPE_BATCH = 0x04,       /* Several frames, each a hw_lcp_batch_field record */
+    HW_LCP_TYPE_TMPL_TX = 0x05,     /* [template id][patch...] : cached 802.11 frame to send (lcp_tmpl.h) */
+    HW_LCP_TYPE_80211 = 0xff,
+};
+
+/* Interface IDs. Frames of older peers carry 0 and stay on the station */
+enum hw_lcp_iface
+{
+    HW_LCP_IFACE_STA = 0,
+    HW_LCP_IFACE_AP = 1,            /* SoftAP */
+    HW_LCP_IFACE_MAX,
+};
+
+/* Capture metadata in front of HW_LCP_TYPE_80211_META frames, little endian (wifi_pkt_rx_ctrl_t) */
+enum hw_lcp_meta_field
+{
+    HW_LCP_META_TIMESTAMP = 0,      /* Device local time in us, 4 bytes */
+    HW_LCP_META_RSSI = 4,           /* dBm, signed */
+    HW_LCP_META_CHANNEL,
+    HW_LCP_META_RATE,
+    HW_LCP_META_FLAGS,
+    HW_LCP_META_ORIG_LEN1,          /* Length on air incl. FCS, may exceed the forwarded length */
+    HW_LCP_META_ORIG_LEN2,
+    HW_LCP_META_RESERVED1,
+    HW_LCP_META_RESERVED2,
+    HW_LCP_META_LEN,
+};
+
+#define HW_LCP_META_FLAG_SNAPPED    (0x01)  /* Cut at the snap length, orig_len is the frame's */
+
+typedef struct hw_lcp_rx_meta
+{
+    uint32_t timestamp;
+    int8_t rssi;
+    u8 channel;
+    u8 rate;
+    u8 flags;
+    uint16_t orig_len;
+} hw_lcp_rx_meta;
+
+/*
+ * Sequence / timestamp trailer of HW_LCP_FLAG_EXT frames, little endian. The length
+ * field counts it, is_valid_hw_frame() does not, so the payload stays at PAYLOAD_FIELD.
+ * Timestamps are device clock in us, each one valid only with its flag.
+ */
+enum hw_lcp_ext_field
+{
+    HW_LCP_EXT_SEQ = 0,             /* LE16, per direction */
+    HW_LCP_EXT_FLAGS = 2,
+    HW_LCP_EXT_RESERVED,
+    HW_LCP_EXT_CAPTURE_TS = 4,      /* rx_ctrl.timestamp */
+    HW_LCP_EXT_ENQUEUE_TS = 8,      /* Entered the device queue */
+    HW_LCP_EXT_SEND_TS = 12,        /* Handed to the link */
+    HW_LCP_EXT_LEN = 16,
+};
+
+#define HW_LCP_EXT_CAPTURE_VALID    (0x01)
+#define HW_LCP_EXT_ENQUEUE_VALID    (0x02)
+#define HW_LCP_EXT_SEND_VALID       (0x04)
+
+typedef struct hw_lcp_ext
+{
+    uint16_t seq;
+    u8 flags;
+    uint32_t capture_us;
+    uint32_t enqueue_us;
+    uint32_t send_us;
+} hw_lcp_ext;
+
+/* H/W commands : HW_LCP_TYPE_CMD payload = [command][arguments...] */
+enum hw_link_ctl_protocol_cmd
+{
+    HW_CMD_SET_ETH_CONVERT = 0x01,  /* [0|1] : forward data frames as 802.3 */
+    HW_CMD_SET_CAPTURE_META = 0x02, /* [0|1] : forward 802.11 frames as HW_LCP_TYPE_80211_META */
+    HW_CMD_SET_QUEUE_AQM = 0x03,    /* [queue][mode][target ms LE16][interval ms LE16] */
+    HW_CMD_GET_QUEUE_STATS = 0x04,  /* [queue] -> [cmd][queue][enqueued][dequeued][tail drops][aged out][max sojourn us], LE32 */
+    HW_CMD_SET_LINK_SEQ = 0x05,     /* [0|1] : device to host frames carry the hw_lcp_ext trailer */
+    HW_CMD_GET_LINK_SEQ = 0x06,     /* -> [cmd][received][lost][reordered][duplicates][resets], LE32, host to device */
+    HW_CMD_TRACE_DRAIN = 0x07,      /* [0 : reply | 1 : dump to console] -> trace_reply_field layout (trace_buf.h) */
+    HW_CMD_OTA_BEGIN = 0x08,        /* [image size LE32][sha256 32] -> ota reply */
+    HW_CMD_OTA_DATA = 0x09,         /* [offset LE32][data] (no data : window probe) -> ota reply */
+    HW_CMD_OTA_END = 0x0A,          /* [0 | 1 : reboot once verified] -> ota reply, LCP_OTA_BUSY until verified */
+    HW_CMD_OTA_ABORT = 0x0B,        /* -> ota reply */
+    HW_CMD_SET_IFACE_FILTER = 0x0C, /* [iface][HW_IFACE_FILTER_* flags][quantum bytes LE16, 0 : keep] */
+    HW_CMD_GET_IFACE_STATS = 0x0D,  /* [iface] -> [cmd][iface][hw_iface_stats, LE32 each] */
+    HW_CMD_SET_SNAPLEN = 0x0E,      /* [802.11 type 0-3 | HW_LCP_SNAP_ALL][bytes LE16, 0 : whole frame] */
+    HW_CMD_SET_LINK_BATCH = 0x0F,   /* [0|1] : pack several device to host frames per link frame */
+    HW_CMD_TMPL_PUT = 0x10,         /* [template id][802.11 frame] : cache (or replace) a template */
+    HW_CMD_TMPL_MISS = 0x11,        /* Device -> host [cmd][template id] : HW_LCP_TYPE_TMPL_TX not cached, dropped */
+    HW_CMD_GET_TMPL_STATS = 0x12,   /* -> [cmd][puts][hits][misses][evictions][invalid], LE32 */
+    HW_CMD_SCHED_ADD = 0x13,        /* hw_cmd_sched_add_field layout -> [cmd][id LE16][status][device time LE32] */
+    HW_CMD_SCHED_DEL = 0x14,        /* [id LE16, LCP_SCHED_ID_ALL : all] */
+    HW_CMD_GET_SCHED_STATS = 0x15,  /* -> [cmd][sent][overruns][expired][busy][errors][late max us][late avg us]
+                                       [lateness histogram, LCP_SCHED_HIST_BUCKETS], LE32
+                                       [id LE16] -> [cmd][id LE16][sent][overruns][expired][late max us][late avg us] */
+};
+
+/* Device queues addressed by the queue commands */
+enum hw_link_ctl_protocol_queue
+{
+    HW_QUEUE_TX = 0,                /* Device -> host, the station's */
+    HW_QUEUE_RX = 1,                /* Host -> device, the station's */
+    HW_QUEUE_IFACE_TX = 0x10,       /* + iface : device -> host queue of one interface */
+    HW_QUEUE_IFACE_RX = 0x20,       /* + iface : host -> device queue of one interface */
+};
+
+#define HW_CMD_QUEUE_STATS_LEN      (2 + 5 * 4)
+#define HW_CMD_IFACE_STATS_LEN      (2 + 8 * 4)
+#define HW_CMD_LINK_SEQ_LEN         (1 + 5 * 4)
+#define HW_CMD_TMPL_STATS_LEN       (1 + 5 * 4)
+#define HW_CMD_SCHED_STATS_LEN      (1 + (7 + 16) * 4)
+#define HW_CMD_SCHED_ENTRY_STATS_LEN (3 + 5 * 4)
+
+/* Reply to every HW_CMD_OTA_* command */
+enum hw_cmd_ota_reply_field
+{
+    HW_CMD_OTA_REPLY_CMD = 0,
+    HW_CMD_OTA_REPLY_STATUS = 1,        /* enum lcp_ota_status */
+    HW_CMD_OTA_REPLY_NEXT = 2,          /* LE32, next offset the device expects */
+    HW_CMD_OTA_REPLY_WINDOW = 6,        /* LE32, bytes it can take right now */
+    HW_CMD_OTA_REPLY_REQ = 10,          /* LE32, offset of the HW_CMD_OTA_DATA this answers */
+    HW_CMD_OTA_REPLY_LEN = 14,
+};
+
+#define HW_CMD_OTA_DATA_HDR_LEN     (1 + 4)
+
+/* HW_CMD_SCHED_ADD : an 802.11 frame the device sends on its own, once or every period */
+enum hw_cmd_sched_add_field
+{
+    HW_CMD_SCHED_ADD_CMD = 0,
+    HW_CMD_SCHED_ADD_ID = 1,            /* LE16, replaces an entry with the same id */
+    HW_CMD_SCHED_ADD_IFACE = 3,
+    HW_CMD_SCHED_ADD_FLAGS = 4,         /* HW_SCHED_FLAG_* */
+    HW_CMD_SCHED_ADD_FIRST = 5,         /* LE32, us from reception, or device time with HW_SCHED_FLAG_ABS */
+    HW_CMD_SCHED_ADD_PERIOD = 9,        /* LE32, us, 0 : send once */
+    HW_CMD_SCHED_ADD_MAX_LATE = 13,     /* LE32, us, drop a send later than this, 0 : no limit */
+    HW_CMD_SCHED_ADD_COUNT = 17,        /* LE16, sends, 0 : until HW_CMD_SCHED_DEL */
+    HW_CMD_SCHED_ADD_FRAME = 19,
+};
+
+#define HW_CMD_SCHED_ADD_HDR_LEN    (HW_CMD_SCHED_ADD_FRAME)
+#define HW_CMD_SCHED_ADD_REPLY_LEN  (1 + 2 + 1 + 4)
+#define HW_SCHED_FLAG_ABS           (0x01)  /* First is the low 32 bits of the device clock (hw_lcp_ext timestamps) */
+
+/* Record of a HW_LCP_TYPE_BATCH payload; records follow each other up to the payload length */
+enum hw_lcp_batch_field
+{
+    HW_LCP_BATCH_TYPE = 0,
+    HW_LCP_BATCH_IFACE,
+    HW_LCP_BATCH_LEN1,              /* LE16, data only */
+    HW_LCP_BATCH_LEN2,
+    HW_LCP_BATCH_DATA,
+};
+
+#define HW_LCP_BATCH_HDR_LEN        (HW_LCP_BATCH_DATA)
+
+/* Patch of a HW_LCP_TYPE_TMPL_TX frame : [offset LE16][len][len bytes] written over the template */
+#define HW_LCP_TMPL_PATCH_HDR_LEN   (3)
+
+typedef struct hw_lcp_batch_rec
+{
+    u8 type;
+    u8 iface;
+    int len;
+    const u8 *data;
+} hw_lcp_batch_rec;
+
+/*
+ * Snap length : bytes of a sniffed frame forwarded to the host, per 802.11 frame
+ * type (FC type bits : management, control, data, extension). 0 forwards the
+ * whole frame. Snapped frames go out as HW_LCP_TYPE_80211_META with
+ * HW_LCP_META_FLAG_SNAPPED and their on-air length in orig_len.
+ */
+#define HW_LCP_SNAP_TYPES           (4)
+#define HW_LCP_SNAP_ALL             (0xff)
+#define HW_LCP_SNAPLEN_MIN          (24)    /* Basic MAC header */
+
+typedef struct hw_lcp_snap
+{
+    uint16_t len[HW_LCP_SNAP_TYPES];
+} hw_lcp_snap;
+
 u8 *hw_frame_assemble(u8 *, int *);
+u8 *hw_frame_assemble_type(u8 *, int *, u8);
+int hw_frame_encap(u8 *, int, u8);
+int hw_frame_encap_ext(u8 *, int, u8, const hw_lcp_ext *);
+int hw_frame_get_ext(u8 *, hw_lcp_ext *);
 int is_valid_hw_frame(u8 *);
+int hw_frame_raw_len(const u8 *);
+u8 hw_frame_type(u8 *);
+u8 hw_frame_iface(const u8 *);
+void hw_frame_set_iface(u8 *, u8);
+void hw_lcp_meta_encode(u8 *, const hw_lcp_rx_meta *);
+void hw_lcp_meta_decode(const u8 *, hw_lcp_rx_meta *);
+void hw_lcp_batch_put_hdr(u8 *, u8, u8, int);
+int hw_lcp_batch_next(const u8 *, int, int *, hw_lcp_batch_rec *);
+void hw_lcp_snap_set(hw_lcp_snap *, u8, uint16_t);
+int hw_lcp_snap_len(const hw_lcp_snap *, const u8 *, int);
+void hw_lcp_put_le32(u8 *, uint32_t);
+uint32_t hw_lcp_get_le32(const u8 *);
 
 #endif
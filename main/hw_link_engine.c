@@ -0,0 +1,179 @@
+#include "hw_link_engine.h"
+#include "hw_link_ctrl_protocol.h"
+#include "trace_buf.h"
+
+void hw_link_engine_init(hw_link_engine *engine, hw_transport *transport,
+                         hw_link_get_tx_cb get_tx, hw_link_on_rx_cb on_rx, void *ctx)
+{
+    memset(engine, 0x0, sizeof(hw_link_engine));
+    engine->transport = transport;
+    engine->get_tx    = get_tx;
+    engine->on_rx     = on_rx;
+    engine->ctx       = ctx;
+    engine->state     = HW_LINK_ENGINE_IDLE;
+    hw_link_xfer_init(&engine->xfer);
+}
+
+/* Pull the next payload straight into tx_buf and frame it in place */
+static void engine_fetch_tx(hw_link_engine *engine)
+{
+    hw_link_tx_desc desc;
+    hw_lcp_ext ext;
+    int len;
+
+    if (!engine->get_tx)
+    {
+        return;
+    }
+
+    memset(&desc, 0x0, sizeof(desc));
+    desc.type = HW_LCP_TYPE_80211;
+    len = engine->get_tx(engine->ctx, &engine->tx_buf[PAYLOAD_FIELD], &desc);
+    if (len <= 0 || len > HW_LCP_MAX_PAYLOAD_LEN)
+    {
+        return;
+    }
+
+    if (!__atomic_load_n(&engine->seq_enabled, __ATOMIC_RELAXED))
+    {
+        engine->tx_len = hw_frame_encap(engine->tx_buf, len, desc.type);
+    }
+    else
+    {
+        ext.seq        = engine->tx_seq++;
+        ext.flags      = desc.ts_flags;
+        ext.capture_us = desc.capture_us;
+        ext.enqueue_us = desc.enqueue_us;
+        ext.send_us    = desc.send_us;
+        engine->tx_len = hw_frame_encap_ext(engine->tx_buf, len, desc.type, &ext);
+    }
+    hw_frame_set_iface(engine->tx_buf, desc.iface);
+}
+
+/*
+ * Takes effect from the next frame fetched; the sequence keeps counting across toggles.
+ * May be called from another thread than the one polling the engine (host_link_set_seq).
+ */
+void hw_link_engine_set_seq(hw_link_engine *engine, int enable)
+{
+    __atomic_store_n(&engine->seq_enabled, (u8)(enable != 0), __ATOMIC_RELAXED);
+}
+
+static void engine_deliver(hw_link_engine *engine, u8 *frame)
+{
+    engine->frames_rx++;
+    if (engine->on_rx)
+    {
+        engine->on_rx(engine->ctx, frame);
+    }
+}
+
+static int engine_fail(hw_link_engine *engine, int ret)
+{
+    if (ret == HW_TRANSPORT_TIMEOUT)
+    {
+        /* The exchange stays queued, the next poll keeps waiting for it */
+        engine->timeouts++;
+        return HW_LINK_ENGINE_TIMEOUT;
+    }
+
+    engine->errors++;
+    hw_link_xfer_abort(&engine->xfer);
+    hw_transport_reset(engine->transport);
+    engine->state = HW_LINK_ENGINE_IDLE;
+    return HW_LINK_ENGINE_ERR;
+}
+
+static int engine_done(hw_link_engine *engine)
+{
+    if (hw_link_xfer_tx_sent(&engine->xfer))
+    {
+        engine->frames_tx++;
+        engine->tx_len = 0;
+    }
+    engine->state = HW_LINK_ENGINE_IDLE;
+    return HW_LINK_ENGINE_OK;
+}
+
+/* Advance the current exchange. Returns HW_LINK_ENGINE_OK once a full exchange completed */
+int hw_link_engine_poll(hw_link_engine *engine, int timeout_ms)
+{
+    const hw_transport_ops *ops = engine->transport->ops;
+    const u8 *inline_frame = NULL;
+    int ret, data_len, inline_len;
+
+    if (engine->state == HW_LINK_ENGINE_IDLE)
+    {
+        /* Only pick the next frame once the previous one has been clocked out */
+        if (engine->tx_len == 0)
+        {
+            engine_fetch_tx(engine);
+        }
+
+        /* Phase 1 : fixed size header advertising pending lengths (small frames ride inline) */
+        hw_link_xfer_header_build(&engine->xfer, engine->hdr_tx, engine->tx_buf, engine->tx_len);
+        memset(engine->hdr_rx, 0x0, sizeof(engine->hdr_rx));
+
+        TRACE_BEGIN(TRACE_ID_LINK_XFER_HDR, engine->tx_len);
+        ret = ops->queue(engine->transport, engine->hdr_tx, engine->hdr_rx, HW_LINK_HDR_LEN);
+        if (ret != HW_TRANSPORT_OK)
+        {
+            return engine_fail(engine, HW_TRANSPORT_ERR);
+        }
+        engine->state = HW_LINK_ENGINE_HEADER_WAIT;
+    }
+
+    if (engine->state == HW_LINK_ENGINE_HEADER_WAIT)
+    {
+        ret = ops->get_result(engine->transport, timeout_ms);
+        if (ret < 0)
+        {
+            return engine_fail(engine, ret);
+        }
+
+        TRACE_END(TRACE_ID_LINK_XFER_HDR, 0);
+        data_len = hw_link_xfer_header_done(&engine->xfer, engine->hdr_rx, &inline_frame, &inline_len);
+        if (data_len == HW_LINK_XFER_ERR)
+        {
+            return engine_fail(engine, HW_TRANSPORT_ERR);
+        }
+
+        if (inline_len > 0)
+        {
+            memcpy(engine->rx_buf, inline_frame, inline_len);
+            engine_deliver(engine, engine->rx_buf);
+        }
+
+        if (data_len == 0)
+        {
+            return engine_done(engine);
+        }
+
+        /* Phase 2 : data transfer sized to the longer of the two pending frames */
+        memset(engine->rx_buf, 0x0, data_len);
+        TRACE_BEGIN(TRACE_ID_LINK_XFER_DATA, data_len);
+        ret = ops->queue(engine->transport,
+                         (engine->xfer.tx_len > 0 && !engine->xfer.tx_inline) ? engine->tx_buf : NULL,
+                         engine->rx_buf, data_len);
+        if (ret != HW_TRANSPORT_OK)
+        {
+            return engine_fail(engine, HW_TRANSPORT_ERR);
+        }
+        engine->state = HW_LINK_ENGINE_DATA_WAIT;
+    }
+
+    ret = ops->get_result(engine->transport, timeout_ms);
+    if (ret < 0)
+    {
+        return engine_fail(engine, ret);
+    }
+
+    TRACE_END(TRACE_ID_LINK_XFER_DATA, 0);
+    hw_link_xfer_data_done(&engine->xfer);
+    if (engine->xfer.peer_len > 0)
+    {
+        engine_deliver(engine, engine->rx_buf);
+    }
+
+    return engine_done(engine);
+}
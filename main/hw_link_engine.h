@@ -0,0 +1,69 @@
+#ifndef _HW_LINK_ENGINE_H
+#define _HW_LINK_ENGINE_H
+
+#include "utils.h"
+#include "hw_link_xfer.h"
+#include "hw_transport.h"
+
+/*
+ * LCP link engine : runs the two-phase exchange (hw_link_xfer) over any
+ * hw_transport. get_tx() supplies the next payload to send and fills its
+ * descriptor (LCP type, timestamps), on_rx() is called with every LCP frame
+ * received from the peer. With sequencing on, every frame sent carries the
+ * hw_lcp_ext trailer with the next sequence number of this direction.
+ */
+
+#define HW_LINK_ENGINE_OK       (0)
+#define HW_LINK_ENGINE_TIMEOUT  (HW_TRANSPORT_TIMEOUT)
+#define HW_LINK_ENGINE_ERR      (HW_TRANSPORT_ERR)
+
+enum hw_link_engine_state
+{
+    HW_LINK_ENGINE_IDLE = 0,
+    HW_LINK_ENGINE_HEADER_WAIT,
+    HW_LINK_ENGINE_DATA_WAIT,
+};
+
+typedef struct hw_link_tx_desc
+{
+    u8 type;
+    u8 iface;                   /* hw_lcp_iface */
+    u8 ts_flags;                /* HW_LCP_EXT_*_VALID */
+    uint32_t capture_us;
+    uint32_t enqueue_us;
+    uint32_t send_us;
+} hw_link_tx_desc;
+
+typedef int (*hw_link_get_tx_cb)(void *ctx, u8 *buf, hw_link_tx_desc *desc);
+typedef void (*hw_link_on_rx_cb)(void *ctx, u8 *frame);
+
+typedef struct hw_link_engine
+{
+    hw_transport *transport;
+    hw_link_xfer xfer;
+    int state;
+
+    hw_link_get_tx_cb get_tx;
+    hw_link_on_rx_cb on_rx;
+    void *ctx;
+
+    int tx_len;                 /* Assembled LCP frame waiting in tx_buf, 0 if none */
+    u8 seq_enabled;
+    uint16_t tx_seq;
+
+    WORD_ALIGNED_ATTR u8 hdr_tx[HW_LINK_HDR_LEN];
+    WORD_ALIGNED_ATTR u8 hdr_rx[HW_LINK_HDR_LEN];
+    WORD_ALIGNED_ATTR u8 tx_buf[HW_LINK_MAX_DATA_LEN];
+    WORD_ALIGNED_ATTR u8 rx_buf[HW_LINK_MAX_DATA_LEN];
+
+    unsigned long frames_tx;
+    unsigned long frames_rx;
+    unsigned long timeouts;
+    unsigned long errors;
+} hw_link_engine;
+
+void hw_link_engine_init(hw_link_engine *, hw_transport *, hw_link_get_tx_cb, hw_link_on_rx_cb, void *);
+int hw_link_engine_poll(hw_link_engine *, int);
+void hw_link_engine_set_seq(hw_link_engine *, int);
+
+#endif
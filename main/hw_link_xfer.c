@@ -0,0 +1,153 @@
+#include "hw_link_xfer.h"
+
+__inline static int xfer_align(int len)
+{
+    return (len + (HW_LINK_XFER_ALIGN - 1)) & ~(HW_LINK_XFER_ALIGN - 1);
+}
+
+void hw_link_xfer_init(hw_link_xfer *xfer)
+{
+    memset(xfer, 0x0, sizeof(hw_link_xfer));
+    xfer->phase = HW_LINK_PHASE_HEADER;
+}
+
+/* Fill the local header for the next exchange. frame may be NULL when there is nothing to send. */
+int hw_link_xfer_header_build(hw_link_xfer *xfer, u8 *hdr, const u8 *frame, int frame_len)
+{
+    if (!xfer || !hdr)
+    {
+        ERROR_PRINT("!xfer || !hdr\n");
+        return HW_LINK_XFER_ERR;
+    }
+
+    if (!frame || frame_len < 0 || frame_len > HW_LINK_MAX_DATA_LEN)
+    {
+        frame_len = 0;
+    }
+
+    memset(hdr, 0x0, HW_LINK_HDR_LEN);
+    hdr[HW_LINK_HDR_START_FIELD] = HW_LINK_HDR_START_FLAG;
+
+    xfer->phase     = HW_LINK_PHASE_HEADER;
+    xfer->tx_len    = frame_len;
+    xfer->tx_inline = (frame_len > 0 && frame_len <= HW_LINK_INLINE_MAX);
+    xfer->tx_done   = 0;
+    xfer->peer_len  = 0;
+    xfer->data_len  = 0;
+
+    if (xfer->tx_inline)
+    {
+        hdr[HW_LINK_HDR_FLAGS_FIELD]      = HW_LINK_FLAG_INLINE;
+        hdr[HW_LINK_HDR_INLINE_LEN_FIELD] = (u8)frame_len;
+        memcpy(&hdr[HW_LINK_HDR_INLINE_FIELD], frame, frame_len);
+    }
+    else
+    {
+        hdr[HW_LINK_HDR_DATA_LEN_FIELD1] = (u8)(frame_len & 0xFF);         // Lower byte
+        hdr[HW_LINK_HDR_DATA_LEN_FIELD2] = (u8)((frame_len >> 8) & 0xFF);  // Upper byte
+    }
+
+    return HW_LINK_HDR_LEN;
+}
+
+/*
+ * Consume the peer header once the header transfer completed.
+ * Returns the data phase length in bytes (0 = no data phase) or HW_LINK_XFER_ERR.
+ */
+int hw_link_xfer_header_done(hw_link_xfer *xfer, const u8 *peer_hdr, const u8 **inline_frame, int *inline_len)
+{
+    int peer_len, local_len;
+
+    if (inline_frame)
+    {
+        *inline_frame = NULL;
+    }
+    if (inline_len)
+    {
+        *inline_len = 0;
+    }
+
+    xfer->hdr_xfers++;
+    xfer->bus_bytes += HW_LINK_HDR_LEN;
+
+    if (!peer_hdr || peer_hdr[HW_LINK_HDR_START_FIELD] != HW_LINK_HDR_START_FLAG)
+    {
+        /* Peer is not talking to us (idle master, lost sync): nothing was delivered */
+        hw_link_xfer_abort(xfer);
+        return HW_LINK_XFER_ERR;
+    }
+
+    peer_len = peer_hdr[HW_LINK_HDR_DATA_LEN_FIELD1] | (peer_hdr[HW_LINK_HDR_DATA_LEN_FIELD2] << 8);
+    if (peer_len > HW_LINK_MAX_DATA_LEN)
+    {
+        ERROR_PRINT("Invalid peer data len [%d]\n", peer_len);
+        hw_link_xfer_abort(xfer);
+        return HW_LINK_XFER_ERR;
+    }
+
+    if (peer_hdr[HW_LINK_HDR_FLAGS_FIELD] & HW_LINK_FLAG_INLINE)
+    {
+        int len = peer_hdr[HW_LINK_HDR_INLINE_LEN_FIELD];
+
+        if (len > HW_LINK_INLINE_MAX)
+        {
+            ERROR_PRINT("Invalid inline len [%d]\n", len);
+            hw_link_xfer_abort(xfer);
+            return HW_LINK_XFER_ERR;
+        }
+        if (inline_frame)
+        {
+            *inline_frame = &peer_hdr[HW_LINK_HDR_INLINE_FIELD];
+        }
+        if (inline_len)
+        {
+            *inline_len = len;
+        }
+        xfer->frame_bytes += len;
+    }
+
+    if (xfer->tx_inline)
+    {
+        xfer->tx_done = 1;
+        xfer->frame_bytes += xfer->tx_len;
+    }
+
+    local_len = xfer->tx_inline ? 0 : xfer->tx_len;
+    xfer->peer_len = peer_len;
+    xfer->data_len = xfer_align((local_len > peer_len) ? local_len : peer_len);
+    xfer->phase = (xfer->data_len > 0) ? HW_LINK_PHASE_DATA : HW_LINK_PHASE_HEADER;
+
+    return xfer->data_len;
+}
+
+/* Data transfer completed: the local frame (if any) has been delivered. */
+void hw_link_xfer_data_done(hw_link_xfer *xfer)
+{
+    if (xfer->phase != HW_LINK_PHASE_DATA)
+    {
+        return;
+    }
+
+    xfer->data_xfers++;
+    xfer->bus_bytes += xfer->data_len;
+    xfer->frame_bytes += xfer->peer_len;
+    if (!xfer->tx_inline && xfer->tx_len > 0)
+    {
+        xfer->tx_done = 1;
+        xfer->frame_bytes += xfer->tx_len;
+    }
+    xfer->phase = HW_LINK_PHASE_HEADER;
+}
+
+void hw_link_xfer_abort(hw_link_xfer *xfer)
+{
+    xfer->phase    = HW_LINK_PHASE_HEADER;
+    xfer->tx_done  = 0;
+    xfer->peer_len = 0;
+    xfer->data_len = 0;
+}
+
+int hw_link_xfer_tx_sent(const hw_link_xfer *xfer)
+{
+    return xfer->tx_done;
+}
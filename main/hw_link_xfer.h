@@ -0,0 +1,72 @@
+#ifndef _HW_LINK_XFER_H
+#define _HW_LINK_XFER_H
+
+#include "utils.h"
+
+/*
+ * Two-phase link transfer.
+ *
+ * Every exchange starts with a fixed HW_LINK_HDR_LEN byte header transfer in
+ * both directions. The header advertises the length of the LCP frame each side
+ * wants to send; the follow-up data transfer is clocked for exactly the longer
+ * of the two (rounded up for DMA) and is skipped when neither side has data.
+ * A frame that fits in the header's inline area is carried by the header
+ * transfer itself.
+ *
+ * The link is symmetric, so the same state machine is used by the device and
+ * by the host (which, as SPI master, decides to clock the data phase).
+ */
+
+#define HW_LINK_HDR_LEN             (32)
+#define HW_LINK_HDR_START_FLAG      (0x7d)
+#define HW_LINK_XFER_ALIGN          (4)
+#define HW_LINK_MAX_DATA_LEN        (512 + 16 + 8)  /* LCP payload + sequence trailer + framing, aligned */
+
+#define HW_LINK_FLAG_INLINE         (0x01)
+
+#define HW_LINK_XFER_ERR            (-1)
+
+enum hw_link_hdr_field
+{
+    HW_LINK_HDR_START_FIELD = 0,
+    HW_LINK_HDR_FLAGS_FIELD,
+    HW_LINK_HDR_DATA_LEN_FIELD1,
+    HW_LINK_HDR_DATA_LEN_FIELD2,
+    HW_LINK_HDR_INLINE_LEN_FIELD,
+    HW_LINK_HDR_RESERVED_FIELD1,
+    HW_LINK_HDR_RESERVED_FIELD2,
+    HW_LINK_HDR_RESERVED_FIELD3,
+    HW_LINK_HDR_INLINE_FIELD, //8
+};
+
+#define HW_LINK_INLINE_MAX          (HW_LINK_HDR_LEN - HW_LINK_HDR_INLINE_FIELD)
+
+enum hw_link_phase
+{
+    HW_LINK_PHASE_HEADER = 0,
+    HW_LINK_PHASE_DATA,
+};
+
+typedef struct hw_link_xfer
+{
+    int phase;
+    int tx_len;          /* Local LCP frame offered in this exchange, 0 if none */
+    int tx_inline;       /* Local frame travels inside the header */
+    int peer_len;        /* LCP frame length the peer offered for the data phase */
+    int data_len;        /* Negotiated data phase length in bytes */
+    int tx_done;         /* Local frame has been clocked out */
+
+    unsigned long hdr_xfers;
+    unsigned long data_xfers;
+    unsigned long bus_bytes;
+    unsigned long frame_bytes;
+} hw_link_xfer;
+
+void hw_link_xfer_init(hw_link_xfer *);
+int hw_link_xfer_header_build(hw_link_xfer *, u8 *, const u8 *, int);
+int hw_link_xfer_header_done(hw_link_xfer *, const u8 *, const u8 **, int *);
+void hw_link_xfer_data_done(hw_link_xfer *);
+void hw_link_xfer_abort(hw_link_xfer *);
+int hw_link_xfer_tx_sent(const hw_link_xfer *);
+
+#endif
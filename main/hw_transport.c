@@ -0,0 +1,42 @@
+#include "hw_transport.h"
+
+int hw_transport_open(hw_transport *transport)
+{
+    if (!transport || !transport->ops)
+    {
+        ERROR_PRINT("!transport || !transport->ops\n");
+        return HW_TRANSPORT_ERR;
+    }
+
+    INFO_PRINT("link transport [%s]\n", transport->ops->name);
+
+    return transport->ops->open ? transport->ops->open(transport) : HW_TRANSPORT_OK;
+}
+
+void hw_transport_close(hw_transport *transport)
+{
+    if (transport && transport->ops && transport->ops->close)
+    {
+        transport->ops->close(transport);
+    }
+}
+
+/* Queue one exchange and wait for it */
+int hw_transport_transmit(hw_transport *transport, const u8 *tx, u8 *rx, int len, int timeout_ms)
+{
+    int ret = transport->ops->queue(transport, tx, rx, len);
+
+    if (ret != HW_TRANSPORT_OK)
+    {
+        return ret;
+    }
+    return transport->ops->get_result(transport, timeout_ms);
+}
+
+void hw_transport_reset(hw_transport *transport)
+{
+    if (transport->ops->reset)
+    {
+        transport->ops->reset(transport);
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef _HW_TRANSPORT_H
+#define _HW_TRANSPORT_H
+
+#include "utils.h"
+
+/*
+ * Link transport.
+ *
+ * A transport moves one full duplex exchange at a time: queue() hands over the
+ * TX and RX buffers of an exchange of len bytes, get_result() waits for it to
+ * complete. SPI maps this onto slave transactions; byte stream transports
+ * (UART, sockets, pipes) write len bytes and read len bytes from the peer.
+ * A transport with an "exchange queued" signal to the peer drives it itself
+ * from queue() (SPI handshake line, set by the slave driver callbacks).
+ * reset() drops a partially received exchange so a byte stream can
+ * resynchronise after a framing error; it may be NULL.
+ */
+
+#define HW_TRANSPORT_OK         (0)
+#define HW_TRANSPORT_TIMEOUT    (-1)
+#define HW_TRANSPORT_ERR        (-2)
+
+typedef struct hw_transport hw_transport;
+
+typedef struct hw_transport_ops
+{
+    const char *name;
+    int (*open)(hw_transport *);
+    void (*close)(hw_transport *);
+    int (*queue)(hw_transport *, const u8 *, u8 *, int);
+    int (*get_result)(hw_transport *, int);
+    void (*reset)(hw_transport *);
+} hw_transport_ops;
+
+struct hw_transport
+{
+    const hw_transport_ops *ops;
+    void *priv;
+};
+
+int hw_transport_open(hw_transport *);
+void hw_transport_close(hw_transport *);
+int hw_transport_transmit(hw_transport *, const u8 *, u8 *, int, int);
+void hw_transport_reset(hw_transport *);
+
+#if defined(CONFIG_IDF_TARGET_ESP32)
+hw_transport *hw_transport_spi_get(void);
+hw_transport *hw_transport_uart_get(void);
+#else
+hw_transport *hw_transport_sock_create(int, int);
+hw_transport *hw_transport_sock_connect(const char *);
+hw_transport *hw_transport_sock_listen(const char *);
+void hw_transport_sock_destroy(hw_transport *);
+#endif
+
+#endif
@@ -0,0 +1,285 @@
+/*
+ * Linux byte stream transport : UNIX domain socket or a pair of pipes.
+ * Lets the device data path and the host stack run against each other on one machine.
+ */
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "hw_transport.h"
+#include "hw_link_xfer.h"
+
+typedef struct sock_priv
+{
+    int rd_fd;
+    int wr_fd;
+    int listen_fd;
+    u8 *rx;
+    int len;
+    int done;
+    int timeout_ms;                 /* Of the last get_result(), used by queue() writes */
+} sock_priv;
+
+#define SOCK_WRITE_TIMEOUT_MS   (1000)  /* Until the first get_result() */
+
+static const u8 zero_buf[HW_LINK_MAX_DATA_LEN];
+
+static long sock_now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+
+/* Writes wait for room with poll(), bounded by the timeout of the exchanges */
+static int sock_write_all(int fd, const u8 *buf, int len, int timeout_ms)
+{
+    long deadline = sock_now_ms() + timeout_ms;
+    struct pollfd pfd;
+    int done = 0, ret;
+
+    pfd.fd = fd;
+    pfd.events = POLLOUT;
+
+    while (done < len)
+    {
+        ret = write(fd, buf + done, len - done);
+        if (ret >= 0)
+        {
+            done += ret;
+            continue;
+        }
+        if (errno == EINTR)
+        {
+            continue;
+        }
+        if (errno != EAGAIN)
+        {
+            return HW_TRANSPORT_ERR;
+        }
+
+        timeout_ms = (int)(deadline - sock_now_ms());
+        if (timeout_ms <= 0 || poll(&pfd, 1, timeout_ms) <= 0)
+        {
+            return HW_TRANSPORT_TIMEOUT;
+        }
+    }
+    return HW_TRANSPORT_OK;
+}
+
+static int sock_open(hw_transport *transport)
+{
+    sock_priv *priv = (sock_priv *)transport->priv;
+    int fd;
+
+    if (priv->listen_fd < 0)
+    {
+        return HW_TRANSPORT_OK;
+    }
+
+    /* Listening side : wait for the peer */
+    fd = accept(priv->listen_fd, NULL, NULL);
+    if (fd < 0)
+    {
+        ERROR_PRINT("accept failed [%d]\n", errno);
+        return HW_TRANSPORT_ERR;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    priv->rd_fd = fd;
+    priv->wr_fd = fd;
+    return HW_TRANSPORT_OK;
+}
+
+static void sock_close(hw_transport *transport)
+{
+    sock_priv *priv = (sock_priv *)transport->priv;
+
+    if (priv->rd_fd >= 0)
+    {
+        close(priv->rd_fd);
+    }
+    if (priv->wr_fd >= 0 && priv->wr_fd != priv->rd_fd)
+    {
+        close(priv->wr_fd);
+    }
+    if (priv->listen_fd >= 0)
+    {
+        close(priv->listen_fd);
+    }
+    priv->rd_fd = priv->wr_fd = priv->listen_fd = -1;
+}
+
+static int sock_queue(hw_transport *transport, const u8 *tx, u8 *rx, int len)
+{
+    sock_priv *priv = (sock_priv *)transport->priv;
+    int ret;
+
+    if (len > HW_LINK_MAX_DATA_LEN)
+    {
+        return HW_TRANSPORT_ERR;
+    }
+
+    ret = sock_write_all(priv->wr_fd, tx ? tx : zero_buf, len, priv->timeout_ms);
+    if (ret != HW_TRANSPORT_OK)
+    {
+        return ret;
+    }
+
+    priv->rx   = rx;
+    priv->len  = len;
+    priv->done = 0;
+    return HW_TRANSPORT_OK;
+}
+
+static int sock_get_result(hw_transport *transport, int timeout_ms)
+{
+    sock_priv *priv = (sock_priv *)transport->priv;
+    long deadline = sock_now_ms() + timeout_ms;
+    struct pollfd pfd;
+    int ret;
+
+    priv->timeout_ms = timeout_ms;
+    pfd.fd = priv->rd_fd;
+    pfd.events = POLLIN;
+
+    while (priv->done < priv->len)
+    {
+        ret = read(priv->rd_fd, priv->rx + priv->done, priv->len - priv->done);
+        if (ret > 0)
+        {
+            priv->done += ret;
+            continue;
+        }
+        if (ret == 0)
+        {
+            return HW_TRANSPORT_ERR;    /* Peer closed */
+        }
+        if (errno == EINTR)
+        {
+            continue;
+        }
+        if (errno != EAGAIN)
+        {
+            return HW_TRANSPORT_ERR;
+        }
+
+        timeout_ms = (int)(deadline - sock_now_ms());
+        if (timeout_ms <= 0 || poll(&pfd, 1, timeout_ms) <= 0)
+        {
+            return HW_TRANSPORT_TIMEOUT;
+        }
+    }
+    return priv->len;
+}
+
+static void sock_reset(hw_transport *transport)
+{
+    sock_priv *priv = (sock_priv *)transport->priv;
+    u8 drain[256];
+
+    while (read(priv->rd_fd, drain, sizeof(drain)) > 0)
+    {
+    }
+    priv->done = 0;
+}
+
+static const hw_transport_ops sock_ops =
+{
+    .name       = "unix-stream",
+    .open       = sock_open,
+    .close      = sock_close,
+    .queue      = sock_queue,
+    .get_result = sock_get_result,
+    .reset      = sock_reset,
+};
+
+static hw_transport *sock_alloc(int rd_fd, int wr_fd, int listen_fd)
+{
+    hw_transport *transport = calloc(1, sizeof(hw_transport) + sizeof(sock_priv));
+    sock_priv *priv;
+
+    if (!transport)
+    {
+        return NULL;
+    }
+    priv = (sock_priv *)(transport + 1);
+    priv->rd_fd = rd_fd;
+    priv->wr_fd = wr_fd;
+    priv->listen_fd = listen_fd;
+    priv->timeout_ms = SOCK_WRITE_TIMEOUT_MS;
+
+    /* Reads are driven by poll() so a timed out exchange can be resumed */
+    if (rd_fd >= 0)
+    {
+        fcntl(rd_fd, F_SETFL, fcntl(rd_fd, F_GETFL) | O_NONBLOCK);
+    }
+
+    transport->ops = &sock_ops;
+    transport->priv = priv;
+    return transport;
+}
+
+/* Wrap existing descriptors : one socket (rd_fd == wr_fd) or a pipe pair */
+hw_transport *hw_transport_sock_create(int rd_fd, int wr_fd)
+{
+    return sock_alloc(rd_fd, wr_fd, -1);
+}
+
+hw_transport *hw_transport_sock_connect(const char *path)
+{
+    struct sockaddr_un addr;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (fd < 0)
+    {
+        return NULL;
+    }
+
+    memset(&addr, 0x0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        ERROR_PRINT("connect [%s] failed [%d]\n", path, errno);
+        close(fd);
+        return NULL;
+    }
+    return sock_alloc(fd, fd, -1);
+}
+
+hw_transport *hw_transport_sock_listen(const char *path)
+{
+    struct sockaddr_un addr;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (fd < 0)
+    {
+        return NULL;
+    }
+
+    memset(&addr, 0x0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    unlink(path);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 1) < 0)
+    {
+        ERROR_PRINT("bind/listen [%s] failed [%d]\n", path, errno);
+        close(fd);
+        return NULL;
+    }
+    return sock_alloc(-1, -1, fd);
+}
+
+void hw_transport_sock_destroy(hw_transport *transport)
+{
+    if (transport)
+    {
+        sock_close(transport);
+        free(transport);
+    }
+}
@@ -0,0 +1,191 @@
+#include <assert.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+
+#include "driver/spi_slave.h"
+#include "driver/gpio.h"
+
+#include "hw_transport.h"
+
+#if CONFIG_IDF_TARGET_ESP32 || CONFIG_IDF_TARGET_ESP32S2
+#define GPIO_HANDSHAKE 2
+#define GPIO_MOSI 12
+#define GPIO_MISO 13
+#define GPIO_SCLK 15
+#define GPIO_CS 14
+
+#elif CONFIG_IDF_TARGET_ESP32C3 || CONFIG_IDF_TARGET_ESP32C2
+#define GPIO_HANDSHAKE 3
+#define GPIO_MOSI 7
+#define GPIO_MISO 2
+#define GPIO_SCLK 6
+#define GPIO_CS 10
+
+#elif CONFIG_IDF_TARGET_ESP32C6
+#define GPIO_HANDSHAKE 15
+#define GPIO_MOSI 19
+#define GPIO_MISO 20
+#define GPIO_SCLK 18
+#define GPIO_CS 9
+
+#elif CONFIG_IDF_TARGET_ESP32H2
+#define GPIO_HANDSHAKE 2
+#define GPIO_MOSI 5
+#define GPIO_MISO 0
+#define GPIO_SCLK 4
+#define GPIO_CS 1
+
+#elif CONFIG_IDF_TARGET_ESP32S3
+#define GPIO_HANDSHAKE 2
+#define GPIO_MOSI 11
+#define GPIO_MISO 13
+#define GPIO_SCLK 12
+#define GPIO_CS 10
+
+#endif //CONFIG_IDF_TARGET_ESP32 || CONFIG_IDF_TARGET_ESP32S2
+
+#ifdef CONFIG_IDF_TARGET_ESP32
+#define RCV_HOST    HSPI_HOST
+
+#else
+#define RCV_HOST    SPI2_HOST
+
+#endif
+
+/* Called after a transaction is queued and ready for pickup by master. We use this to set the handshake line high. */
+void my_post_setup_cb(spi_slave_transaction_t *trans)
+{
+    gpio_set_level(GPIO_HANDSHAKE, 1);
+}
+
+/* Called after transaction is sent/received. We use this to set the handshake line low. */
+void my_post_trans_cb(spi_slave_transaction_t *trans)
+{
+    gpio_set_level(GPIO_HANDSHAKE, 0);
+}
+
+static int spi_open(hw_transport *transport)
+{
+    esp_err_t ret;
+
+    TRACE_FUNC_ENTRY();
+
+    /* Configuration for the SPI bus */
+    spi_bus_config_t buscfg =
+    {
+        .mosi_io_num = GPIO_MOSI,
+        .miso_io_num = GPIO_MISO,
+        .sclk_io_num = GPIO_SCLK,
+        .quadwp_io_num = -1,
+        .quadhd_io_num = -1,
+    };
+
+    /* Configuration for the SPI slave interface */
+    spi_slave_interface_config_t slvcfg =
+    {
+        .mode=0,
+        .spics_io_num=GPIO_CS,
+        .queue_size=3,
+        .flags=0,
+        .post_setup_cb=my_post_setup_cb,
+        .post_trans_cb=my_post_trans_cb
+    };
+
+    /* Configuration for the handshake line */
+    gpio_config_t io_conf =
+    {
+        .intr_type = GPIO_INTR_DISABLE,
+        .mode = GPIO_MODE_OUTPUT,
+        .pin_bit_mask = (1 << GPIO_HANDSHAKE)
+    };
+
+    /* Configure handshake line as output */
+    gpio_config(&io_conf);
+    /* Enable pull-ups on SPI lines so we don't detect rogue pulses when no master is connected. */
+    gpio_set_pull_mode(GPIO_MOSI, GPIO_PULLUP_ONLY);
+    gpio_set_pull_mode(GPIO_SCLK, GPIO_PULLUP_ONLY);
+    gpio_set_pull_mode(GPIO_CS, GPIO_PULLUP_ONLY);
+
+    /* Initialize SPI slave interface */
+    ret = spi_slave_initialize(RCV_HOST, &buscfg, &slvcfg, SPI_DMA_CH_AUTO);
+    assert(ret == ESP_OK);
+
+    TRACE_FUNC_EXIT();
+    return HW_TRANSPORT_OK;
+}
+
+static void spi_close(hw_transport *transport)
+{
+    spi_slave_free(RCV_HOST);
+}
+
+static int spi_queue(hw_transport *transport, const u8 *tx, u8 *rx, int len)
+{
+    static spi_slave_transaction_t spi_trans;
+    esp_err_t ret;
+
+    memset(&spi_trans, 0x0, sizeof(spi_slave_transaction_t));
+    spi_trans.tx_buffer = tx;
+    spi_trans.rx_buffer = rx;
+    spi_trans.length    = len * 8;
+
+    ret = spi_slave_queue_trans(RCV_HOST, &spi_trans, portMAX_DELAY);
+    if (ret != ESP_OK)
+    {
+        ERROR_PRINT("spi_slave_queue_trans failed with error: %d", ret);
+        return HW_TRANSPORT_ERR;
+    }
+    return HW_TRANSPORT_OK;
+}
+
+static int spi_get_result(hw_transport *transport, int timeout_ms)
+{
+    spi_slave_transaction_t *done_trans = NULL;
+    esp_err_t ret;
+
+    ret = spi_slave_get_trans_result(RCV_HOST, &done_trans, timeout_ms / portTICK_PERIOD_MS);
+    switch (ret)
+    {
+        case ESP_OK:
+            return (int)(done_trans->trans_len / 8);
+
+        case ESP_ERR_INVALID_ARG:
+            ERROR_PRINT("Invalid argument passed to spi_slave_get_trans_result");
+            break;
+
+        case ESP_ERR_TIMEOUT:
+            ERROR_PRINT("SPI transmit timed out");
+            return HW_TRANSPORT_TIMEOUT;
+
+        case ESP_ERR_NO_MEM:
+            ERROR_PRINT("Memory allocation failed for spi_slave_get_trans_result");
+            break;
+
+        default:
+            ERROR_PRINT("SPI transmit failed with error: %d", ret);
+            break;
+    }
+    return HW_TRANSPORT_ERR;
+}
+
+static const hw_transport_ops spi_ops =
+{
+    .name       = "spi-slave",
+    .open       = spi_open,
+    .close      = spi_close,
+    .queue      = spi_queue,
+    .get_result = spi_get_result,
+    .reset      = NULL,
+};
+
+static hw_transport spi_transport =
+{
+    .ops  = &spi_ops,
+    .priv = NULL,
+};
+
+hw_transport *hw_transport_spi_get(void)
+{
+    return &spi_transport;
+}
@@ -0,0 +1,127 @@
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+
+#include "driver/uart.h"
+
+#include "hw_transport.h"
+#include "hw_link_xfer.h"
+
+#if CONFIG_ESP_LINK_TRANSPORT_UART
+#define LINK_UART_PORT          CONFIG_ESP_LINK_UART_PORT
+#define LINK_UART_BAUD          CONFIG_ESP_LINK_UART_BAUD
+#define LINK_UART_TX_PIN        CONFIG_ESP_LINK_UART_TX_PIN
+#define LINK_UART_RX_PIN        CONFIG_ESP_LINK_UART_RX_PIN
+#else
+#define LINK_UART_PORT          1
+#define LINK_UART_BAUD          921600
+#define LINK_UART_TX_PIN        UART_PIN_NO_CHANGE
+#define LINK_UART_RX_PIN        UART_PIN_NO_CHANGE
+#endif
+
+#define LINK_UART_BUF_SIZE      (4 * HW_LINK_MAX_DATA_LEN)
+
+/* Exchange in progress : the TX side is written at queue time, RX is read until len bytes arrived */
+typedef struct uart_exchange
+{
+    u8 *rx;
+    int len;
+    int done;
+} uart_exchange;
+
+static uart_exchange uart_xchg;
+
+static int uart_open(hw_transport *transport)
+{
+    uart_config_t uart_config =
+    {
+        .baud_rate = LINK_UART_BAUD,
+        .data_bits = UART_DATA_8_BITS,
+        .parity    = UART_PARITY_DISABLE,
+        .stop_bits = UART_STOP_BITS_1,
+        .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
+        .source_clk = UART_SCLK_DEFAULT,
+    };
+
+    TRACE_FUNC_ENTRY();
+
+    ESP_ERROR_CHECK(uart_driver_install(LINK_UART_PORT, LINK_UART_BUF_SIZE, LINK_UART_BUF_SIZE, 0, NULL, 0));
+    ESP_ERROR_CHECK(uart_param_config(LINK_UART_PORT, &uart_config));
+    ESP_ERROR_CHECK(uart_set_pin(LINK_UART_PORT, LINK_UART_TX_PIN, LINK_UART_RX_PIN,
+                                 UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE));
+
+    TRACE_FUNC_EXIT();
+    return HW_TRANSPORT_OK;
+}
+
+static void uart_close(hw_transport *transport)
+{
+    uart_driver_delete(LINK_UART_PORT);
+}
+
+static int uart_queue(hw_transport *transport, const u8 *tx, u8 *rx, int len)
+{
+    static const u8 zero_buf[HW_LINK_MAX_DATA_LEN];
+
+    if (len > HW_LINK_MAX_DATA_LEN)
+    {
+        return HW_TRANSPORT_ERR;
+    }
+
+    if (uart_write_bytes(LINK_UART_PORT, tx ? (const char *)tx : (const char *)zero_buf, len) != len)
+    {
+        ERROR_PRINT("uart_write_bytes failed\n");
+        return HW_TRANSPORT_ERR;
+    }
+
+    uart_xchg.rx   = rx;
+    uart_xchg.len  = len;
+    uart_xchg.done = 0;
+    return HW_TRANSPORT_OK;
+}
+
+static int uart_get_result(hw_transport *transport, int timeout_ms)
+{
+    int ret = uart_read_bytes(LINK_UART_PORT, uart_xchg.rx + uart_xchg.done,
+                              uart_xchg.len - uart_xchg.done, timeout_ms / portTICK_PERIOD_MS);
+
+    if (ret < 0)
+    {
+        return HW_TRANSPORT_ERR;
+    }
+
+    uart_xchg.done += ret;
+    if (uart_xchg.done < uart_xchg.len)
+    {
+        return HW_TRANSPORT_TIMEOUT;
+    }
+    return uart_xchg.len;
+}
+
+/* Lost sync : drop whatever is buffered and start over with the next header */
+static void uart_reset(hw_transport *transport)
+{
+    uart_flush_input(LINK_UART_PORT);
+    uart_xchg.done = 0;
+}
+
+static const hw_transport_ops uart_ops =
+{
+    .name       = "uart",
+    .open       = uart_open,
+    .close      = uart_close,
+    .queue      = uart_queue,
+    .get_result = uart_get_result,
+    .reset      = uart_reset,
+};
+
+static hw_transport uart_transport =
+{
+    .ops  = &uart_ops,
+    .priv = NULL,
+};
+
+hw_transport *hw_transport_uart_get(void)
+{
+    return &uart_transport;
+}
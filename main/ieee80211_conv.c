@@ -0,0 +1,222 @@
+#include "ieee80211_conv.h"
+
+#define FC0_TYPE_MASK               (0x0c)
+#define FC0_TYPE_DATA               (0x08)
+#define FC0_SUBTYPE_QOS             (0x80)
+#define FC0_SUBTYPE_NODATA          (0x40)
+#define FC1_TO_DS                   (0x01)
+#define FC1_FROM_DS                 (0x02)
+#define FC1_PROTECTED               (0x40)
+#define FC1_ORDER                   (0x80)
+
+#define QOS_CTRL_LEN                (2)
+#define QOS_CTRL_AMSDU              (0x80)
+#define HT_CTRL_LEN                 (4)
+#define ADDR4_LEN                   (6)
+#define AMSDU_SUBFRAME_HDR_LEN      (14)
+
+static const u8 rfc1042_header[] = { 0xaa, 0xaa, 0x03, 0x00, 0x00, 0x00 };
+static const u8 bridge_tunnel_header[] = { 0xaa, 0xaa, 0x03, 0x00, 0x00, 0xf8 };
+
+/* Build DA/SA + EtherType (SNAP) or DA/SA + length (raw LLC) in out and hand it to cb */
+static int msdu_to_8023(const u8 *da, const u8 *sa, const u8 *msdu, int msdu_len,
+                        u8 *out, int out_size, ieee8023_frame_cb cb, void *ctx)
+{
+    int len;
+
+    if (msdu_len >= IEEE80211_SNAP_LEN &&
+        (memcmp(msdu, rfc1042_header, sizeof(rfc1042_header)) == 0 ||
+         memcmp(msdu, bridge_tunnel_header, sizeof(bridge_tunnel_header)) == 0))
+    {
+        /* LLC/SNAP : the EtherType replaces the 8 byte SNAP header */
+        len = ETH_HDR_LEN - 2 + msdu_len - (IEEE80211_SNAP_LEN - 2);
+        if (len > out_size)
+        {
+            return IEEE80211_CONV_ERR;
+        }
+        memcpy(&out[12], &msdu[6], msdu_len - 6);
+    }
+    else
+    {
+        /* Non SNAP LLC : 802.3 length field followed by the raw LLC payload */
+        len = ETH_HDR_LEN + msdu_len;
+        if (len > out_size)
+        {
+            return IEEE80211_CONV_ERR;
+        }
+        out[12] = (u8)((msdu_len >> 8) & 0xFF);
+        out[13] = (u8)(msdu_len & 0xFF);
+        memcpy(&out[ETH_HDR_LEN], msdu, msdu_len);
+    }
+
+    memcpy(&out[0], da, IEEE80211_MAC_LEN);
+    memcpy(&out[IEEE80211_MAC_LEN], sa, IEEE80211_MAC_LEN);
+
+    if (cb)
+    {
+        cb(ctx, out, len);
+    }
+    return len;
+}
+
+/*
+ * Convert an 802.11 data frame (without FCS) to 802.3.
+ * Returns the number of 802.3 frames produced, IEEE80211_CONV_SKIP or IEEE80211_CONV_ERR.
+ */
+int ieee80211_data_to_8023(const u8 *frame, int len, u8 *out, int out_size, ieee8023_frame_cb cb, void *ctx)
+{
+    const u8 *da, *sa, *payload;
+    int hdr_len = IEEE80211_HDR_LEN;
+    int amsdu = 0, payload_len, count = 0;
+
+    if (!frame || !out || len < IEEE80211_HDR_LEN)
+    {
+        return IEEE80211_CONV_ERR;
+    }
+
+    if ((frame[0] & FC0_TYPE_MASK) != FC0_TYPE_DATA ||
+        (frame[0] & FC0_SUBTYPE_NODATA) ||
+        (frame[1] & FC1_PROTECTED))
+    {
+        return IEEE80211_CONV_SKIP;
+    }
+
+    switch (frame[1] & (FC1_TO_DS | FC1_FROM_DS))
+    {
+        case 0:
+            da = &frame[4];
+            sa = &frame[10];
+            break;
+
+        case FC1_FROM_DS:
+            da = &frame[4];
+            sa = &frame[16];
+            break;
+
+        case FC1_TO_DS:
+            da = &frame[16];
+            sa = &frame[10];
+            break;
+
+        default:
+            da = &frame[16];
+            sa = &frame[24];
+            hdr_len += ADDR4_LEN;
+            break;
+    }
+
+    if (frame[0] & FC0_SUBTYPE_QOS)
+    {
+        if (len < hdr_len + QOS_CTRL_LEN)
+        {
+            return IEEE80211_CONV_ERR;
+        }
+        amsdu = frame[hdr_len] & QOS_CTRL_AMSDU;
+        hdr_len += QOS_CTRL_LEN;
+        if (frame[1] & FC1_ORDER)
+        {
+            hdr_len += HT_CTRL_LEN;
+        }
+    }
+
+    if (len <= hdr_len)
+    {
+        return IEEE80211_CONV_SKIP;
+    }
+
+    payload = &frame[hdr_len];
+    payload_len = len - hdr_len;
+
+    if (!amsdu)
+    {
+        if (msdu_to_8023(da, sa, payload, payload_len, out, out_size, cb, ctx) < 0)
+        {
+            return IEEE80211_CONV_ERR;
+        }
+        return 1;
+    }
+
+    /* A-MSDU : DA(6) SA(6) Length(2, BE) MSDU, each subframe but the last padded to 4 bytes */
+    while (payload_len >= AMSDU_SUBFRAME_HDR_LEN)
+    {
+        int msdu_len = (payload[12] << 8) | payload[13];
+        int sub_len = AMSDU_SUBFRAME_HDR_LEN + msdu_len;
+
+        if (sub_len > payload_len)
+        {
+            return count ? count : IEEE80211_CONV_ERR;
+        }
+        if (msdu_to_8023(&payload[0], &payload[6], &payload[AMSDU_SUBFRAME_HDR_LEN], msdu_len,
+                         out, out_size, cb, ctx) < 0)
+        {
+            return count ? count : IEEE80211_CONV_ERR;
+        }
+        count++;
+
+        sub_len = (sub_len + 3) & ~3;
+        if (sub_len >= payload_len)
+        {
+            break;
+        }
+        payload += sub_len;
+        payload_len -= sub_len;
+    }
+
+    return count ? count : IEEE80211_CONV_ERR;
+}
+
+/*
+ * Build a ToDS 802.11 data frame for an 802.3 frame (DA/SA/EtherType or length).
+ * Sequence control is left to the driver. Returns the 802.11 frame length or IEEE80211_CONV_ERR.
+ */
+int ieee8023_to_80211_data(const u8 *eth, int len, const u8 *bssid, u8 *out, int out_size)
+{
+    int type_len, body_len, out_len;
+
+    if (!eth || !bssid || !out || len < ETH_HDR_LEN)
+    {
+        return IEEE80211_CONV_ERR;
+    }
+
+    type_len = (eth[12] << 8) | eth[13];
+    body_len = len - ETH_HDR_LEN;
+
+    if (type_len >= ETH_P_802_3_MIN)
+    {
+        out_len = IEEE80211_HDR_LEN + IEEE80211_SNAP_LEN + body_len;
+    }
+    else
+    {
+        if (type_len > body_len)
+        {
+            return IEEE80211_CONV_ERR;
+        }
+        body_len = type_len;    /* Drop 802.3 padding */
+        out_len = IEEE80211_HDR_LEN + body_len;
+    }
+    if (out_len > out_size)
+    {
+        return IEEE80211_CONV_ERR;
+    }
+
+    memset(out, 0x0, IEEE80211_HDR_LEN);
+    out[0] = FC0_TYPE_DATA;
+    out[1] = FC1_TO_DS;
+    memcpy(&out[4], bssid, IEEE80211_MAC_LEN);                  /* Addr1 : BSSID */
+    memcpy(&out[10], &eth[IEEE80211_MAC_LEN], IEEE80211_MAC_LEN); /* Addr2 : SA */
+    memcpy(&out[16], &eth[0], IEEE80211_MAC_LEN);               /* Addr3 : DA */
+
+    if (type_len >= ETH_P_802_3_MIN)
+    {
+        memcpy(&out[IEEE80211_HDR_LEN], rfc1042_header, sizeof(rfc1042_header));
+        out[IEEE80211_HDR_LEN + 6] = eth[12];
+        out[IEEE80211_HDR_LEN + 7] = eth[13];
+        memcpy(&out[IEEE80211_HDR_LEN + IEEE80211_SNAP_LEN], &eth[ETH_HDR_LEN], body_len);
+    }
+    else
+    {
+        memcpy(&out[IEEE80211_HDR_LEN], &eth[ETH_HDR_LEN], body_len);
+    }
+
+    return out_len;
+}
@@ -0,0 +1,22 @@
+#ifndef _IEEE80211_CONV_H
+#define _IEEE80211_CONV_H
+
+#include "utils.h"
+
+#define IEEE80211_MAC_LEN           (6)
+#define IEEE80211_HDR_LEN           (24)
+#define IEEE80211_FCS_LEN           (4)
+#define IEEE80211_SNAP_LEN          (8)     /* LLC/SNAP + EtherType */
+#define ETH_HDR_LEN                 (14)
+#define ETH_P_802_3_MIN             (0x0600)
+
+#define IEEE80211_CONV_ERR          (-1)
+#define IEEE80211_CONV_SKIP         (-2)    /* Not a convertible data frame (protected, no payload, ...) */
+
+/* Called once per converted 802.3 frame; an A-MSDU produces one call per subframe */
+typedef void (*ieee8023_frame_cb)(void *ctx, u8 *frame, int len);
+
+int ieee80211_data_to_8023(const u8 *, int, u8 *, int, ieee8023_frame_cb, void *);
+int ieee8023_to_80211_data(const u8 *, int, const u8 *, u8 *, int);
+
+#endif
@@ -0,0 +1,386 @@
+#include "lcp_ota.h"
+
+#define OTA_LOAD(x)         __atomic_load_n(&(x), __ATOMIC_ACQUIRE)
+#define OTA_STORE(x, v)     __atomic_store_n(&(x), (v), __ATOMIC_RELEASE)
+
+void lcp_ota_init(lcp_ota *ota, lcp_ota_flash *flash, int nbufs, lcp_ota_notify_fn notify, void *notify_ctx)
+{
+    memset(ota, 0x0, sizeof(lcp_ota));
+    ota->flash      = flash;
+    ota->nbufs      = (nbufs >= 1 && nbufs <= LCP_OTA_BUFS) ? nbufs : LCP_OTA_BUFS;
+    ota->notify     = notify;
+    ota->notify_ctx = notify_ctx;
+    ota->state      = LCP_OTA_IDLE;
+}
+
+static void lcp_ota_wake(lcp_ota *ota)
+{
+    if (ota->notify)
+    {
+        ota->notify(ota->notify_ctx);
+    }
+}
+
+int lcp_ota_active(lcp_ota *ota)
+{
+    int state = OTA_LOAD(ota->state);
+
+    return (state == LCP_OTA_RECEIVING || state == LCP_OTA_VERIFYING || state == LCP_OTA_ACTIVATING);
+}
+
+/* Bytes the link side can take now : free space of the consecutive buffers not handed to the writer */
+uint32_t lcp_ota_window(lcp_ota *ota)
+{
+    uint32_t window = 0;
+    lcp_ota_buf *buf;
+    int i;
+
+    if (OTA_LOAD(ota->state) != LCP_OTA_RECEIVING)
+    {
+        return 0;
+    }
+    for (i = 0; i < ota->nbufs; i++)
+    {
+        buf = &ota->bufs[(ota->fill + i) % ota->nbufs];
+        if (OTA_LOAD(buf->full))
+        {
+            break;
+        }
+        window += LCP_OTA_BUF_SIZE - buf->len;
+    }
+    if (window > ota->image_size - ota->next_offset)
+    {
+        window = ota->image_size - ota->next_offset;
+    }
+    return window;
+}
+
+static int lcp_ota_begin(lcp_ota *ota, const u8 *cmd, int len)
+{
+    int state = OTA_LOAD(ota->state);
+
+    if (len < 1 + 4 + SHA256_LEN)
+    {
+        return LCP_OTA_ERR_SIZE;
+    }
+    if (state == LCP_OTA_RECEIVING || state == LCP_OTA_VERIFYING || state == LCP_OTA_ACTIVATING)
+    {
+        /* A resend after a lost reply : the reply carries the next offset to resume from */
+        if (hw_lcp_get_le32(&cmd[1]) == ota->image_size && !memcmp(&cmd[5], ota->hash, SHA256_LEN) &&
+            !OTA_LOAD(ota->abort_pending))
+        {
+            return LCP_OTA_OK;
+        }
+        return LCP_OTA_ERR_STATE;
+    }
+    if (OTA_LOAD(ota->abort_pending))
+    {
+        return LCP_OTA_BUSY;
+    }
+
+    ota->image_size = hw_lcp_get_le32(&cmd[1]);
+    if (ota->image_size == 0)
+    {
+        return LCP_OTA_ERR_SIZE;
+    }
+    memcpy(ota->hash, &cmd[5], SHA256_LEN);
+    memset(ota->bufs, 0x0, sizeof(ota->bufs));
+    memset(&ota->stats, 0x0, sizeof(lcp_ota_stats));
+    ota->next_offset = 0;
+    ota->fill        = 0;
+    ota->written     = 0;
+    ota->drain       = 0;
+    ota->result      = LCP_OTA_OK;
+    ota->reboot      = 0;
+
+    OTA_STORE(ota->begin_pending, 1);
+    OTA_STORE(ota->state, LCP_OTA_RECEIVING);
+    lcp_ota_wake(ota);
+    INFO_PRINT("ota begin [%u bytes] [%d buffers]\n", (unsigned int)ota->image_size, ota->nbufs);
+    return LCP_OTA_OK;
+}
+
+/* Copy into the fill buffers. Never waits : data that does not fit is refused as a whole */
+static int lcp_ota_data(lcp_ota *ota, uint32_t offset, const u8 *data, int len)
+{
+    int state = OTA_LOAD(ota->state);
+    lcp_ota_buf *buf;
+    int n;
+
+    if (len == 0)
+    {
+        ota->stats.probes++;
+        return LCP_OTA_OK;
+    }
+    if (state != LCP_OTA_RECEIVING)
+    {
+        return (state == LCP_OTA_FAILED) ? ota->result : LCP_OTA_ERR_STATE;
+    }
+    if (offset != ota->next_offset)
+    {
+        ota->stats.offset_errors++;
+        return LCP_OTA_ERR_OFFSET;
+    }
+    if ((uint32_t)len > lcp_ota_window(ota))
+    {
+        ota->stats.busy++;
+        return (offset + len > ota->image_size) ? LCP_OTA_ERR_SIZE : LCP_OTA_BUSY;
+    }
+
+    while (len > 0)
+    {
+        buf = &ota->bufs[ota->fill];
+        if (buf->len == 0)
+        {
+            buf->offset = ota->next_offset;
+        }
+        n = LCP_OTA_BUF_SIZE - buf->len;
+        if (n > len)
+        {
+            n = len;
+        }
+        memcpy(&buf->data[buf->len], data, n);
+        buf->len += n;
+        ota->next_offset += n;
+        data += n;
+        len -= n;
+
+        if (ota->next_offset == ota->image_size)
+        {
+            /* Before the writer can see the last buffer, it moves VERIFYING on to DONE */
+            OTA_STORE(ota->state, LCP_OTA_VERIFYING);
+        }
+        if (buf->len == LCP_OTA_BUF_SIZE || ota->next_offset == ota->image_size)
+        {
+            OTA_STORE(buf->full, 1);
+            ota->fill = (ota->fill + 1) % ota->nbufs;
+            lcp_ota_wake(ota);
+        }
+    }
+    ota->stats.frames++;
+    ota->stats.bytes = ota->next_offset;
+    return LCP_OTA_OK;
+}
+
+static int lcp_ota_end(lcp_ota *ota, const u8 *cmd, int len)
+{
+    switch (OTA_LOAD(ota->state))
+    {
+        case LCP_OTA_RECEIVING:
+            return LCP_OTA_ERR_SIZE;
+
+        case LCP_OTA_VERIFYING:
+        case LCP_OTA_ACTIVATING:
+            ota->reboot = (len >= 2 && cmd[1] != 0);
+            return LCP_OTA_BUSY;
+
+        case LCP_OTA_DONE:
+            ota->reboot = (len >= 2 && cmd[1] != 0);
+            lcp_ota_wake(ota);
+            return LCP_OTA_OK;
+
+        case LCP_OTA_FAILED:
+            return ota->result;
+
+        default:
+            return LCP_OTA_ERR_STATE;
+    }
+}
+
+/*
+ * Wins against the writer up to the boot partition switch : the writer moves
+ * VERIFYING to ACTIVATING with a CAS too, only one of them gets there. Once the
+ * partition is being (or has been) switched the abort is refused.
+ */
+static int lcp_ota_abort(lcp_ota *ota)
+{
+    int state = OTA_LOAD(ota->state);
+
+    while (state == LCP_OTA_RECEIVING || state == LCP_OTA_VERIFYING)
+    {
+        if (__atomic_compare_exchange_n(&ota->state, &state, LCP_OTA_IDLE, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        {
+            OTA_STORE(ota->abort_pending, 1);
+            lcp_ota_wake(ota);
+            INFO_PRINT("ota abort at [%u]\n", (unsigned int)ota->next_offset);
+            return LCP_OTA_OK;
+        }
+    }
+    return (state == LCP_OTA_ACTIVATING || state == LCP_OTA_DONE) ? LCP_OTA_ERR_STATE : LCP_OTA_OK;
+}
+
+/* Link side : one HW_CMD_OTA_* command, reply built into reply (HW_CMD_OTA_REPLY_LEN). Returns the reply length */
+int lcp_ota_handle_cmd(lcp_ota *ota, const u8 *cmd, int len, u8 *reply)
+{
+    uint32_t req = 0;
+    int status;
+
+    switch (cmd[0])
+    {
+        case HW_CMD_OTA_BEGIN:
+            status = lcp_ota_begin(ota, cmd, len);
+            break;
+
+        case HW_CMD_OTA_DATA:
+            if (len < HW_CMD_OTA_DATA_HDR_LEN)
+            {
+                status = LCP_OTA_ERR_SIZE;
+                break;
+            }
+            req = hw_lcp_get_le32(&cmd[1]);
+            status = lcp_ota_data(ota, req, &cmd[HW_CMD_OTA_DATA_HDR_LEN], len - HW_CMD_OTA_DATA_HDR_LEN);
+            break;
+
+        case HW_CMD_OTA_END:
+            status = lcp_ota_end(ota, cmd, len);
+            break;
+
+        case HW_CMD_OTA_ABORT:
+            status = lcp_ota_abort(ota);
+            break;
+
+        default:
+            status = LCP_OTA_ERR_STATE;
+            break;
+    }
+
+    reply[HW_CMD_OTA_REPLY_CMD]    = cmd[0];
+    reply[HW_CMD_OTA_REPLY_STATUS] = (u8)status;
+    hw_lcp_put_le32(&reply[HW_CMD_OTA_REPLY_NEXT], ota->next_offset);
+    hw_lcp_put_le32(&reply[HW_CMD_OTA_REPLY_WINDOW], lcp_ota_window(ota));
+    hw_lcp_put_le32(&reply[HW_CMD_OTA_REPLY_REQ], req);
+    return HW_CMD_OTA_REPLY_LEN;
+}
+
+static void lcp_ota_fail(lcp_ota *ota, int result)
+{
+    int state = LCP_OTA_RECEIVING;
+
+    ota->result = result;
+    if (!__atomic_compare_exchange_n(&ota->state, &state, LCP_OTA_FAILED, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+    {
+        state = LCP_OTA_VERIFYING;
+        if (!__atomic_compare_exchange_n(&ota->state, &state, LCP_OTA_FAILED, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        {
+            state = LCP_OTA_ACTIVATING;
+            __atomic_compare_exchange_n(&ota->state, &state, LCP_OTA_FAILED, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+        }
+    }
+    ota->flash->ops->abort(ota->flash);
+    ERROR_PRINT("ota failed [%d] at [%u]\n", result, (unsigned int)ota->written);
+}
+
+/* Read the image back from flash and check it against the hash from HW_CMD_OTA_BEGIN */
+static int lcp_ota_verify(lcp_ota *ota, u8 *scratch)
+{
+    u8 digest[SHA256_LEN];
+    sha256_ctx ctx;
+    uint32_t offset;
+    int n;
+
+    sha256_init(&ctx);
+    for (offset = 0; offset < ota->image_size; offset += n)
+    {
+        n = (ota->image_size - offset > LCP_OTA_BUF_SIZE) ? LCP_OTA_BUF_SIZE : (int)(ota->image_size - offset);
+        if (ota->flash->ops->read(ota->flash, offset, scratch, n) != LCP_OTA_FLASH_OK)
+        {
+            sha256_final(&ctx, digest);
+            return LCP_OTA_ERR_FLASH;
+        }
+        sha256_update(&ctx, scratch, n);
+        if (OTA_LOAD(ota->abort_pending))
+        {
+            break;                  /* Aborted, the result no longer matters */
+        }
+    }
+    sha256_final(&ctx, digest);
+
+    return memcmp(digest, ota->hash, SHA256_LEN) ? LCP_OTA_ERR_HASH : LCP_OTA_OK;
+}
+
+/*
+ * Writer side : one step of flash work (begin, one buffer, verify). Runs in its
+ * own task. Returns 1 if it did something, 0 when there is nothing to do.
+ */
+int lcp_ota_work(lcp_ota *ota)
+{
+    const lcp_ota_flash_ops *ops = ota->flash->ops;
+    lcp_ota_buf *buf;
+    int state, ret;
+
+    if (OTA_LOAD(ota->abort_pending))
+    {
+        ops->abort(ota->flash);
+        memset(ota->bufs, 0x0, sizeof(ota->bufs));
+        OTA_STORE(ota->begin_pending, 0);
+        OTA_STORE(ota->abort_pending, 0);
+        return 1;
+    }
+
+    if (OTA_LOAD(ota->begin_pending))
+    {
+        OTA_STORE(ota->begin_pending, 0);
+        if (ops->begin(ota->flash, ota->image_size) != LCP_OTA_FLASH_OK)
+        {
+            lcp_ota_fail(ota, LCP_OTA_ERR_SIZE);
+        }
+        return 1;
+    }
+
+    state = OTA_LOAD(ota->state);
+    if (state != LCP_OTA_RECEIVING && state != LCP_OTA_VERIFYING)
+    {
+        return 0;
+    }
+
+    buf = &ota->bufs[ota->drain];
+    if (!OTA_LOAD(buf->full))
+    {
+        return 0;
+    }
+
+    if (ops->write(ota->flash, buf->offset, buf->data, buf->len) != LCP_OTA_FLASH_OK)
+    {
+        lcp_ota_fail(ota, LCP_OTA_ERR_FLASH);
+        return 1;
+    }
+    ota->written += buf->len;
+    ota->stats.sectors++;
+    buf->len = 0;
+    OTA_STORE(buf->full, 0);
+    ota->drain = (ota->drain + 1) % ota->nbufs;
+
+    if (ota->written < ota->image_size)
+    {
+        return 1;
+    }
+
+    /* Last sector written : the link side no longer touches the buffers */
+    ret = lcp_ota_verify(ota, buf->data);
+    if (ret == LCP_OTA_OK)
+    {
+        /* Past this point an abort is refused; lost the race : the abort path cleans up */
+        state = LCP_OTA_VERIFYING;
+        if (!__atomic_compare_exchange_n(&ota->state, &state, LCP_OTA_ACTIVATING, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        {
+            return 1;
+        }
+        if (ops->activate(ota->flash) != LCP_OTA_FLASH_OK)
+        {
+            ret = LCP_OTA_ERR_FLASH;
+        }
+    }
+    else if (OTA_LOAD(ota->abort_pending))
+    {
+        return 1;
+    }
+    if (ret != LCP_OTA_OK)
+    {
+        lcp_ota_fail(ota, ret);
+        return 1;
+    }
+
+    OTA_STORE(ota->state, LCP_OTA_DONE);
+    INFO_PRINT("ota image [%u bytes] verified, boot partition switched\n", (unsigned int)ota->written);
+    return 1;
+}
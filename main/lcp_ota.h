@@ -0,0 +1,132 @@
+#ifndef _LCP_OTA_H
+#define _LCP_OTA_H
+
+#include "utils.h"
+#include "hw_link_ctrl_protocol.h"
+#include "sha256.h"
+
+/*
+ * Firmware update over the link (HW_CMD_OTA_*).
+ *
+ * The link task only copies image data into one of two sector sized buffers
+ * (lcp_ota_handle_cmd, never blocks). Full buffers are written to the
+ * inactive partition by a separate writer (lcp_ota_work) while the other one
+ * fills, so the link never waits on a flash erase or program. Every reply
+ * carries the next offset the device expects and the bytes it can accept
+ * right now; the host keeps its unacknowledged data within that window and
+ * goes back to the next offset on LCP_OTA_BUSY / LCP_OTA_ERR_OFFSET. Once the
+ * last byte is on flash the writer reads the image back, checks its SHA-256
+ * and switches the boot partition. A HW_CMD_OTA_BEGIN repeated with the size
+ * and hash of the update in progress is accepted as is, so a host that lost
+ * the first reply resumes from the next offset.
+ *
+ * The flash is reached through lcp_ota_flash_ops: esp_ota on the module, a
+ * file on Linux.
+ */
+
+#define LCP_OTA_BUF_SIZE            (4096)      /* One flash sector */
+#define LCP_OTA_BUFS                (2)
+#define LCP_OTA_DATA_MAX            (HW_LCP_MAX_PAYLOAD_LEN - HW_CMD_OTA_DATA_HDR_LEN)
+#define LCP_OTA_PROBE               (0xFFFFFFFF)    /* Request offset of a window probe */
+
+#define LCP_OTA_FLASH_OK            (0)
+#define LCP_OTA_FLASH_ERR           (-1)
+
+enum lcp_ota_status
+{
+    LCP_OTA_OK = 0,
+    LCP_OTA_BUSY,               /* No room / still writing : resend from the next offset, retry END */
+    LCP_OTA_ERR_STATE,
+    LCP_OTA_ERR_OFFSET,         /* Not the next offset : resend from the next offset */
+    LCP_OTA_ERR_SIZE,
+    LCP_OTA_ERR_FLASH,
+    LCP_OTA_ERR_HASH,
+};
+
+enum lcp_ota_state
+{
+    LCP_OTA_IDLE = 0,
+    LCP_OTA_RECEIVING,
+    LCP_OTA_VERIFYING,          /* Everything received, writer finishing */
+    LCP_OTA_ACTIVATING,         /* Image verified, switching the boot partition : no abort from here */
+    LCP_OTA_DONE,
+    LCP_OTA_FAILED,
+};
+
+typedef struct lcp_ota_flash lcp_ota_flash;
+
+typedef struct lcp_ota_flash_ops
+{
+    const char *name;
+    int (*begin)(lcp_ota_flash *, uint32_t);
+    int (*write)(lcp_ota_flash *, uint32_t, const u8 *, int);  /* Sequential, erases as it goes */
+    int (*read)(lcp_ota_flash *, uint32_t, u8 *, int);
+    int (*activate)(lcp_ota_flash *);                           /* Boot from the new image next time */
+    void (*abort)(lcp_ota_flash *);
+} lcp_ota_flash_ops;
+
+struct lcp_ota_flash
+{
+    const lcp_ota_flash_ops *ops;
+    void *priv;
+};
+
+typedef struct lcp_ota_buf
+{
+    u8 data[LCP_OTA_BUF_SIZE];
+    uint32_t offset;
+    int len;
+    int full;                   /* Handed to the writer */
+} lcp_ota_buf;
+
+typedef struct lcp_ota_stats
+{
+    uint32_t frames;
+    uint32_t bytes;
+    uint32_t busy;              /* Data refused, window full */
+    uint32_t offset_errors;
+    uint32_t probes;
+    uint32_t sectors;
+} lcp_ota_stats;
+
+typedef void (*lcp_ota_notify_fn)(void *);
+
+typedef struct lcp_ota
+{
+    lcp_ota_flash *flash;
+    int nbufs;
+    lcp_ota_notify_fn notify;   /* Wakes the writer */
+    void *notify_ctx;
+
+    int state;
+    int result;
+    int begin_pending;
+    int abort_pending;
+    int reboot;
+    uint32_t image_size;
+    u8 hash[SHA256_LEN];
+
+    uint32_t next_offset;       /* Link side */
+    int fill;
+    uint32_t written;           /* Writer side */
+    int drain;
+
+    lcp_ota_buf bufs[LCP_OTA_BUFS];
+    lcp_ota_stats stats;
+} lcp_ota;
+
+void lcp_ota_init(lcp_ota *, lcp_ota_flash *, int, lcp_ota_notify_fn, void *);
+int lcp_ota_handle_cmd(lcp_ota *, const u8 *, int, u8 *);
+int lcp_ota_work(lcp_ota *);
+int lcp_ota_active(lcp_ota *);
+uint32_t lcp_ota_window(lcp_ota *);
+
+#if defined(CONFIG_IDF_TARGET_ESP32)
+lcp_ota_flash *lcp_ota_flash_esp_get(void);
+#else
+lcp_ota_flash *lcp_ota_flash_file_create(const char *, uint32_t, uint32_t, uint32_t);
+void lcp_ota_flash_file_destroy(lcp_ota_flash *);
+int lcp_ota_flash_file_activated(lcp_ota_flash *);
+#endif
+
+#endif
@@ -0,0 +1,109 @@
+/*
+ * OTA partition through esp_ota : the next update partition, written
+ * sequentially (esp_ota erases each sector when the writes reach it).
+ */
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+
+#include "lcp_ota.h"
+
+typedef struct flash_esp_priv
+{
+    const esp_partition_t *part;
+    esp_ota_handle_t handle;
+    int open;
+} flash_esp_priv;
+
+static int flash_esp_begin(lcp_ota_flash *flash, uint32_t image_size)
+{
+    flash_esp_priv *priv = (flash_esp_priv *)flash->priv;
+    esp_err_t ret;
+
+    priv->part = esp_ota_get_next_update_partition(NULL);
+    if (!priv->part || image_size > priv->part->size)
+    {
+        ERROR_PRINT("no OTA partition for [%u] bytes\n", (unsigned int)image_size);
+        return LCP_OTA_FLASH_ERR;
+    }
+
+    ret = esp_ota_begin(priv->part, OTA_WITH_SEQUENTIAL_WRITES, &priv->handle);
+    if (ret != ESP_OK)
+    {
+        ERROR_PRINT("esp_ota_begin failed with error: %d\n", ret);
+        return LCP_OTA_FLASH_ERR;
+    }
+    priv->open = 1;
+    INFO_PRINT("ota partition [%s] at [0x%x]\n", priv->part->label, (unsigned int)priv->part->address);
+    return LCP_OTA_FLASH_OK;
+}
+
+static int flash_esp_write(lcp_ota_flash *flash, uint32_t offset, const u8 *buf, int len)
+{
+    flash_esp_priv *priv = (flash_esp_priv *)flash->priv;
+    esp_err_t ret;
+
+    /* Buffers reach the writer in offset order, so the plain sequential write is enough */
+    ret = esp_ota_write(priv->handle, buf, len);
+    if (ret != ESP_OK)
+    {
+        ERROR_PRINT("esp_ota_write failed with error: %d\n", ret);
+        return LCP_OTA_FLASH_ERR;
+    }
+    return LCP_OTA_FLASH_OK;
+}
+
+static int flash_esp_read(lcp_ota_flash *flash, uint32_t offset, u8 *buf, int len)
+{
+    flash_esp_priv *priv = (flash_esp_priv *)flash->priv;
+
+    return (esp_partition_read(priv->part, offset, buf, len) == ESP_OK) ? LCP_OTA_FLASH_OK : LCP_OTA_FLASH_ERR;
+}
+
+/* esp_ota_end() also validates the app image header and checksum */
+static int flash_esp_activate(lcp_ota_flash *flash)
+{
+    flash_esp_priv *priv = (flash_esp_priv *)flash->priv;
+    esp_err_t ret;
+
+    priv->open = 0;
+    ret = esp_ota_end(priv->handle);
+    if (ret == ESP_OK)
+    {
+        ret = esp_ota_set_boot_partition(priv->part);
+    }
+    if (ret != ESP_OK)
+    {
+        ERROR_PRINT("ota activate failed with error: %d\n", ret);
+        return LCP_OTA_FLASH_ERR;
+    }
+    return LCP_OTA_FLASH_OK;
+}
+
+static void flash_esp_abort(lcp_ota_flash *flash)
+{
+    flash_esp_priv *priv = (flash_esp_priv *)flash->priv;
+
+    if (priv->open)
+    {
+        esp_ota_abort(priv->handle);
+        priv->open = 0;
+    }
+}
+
+static const lcp_ota_flash_ops flash_esp_ops =
+{
+    .name     = "esp_ota",
+    .begin    = flash_esp_begin,
+    .write    = flash_esp_write,
+    .read     = flash_esp_read,
+    .activate = flash_esp_activate,
+    .abort    = flash_esp_abort,
+};
+
+static flash_esp_priv esp_priv;
+static lcp_ota_flash esp_flash = { &flash_esp_ops, &esp_priv };
+
+lcp_ota_flash *lcp_ota_flash_esp_get(void)
+{
+    return &esp_flash;
+}
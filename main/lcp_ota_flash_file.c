@@ -0,0 +1,172 @@
+/*
+ * Linux stand-in for the OTA partition : a file the size of the partition.
+ * Optional erase / program delays model NOR flash timing (per 4 KB sector
+ * erase, per 256 byte page program) so the update path can be timed on a PC.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "lcp_ota.h"
+
+#define FLASH_FILE_SECTOR       (4096)
+#define FLASH_FILE_PAGE         (256)
+
+typedef struct flash_file_priv
+{
+    const char *path;
+    int fd;
+    uint32_t part_size;
+    uint32_t erase_us;
+    uint32_t page_us;
+    uint32_t erased_to;         /* Sectors below this are erased */
+    int activated;
+} flash_file_priv;
+
+static void flash_file_delay(uint32_t us)
+{
+    struct timespec ts;
+
+    if (us == 0)
+    {
+        return;
+    }
+    ts.tv_sec = us / 1000000;
+    ts.tv_nsec = (long)(us % 1000000) * 1000;
+    while (nanosleep(&ts, &ts) < 0 && errno == EINTR)
+    {
+    }
+}
+
+static int flash_file_begin(lcp_ota_flash *flash, uint32_t image_size)
+{
+    flash_file_priv *priv = (flash_file_priv *)flash->priv;
+
+    if (image_size > priv->part_size)
+    {
+        ERROR_PRINT("image [%u] larger than partition [%u]\n", (unsigned int)image_size, (unsigned int)priv->part_size);
+        return LCP_OTA_FLASH_ERR;
+    }
+    if (priv->fd < 0)
+    {
+        priv->fd = open(priv->path, O_RDWR | O_CREAT, 0644);
+        if (priv->fd < 0 || ftruncate(priv->fd, priv->part_size) < 0)
+        {
+            ERROR_PRINT("open [%s] failed [%d]\n", priv->path, errno);
+            return LCP_OTA_FLASH_ERR;
+        }
+    }
+    priv->erased_to = 0;
+    priv->activated = 0;
+    return LCP_OTA_FLASH_OK;
+}
+
+/* Sequential writes erase each sector the first time they reach it, like esp_ota_write */
+static int flash_file_write(lcp_ota_flash *flash, uint32_t offset, const u8 *buf, int len)
+{
+    static u8 erased[FLASH_FILE_SECTOR];
+    flash_file_priv *priv = (flash_file_priv *)flash->priv;
+
+    if (priv->fd < 0 || offset + len > priv->part_size)
+    {
+        return LCP_OTA_FLASH_ERR;
+    }
+
+    while (priv->erased_to < offset + len)
+    {
+        memset(erased, 0xFF, sizeof(erased));
+        if (pwrite(priv->fd, erased, FLASH_FILE_SECTOR, priv->erased_to) != FLASH_FILE_SECTOR)
+        {
+            return LCP_OTA_FLASH_ERR;
+        }
+        flash_file_delay(priv->erase_us);
+        priv->erased_to += FLASH_FILE_SECTOR;
+    }
+
+    if (pwrite(priv->fd, buf, len, offset) != len)
+    {
+        return LCP_OTA_FLASH_ERR;
+    }
+    flash_file_delay(priv->page_us * ((len + FLASH_FILE_PAGE - 1) / FLASH_FILE_PAGE));
+    return LCP_OTA_FLASH_OK;
+}
+
+static int flash_file_read(lcp_ota_flash *flash, uint32_t offset, u8 *buf, int len)
+{
+    flash_file_priv *priv = (flash_file_priv *)flash->priv;
+
+    if (priv->fd < 0 || pread(priv->fd, buf, len, offset) != len)
+    {
+        return LCP_OTA_FLASH_ERR;
+    }
+    return LCP_OTA_FLASH_OK;
+}
+
+static int flash_file_activate(lcp_ota_flash *flash)
+{
+    flash_file_priv *priv = (flash_file_priv *)flash->priv;
+
+    if (priv->fd < 0 || fdatasync(priv->fd) < 0)
+    {
+        return LCP_OTA_FLASH_ERR;
+    }
+    priv->activated = 1;
+    return LCP_OTA_FLASH_OK;
+}
+
+static void flash_file_abort(lcp_ota_flash *flash)
+{
+    flash_file_priv *priv = (flash_file_priv *)flash->priv;
+
+    priv->erased_to = 0;
+    priv->activated = 0;
+}
+
+static const lcp_ota_flash_ops flash_file_ops =
+{
+    .name     = "file",
+    .begin    = flash_file_begin,
+    .write    = flash_file_write,
+    .read     = flash_file_read,
+    .activate = flash_file_activate,
+    .abort    = flash_file_abort,
+};
+
+lcp_ota_flash *lcp_ota_flash_file_create(const char *path, uint32_t part_size, uint32_t erase_us, uint32_t page_us)
+{
+    lcp_ota_flash *flash = calloc(1, sizeof(lcp_ota_flash) + sizeof(flash_file_priv));
+    flash_file_priv *priv;
+
+    if (!flash)
+    {
+        return NULL;
+    }
+    priv = (flash_file_priv *)(flash + 1);
+    priv->path      = path;
+    priv->fd        = -1;
+    priv->part_size = part_size;
+    priv->erase_us  = erase_us;
+    priv->page_us   = page_us;
+
+    flash->ops = &flash_file_ops;
+    flash->priv = priv;
+    return flash;
+}
+
+void lcp_ota_flash_file_destroy(lcp_ota_flash *flash)
+{
+    flash_file_priv *priv = (flash_file_priv *)flash->priv;
+
+    if (priv->fd >= 0)
+    {
+        close(priv->fd);
+    }
+    free(flash);
+}
+
+/* Whether the last image was verified and "booted from" */
+int lcp_ota_flash_file_activated(lcp_ota_flash *flash)
+{
+    return ((flash_file_priv *)flash->priv)->activated;
+}
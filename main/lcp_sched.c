@@ -0,0 +1,256 @@
+#include "lcp_sched.h"
+
+void lcp_sched_init(lcp_sched *sched, lcp_sched_entry *entries, int *heap, int capacity,
+                    const lcp_sched_ops *ops, void *ctx)
+{
+    memset(sched, 0x0, sizeof(lcp_sched));
+    memset(entries, 0x0, sizeof(lcp_sched_entry) * capacity);
+    sched->entries  = entries;
+    sched->heap     = heap;
+    sched->capacity = capacity;
+    sched->ops      = ops;
+    sched->ctx      = ctx;
+}
+
+static int lcp_sched_before(const lcp_sched *sched, int a, int b)
+{
+    return sched->entries[sched->heap[a]].target_us < sched->entries[sched->heap[b]].target_us;
+}
+
+static void lcp_sched_swap(lcp_sched *sched, int a, int b)
+{
+    int tmp = sched->heap[a];
+
+    sched->heap[a] = sched->heap[b];
+    sched->heap[b] = tmp;
+    sched->entries[sched->heap[a]].heap_pos = a;
+    sched->entries[sched->heap[b]].heap_pos = b;
+}
+
+static void lcp_sched_sift_up(lcp_sched *sched, int pos)
+{
+    while (pos > 0 && lcp_sched_before(sched, pos, (pos - 1) / 2))
+    {
+        lcp_sched_swap(sched, pos, (pos - 1) / 2);
+        pos = (pos - 1) / 2;
+    }
+}
+
+static void lcp_sched_sift_down(lcp_sched *sched, int pos)
+{
+    int child;
+
+    while ((child = 2 * pos + 1) < sched->count)
+    {
+        if (child + 1 < sched->count && lcp_sched_before(sched, child + 1, child))
+        {
+            child++;
+        }
+        if (!lcp_sched_before(sched, child, pos))
+        {
+            break;
+        }
+        lcp_sched_swap(sched, pos, child);
+        pos = child;
+    }
+}
+
+static void lcp_sched_unlink(lcp_sched *sched, lcp_sched_entry *entry)
+{
+    int pos = entry->heap_pos;
+
+    sched->count--;
+    if (pos != sched->count)
+    {
+        lcp_sched_swap(sched, pos, sched->count);
+        lcp_sched_sift_down(sched, pos);
+        lcp_sched_sift_up(sched, pos);
+    }
+    entry->used = 0;
+}
+
+lcp_sched_entry *lcp_sched_find(lcp_sched *sched, uint16_t id)
+{
+    int i;
+
+    for (i = 0; i < sched->capacity; i++)
+    {
+        if (sched->entries[i].used && sched->entries[i].id == id)
+        {
+            return &sched->entries[i];
+        }
+    }
+    return NULL;
+}
+
+/* Register (or replace) entry req->id. NULL when the table is full or req is invalid */
+lcp_sched_entry *lcp_sched_add(lcp_sched *sched, const lcp_sched_req *req)
+{
+    lcp_sched_entry *entry;
+    int i;
+
+    if (req->id == LCP_SCHED_ID_ALL || req->len <= 0)
+    {
+        return NULL;
+    }
+
+    entry = lcp_sched_find(sched, req->id);
+    if (entry)
+    {
+        lcp_sched_unlink(sched, entry);
+    }
+    else
+    {
+        for (i = 0; i < sched->capacity && sched->entries[i].used; i++)
+        {
+        }
+        if (i == sched->capacity)
+        {
+            return NULL;
+        }
+        entry = &sched->entries[i];
+    }
+
+    memset(entry, 0x0, sizeof(lcp_sched_entry));
+    entry->id          = req->id;
+    entry->used        = 1;
+    entry->iface       = req->iface;
+    entry->target_us   = req->first_us;
+    entry->period_us   = req->period_us;
+    entry->max_late_us = req->max_late_us;
+    entry->remaining   = req->period_us ? req->count : 1;
+    entry->frame       = req->frame;
+    entry->len         = req->len;
+
+    entry->heap_pos = sched->count;
+    sched->heap[sched->count++] = (int)(entry - sched->entries);
+    lcp_sched_sift_up(sched, entry->heap_pos);
+    return entry;
+}
+
+/* Entry id, or all of them with LCP_SCHED_ID_ALL. Returns how many were removed */
+int lcp_sched_remove(lcp_sched *sched, uint16_t id)
+{
+    lcp_sched_entry *entry;
+    int i, n = 0;
+
+    if (id == LCP_SCHED_ID_ALL)
+    {
+        for (i = 0; i < sched->capacity; i++)
+        {
+            n += sched->entries[i].used;
+            sched->entries[i].used = 0;
+        }
+        sched->count = 0;
+        return n;
+    }
+
+    entry = lcp_sched_find(sched, id);
+    if (!entry)
+    {
+        return 0;
+    }
+    lcp_sched_unlink(sched, entry);
+    return 1;
+}
+
+/* Earliest target into *target_us. Returns 0 when nothing is scheduled */
+int lcp_sched_next(const lcp_sched *sched, uint64_t *target_us)
+{
+    if (sched->count == 0)
+    {
+        return 0;
+    }
+    *target_us = sched->entries[sched->heap[0]].target_us;
+    return 1;
+}
+
+static void lcp_sched_account(lcp_sched *sched, lcp_sched_entry *entry, uint64_t late)
+{
+    uint32_t late_us = (late > 0xFFFFFFFFULL) ? 0xFFFFFFFF : (uint32_t)late;
+    int bucket = 0;
+
+    while (bucket < LCP_SCHED_HIST_BUCKETS - 1 && (late_us >> bucket) != 0)
+    {
+        bucket++;
+    }
+    sched->stats.hist[bucket]++;
+    sched->stats.sent++;
+    sched->stats.late_sum_us += late_us;
+    if (late_us > sched->stats.late_max_us)
+    {
+        sched->stats.late_max_us = late_us;
+    }
+
+    entry->stats.sent++;
+    entry->stats.late_sum_us += late_us;
+    if (late_us > entry->stats.late_max_us)
+    {
+        entry->stats.late_max_us = late_us;
+    }
+}
+
+/*
+ * Send the entries that are due, at most budget of them. Stops early when the
+ * air is busy; the entry keeps its target and goes first next time. Returns
+ * the number of frames sent.
+ */
+int lcp_sched_run(lcp_sched *sched, int budget)
+{
+    lcp_sched_entry *entry;
+    uint64_t now, late, skipped;
+    int sent = 0, rc;
+
+    while (sched->count > 0 && budget-- > 0)
+    {
+        entry = &sched->entries[sched->heap[0]];
+        now = sched->ops->now(sched->ctx);
+        if (entry->target_us > now)
+        {
+            break;
+        }
+        late = now - entry->target_us;
+
+        if (entry->max_late_us && late > entry->max_late_us)
+        {
+            sched->stats.expired++;
+            entry->stats.expired++;
+        }
+        else
+        {
+            rc = sched->ops->tx(sched->ctx, entry);
+            if (rc == LCP_SCHED_TX_BUSY)
+            {
+                sched->stats.busy++;
+                break;
+            }
+            if (rc == LCP_SCHED_TX_SENT)
+            {
+                lcp_sched_account(sched, entry, late);
+                sent++;
+            }
+            else
+            {
+                sched->stats.errors++;
+            }
+        }
+
+        if (entry->remaining && --entry->remaining == 0)
+        {
+            lcp_sched_unlink(sched, entry);
+            continue;
+        }
+
+        /* Next period from the target, not from now; periods already gone are skipped */
+        entry->target_us += entry->period_us;
+        if (entry->target_us <= now)
+        {
+            skipped = (now - entry->target_us) / entry->period_us + 1;
+            entry->target_us += skipped * entry->period_us;
+            sched->stats.overruns += (uint32_t)skipped;
+            entry->stats.overruns += (uint32_t)skipped;
+        }
+        lcp_sched_sift_down(sched, 0);
+    }
+    return sent;
+}
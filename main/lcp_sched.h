@@ -0,0 +1,115 @@
+#ifndef _LCP_SCHED_H
+#define _LCP_SCHED_H
+
+#include "utils.h"
+
+/*
+ * Timed transmit : frames the host registered once, sent by the device at a
+ * period or at an absolute time (HW_CMD_SCHED_ADD), so keepalives, beacons
+ * and timed probes no longer carry the link and polling jitter of a frame
+ * pushed by the host at the right moment.
+ *
+ * Entries sit in a binary min-heap on their next target time; lcp_sched_run()
+ * sends every entry that is due and lcp_sched_next() tells the caller when to
+ * wake up again (a one-shot timer on the module). A periodic entry's next
+ * target is its previous target plus the period, so lateness never adds up;
+ * periods that passed completely while the air was busy are skipped and
+ * counted as overruns. An entry sent later than its max_late is dropped for
+ * that period instead (expired).
+ *
+ * The clock and the air come through lcp_sched_ops, so the same code runs
+ * on the module (esp_timer, esp_wifi_80211_tx) and on Linux for benchmarks.
+ * Entry storage is provided by the caller; the frames are not copied.
+ */
+
+#define LCP_SCHED_ID_ALL            (0xFFFF)
+#define LCP_SCHED_HIST_BUCKETS      (16)    /* Lateness, bucket k : [2^(k-1), 2^k) us, 0 : on time */
+
+#define LCP_SCHED_OK                (0)
+#define LCP_SCHED_FULL              (-1)
+#define LCP_SCHED_INVALID           (-2)
+
+/* Result of lcp_sched_ops.tx */
+#define LCP_SCHED_TX_SENT           (0)
+#define LCP_SCHED_TX_BUSY           (1)     /* Try the same entry again later */
+#define LCP_SCHED_TX_ERR            (-1)
+
+typedef struct lcp_sched_entry lcp_sched_entry;
+
+typedef struct lcp_sched_ops
+{
+    uint64_t (*now)(void *);                                /* Monotonic, us */
+    int (*tx)(void *, const lcp_sched_entry *);
+} lcp_sched_ops;
+
+typedef struct lcp_sched_entry_stats
+{
+    uint32_t sent;
+    uint32_t overruns;
+    uint32_t expired;
+    uint32_t late_max_us;
+    uint64_t late_sum_us;
+} lcp_sched_entry_stats;
+
+struct lcp_sched_entry
+{
+    uint16_t id;
+    u8 used;
+    u8 iface;
+    uint64_t target_us;
+    uint32_t period_us;             /* 0 : once */
+    uint32_t max_late_us;           /* 0 : no limit */
+    uint16_t remaining;             /* Sends left, 0 : until removed */
+    int heap_pos;
+
+    const u8 *frame;
+    int len;
+
+    lcp_sched_entry_stats stats;
+};
+
+typedef struct lcp_sched_req
+{
+    uint16_t id;
+    u8 iface;
+    uint64_t first_us;              /* Absolute, on the scheduler's clock */
+    uint32_t period_us;
+    uint32_t max_late_us;
+    uint16_t count;                 /* 0 : until removed (periodic) */
+    const u8 *frame;
+    int len;
+} lcp_sched_req;
+
+typedef struct lcp_sched_stats
+{
+    uint32_t sent;
+    uint32_t overruns;
+    uint32_t expired;
+    uint32_t busy;
+    uint32_t errors;
+    uint32_t late_max_us;
+    uint64_t late_sum_us;
+    uint32_t hist[LCP_SCHED_HIST_BUCKETS];
+} lcp_sched_stats;
+
+typedef struct lcp_sched
+{
+    lcp_sched_entry *entries;
+    int *heap;                      /* Entry indexes, earliest target first */
+    int capacity;
+    int count;
+
+    const lcp_sched_ops *ops;
+    void *ctx;
+
+    lcp_sched_stats stats;
+} lcp_sched;
+
+void lcp_sched_init(lcp_sched *, lcp_sched_entry *, int *, int, const lcp_sched_ops *, void *);
+lcp_sched_entry *lcp_sched_add(lcp_sched *, const lcp_sched_req *);
+int lcp_sched_remove(lcp_sched *, uint16_t);
+lcp_sched_entry *lcp_sched_find(lcp_sched *, uint16_t);
+int lcp_sched_next(const lcp_sched *, uint64_t *);
+int lcp_sched_run(lcp_sched *, int);
+
+#endif
@@ -0,0 +1,65 @@
+#include "lcp_seq.h"
+
+void lcp_seq_rx_init(lcp_seq_rx *rx)
+{
+    memset(rx, 0x0, sizeof(lcp_seq_rx));
+}
+
+static void lcp_seq_restart(lcp_seq_rx *rx, uint16_t seq)
+{
+    rx->next = seq + 1;
+    rx->window = 1;
+    rx->started = 1;
+}
+
+int lcp_seq_rx_update(lcp_seq_rx *rx, uint16_t seq)
+{
+    int16_t diff = (int16_t)(seq - rx->next);
+    int age;
+
+    if (!rx->started)
+    {
+        lcp_seq_restart(rx, seq);
+        rx->stats.received++;
+        return LCP_SEQ_IN_ORDER;
+    }
+
+    if (diff > LCP_SEQ_RESET_GAP || diff < -LCP_SEQ_RESET_GAP)
+    {
+        lcp_seq_restart(rx, seq);
+        rx->stats.received++;
+        rx->stats.resets++;
+        return LCP_SEQ_RESET;
+    }
+
+    if (diff >= 0)
+    {
+        /* diff frames skipped, then this one */
+        rx->window = (diff + 1 >= LCP_SEQ_WINDOW) ? 1 : ((rx->window << (diff + 1)) | 1);
+        rx->next = seq + 1;
+        rx->stats.received++;
+        rx->stats.lost += diff;
+        return diff ? LCP_SEQ_GAP : LCP_SEQ_IN_ORDER;
+    }
+
+    /* Behind next : age 0 is next - 1 */
+    age = -diff - 1;
+    if (age < LCP_SEQ_WINDOW)
+    {
+        if (rx->window & (1ULL << age))
+        {
+            rx->stats.duplicates++;
+            return LCP_SEQ_DUPLICATE;
+        }
+        rx->window |= (1ULL << age);
+    }
+
+    /* Older than the window can not be checked for duplicates : count it as late */
+    rx->stats.received++;
+    rx->stats.reordered++;
+    if (rx->stats.lost > 0)
+    {
+        rx->stats.lost--;
+    }
+    return LCP_SEQ_REORDERED;
+}
@@ -0,0 +1,45 @@
+#ifndef _LCP_SEQ_H
+#define _LCP_SEQ_H
+
+#include "utils.h"
+
+/*
+ * Receive side accounting of the per-direction LCP sequence numbers (hw_lcp_ext).
+ * Tracks the last LCP_SEQ_WINDOW sequence numbers so late frames can be told
+ * apart from duplicates. A jump of more than LCP_SEQ_RESET_GAP either way is
+ * taken as the peer restarting, not as loss.
+ */
+
+#define LCP_SEQ_WINDOW          (64)
+#define LCP_SEQ_RESET_GAP       (4096)
+
+enum lcp_seq_result
+{
+    LCP_SEQ_IN_ORDER = 0,
+    LCP_SEQ_GAP,                /* Frames before this one are missing */
+    LCP_SEQ_REORDERED,          /* Late, fills an earlier gap */
+    LCP_SEQ_DUPLICATE,
+    LCP_SEQ_RESET,
+};
+
+typedef struct lcp_seq_stats
+{
+    uint32_t received;
+    uint32_t lost;              /* Missing now : gaps not filled by late frames */
+    uint32_t reordered;
+    uint32_t duplicates;
+    uint32_t resets;
+} lcp_seq_stats;
+
+typedef struct lcp_seq_rx
+{
+    uint16_t next;
+    u8 started;
+    uint64_t window;            /* Bit n : next - 1 - n was received */
+    lcp_seq_stats stats;
+} lcp_seq_rx;
+
+void lcp_seq_rx_init(lcp_seq_rx *);
+int lcp_seq_rx_update(lcp_seq_rx *, uint16_t);
+
+#endif
@@ -0,0 +1,217 @@
+#include "lcp_tmpl.h"
+
+void lcp_tmpl_init(lcp_tmpl_store *store, u8 *arena, int arena_size)
+{
+    memset(store, 0x0, sizeof(lcp_tmpl_store));
+    store->arena = arena;
+    store->arena_size = arena_size;
+}
+
+static int lcp_tmpl_find(const lcp_tmpl_store *store, u8 id)
+{
+    int i;
+
+    for (i = 0; i < store->count; i++)
+    {
+        if (store->entries[i].id == id)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* Close the gap the template leaves so free space stays at the end of the arena */
+static void lcp_tmpl_remove(lcp_tmpl_store *store, int i)
+{
+    lcp_tmpl_entry entry = store->entries[i];
+    int k;
+
+    memmove(&store->arena[entry.off], &store->arena[entry.off + entry.len], store->used - (entry.off + entry.len));
+    store->used -= entry.len;
+    store->entries[i] = store->entries[--store->count];
+    for (k = 0; k < store->count; k++)
+    {
+        if (store->entries[k].off > entry.off)
+        {
+            store->entries[k].off -= entry.len;
+        }
+    }
+}
+
+static int lcp_tmpl_lru(const lcp_tmpl_store *store)
+{
+    int i, lru = 0;
+
+    for (i = 1; i < store->count; i++)
+    {
+        if ((int32_t)(store->entries[i].last_use - store->entries[lru].last_use) < 0)
+        {
+            lru = i;
+        }
+    }
+    return lru;
+}
+
+/* Cache frame as template id, replacing an older one with the same id */
+int lcp_tmpl_put(lcp_tmpl_store *store, u8 id, const u8 *frame, int len)
+{
+    lcp_tmpl_entry *entry;
+    int i;
+
+    if (len <= 0 || len > store->arena_size || len > HW_LCP_MAX_PAYLOAD_LEN)
+    {
+        store->stats.invalid++;
+        return LCP_TMPL_INVALID;
+    }
+
+    i = lcp_tmpl_find(store, id);
+    if (i >= 0)
+    {
+        lcp_tmpl_remove(store, i);
+    }
+    while (store->count == LCP_TMPL_SLOTS || store->used + len > store->arena_size)
+    {
+        lcp_tmpl_remove(store, lcp_tmpl_lru(store));
+        store->stats.evictions++;
+    }
+
+    entry = &store->entries[store->count++];
+    entry->id       = id;
+    entry->off      = (uint16_t)store->used;
+    entry->len      = (uint16_t)len;
+    entry->last_use = ++store->tick;
+    memcpy(&store->arena[store->used], frame, len);
+    store->used += len;
+    store->stats.puts++;
+    return LCP_TMPL_OK;
+}
+
+/* Template id and its length, NULL if not cached. Counts as a use */
+const u8 *lcp_tmpl_get(lcp_tmpl_store *store, u8 id, int *len)
+{
+    int i = lcp_tmpl_find(store, id);
+
+    if (i < 0)
+    {
+        return NULL;
+    }
+    store->entries[i].last_use = ++store->tick;
+    *len = store->entries[i].len;
+    return &store->arena[store->entries[i].off];
+}
+
+int lcp_tmpl_cached(const lcp_tmpl_store *store, u8 id)
+{
+    return lcp_tmpl_find(store, id) >= 0;
+}
+
+void lcp_tmpl_drop(lcp_tmpl_store *store, u8 id)
+{
+    int i = lcp_tmpl_find(store, id);
+
+    if (i >= 0)
+    {
+        lcp_tmpl_remove(store, i);
+    }
+}
+
+/*
+ * Frame of a HW_LCP_TYPE_TMPL_TX payload ([id][patch...]) into out. Returns its
+ * length, LCP_TMPL_MISS if the template is not cached, LCP_TMPL_INVALID on a
+ * malformed patch.
+ */
+int lcp_tmpl_build(lcp_tmpl_store *store, const u8 *payload, int len, u8 *out, int out_size)
+{
+    const u8 *tmpl;
+    int tmpl_len, off, patch_off, patch_len;
+
+    if (len < 1)
+    {
+        store->stats.invalid++;
+        return LCP_TMPL_INVALID;
+    }
+    tmpl = lcp_tmpl_get(store, payload[0], &tmpl_len);
+    if (!tmpl)
+    {
+        store->stats.misses++;
+        return LCP_TMPL_MISS;
+    }
+    if (tmpl_len > out_size)
+    {
+        store->stats.invalid++;
+        return LCP_TMPL_INVALID;
+    }
+    memcpy(out, tmpl, tmpl_len);
+
+    for (off = 1; off < len; off += HW_LCP_TMPL_PATCH_HDR_LEN + patch_len)
+    {
+        if (len - off < HW_LCP_TMPL_PATCH_HDR_LEN)
+        {
+            store->stats.invalid++;
+            return LCP_TMPL_INVALID;
+        }
+        patch_off = payload[off] | (payload[off + 1] << 8);
+        patch_len = payload[off + 2];
+        if (patch_len == 0 || patch_off + patch_len > tmpl_len || off + HW_LCP_TMPL_PATCH_HDR_LEN + patch_len > len)
+        {
+            store->stats.invalid++;
+            return LCP_TMPL_INVALID;
+        }
+        memcpy(&out[patch_off], &payload[off + HW_LCP_TMPL_PATCH_HDR_LEN], patch_len);
+    }
+    store->stats.hits++;
+    return tmpl_len;
+}
+
+/*
+ * Host side : HW_LCP_TYPE_TMPL_TX payload turning tmpl into frame (same length)
+ * into out. Differing bytes closer than a patch header are sent in one patch.
+ * Returns the payload length, or -1 if it would not fit in out_size.
+ */
+int lcp_tmpl_encode(u8 id, const u8 *tmpl, const u8 *frame, int len, u8 *out, int out_size)
+{
+    int n = 1, i = 0, start, end, j;
+
+    if (out_size < 1)
+    {
+        return -1;
+    }
+    out[0] = id;
+
+    while (i < len)
+    {
+        if (tmpl[i] == frame[i])
+        {
+            i++;
+            continue;
+        }
+
+        /* Extend the patch over short runs of equal bytes, up to 255 bytes */
+        start = i;
+        end = i + 1;
+        for (j = end; j < len && j - start < 255; j++)
+        {
+            if (tmpl[j] != frame[j])
+            {
+                end = j + 1;
+            }
+            else if (j + 1 - end >= HW_LCP_TMPL_PATCH_HDR_LEN)
+            {
+                break;
+            }
+        }
+
+        if (n + HW_LCP_TMPL_PATCH_HDR_LEN + (end - start) > out_size)
+        {
+            return -1;
+        }
+        out[n]     = (u8)(start & 0xFF);
+        out[n + 1] = (u8)((start >> 8) & 0xFF);
+        out[n + 2] = (u8)(end - start);
+        memcpy(&out[n + HW_LCP_TMPL_PATCH_HDR_LEN], &frame[start], end - start);
+        n += HW_LCP_TMPL_PATCH_HDR_LEN + (end - start);
+        i = end;
+    }
+    return n;
+}
@@ -0,0 +1,65 @@
+#ifndef _LCP_TMPL_H
+#define _LCP_TMPL_H
+
+#include "utils.h"
+#include "hw_link_ctrl_protocol.h"
+
+/*
+ * Injection frame templates.
+ *
+ * The host uploads a frame it sends over and over once (HW_CMD_TMPL_PUT) and
+ * then only sends the bytes that change from it (HW_LCP_TYPE_TMPL_TX : template
+ * id and patches). The device copies the template, applies the patches and
+ * injects the result like any HW_LCP_TYPE_80211 frame.
+ *
+ * Templates live packed in one caller provided arena, at most LCP_TMPL_SLOTS
+ * of them; the least recently used ones are evicted to make room. A frame for
+ * a template that is not cached is dropped and reported (HW_CMD_TMPL_MISS).
+ *
+ * The store is deterministic, so the host runs the same code as a shadow of
+ * the device's cache and knows when to upload again without asking.
+ */
+
+#define LCP_TMPL_SLOTS              (32)
+
+#define LCP_TMPL_OK                 (0)
+#define LCP_TMPL_MISS               (-1)
+#define LCP_TMPL_INVALID            (-2)
+
+typedef struct lcp_tmpl_entry
+{
+    u8 id;
+    uint16_t off;
+    uint16_t len;
+    uint32_t last_use;
+} lcp_tmpl_entry;
+
+typedef struct lcp_tmpl_stats
+{
+    uint32_t puts;
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t evictions;
+    uint32_t invalid;           /* Bad template or patch */
+} lcp_tmpl_stats;
+
+typedef struct lcp_tmpl_store
+{
+    u8 *arena;
+    int arena_size;
+    int used;                   /* Arena bytes, templates are kept packed from 0 */
+    lcp_tmpl_entry entries[LCP_TMPL_SLOTS];
+    int count;
+    uint32_t tick;
+    lcp_tmpl_stats stats;
+} lcp_tmpl_store;
+
+void lcp_tmpl_init(lcp_tmpl_store *, u8 *, int);
+int lcp_tmpl_put(lcp_tmpl_store *, u8, const u8 *, int);
+const u8 *lcp_tmpl_get(lcp_tmpl_store *, u8, int *);
+int lcp_tmpl_cached(const lcp_tmpl_store *, u8);
+void lcp_tmpl_drop(lcp_tmpl_store *, u8);
+int lcp_tmpl_build(lcp_tmpl_store *, const u8 *, int, u8 *, int);
+int lcp_tmpl_encode(u8, const u8 *, const u8 *, int, u8 *, int);
+
+#endif
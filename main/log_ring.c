@@ -0,0 +1,198 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "utils.h"
+#include "log_ring.h"
+
+#if defined(CONFIG_IDF_TARGET_ESP32)
+    #include "freertos/task.h"
+
+    #define LOG_RING_TASK_STACK         (3072)
+    #define LOG_RING_TASK_PRIORITY      (tskIDLE_PRIORITY + 1)
+    #define LOG_RING_FLUSH_PERIOD_MS    (50)
+
+    #define LOG_RING_TIMESTAMP()        esp_log_timestamp()
+#else
+    #include <time.h>
+
+    static uint32_t log_ring_host_timestamp(void)
+    {
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint32_t)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+    }
+    #define LOG_RING_TIMESTAMP()        log_ring_host_timestamp()
+#endif
+
+#define LOG_RING_MASK       (LOG_RING_SIZE - 1)
+
+/* Bounded MPSC queue : producers claim a slot with a CAS on enqueue_pos, the slot seq publishes it */
+static log_record log_ring[LOG_RING_SIZE];
+static uint32_t enqueue_pos;
+static uint32_t dequeue_pos;
+static uint32_t dropped;
+
+static const char *const level_names[] = { "NONE", "ERROR", "INFO", "DEBUG", "TRACE" };
+static const char level_chars[] = { 'N', 'E', 'I', 'D', 'V' };
+
+void log_ring_init(void)
+{
+    int i;
+
+    memset(log_ring, 0x0, sizeof(log_ring));
+    for (i = 0; i < LOG_RING_SIZE; i++)
+    {
+        log_ring[i].seq = i;
+    }
+    enqueue_pos = 0;
+    dequeue_pos = 0;
+    dropped = 0;
+}
+
+int log_ring_write(log_site *site, uint8_t level, const char *func, const char *fmt, int nargs, const uintptr_t *args)
+{
+    uint32_t now = LOG_RING_TIMESTAMP();
+    uint32_t pos, seq;
+    log_record *rec;
+    int32_t diff;
+
+    /* Per call site rate limit. Racy across tasks on purpose: it only has to be roughly right */
+    if ((uint32_t)(now - site->window_start) >= LOG_RING_RATE_WINDOW_MS)
+    {
+        site->window_start = now;
+        site->count = 0;
+    }
+    if (site->count >= LOG_RING_RATE_BURST)
+    {
+        site->suppressed++;
+        return LOG_RING_SUPPRESSED;
+    }
+    site->count++;
+
+    pos = __atomic_load_n(&enqueue_pos, __ATOMIC_RELAXED);
+    for (;;)
+    {
+        rec = &log_ring[pos & LOG_RING_MASK];
+        seq = __atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE);
+        diff = (int32_t)(seq - pos);
+
+        if (diff == 0)
+        {
+            if (__atomic_compare_exchange_n(&enqueue_pos, &pos, pos + 1, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            {
+                break;
+            }
+        }
+        else if (diff < 0)
+        {
+            __atomic_fetch_add(&dropped, 1, __ATOMIC_RELAXED);
+            return LOG_RING_FULL;
+        }
+        else
+        {
+            pos = __atomic_load_n(&enqueue_pos, __ATOMIC_RELAXED);
+        }
+    }
+
+    if (nargs > LOG_RING_MAX_ARGS)
+    {
+        nargs = LOG_RING_MAX_ARGS;
+    }
+
+    rec->timestamp  = now;
+    rec->fmt        = fmt;
+    rec->func       = func;
+    rec->level      = level;
+    rec->nargs      = (uint8_t)nargs;
+    rec->suppressed = site->suppressed;
+    site->suppressed = 0;
+    memcpy(rec->args, args, nargs * sizeof(uintptr_t));
+
+    __atomic_store_n(&rec->seq, pos + 1, __ATOMIC_RELEASE);
+
+    return LOG_RING_SUCCESS;
+}
+
+static void log_record_print(const log_record *rec)
+{
+    uintptr_t a[LOG_RING_MAX_ARGS] = {0};
+    int level = (rec->level <= LOG_LEVEL_TRACE) ? rec->level : LOG_LEVEL_NONE;
+    size_t fmt_len = strlen(rec->fmt);
+
+    memcpy(a, rec->args, rec->nargs * sizeof(uintptr_t));
+
+    printf("%c (%u) %s: [%s] (%s) : ", level_chars[level], (unsigned int)rec->timestamp,
+           PRINT_LOGO_NAME, rec->func, level_names[level]);
+    printf(rec->fmt, a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7]);
+    if (fmt_len == 0 || rec->fmt[fmt_len - 1] != '\n')
+    {
+        printf("\n");
+    }
+    if (rec->suppressed)
+    {
+        printf("%c (%u) %s: [%s] (%s) : %u similar messages suppressed\n", level_chars[level],
+               (unsigned int)rec->timestamp, PRINT_LOGO_NAME, rec->func, level_names[level],
+               (unsigned int)rec->suppressed);
+    }
+}
+
+/* Format every pending record. Single consumer only. Returns the number of records printed */
+int log_ring_flush(void)
+{
+    static uint32_t reported_drops;
+    uint32_t drops;
+    log_record *rec;
+    int count = 0;
+
+    for (;;)
+    {
+        rec = &log_ring[dequeue_pos & LOG_RING_MASK];
+        if (__atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE) != dequeue_pos + 1)
+        {
+            break;
+        }
+
+        log_record_print(rec);
+
+        __atomic_store_n(&rec->seq, dequeue_pos + LOG_RING_SIZE, __ATOMIC_RELEASE);
+        dequeue_pos++;
+        count++;
+    }
+
+    drops = log_ring_dropped();
+    if (drops != reported_drops)
+    {
+        printf("W %s: log ring full, %u records dropped\n", PRINT_LOGO_NAME, (unsigned int)(drops - reported_drops));
+        reported_drops = drops;
+    }
+
+    return count;
+}
+
+uint32_t log_ring_dropped(void)
+{
+    return __atomic_load_n(&dropped, __ATOMIC_RELAXED);
+}
+
+#if defined(CONFIG_IDF_TARGET_ESP32)
+static void log_ring_task(void *arg)
+{
+    while (1)
+    {
+        log_ring_flush();
+        vTaskDelay(LOG_RING_FLUSH_PERIOD_MS / portTICK_PERIOD_MS);
+    }
+}
+
+void log_ring_task_start(void)
+{
+    xTaskCreate(log_ring_task, "log_ring", LOG_RING_TASK_STACK, NULL, LOG_RING_TASK_PRIORITY, NULL);
+}
+#else
+void log_ring_task_start(void)
+{
+    /* Host builds call log_ring_flush() themselves */
+}
+#endif
@@ -0,0 +1,85 @@
+#ifndef _LOG_RING_H
+#define _LOG_RING_H
+
+#include <stdint.h>
+
+/*
+ * Deferred binary logging.
+ *
+ * The log macros only store the format string address, the calling function
+ * and the raw arguments into a lock-free ring. Formatting and output are done
+ * later by log_ring_flush() from a low priority task.
+ *
+ * Restrictions of the deferred path :
+ *  - arguments must fit in a uintptr_t (no double / 64 bit values)
+ *  - "%s" arguments must still be valid when the record is flushed
+ *  - at most LOG_RING_MAX_ARGS arguments
+ */
+
+#define LOG_RING_SIZE               (64)     /* Power of 2 */
+#define LOG_RING_MAX_ARGS           (8)
+#define LOG_RING_RATE_WINDOW_MS     (1000)
+#define LOG_RING_RATE_BURST         (10)     /* Records per call site per window */
+
+#define LOG_RING_SUCCESS            (0)
+#define LOG_RING_FULL               (-1)
+#define LOG_RING_SUPPRESSED         (-2)
+
+typedef struct log_site
+{
+    uint32_t window_start;
+    uint16_t count;
+    uint16_t suppressed;
+} log_site;
+
+typedef struct log_record
+{
+    uint32_t seq;
+    uint32_t timestamp;
+    const char *fmt;
+    const char *func;
+    uint16_t suppressed;
+    uint8_t level;
+    uint8_t nargs;
+    uintptr_t args[LOG_RING_MAX_ARGS];
+} log_record;
+
+void log_ring_init(void);
+int log_ring_write(log_site *, uint8_t, const char *, const char *, int, const uintptr_t *);
+int log_ring_flush(void);
+uint32_t log_ring_dropped(void);
+void log_ring_task_start(void);
+
+#define LOG_RING_ARG(x)     ((uintptr_t)(x))
+
+#define LOG_RING_ARGS_1(f)                          0
+#define LOG_RING_ARGS_2(f, a)                       LOG_RING_ARG(a)
+#define LOG_RING_ARGS_3(f, a, b)                    LOG_RING_ARGS_2(f, a), LOG_RING_ARG(b)
+#define LOG_RING_ARGS_4(f, a, b, c)                 LOG_RING_ARGS_3(f, a, b), LOG_RING_ARG(c)
+#define LOG_RING_ARGS_5(f, a, b, c, d)              LOG_RING_ARGS_4(f, a, b, c), LOG_RING_ARG(d)
+#define LOG_RING_ARGS_6(f, a, b, c, d, e)           LOG_RING_ARGS_5(f, a, b, c, d), LOG_RING_ARG(e)
+#define LOG_RING_ARGS_7(f, a, b, c, d, e, g)        LOG_RING_ARGS_6(f, a, b, c, d, e), LOG_RING_ARG(g)
+#define LOG_RING_ARGS_8(f, a, b, c, d, e, g, h)     LOG_RING_ARGS_7(f, a, b, c, d, e, g), LOG_RING_ARG(h)
+#define LOG_RING_ARGS_9(f, a, b, c, d, e, g, h, i)  LOG_RING_ARGS_8(f, a, b, c, d, e, g, h), LOG_RING_ARG(i)
+
+/* Counts the format string plus its arguments (1..9) */
+#define LOG_RING_NARGS(...) \
+    LOG_RING_NARGS_(__VA_ARGS__, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define LOG_RING_NARGS_(_1, _2, _3, _4, _5, _6, _7, _8, _9, N, ...)     N
+
+/* LOG_RING_WRITE(level, fmt, args...) : one static rate limit state per call site */
+#define LOG_RING_WRITE(level, ...) \
+    LOG_RING_WRITE_(level, LOG_RING_NARGS(__VA_ARGS__), __VA_ARGS__)
+#define LOG_RING_WRITE_(level, n, ...) \
+    LOG_RING_WRITE__(level, n, __VA_ARGS__)
+#define LOG_RING_WRITE__(level, n, ...) \
+    do \
+    { \
+        static log_site _log_site; \
+        const uintptr_t _log_args[] = { LOG_RING_ARGS_##n(__VA_ARGS__) }; \
+        log_ring_write(&_log_site, (level), __func__, LOG_RING_FMT(__VA_ARGS__), (n) - 1, _log_args); \
+    } while (0)
+#define LOG_RING_FMT(...)           LOG_RING_FMT_(__VA_ARGS__, 0)
+#define LOG_RING_FMT_(fmt, ...)     (fmt)
+
+#endif
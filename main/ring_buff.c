@@ -1,15 +1,86 @@
 #include "ring_buff.h"
+#include "trace_buf.h"
+
+#if defined(CONFIG_IDF_TARGET_ESP32)
+    #include "esp_timer.h"
+
+    static uint32_t buffer_platform_clock(void)
+    {
+        return (uint32_t)esp_timer_get_time();
+    }
+#elif defined(__linux__) && !defined(__KERNEL__)
+    #include <time.h>
+
+    static uint32_t buffer_platform_clock(void)
+    {
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint32_t)(ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000);
+    }
+#else
+    static uint32_t buffer_platform_clock(void)
+    {
+        return 0;   /* No clock : every sojourn is 0 and the AQM never drops */
+    }
+#endif
 
 static struct ring_buffer tx_ring_buff;
 static struct ring_buffer rx_ring_buff;
+static buffer_clock_fn buffer_clock = buffer_platform_clock;
+
+/* Trace arg : ring in the top byte (HW_QUEUE_TX / HW_QUEUE_RX), value below */
+#define BUFFER_TRACE_ARG(ring_buff, v) \
+    (((uint32_t)((ring_buff) == &rx_ring_buff) << 24) | ((uint32_t)(v) & 0xFFFFFF))
+
+/* Build time queue management of the device to host rings */
+void buffer_tx_aqm_config(buffer_aqm_config *config)
+{
+#if CONFIG_ESP_TX_QUEUE_AQM_CODEL
+    config->mode        = BUFFER_AQM_CODEL;
+    config->target_us   = CONFIG_ESP_TX_QUEUE_TARGET_MS * 1000;
+    config->interval_us = CONFIG_ESP_TX_QUEUE_INTERVAL_MS * 1000;
+#elif CONFIG_ESP_TX_QUEUE_AQM_DEADLINE
+    config->mode        = BUFFER_AQM_DEADLINE;
+    config->target_us   = CONFIG_ESP_TX_QUEUE_TARGET_MS * 1000;
+    config->interval_us = BUFFER_AQM_INTERVAL_US;
+#else
+    config->mode        = BUFFER_AQM_NONE;
+    config->target_us   = BUFFER_AQM_TARGET_US;
+    config->interval_us = BUFFER_AQM_INTERVAL_US;
+#endif
+}
+
+/* Empty ring with its lock, config NULL : tail drop only */
+void ring_buffer_init(struct ring_buffer *ring_buff, const buffer_aqm_config *config)
+{
+    memset(ring_buff, 0x0, sizeof(ring_buffer));
+    LOCK_INIT(&ring_buff->lock);
+
+    ring_buff->aqm.config.mode        = config ? config->mode : BUFFER_AQM_NONE;
+    ring_buff->aqm.config.target_us   = config ? config->target_us : BUFFER_AQM_TARGET_US;
+    ring_buff->aqm.config.interval_us = config ? config->interval_us : BUFFER_AQM_INTERVAL_US;
+}
 
 void buffer_init(void)
 {
-    memset(&tx_ring_buff, 0x0, sizeof(ring_buffer));
-    LOCK_INIT(&tx_ring_buff.lock);
+    buffer_aqm_config config;
 
-    memset(&rx_ring_buff, 0x0, sizeof(ring_buffer));
-    LOCK_INIT(&rx_ring_buff.lock);
+    buffer_tx_aqm_config(&config);
+    ring_buffer_init(&tx_ring_buff, &config);
+    ring_buffer_init(&rx_ring_buff, NULL);
+}
+
+/* Simulations run the rings on a virtual clock. NULL restores the platform clock */
+void buffer_set_clock(buffer_clock_fn clock)
+{
+    buffer_clock = clock ? clock : buffer_platform_clock;
+}
+
+/* Time base of enqueue_us */
+uint32_t buffer_now_us(void)
+{
+    return buffer_clock();
 }
 
 __inline static int is_buffer_empty(struct ring_buffer *ring_buff)
@@ -22,31 +93,63 @@ __inline static int is_buffer_full(struct ring_buffer *ring_buff)
     return (ring_buff->count >= BUFFER_COUNT);
 }
 
-int buffer_enqueue(struct ring_buffer *ring_buff, u8 *buf, int len)
+/*
+ * Enqueue hdr (may be NULL) followed by buf into one slot, without staging the two in a temp buffer.
+ * capture_us is the frame's receive time on air, when known.
+ */
+int buffer_enqueue_hdr(struct ring_buffer *ring_buff, const u8 *hdr, int hdr_len, u8 *buf, int len, u8 type,
+                       uint32_t capture_us)
 {
     if (is_buffer_full(ring_buff))
     {
         DEBUG_PRINT("ring buff count[%d]\n", ring_buff->count);
+        ring_buff->stats.tail_drops++;
+        TRACE_INSTANT(TRACE_ID_RING_TAIL_DROP, BUFFER_TRACE_ARG(ring_buff, ring_buff->count));
         return BUFFER_FULL;
     }
 
-    memcpy(ring_buff->buffers[ring_buff->tail].buf, buf, len);
-    ring_buff->buffers[ring_buff->tail].len = len;
+    if (len < 0 || hdr_len < 0 || hdr_len + len > MAX_BUFFER_SIZE)
+    {
+        DEBUG_PRINT("invalid len[%d + %d]\n", hdr_len, len);
+        return BUFFER_INVALID_LEN;
+    }
+
+    if (hdr_len > 0)
+    {
+        memcpy(ring_buff->buffers[ring_buff->tail].buf, hdr, hdr_len);
+    }
+    memcpy(ring_buff->buffers[ring_buff->tail].buf + hdr_len, buf, len);
+    ring_buff->buffers[ring_buff->tail].len = hdr_len + len;
+    ring_buff->buffers[ring_buff->tail].type = type;
+    ring_buff->buffers[ring_buff->tail].enqueue_us = buffer_clock();
+    ring_buff->buffers[ring_buff->tail].capture_us = capture_us;
     ring_buff->tail = (ring_buff->tail + 1) % BUFFER_COUNT;
     ring_buff->count++;
+    ring_buff->stats.enqueued++;
+    TRACE_INSTANT(TRACE_ID_RING_ENQUEUE, BUFFER_TRACE_ARG(ring_buff, ring_buff->count));
     return 0;
 }
 
-buffer *buffer_dequeue(struct ring_buffer *ring_buff)
+int buffer_enqueue(struct ring_buffer *ring_buff, u8 *buf, int len, u8 type)
+{
+    return buffer_enqueue_hdr(ring_buff, NULL, 0, buf, len, type, 0);
+}
+
+/* Oldest frame without removing it, NULL if empty. Caller holds the ring lock */
+buffer *buffer_peek(struct ring_buffer *ring_buff)
+{
+    return is_buffer_empty(ring_buff) ? NULL : &ring_buff->buffers[ring_buff->head];
+}
+
+static buffer *buffer_pop(struct ring_buffer *ring_buff)
 {
     buffer *buf;
 
     if (is_buffer_empty(ring_buff))
     {
-        DEBUG_PRINT("ring buff count[%d]\n", ring_buff->count);
         return NULL;
     }
-        
+
     buf = &ring_buff->buffers[ring_buff->head];
     ring_buff->head = (ring_buff->head + 1) % BUFFER_COUNT;
     ring_buff->count--;
@@ -54,6 +157,205 @@ buffer *buffer_dequeue(struct ring_buffer *ring_buff)
     return buf;
 }
 
+static uint32_t buffer_isqrt(uint32_t x)
+{
+    uint32_t r = 0, bit = 1UL << 30;
+
+    while (bit > x)
+    {
+        bit >>= 2;
+    }
+    while (bit)
+    {
+        if (x >= r + bit)
+        {
+            x -= r + bit;
+            r = (r >> 1) + bit;
+        }
+        else
+        {
+            r >>= 1;
+        }
+        bit >>= 2;
+    }
+    return r;
+}
+
+/* CoDel control law : the drop rate grows with the square root of consecutive drops */
+static uint32_t codel_control_law(buffer_aqm *aqm, uint32_t t)
+{
+    return t + aqm->config.interval_us / buffer_isqrt(aqm->drop_count);
+}
+
+/* RFC 8289 dodequeue() : is this frame part of a standing queue above target */
+static int codel_ok_to_drop(struct ring_buffer *ring_buff, uint32_t sojourn, uint32_t now)
+{
+    buffer_aqm *aqm = &ring_buff->aqm;
+
+    if (sojourn < aqm->config.target_us || ring_buff->count == 0)
+    {
+        aqm->first_above_us = 0;
+        return 0;
+    }
+    if (aqm->first_above_us == 0)
+    {
+        aqm->first_above_us = (now + aqm->config.interval_us) | 1;
+        return 0;
+    }
+    return (int32_t)(now - aqm->first_above_us) >= 0;
+}
+
+static void buffer_aged_out(struct ring_buffer *ring_buff, uint32_t sojourn)
+{
+    ring_buff->stats.aged_out++;
+    TRACE_INSTANT(TRACE_ID_RING_AGED_OUT, BUFFER_TRACE_ARG(ring_buff, sojourn));
+    DEBUG_PRINT("aged out [%u us]\n", (unsigned int)sojourn);
+}
+
+static buffer *codel_dequeue(struct ring_buffer *ring_buff, uint32_t now)
+{
+    buffer_aqm *aqm = &ring_buff->aqm;
+    buffer *buf = buffer_pop(ring_buff);
+    uint32_t sojourn;
+    int drop;
+
+    if (!buf)
+    {
+        aqm->first_above_us = 0;
+        aqm->dropping = 0;
+        return NULL;
+    }
+    sojourn = now - buf->enqueue_us;
+    drop = codel_ok_to_drop(ring_buff, sojourn, now);
+
+    if (aqm->dropping)
+    {
+        if (!drop)
+        {
+            aqm->dropping = 0;
+        }
+        while (aqm->dropping && (int32_t)(now - aqm->drop_next_us) >= 0)
+        {
+            buffer_aged_out(ring_buff, sojourn);
+            aqm->drop_count++;
+            buf = buffer_pop(ring_buff);
+            if (!buf)
+            {
+                aqm->dropping = 0;
+                return NULL;
+            }
+            sojourn = now - buf->enqueue_us;
+            if (!codel_ok_to_drop(ring_buff, sojourn, now))
+            {
+                aqm->dropping = 0;
+            }
+            else
+            {
+                aqm->drop_next_us = codel_control_law(aqm, aqm->drop_next_us);
+            }
+        }
+    }
+    else if (drop)
+    {
+        uint32_t delta = aqm->drop_count - 2;
+
+        buffer_aged_out(ring_buff, sojourn);
+        buf = buffer_pop(ring_buff);
+        if (buf)
+        {
+            sojourn = now - buf->enqueue_us;
+            codel_ok_to_drop(ring_buff, sojourn, now);
+        }
+        aqm->dropping = 1;
+
+        /* Re-entering soon after the last dropping state : resume near the previous rate */
+        if (aqm->drop_count > 2 && (int32_t)(now - aqm->drop_next_us) < (int32_t)(16 * aqm->config.interval_us))
+        {
+            aqm->drop_count = delta;
+        }
+        else
+        {
+            aqm->drop_count = 1;
+        }
+        aqm->drop_next_us = codel_control_law(aqm, now);
+    }
+    return buf;
+}
+
+buffer *buffer_dequeue(struct ring_buffer *ring_buff)
+{
+    uint32_t now = buffer_clock();
+    uint32_t sojourn;
+    buffer *buf;
+
+    if (is_buffer_empty(ring_buff))
+    {
+        DEBUG_PRINT("ring buff count[%d]\n", ring_buff->count);
+        return NULL;
+    }
+
+    switch (ring_buff->aqm.config.mode)
+    {
+        case BUFFER_AQM_CODEL:
+            buf = codel_dequeue(ring_buff, now);
+            break;
+
+        case BUFFER_AQM_DEADLINE:
+            while ((buf = buffer_pop(ring_buff)) != NULL &&
+                   now - buf->enqueue_us > ring_buff->aqm.config.target_us)
+            {
+                buffer_aged_out(ring_buff, now - buf->enqueue_us);
+            }
+            break;
+
+        default:
+            buf = buffer_pop(ring_buff);
+            break;
+    }
+
+    if (buf)
+    {
+        sojourn = now - buf->enqueue_us;
+        if (sojourn > ring_buff->stats.max_sojourn_us)
+        {
+            ring_buff->stats.max_sojourn_us = sojourn;
+        }
+        ring_buff->stats.dequeued++;
+        TRACE_INSTANT(TRACE_ID_RING_DEQUEUE, BUFFER_TRACE_ARG(ring_buff, sojourn));
+    }
+    return buf;
+}
+
+/*
+ * Put back the frame buffer_dequeue() just returned, within the same lock hold so
+ * its slot is untouched. Frames the AQM dropped on the way stay dropped.
+ */
+void buffer_unget(struct ring_buffer *ring_buff)
+{
+    ring_buff->head = (ring_buff->head + BUFFER_COUNT - 1) % BUFFER_COUNT;
+    ring_buff->count++;
+    ring_buff->stats.dequeued--;
+}
+
+void buffer_set_aqm(struct ring_buffer *ring_buff, const buffer_aqm_config *config)
+{
+    LOCK(&ring_buff->lock);
+    memset(&ring_buff->aqm, 0x0, sizeof(buffer_aqm));
+    ring_buff->aqm.config = *config;
+    if (ring_buff->aqm.config.interval_us == 0)
+    {
+        ring_buff->aqm.config.interval_us = BUFFER_AQM_INTERVAL_US;
+    }
+    UNLOCK(&ring_buff->lock);
+}
+
+void buffer_get_stats(struct ring_buffer *ring_buff, buffer_stats *stats)
+{
+    LOCK(&ring_buff->lock);
+    *stats = ring_buff->stats;
+    UNLOCK(&ring_buff->lock);
+}
+
 /* Tx Ring buff */
 int is_tx_buffer_empty(void)
 {
@@ -65,9 +367,19 @@ int is_tx_buffer_full(void)
     return is_buffer_full(&tx_ring_buff);
 }
 
-int tx_buffer_enqueue(u8 *buf, int len)
+int tx_buffer_count(void)
+{
+    return tx_ring_buff.count;
+}
+
+int tx_buffer_enqueue(u8 *buf, int len, u8 type)
 {
-    return buffer_enqueue(&tx_ring_buff, buf, len);
+    return buffer_enqueue(&tx_ring_buff, buf, len, type);
+}
+
+int tx_buffer_enqueue_hdr(const u8 *hdr, int hdr_len, u8 *buf, int len, u8 type, uint32_t capture_us)
+{
+    return buffer_enqueue_hdr(&tx_ring_buff, hdr, hdr_len, buf, len, type, capture_us);
 }
 
 buffer *tx_buffer_dequeue(void)
@@ -85,6 +397,16 @@ void tx_buffer_critical_section_unlock(void)
     UNLOCK(&tx_ring_buff.lock);
 }
 
+void tx_buffer_set_aqm(const buffer_aqm_config *config)
+{
+    buffer_set_aqm(&tx_ring_buff, config);
+}
+
+void tx_buffer_get_stats(buffer_stats *stats)
+{
+    buffer_get_stats(&tx_ring_buff, stats);
+}
+
 
 /* RX Ring buff */
 int is_rx_buffer_empty(void)
@@ -97,9 +419,9 @@ int is_rx_buffer_full(void)
     return is_buffer_full(&rx_ring_buff);
 }
 
-int rx_buffer_enqueue(u8 *buf, int len)
+int rx_buffer_enqueue(u8 *buf, int len, u8 type)
 {
-    return buffer_enqueue(&rx_ring_buff, buf, len);
+    return buffer_enqueue(&rx_ring_buff, buf, len, type);
 }
 
 buffer *rx_buffer_dequeue(void)
@@ -117,6 +439,16 @@ void rx_buffer_critical_section_unlock(void)
     UNLOCK(&rx_ring_buff.lock);
 }
 
+void rx_buffer_set_aqm(const buffer_aqm_config *config)
+{
+    buffer_set_aqm(&rx_ring_buff, config);
+}
+
+void rx_buffer_get_stats(buffer_stats *stats)
+{
+    buffer_get_stats(&rx_ring_buff, stats);
+}
+
 void buffer_deinit(void)
 {
     tx_buffer_critical_section_lock();
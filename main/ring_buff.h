@@ -8,13 +8,52 @@
 #define BUFFER_FULL             (-1)
 #define BUFFER_EMPTY            (NULL)
 #define BUFFER_ENQUEUE_SUCESS   (0)
+#define BUFFER_INVALID_LEN      (-2)
+
+/* Queue management applied at dequeue, on the time a frame spent in the ring (sojourn) */
+#define BUFFER_AQM_NONE         (0)     /* Tail drop only */
+#define BUFFER_AQM_CODEL        (1)     /* CoDel : drop while sojourn stays above target for an interval */
+#define BUFFER_AQM_DEADLINE     (2)     /* Drop every frame older than target */
+
+#define BUFFER_AQM_TARGET_US    (5000)
+#define BUFFER_AQM_INTERVAL_US  (100000)
+
+typedef uint32_t (*buffer_clock_fn)(void);
 
 typedef struct buffer
 {
     u8 buf[MAX_BUFFER_SIZE];
     int len;
+    u8 type;
+    uint32_t enqueue_us;
+    uint32_t capture_us;        /* 0 : unknown */
 } buffer;
 
+typedef struct buffer_aqm_config
+{
+    u8 mode;
+    uint32_t target_us;
+    uint32_t interval_us;
+} buffer_aqm_config;
+
+typedef struct buffer_stats
+{
+    uint32_t enqueued;
+    uint32_t dequeued;
+    uint32_t tail_drops;        /* Ring full at enqueue */
+    uint32_t aged_out;          /* Dropped by the AQM at dequeue */
+    uint32_t max_sojourn_us;    /* Of the frames handed out */
+} buffer_stats;
+
+typedef struct buffer_aqm
+{
+    buffer_aqm_config config;
+    uint32_t first_above_us;    /* 0 : sojourn below target */
+    uint32_t drop_next_us;
+    uint32_t drop_count;
+    u8 dropping;
+} buffer_aqm;
+
 typedef struct ring_buffer
 {
     buffer buffers[BUFFER_COUNT];
@@ -22,23 +61,43 @@ typedef struct ring_buffer
     int tail;
     u8 count;
     lock_t lock;
+    buffer_aqm aqm;
+    buffer_stats stats;
 } ring_buffer;
 
+/* Any ring : callers hold ring_buff->lock around enqueue / dequeue / peek */
+void ring_buffer_init(ring_buffer *, const buffer_aqm_config *);
+int buffer_enqueue_hdr(ring_buffer *, const u8 *, int, u8 *, int, u8, uint32_t);
+buffer *buffer_dequeue(ring_buffer *);
+buffer *buffer_peek(ring_buffer *);
+void buffer_unget(ring_buffer *);
+void buffer_set_aqm(ring_buffer *, const buffer_aqm_config *);
+void buffer_get_stats(ring_buffer *, buffer_stats *);
+void buffer_tx_aqm_config(buffer_aqm_config *);
+
 void buffer_init(void);
 void buffer_deinit(void);
+void buffer_set_clock(buffer_clock_fn);
+uint32_t buffer_now_us(void);
 
 int is_tx_buffer_empty(void);
 int is_tx_buffer_full(void);
-int tx_buffer_enqueue(u8 *, int);
+int tx_buffer_count(void);
+int tx_buffer_enqueue(u8 *, int, u8);
+int tx_buffer_enqueue_hdr(const u8 *, int, u8 *, int, u8, uint32_t);
 buffer *tx_buffer_dequeue(void);
 void tx_buffer_critical_section_lock(void);
 void tx_buffer_critical_section_unlock(void);
+void tx_buffer_set_aqm(const buffer_aqm_config *);
+void tx_buffer_get_stats(buffer_stats *);
 
 int is_rx_buffer_empty(void);
 int is_rx_buffer_full(void);
-int rx_buffer_enqueue(u8 *, int);
+int rx_buffer_enqueue(u8 *, int, u8);
 buffer *rx_buffer_dequeue(void);
 void rx_buffer_critical_section_lock(void);
 void rx_buffer_critical_section_unlock(void);
+void rx_buffer_set_aqm(const buffer_aqm_config *);
+void rx_buffer_get_stats(buffer_stats *);
 
 #endif
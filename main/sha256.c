@@ -0,0 +1,148 @@
+#include "sha256.h"
+
+#if defined(CONFIG_IDF_TARGET_ESP32)
+
+void sha256_init(sha256_ctx *ctx)
+{
+    mbedtls_sha256_init(ctx);
+    mbedtls_sha256_starts(ctx, 0);
+}
+
+void sha256_update(sha256_ctx *ctx, const u8 *data, size_t len)
+{
+    mbedtls_sha256_update(ctx, data, len);
+}
+
+void sha256_final(sha256_ctx *ctx, u8 *digest)
+{
+    mbedtls_sha256_finish(ctx, digest);
+    mbedtls_sha256_free(ctx);
+}
+
+#else
+
+/* FIPS 180-4 */
+static const uint32_t sha256_k[64] =
+{
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+#define ROTR(x, n)      (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void sha256_block(sha256_ctx *ctx, const u8 *p)
+{
+    uint32_t w[64], a, b, c, d, e, f, g, h, t1, t2;
+    int i;
+
+    for (i = 0; i < 16; i++)
+    {
+        w[i] = ((uint32_t)p[i * 4] << 24) | ((uint32_t)p[i * 4 + 1] << 16) |
+               ((uint32_t)p[i * 4 + 2] << 8) | p[i * 4 + 3];
+    }
+    for (i = 16; i < 64; i++)
+    {
+        w[i] = (ROTR(w[i - 2], 17) ^ ROTR(w[i - 2], 19) ^ (w[i - 2] >> 10)) + w[i - 7] +
+               (ROTR(w[i - 15], 7) ^ ROTR(w[i - 15], 18) ^ (w[i - 15] >> 3)) + w[i - 16];
+    }
+
+    a = ctx->state[0]; b = ctx->state[1]; c = ctx->state[2]; d = ctx->state[3];
+    e = ctx->state[4]; f = ctx->state[5]; g = ctx->state[6]; h = ctx->state[7];
+    for (i = 0; i < 64; i++)
+    {
+        t1 = h + (ROTR(e, 6) ^ ROTR(e, 11) ^ ROTR(e, 25)) + ((e & f) ^ (~e & g)) + sha256_k[i] + w[i];
+        t2 = (ROTR(a, 2) ^ ROTR(a, 13) ^ ROTR(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+    ctx->state[0] += a; ctx->state[1] += b; ctx->state[2] += c; ctx->state[3] += d;
+    ctx->state[4] += e; ctx->state[5] += f; ctx->state[6] += g; ctx->state[7] += h;
+}
+
+void sha256_init(sha256_ctx *ctx)
+{
+    static const uint32_t iv[8] =
+    {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+    };
+
+    memcpy(ctx->state, iv, sizeof(iv));
+    ctx->len = 0;
+    ctx->fill = 0;
+}
+
+void sha256_update(sha256_ctx *ctx, const u8 *data, size_t len)
+{
+    size_t n;
+
+    ctx->len += len;
+    while (len > 0)
+    {
+        if (ctx->fill == 0 && len >= 64)
+        {
+            sha256_block(ctx, data);
+            data += 64;
+            len -= 64;
+            continue;
+        }
+        n = 64 - ctx->fill;
+        if (n > len)
+        {
+            n = len;
+        }
+        memcpy(&ctx->block[ctx->fill], data, n);
+        ctx->fill += (int)n;
+        data += n;
+        len -= n;
+        if (ctx->fill == 64)
+        {
+            sha256_block(ctx, ctx->block);
+            ctx->fill = 0;
+        }
+    }
+}
+
+void sha256_final(sha256_ctx *ctx, u8 *digest)
+{
+    uint64_t bits = ctx->len * 8;
+    int i;
+
+    ctx->block[ctx->fill++] = 0x80;
+    if (ctx->fill > 56)
+    {
+        memset(&ctx->block[ctx->fill], 0x0, 64 - ctx->fill);
+        sha256_block(ctx, ctx->block);
+        ctx->fill = 0;
+    }
+    memset(&ctx->block[ctx->fill], 0x0, 56 - ctx->fill);
+    for (i = 0; i < 8; i++)
+    {
+        ctx->block[56 + i] = (u8)(bits >> (56 - i * 8));
+    }
+    sha256_block(ctx, ctx->block);
+
+    for (i = 0; i < 8; i++)
+    {
+        digest[i * 4]     = (u8)(ctx->state[i] >> 24);
+        digest[i * 4 + 1] = (u8)(ctx->state[i] >> 16);
+        digest[i * 4 + 2] = (u8)(ctx->state[i] >> 8);
+        digest[i * 4 + 3] = (u8)ctx->state[i];
+    }
+}
+
+#endif /* CONFIG_IDF_TARGET_ESP32 */
+
+void sha256(const u8 *data, size_t len, u8 *digest)
+{
+    sha256_ctx ctx;
+
+    sha256_init(&ctx);
+    sha256_update(&ctx, data, len);
+    sha256_final(&ctx, digest);
+}
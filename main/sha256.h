@@ -0,0 +1,32 @@
+#ifndef _SHA256_H
+#define _SHA256_H
+
+#include "utils.h"
+
+/*
+ * SHA-256 for the firmware update path. The ESP32 build maps onto mbedtls
+ * (hardware accelerated); other builds use the portable implementation.
+ */
+
+#define SHA256_LEN              (32)
+
+#if defined(CONFIG_IDF_TARGET_ESP32)
+    #include "mbedtls/sha256.h"
+
+    typedef mbedtls_sha256_context sha256_ctx;
+#else
+    typedef struct sha256_ctx
+    {
+        uint32_t state[8];
+        uint64_t len;           /* Bytes hashed */
+        u8 block[64];
+        int fill;
+    } sha256_ctx;
+#endif
+
+void sha256_init(sha256_ctx *);
+void sha256_update(sha256_ctx *, const u8 *, size_t);
+void sha256_final(sha256_ctx *, u8 *);
+void sha256(const u8 *, size_t, u8 *);
+
+#endif
@@ -0,0 +1,152 @@
+#include "trace_buf.h"
+
+static const char *const trace_id_names[TRACE_ID_MAX] =
+{
+    [TRACE_ID_NONE]           = "none",
+    [TRACE_ID_WIFI_RX]        = "wifi_rx",
+    [TRACE_ID_ETH_CONVERT]    = "eth_convert",
+    [TRACE_ID_RING_ENQUEUE]   = "ring_enqueue",
+    [TRACE_ID_RING_DEQUEUE]   = "ring_dequeue",
+    [TRACE_ID_RING_TAIL_DROP] = "ring_tail_drop",
+    [TRACE_ID_RING_AGED_OUT]  = "ring_aged_out",
+    [TRACE_ID_LINK_TX_FETCH]  = "link_tx_fetch",
+    [TRACE_ID_LINK_XFER_HDR]  = "link_xfer_hdr",
+    [TRACE_ID_LINK_XFER_DATA] = "link_xfer_data",
+    [TRACE_ID_LINK_RX]        = "link_rx",
+    [TRACE_ID_LINK_CMD]       = "link_cmd",
+    [TRACE_ID_WIFI_TX]        = "wifi_tx",
+};
+
+const char *trace_id_name(uint16_t id)
+{
+    return (id < TRACE_ID_MAX) ? trace_id_names[id] : "unknown";
+}
+
+void trace_event_decode(const u8 *wire, trace_event *ev)
+{
+    ev->tag    = 0;
+    ev->cycles = hw_lcp_get_le32(&wire[TRACE_WIRE_CYCLES]);
+    ev->arg    = hw_lcp_get_le32(&wire[TRACE_WIRE_ARG]);
+    ev->id     = (uint16_t)(wire[TRACE_WIRE_ID] | (wire[TRACE_WIRE_ID + 1] << 8));
+    ev->core   = wire[TRACE_WIRE_CORE];
+    ev->phase  = wire[TRACE_WIRE_PHASE];
+}
+
+#if CONFIG_ESP_TRACE
+
+trace_event trace_buf_ring[TRACE_BUF_EVENTS];
+uint32_t trace_buf_head;
+
+/* Reader side, single consumer (command handler or dump) */
+static uint32_t trace_buf_tail;
+static uint32_t dropped;
+
+void trace_buf_init(void)
+{
+    memset(trace_buf_ring, 0x0, sizeof(trace_buf_ring));
+    __atomic_store_n(&trace_buf_head, 0, __ATOMIC_RELEASE);
+    trace_buf_tail = 0;
+    dropped = 0;
+}
+
+/*
+ * Copy out the next published event. Returns 1 on success, 0 when the reader
+ * caught up with the writers, -1 if the event was overwritten (skipped).
+ */
+static int trace_buf_next(trace_event *ev)
+{
+    uint32_t head = __atomic_load_n(&trace_buf_head, __ATOMIC_ACQUIRE);
+    trace_event *slot;
+    uint32_t tag;
+
+    /* Lapped : everything older than one buffer length is gone */
+    if (head - trace_buf_tail > TRACE_BUF_EVENTS)
+    {
+        dropped += head - trace_buf_tail - TRACE_BUF_EVENTS;
+        trace_buf_tail = head - TRACE_BUF_EVENTS;
+    }
+    if (trace_buf_tail == head)
+    {
+        return 0;
+    }
+
+    slot = &trace_buf_ring[trace_buf_tail & TRACE_BUF_MASK];
+    tag = __atomic_load_n(&slot->tag, __ATOMIC_ACQUIRE);
+    if (tag == 0 || (int32_t)(tag - (trace_buf_tail + 1)) < 0)
+    {
+        /* Claimed but not published yet : try again on the next drain */
+        return 0;
+    }
+
+    *ev = *slot;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (tag != trace_buf_tail + 1 || __atomic_load_n(&slot->tag, __ATOMIC_RELAXED) != tag)
+    {
+        dropped++;
+        trace_buf_tail++;
+        return -1;
+    }
+    trace_buf_tail++;
+    return 1;
+}
+
+/* Build one HW_CMD_TRACE_DRAIN reply into out (HW_LCP_MAX_PAYLOAD_LEN bytes). Returns its length */
+int trace_buf_drain(u8 *out, int cmd)
+{
+    trace_event ev;
+    u8 *wire;
+    int count = 0, ret;
+
+    while (count < TRACE_REPLY_MAX_EVENTS && (ret = trace_buf_next(&ev)) != 0)
+    {
+        if (ret < 0)
+        {
+            continue;
+        }
+        wire = &out[TRACE_REPLY_EVENTS + count * TRACE_WIRE_LEN];
+        hw_lcp_put_le32(&wire[TRACE_WIRE_CYCLES], ev.cycles);
+        hw_lcp_put_le32(&wire[TRACE_WIRE_ARG], ev.arg);
+        wire[TRACE_WIRE_ID]     = (u8)(ev.id & 0xFF);
+        wire[TRACE_WIRE_ID + 1] = (u8)(ev.id >> 8);
+        wire[TRACE_WIRE_CORE]   = ev.core;
+        wire[TRACE_WIRE_PHASE]  = ev.phase;
+        count++;
+    }
+
+    out[TRACE_REPLY_CMD]      = (u8)cmd;
+    out[TRACE_REPLY_COUNT]    = (u8)count;
+    out[TRACE_REPLY_MORE]     = (trace_buf_tail != __atomic_load_n(&trace_buf_head, __ATOMIC_ACQUIRE));
+    out[TRACE_REPLY_RESERVED] = 0;
+    hw_lcp_put_le32(&out[TRACE_REPLY_DROPPED], dropped);
+    out[TRACE_REPLY_MHZ]      = (u8)(TRACE_BUF_MHZ & 0xFF);
+    out[TRACE_REPLY_MHZ + 1]  = (u8)(TRACE_BUF_MHZ >> 8);
+
+    return TRACE_REPLY_EVENTS + count * TRACE_WIRE_LEN;
+}
+
+/* Print and consume every pending event */
+void trace_buf_dump(void)
+{
+    static const char phase_chars[] = { 'i', 'B', 'E' };
+    trace_event ev;
+    int ret;
+
+    while ((ret = trace_buf_next(&ev)) != 0)
+    {
+        if (ret < 0)
+        {
+            continue;
+        }
+        printf("T %10u %u %c %-15s %u\n", (unsigned int)ev.cycles, ev.core,
+               (ev.phase <= TRACE_PH_END) ? phase_chars[ev.phase] : '?', trace_id_name(ev.id),
+               (unsigned int)ev.arg);
+    }
+    printf("T dropped %u, %u MHz\n", (unsigned int)dropped, (unsigned int)TRACE_BUF_MHZ);
+}
+
+uint32_t trace_buf_dropped(void)
+{
+    return dropped;
+}
+
+#endif /* CONFIG_ESP_TRACE */
@@ -0,0 +1,156 @@
+#ifndef _TRACE_BUF_H
+#define _TRACE_BUF_H
+
+#include "utils.h"
+#include "hw_link_ctrl_protocol.h"
+
+/*
+ * Timestamped event trace (CONFIG_ESP_TRACE).
+ *
+ * TRACE_BEGIN / TRACE_END / TRACE_INSTANT store a fixed size event (id, cycle
+ * count, core, arg) into a lock-free circular buffer that overwrites the oldest
+ * events. Writers claim a slot with one atomic add; the slot tag publishes it,
+ * so a reader that got lapped drops the event instead of returning a torn one.
+ *
+ * The buffer is drained over the link with HW_CMD_TRACE_DRAIN (host side :
+ * lcp_trace, Chrome trace JSON) or printed to the console with trace_buf_dump().
+ * Without CONFIG_ESP_TRACE the macros expand to nothing and no buffer exists.
+ */
+
+#ifdef CONFIG_ESP_TRACE_EVENTS
+#define TRACE_BUF_EVENTS            CONFIG_ESP_TRACE_EVENTS
+#else
+#define TRACE_BUF_EVENTS            (1024)
+#endif
+
+#if (TRACE_BUF_EVENTS & (TRACE_BUF_EVENTS - 1)) != 0
+#error "CONFIG_ESP_TRACE_EVENTS must be a power of 2"
+#endif
+
+#define TRACE_BUF_MASK              (TRACE_BUF_EVENTS - 1)
+
+enum trace_phase
+{
+    TRACE_PH_INSTANT = 0,
+    TRACE_PH_BEGIN,
+    TRACE_PH_END,
+};
+
+enum trace_id
+{
+    TRACE_ID_NONE = 0,
+    TRACE_ID_WIFI_RX,           /* Promiscuous callback, arg : sig_len */
+    TRACE_ID_ETH_CONVERT,       /* 802.11 -> 802.3, arg : len */
+    TRACE_ID_RING_ENQUEUE,      /* arg : ring << 24 | count after */
+    TRACE_ID_RING_DEQUEUE,      /* arg : ring << 24 | sojourn us */
+    TRACE_ID_RING_TAIL_DROP,    /* arg : ring << 24 | count */
+    TRACE_ID_RING_AGED_OUT,     /* arg : ring << 24 | sojourn us */
+    TRACE_ID_LINK_TX_FETCH,     /* arg : len */
+    TRACE_ID_LINK_XFER_HDR,     /* Phase 1 exchange, arg : tx len */
+    TRACE_ID_LINK_XFER_DATA,    /* Phase 2 exchange, arg : data len */
+    TRACE_ID_LINK_RX,           /* Host frame handling, arg : type << 16 | len */
+    TRACE_ID_LINK_CMD,          /* arg : command */
+    TRACE_ID_WIFI_TX,           /* esp_wifi_80211_tx, arg : len */
+    TRACE_ID_MAX,
+};
+
+/* Memory layout, 16 bytes */
+typedef struct trace_event
+{
+    uint32_t tag;               /* Claim position + 1, 0 while being written */
+    uint32_t cycles;
+    uint32_t arg;
+    uint16_t id;
+    u8 core;
+    u8 phase;
+} trace_event;
+
+/* Wire layout of an event in the HW_CMD_TRACE_DRAIN reply, little endian */
+enum trace_wire_field
+{
+    TRACE_WIRE_CYCLES = 0,
+    TRACE_WIRE_ARG = 4,
+    TRACE_WIRE_ID = 8,
+    TRACE_WIRE_CORE = 10,
+    TRACE_WIRE_PHASE = 11,
+    TRACE_WIRE_LEN = 12,
+};
+
+/* HW_CMD_TRACE_DRAIN reply : header followed by count wire events */
+enum trace_reply_field
+{
+    TRACE_REPLY_CMD = 0,
+    TRACE_REPLY_COUNT = 1,
+    TRACE_REPLY_MORE = 2,       /* Events were left in the buffer */
+    TRACE_REPLY_RESERVED = 3,
+    TRACE_REPLY_DROPPED = 4,    /* LE32, overwritten before they were drained, total */
+    TRACE_REPLY_MHZ = 8,        /* LE16, cycles per us */
+    TRACE_REPLY_EVENTS = 10,
+};
+
+#define TRACE_REPLY_MAX_EVENTS      ((HW_LCP_MAX_PAYLOAD_LEN - TRACE_REPLY_EVENTS) / TRACE_WIRE_LEN)
+
+#if defined(CONFIG_IDF_TARGET_ESP32)
+    #include "esp_cpu.h"
+
+    #define TRACE_BUF_MHZ               CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ
+    #define TRACE_BUF_CYCLES()          esp_cpu_get_cycle_count()
+    #define TRACE_BUF_CORE()            esp_cpu_get_core_id()
+#else
+    #include <sched.h>
+    #include <time.h>
+
+    /* Userspace : ns stand in for cycles */
+    static inline uint32_t trace_buf_host_cycles(void)
+    {
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint32_t)(ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+    }
+    #define TRACE_BUF_MHZ               (1000)
+    #define TRACE_BUF_CYCLES()          trace_buf_host_cycles()
+    #define TRACE_BUF_CORE()            sched_getcpu()
+#endif
+
+const char *trace_id_name(uint16_t);
+void trace_event_decode(const u8 *, trace_event *);
+
+#if CONFIG_ESP_TRACE
+
+extern trace_event trace_buf_ring[TRACE_BUF_EVENTS];
+extern uint32_t trace_buf_head;
+
+static inline void trace_buf_write(uint16_t id, u8 phase, uint32_t arg)
+{
+    uint32_t pos = __atomic_fetch_add(&trace_buf_head, 1, __ATOMIC_RELAXED);
+    trace_event *ev = &trace_buf_ring[pos & TRACE_BUF_MASK];
+
+    __atomic_store_n(&ev->tag, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    ev->cycles = TRACE_BUF_CYCLES();
+    ev->arg    = arg;
+    ev->id     = id;
+    ev->core   = (u8)TRACE_BUF_CORE();
+    ev->phase  = phase;
+    __atomic_store_n(&ev->tag, pos + 1, __ATOMIC_RELEASE);
+}
+
+void trace_buf_init(void);
+int trace_buf_drain(u8 *, int);
+void trace_buf_dump(void);
+uint32_t trace_buf_dropped(void);
+
+#define TRACE_BEGIN(id, arg)        trace_buf_write((id), TRACE_PH_BEGIN, (uint32_t)(arg))
+#define TRACE_END(id, arg)          trace_buf_write((id), TRACE_PH_END, (uint32_t)(arg))
+#define TRACE_INSTANT(id, arg)      trace_buf_write((id), TRACE_PH_INSTANT, (uint32_t)(arg))
+
+#else /* CONFIG_ESP_TRACE */
+
+#define TRACE_BEGIN(id, arg)
+#define TRACE_END(id, arg)
+#define TRACE_INSTANT(id, arg)
+
+#endif /* CONFIG_ESP_TRACE */
+
+#endif
@@ -5,7 +5,7 @@
     #include "sdkconfig.h"
 #endif
 
-#if defined(__linux__)
+#if defined(__linux__) && defined(__KERNEL__)
     #include <linux/slab.h>
     #include <linux/kernel.h>
     #include <linux/spinlock.h>
@@ -67,6 +67,7 @@
     #include "freertos/semphr.h"
     
     #include "esp_log.h"
+    #include "esp_attr.h"
     
     typedef SemaphoreHandle_t lock_t;
     typedef uint8_t u8;
@@ -85,6 +86,43 @@
 
     #define CURRENT_LOG_LEVEL   LOG_LEVEL_INFO
 
+    #if CONFIG_ESP_DEFERRED_LOG
+    /* Hot path safe : records go to the log ring, formatting happens in the log task */
+    #include "log_ring.h"
+
+    #if CURRENT_LOG_LEVEL >= LOG_LEVEL_TRACE
+    #define TRACE_FUNC_ENTRY() \
+        LOG_RING_WRITE(LOG_LEVEL_TRACE, "start")
+    #define TRACE_FUNC_EXIT() \
+        LOG_RING_WRITE(LOG_LEVEL_TRACE, "exit")
+    #else
+    #define TRACE_FUNC_ENTRY()
+    #define TRACE_FUNC_EXIT()
+    #endif
+
+    #if CURRENT_LOG_LEVEL >= LOG_LEVEL_DEBUG
+    #define DEBUG_PRINT(...) \
+        LOG_RING_WRITE(LOG_LEVEL_DEBUG, __VA_ARGS__)
+    #else
+    #define DEBUG_PRINT(fmt, ...)
+    #endif
+
+    #if CURRENT_LOG_LEVEL >= LOG_LEVEL_INFO
+    #define INFO_PRINT(...) \
+        LOG_RING_WRITE(LOG_LEVEL_INFO, __VA_ARGS__)
+    #else
+    #define INFO_PRINT(fmt, ...)
+    #endif
+
+    #if CURRENT_LOG_LEVEL >= LOG_LEVEL_ERROR
+    #define ERROR_PRINT(...) \
+        LOG_RING_WRITE(LOG_LEVEL_ERROR, __VA_ARGS__)
+    #else
+    #define ERROR_PRINT(fmt, ...)
+    #endif
+
+    #else /* CONFIG_ESP_DEFERRED_LOG */
+
     #if CURRENT_LOG_LEVEL >= LOG_LEVEL_TRACE
     #define TRACE_FUNC_ENTRY() \
         ESP_LOGI(PRINT_LOGO_NAME, "[%s] : start", __func__)
@@ -116,6 +154,68 @@
     #define ERROR_PRINT(fmt, ...)
     #endif
 
+    #endif /* CONFIG_ESP_DEFERRED_LOG */
+
+#elif defined(__linux__)
+    /* Userspace build of the portable modules (host library, simulations) */
+    #include <stdio.h>
+    #include <stdlib.h>
+    #include <stdint.h>
+    #include <string.h>
+    #include <pthread.h>
+
+    typedef pthread_mutex_t lock_t;
+    typedef uint8_t u8;
+
+    #define WORD_ALIGNED_ATTR   __attribute__((aligned(4)))
+
+    #define PRINT_LOGO_NAME     "esp32_host"
+
+    #define FREE(x)     free(x)
+
+    #define LOCK_INIT(x)   pthread_mutex_init(x, NULL)
+    #define LOCK(x)        pthread_mutex_lock(x)
+    #define UNLOCK(x)      pthread_mutex_unlock(x)
+
+    #define LOG_LEVEL_NONE      0
+    #define LOG_LEVEL_ERROR     1
+    #define LOG_LEVEL_INFO      2
+    #define LOG_LEVEL_DEBUG     3
+    #define LOG_LEVEL_TRACE     4
+
+    #define CURRENT_LOG_LEVEL   LOG_LEVEL_ERROR
+
+    #if CURRENT_LOG_LEVEL >= LOG_LEVEL_TRACE
+    #define TRACE_FUNC_ENTRY() \
+        fprintf(stderr, "[%s] - [%s] : start\n", PRINT_LOGO_NAME, __func__)
+    #define TRACE_FUNC_EXIT() \
+        fprintf(stderr, "[%s] - [%s] : exit\n", PRINT_LOGO_NAME, __func__)
+    #else
+    #define TRACE_FUNC_ENTRY()
+    #define TRACE_FUNC_EXIT()
+    #endif
+
+    #if CURRENT_LOG_LEVEL >= LOG_LEVEL_DEBUG
+    #define DEBUG_PRINT(fmt, ...) \
+        fprintf(stderr, "[%s] - [%s] (DEBUG) : " fmt, PRINT_LOGO_NAME, __func__, ##__VA_ARGS__)
+    #else
+    #define DEBUG_PRINT(fmt, ...)
+    #endif
+
+    #if CURRENT_LOG_LEVEL >= LOG_LEVEL_INFO
+    #define INFO_PRINT(fmt, ...) \
+        fprintf(stderr, "[%s] - [%s] (INFO) : " fmt, PRINT_LOGO_NAME, __func__, ##__VA_ARGS__)
+    #else
+    #define INFO_PRINT(fmt, ...)
+    #endif
+
+    #if CURRENT_LOG_LEVEL >= LOG_LEVEL_ERROR
+    #define ERROR_PRINT(fmt, ...) \
+        fprintf(stderr, "[%s] - [%s] (ERROR) : " fmt, PRINT_LOGO_NAME, __func__, ##__VA_ARGS__)
+    #else
+    #define ERROR_PRINT(fmt, ...)
+    #endif
+
 #else
     #error "Unknown system!"
 #endif /* CONFIG_IDF_TARGET_ESP32 */
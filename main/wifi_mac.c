@@ -0,0 +1,37 @@
+#include <string.h>
+
+#include "wifi_mac.h"
+
+#define WIFI_MAC_LEN                  6
+
+static uint8_t current_mac[WIFI_MAC_LEN];
+static bool is_current_mac_set = false;
+
+/* Station MAC, set by wifi_service once the interface is up */
+void wifi_mac_set_current(const uint8_t *mac)
+{
+    memcpy(current_mac, mac, WIFI_MAC_LEN);
+    is_current_mac_set = true;
+}
+
+bool is_current_wifi_srv_mac(const uint8_t *mac)
+{
+    return is_current_mac_set && memcmp(current_mac, mac, WIFI_MAC_LEN) == 0;
+}
+
+bool is_broadcast_address(const uint8_t *mac)
+{
+    for (int i = 0; i < WIFI_MAC_LEN; i++)
+    {
+        if (mac[i] != 0xFF)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool is_multicast_address(const uint8_t *mac)
+{
+    return (mac[0] & 0x01) == 1;
+}
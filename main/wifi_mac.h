@@ -0,0 +1,13 @@
+#ifndef _WIFI_MAC_H
+#define _WIFI_MAC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Address checks on the frame path. No ESP-IDF dependency, so they also build on Linux */
+void wifi_mac_set_current(const uint8_t *);
+bool is_current_wifi_srv_mac(const uint8_t *);
+bool is_broadcast_address(const uint8_t *);
+bool is_multicast_address(const uint8_t *);
+
+#endif
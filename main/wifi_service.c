@@ -51,6 +51,10 @@ static EventGroupHandle_t s_wifi_event_group;
 static int s_retry_num;
 static uint8_t cached_mac[WIFI_MAC_LEN];
 static bool is_mac_initialized = false;
+static uint8_t cached_bssid[WIFI_MAC_LEN];
+#if CONFIG_ESP_LCP_SOFTAP
+static uint8_t cached_ap_mac[WIFI_MAC_LEN];
+#endif
 static uint8_t wifi_ssid[32];
 static uint8_t wifi_pw[128];
  const wifi_promiscuous_filter_t filt =
@@ -116,8 +120,11 @@ static void wifi_srv_event_handler(void* arg, esp_event_base_t event_base,
 
         xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
     }
-    else if (event_id == WIFI_EVENT_STA_CONNECTED)
+    else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED)
     {
+        wifi_event_sta_connected_t *event = (wifi_event_sta_connected_t *)event_data;
+
+        memcpy(cached_bssid, event->bssid, WIFI_MAC_LEN);
         INFO_PRINT("event_id=[%d]\n", (int)event_id);
         //xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
         //esp_wifi_disconnect();
@@ -128,6 +135,23 @@ static void wifi_srv_event_handler(void* arg, esp_event_base_t event_base,
     }
 }
 
+#if CONFIG_ESP_LCP_SOFTAP
+/* SoftAP next to the station. The driver moves it to the station's channel on association */
+static void wifi_srv_softap_config(void)
+{
+    wifi_config_t ap_config = {0};
+
+    strcpy((char *)ap_config.ap.ssid, CONFIG_ESP_LCP_SOFTAP_SSID);
+    ap_config.ap.ssid_len = strlen(CONFIG_ESP_LCP_SOFTAP_SSID);
+    strcpy((char *)ap_config.ap.password, CONFIG_ESP_LCP_SOFTAP_PASSWORD);
+    ap_config.ap.channel = CONFIG_ESP_LCP_SOFTAP_CHANNEL;
+    ap_config.ap.max_connection = CONFIG_ESP_LCP_SOFTAP_MAX_STA;
+    ap_config.ap.authmode = (strlen(CONFIG_ESP_LCP_SOFTAP_PASSWORD) == 0) ? WIFI_AUTH_OPEN : WIFI_AUTH_WPA2_PSK;
+
+    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_AP, &ap_config));
+}
+#endif
+
 bool wifi_srv_station_start(uint8_t *ssid, uint8_t *pw)
 {
     s_wifi_event_group = xEventGroupCreate();
@@ -135,6 +159,9 @@ bool wifi_srv_station_start(uint8_t *ssid, uint8_t *pw)
     ESP_ERROR_CHECK(esp_netif_init());
     ESP_ERROR_CHECK(esp_event_loop_create_default());
     esp_netif_create_default_wifi_sta();
+#if CONFIG_ESP_LCP_SOFTAP
+    esp_netif_create_default_wifi_ap();
+#endif
 
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
     ESP_ERROR_CHECK(esp_wifi_init(&cfg));
@@ -175,7 +202,12 @@ bool wifi_srv_station_start(uint8_t *ssid, uint8_t *pw)
         strcpy((char *)wifi_pw, (char *)pw);
     }
 
+#if CONFIG_ESP_LCP_SOFTAP
+    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_APSTA));
+    wifi_srv_softap_config();
+#else
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
+#endif
     ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
     ESP_ERROR_CHECK(esp_wifi_start());
 
@@ -188,6 +220,8 @@ bool wifi_srv_station_start(uint8_t *ssid, uint8_t *pw)
     else
     {
         esp_wifi_get_mac(WIFI_IF_STA, cached_mac);
+        is_mac_initialized = true;
+        wifi_mac_set_current(cached_mac);
         return true;
     }
 }
@@ -198,31 +232,23 @@ uint8_t* get_wifi_srv_mac_address(void)
     {
         esp_wifi_get_mac(ESP_IF_WIFI_STA, cached_mac);
         is_mac_initialized = true;
+        wifi_mac_set_current(cached_mac);
     }
     return cached_mac;
 }
 
-bool is_current_wifi_srv_mac(const uint8_t *mac)
+#if CONFIG_ESP_LCP_SOFTAP
+uint8_t* get_wifi_srv_ap_mac_address(void)
 {
-    uint8_t *current_mac = get_wifi_srv_mac_address();
-    return memcmp(current_mac, mac, WIFI_MAC_LEN) == 0;
-}
-
-bool is_broadcast_address(const uint8_t *mac)
-{
-    for (int i = 0; i < WIFI_MAC_LEN; i++)
-    {
-        if (mac[i] != 0xFF)
-        {
-            return false;
-        }
-    }
-    return true;
+    esp_wifi_get_mac(WIFI_IF_AP, cached_ap_mac);
+    return cached_ap_mac;
 }
+#endif
 
-bool is_multicast_address(const uint8_t *mac)
+/* BSSID of the AP the station is associated with, used as Addr1 of host->air data frames */
+uint8_t* get_wifi_srv_bssid(void)
 {
-    return (mac[0] & 0x01) == 1;
+    return cached_bssid;
 }
 
 void check_promiscuous_filter(void)